@@ -6,20 +6,116 @@
  */
 
 #include "agentmail.h"
-#include <esp_log.h>
-#include <esp_http_client.h>
+#include "agentmail_arena.h"
+#include "agentmail_hmac.h"
+#include "agentmail_json.h"
+#include "agentmail_mime.h"
+#include "agentmail_port.h"
+#include "agentmail_store.h"
+#include "agentmail_transport.h"
 #include <cJSON.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
-
-#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-#include <esp_crt_bundle.h>
-#endif
+#include <sys/stat.h>
+#include <time.h>
 
 static const char *TAG = "agentmail";
 static const char *DEFAULT_BASE_URL = "https://api.agentmail.to/v0";
 static const int DEFAULT_TIMEOUT_MS = 10000;
 static const int MAX_HTTP_RESPONSE_SIZE = 32768; // 32KB
+static const size_t LIST_ARENA_BLOCK_SIZE = 4096;
+static const size_t PAYLOAD_BUFFER_SIZE = 512;   // Initial request payload buffer
+static const size_t PAYLOAD_BUFFER_MAX = 2048;   // Larger payloads are streamed
+static const int DOWNLOAD_MAX_RESUMES = 5;       // Range requests after a dropped download
+static const int DEFAULT_ASYNC_QUEUE_LEN = 8;
+static const uint32_t ASYNC_TASK_STACK_SIZE = 6144;
+static const int ASYNC_TASK_PRIORITY = 5;
+static const uint32_t DEFAULT_RETRY_BASE_DELAY_MS = 500;
+static const uint32_t DEFAULT_RETRY_MAX_DELAY_MS = 30000;
+static const int VALIDATOR_CACHE_SIZE = 8;
+static const size_t VALIDATOR_MAX_LEN = 128;
+static const char *DEFAULT_WS_URL = "wss://ws.agentmail.to/v0";
+static const uint32_t DEFAULT_RECONNECT_DELAY_MS = 1000;
+static const uint32_t DEFAULT_RECONNECT_MAX_DELAY_MS = 60000;
+static const uint32_t DEFAULT_PING_INTERVAL_MS = 30000;
+static const int SUBSCRIBE_RECEIVE_SLICE_MS = 250;
+static const uint32_t SUBSCRIBE_TASK_STACK_SIZE = 8192;
+static const int CATCH_UP_LIMIT = 20;
+static const int DEFAULT_SYNC_PAGE_SIZE = 20;
+static const int DEFAULT_SYNC_MAX_PAGES = 10;
+static const int RECENT_EVENT_IDS = 16;
+static const char *DEFAULT_WEBHOOK_PATH = "/agentmail/webhook";
+static const uint32_t DEFAULT_WEBHOOK_TOLERANCE_S = 300;
+static const time_t MIN_VALID_UNIX_TIME = 1600000000; // Earlier means the clock was never set
+
+/**
+ * HTTP response buffer
+ *
+ * When on_data is set a successful (2xx) body is streamed to it instead
+ * of being buffered; size then counts the bytes streamed. Error bodies
+ * are always buffered so they never reach the caller's sink.
+ */
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t capacity;
+    int status_code;                // Status of the response being received
+    int64_t retry_after_ms;         // From Retry-After (-1 if absent or unusable)
+    agentmail_err_t (*on_data)(void *ctx, const char *data, size_t len);
+    void *on_data_ctx;
+    bool stream_response;           // on_data may stop a large body early (see agentmail_http_request_t)
+    bool want_validators;           // Capture ETag/Last-Modified
+    char *etag;                     // Captured ETag (caller frees)
+    char *last_modified;            // Captured Last-Modified (caller frees)
+} http_response_t;
+
+/**
+ * Cache validators of a previous response, keyed by request path and
+ * projection (see validator_key())
+ */
+typedef struct {
+    char *key;
+    char *etag;
+    char *last_modified;
+    uint32_t last_used;
+} validator_entry_t;
+
+/**
+ * Cached message: one block holding the entry, the attachment array and
+ * every string, charged against the cache size as a whole
+ */
+typedef struct message_cache_entry {
+    struct message_cache_entry *prev; // More recently used
+    struct message_cache_entry *next; // Less recently used
+    uint32_t hash;                  // key_hash(message.message_id)
+    size_t size;                    // Bytes of the block
+    agentmail_message_t message;    // Points into the block
+} message_cache_entry_t;
+
+/**
+ * LRU cache of messages, bounded in bytes
+ */
+typedef struct {
+    size_t capacity;                // 0: disabled
+    size_t used;
+    message_cache_entry_t *head;    // Most recently used
+    message_cache_entry_t *tail;    // Least recently used
+    uint32_t hits;
+    uint32_t misses;
+} message_cache_t;
+
+/**
+ * Token bucket, kept as the time at which it will be full again
+ * (generic cell rate algorithm), so no periodic refill is needed
+ */
+typedef struct {
+    int64_t interval_us;            // Time to refill one token (0: unlimited)
+    int64_t tolerance_us;           // (burst - 1) * interval_us
+    int64_t full_at_us;
+} rate_bucket_t;
 
 /**
  * Internal client structure
@@ -29,18 +125,36 @@ typedef struct {
     char *base_url;
     int timeout_ms;
     bool enable_logging;
+    bool use_arena;                 // Allocate list results from an arena
+    bool decode_in_place;           // Point results into the response body
     void *ctx;
+    const agentmail_transport_t *transport;
+    void *conn;                     // Persistent keep-alive connection
+    char *auth_header;              // "Bearer <api_key>"
+    const char *headers[5];         // Invariant request headers (name/value pairs)
+    http_response_t *response;      // Response buffer of the request in flight
+    int64_t attempt_start_us;       // Start of the attempt in flight, for handshake timing
+    bool attempt_connected;         // The attempt in flight opened a new connection
+    agentmail_mutex_t lock;         // Serializes use of the shared connection
+    agentmail_mutex_t payload_lock; // Guards payload from serialization until the request completes
+    char *payload;                  // Reusable request payload buffer
+    size_t payload_cap;
+    agentmail_mutex_t stats_lock;   // Guards stats (not held during requests)
+    agentmail_stats_t stats;
+    agentmail_retry_policy_t retry;
+    agentmail_mutex_t limiter_lock; // Guards the rate buckets
+    rate_bucket_t rate_all;         // Shared by every request
+    rate_bucket_t rate_class[AGENTMAIL_ENDPOINT_CLASS_COUNT];
+    int async_queue_len;
+    agentmail_mutex_t async_lock;   // Guards lazy start of the async worker
+    agentmail_queue_t async_queue;  // Pending async_job_t (NULL until first async call)
+    agentmail_task_t async_worker;
+    validator_entry_t validators[VALIDATOR_CACHE_SIZE]; // Guarded by lock
+    uint32_t validator_clock;
+    agentmail_mutex_t cache_lock;   // Guards cache (not held during requests)
+    message_cache_t cache;
 } agentmail_client_t;
 
-/**
- * HTTP response buffer
- */
-typedef struct {
-    char *buffer;
-    size_t size;
-    size_t capacity;
-} http_response_t;
-
 /**
  * URL encode a string (specifically handles @ symbol in email addresses)
  * Returns a newly allocated string that must be freed by caller
@@ -84,327 +198,2413 @@ static char* url_encode(const char* str) {
 }
 
 /**
- * HTTP event handler for accumulating response data
+ * Sink callback for accumulating response data
+ *
+ * A body that outgrows MAX_HTTP_RESPONSE_SIZE (or the heap) aborts the
+ * transfer with AGENTMAIL_ERR_NO_MEM rather than being parsed truncated.
  */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
-    http_response_t *response = (http_response_t *)evt->user_data;
-    
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                // Ensure buffer capacity
-                size_t new_size = response->size + evt->data_len;
-                if (new_size >= response->capacity) {
-                    // Grow buffer (double or fit new size)
-                    size_t new_capacity = (new_size * 2 > MAX_HTTP_RESPONSE_SIZE) 
-                                          ? MAX_HTTP_RESPONSE_SIZE 
-                                          : new_size * 2;
-                    if (new_capacity <= response->capacity) {
-                        ESP_LOGE(TAG, "Response too large, dropping data");
-                        break;
-                    }
-                    char *new_buffer = (char *)realloc(response->buffer, new_capacity);
-                    if (new_buffer == NULL) {
-                        ESP_LOGE(TAG, "Failed to grow response buffer");
-                        break;
-                    }
-                    response->buffer = new_buffer;
-                    response->capacity = new_capacity;
-                }
-                // Append data
-                memcpy(response->buffer + response->size, evt->data, evt->data_len);
-                response->size += evt->data_len;
-                response->buffer[response->size] = '\0';
-            }
-            break;
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP event error");
-            break;
-        default:
-            break;
+static agentmail_err_t http_on_data(void *ctx, const char *data, size_t len) {
+    agentmail_client_t *client = (agentmail_client_t *)ctx;
+    http_response_t *response = client->response;
+
+    // A backend that doesn't report the status up front streams everything
+    bool success = response->status_code == 0 ||
+                   (response->status_code >= 200 && response->status_code < 300);
+    if (response->on_data != NULL && success) {
+        response->size += len;
+        return response->on_data(response->on_data_ctx, data, len);
+    }
+
+    // Ensure buffer capacity
+    size_t new_size = response->size + len;
+    if (new_size >= response->capacity) {
+        // Grow buffer (double or fit new size)
+        size_t new_capacity = (new_size * 2 > MAX_HTTP_RESPONSE_SIZE) 
+                              ? MAX_HTTP_RESPONSE_SIZE 
+                              : new_size * 2;
+        if (new_capacity <= response->capacity || new_size >= new_capacity) {
+            ESP_LOGE(TAG, "Response larger than %d bytes, aborting", MAX_HTTP_RESPONSE_SIZE);
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        char *new_buffer = (char *)realloc(response->buffer, new_capacity);
+        if (new_buffer == NULL) {
+            ESP_LOGE(TAG, "Failed to grow response buffer");
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        response->buffer = new_buffer;
+        response->capacity = new_capacity;
     }
-    return ESP_OK;
+    // Append data
+    memcpy(response->buffer + response->size, data, len);
+    response->size += len;
+    response->buffer[response->size] = '\0';
+    return AGENTMAIL_ERR_NONE;
 }
 
 /**
- * Helper function to perform HTTP request
+ * Sink callback recording the status before the body arrives
  */
-static agentmail_err_t perform_http_request(
-    agentmail_client_t *client,
-    const char *method,
-    const char *path,
-    const char *body,
-    http_response_t *response,
-    int *status_code
-) {
-    if (client == NULL || path == NULL || response == NULL || status_code == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
+static void http_on_status(void *ctx, int status_code) {
+    agentmail_client_t *client = (agentmail_client_t *)ctx;
+    client->response->status_code = status_code;
+}
 
-    // Build full URL
-    char url[512];
-    snprintf(url, sizeof(url), "%s%s", client->base_url, path);
+/**
+ * Sink callback counting new connections and the time spent setting them up
+ */
+static void http_on_connected(void *ctx) {
+    agentmail_client_t *client = (agentmail_client_t *)ctx;
+    uint32_t elapsed_ms = (uint32_t)((agentmail_time_us() - client->attempt_start_us) / 1000);
+    client->attempt_connected = true;
+    agentmail_mutex_lock(client->stats_lock);
+    client->stats.handshakes++;
+    client->stats.handshake_time_ms += elapsed_ms;
+    client->stats.last_handshake_ms = elapsed_ms;
+    agentmail_mutex_unlock(client->stats_lock);
+}
 
-    if (client->enable_logging) {
-        ESP_LOGI(TAG, "%s %s", method, url);
-        if (body) {
-            ESP_LOGD(TAG, "Body: %s", body);
-        }
+/**
+ * Parse a Retry-After value (delta-seconds or HTTP-date) into milliseconds
+ *
+ * Returns -1 if the value can't be used, e.g. a date while the system
+ * clock hasn't been set yet.
+ */
+static int64_t parse_retry_after(const char *value) {
+    while (*value == ' ') value++;
+    if (*value >= '0' && *value <= '9') {
+        return (int64_t)strtoll(value, NULL, 10) * 1000;
     }
 
-    // Initialize response buffer
-    response->buffer = (char *)calloc(1, 4096);
-    if (response->buffer == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
+    // IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    int day, year, hour, min, sec;
+    char mon[4] = {};
+    if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d", &day, mon, &year, &hour, &min, &sec) != 6) {
+        return -1;
     }
-    response->capacity = 4096;
-    response->size = 0;
-
-    // Configure HTTP client
-    esp_http_client_config_t http_config = {};
-    http_config.url = url;
-    http_config.timeout_ms = client->timeout_ms;
-    http_config.event_handler = http_event_handler;
-    http_config.user_data = response;
-    http_config.buffer_size = 2048;
-    http_config.buffer_size_tx = 2048;
-#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-    http_config.crt_bundle_attach = esp_crt_bundle_attach;
-#endif
-
-    esp_http_client_handle_t http_client = esp_http_client_init(&http_config);
-    if (http_client == NULL) {
-        free(response->buffer);
-        return AGENTMAIL_ERR_HTTP;
+    const char *found = strstr(MONTHS, mon);
+    if (found == NULL || strlen(mon) != 3 || (found - MONTHS) % 3 != 0) {
+        return -1;
+    }
+    int month = (int)(found - MONTHS) / 3 + 1;
+
+    // Days since the epoch for a proleptic Gregorian date
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    int64_t then = days * 86400 + hour * 3600 + min * 60 + sec;
+
+    int64_t now = (int64_t)time(NULL);
+    if (now < 1577836800) {
+        return -1;  // Clock not synchronized (before 2020)
     }
+    return (then > now) ? (then - now) * 1000 : 0;
+}
 
-    // Set method
-    if (strcmp(method, "GET") == 0) {
-        esp_http_client_set_method(http_client, HTTP_METHOD_GET);
-    } else if (strcmp(method, "POST") == 0) {
-        esp_http_client_set_method(http_client, HTTP_METHOD_POST);
-    } else if (strcmp(method, "PUT") == 0) {
-        esp_http_client_set_method(http_client, HTTP_METHOD_PUT);
-    } else if (strcmp(method, "DELETE") == 0) {
-        esp_http_client_set_method(http_client, HTTP_METHOD_DELETE);
-    } else if (strcmp(method, "PATCH") == 0) {
-        esp_http_client_set_method(http_client, HTTP_METHOD_PATCH);
+/**
+ * Sink callback picking up headers the client acts on
+ */
+static void http_on_header(void *ctx, const char *key, const char *value) {
+    agentmail_client_t *client = (agentmail_client_t *)ctx;
+    http_response_t *response = client->response;
+    if (strcasecmp(key, "Retry-After") == 0) {
+        response->retry_after_ms = parse_retry_after(value);
+    } else if (response->want_validators && strlen(value) < VALIDATOR_MAX_LEN) {
+        if (strcasecmp(key, "ETag") == 0) {
+            free(response->etag);
+            response->etag = strdup(value);
+        } else if (strcasecmp(key, "Last-Modified") == 0) {
+            free(response->last_modified);
+            response->last_modified = strdup(value);
+        }
     }
+}
+
+/**
+ * Drop validators captured by an earlier attempt
+ */
+static void clear_validators(http_response_t *response) {
+    free(response->etag);
+    free(response->last_modified);
+    response->etag = NULL;
+    response->last_modified = NULL;
+}
 
-    // Set headers
-    char auth_header[512];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", client->api_key);
-    esp_http_client_set_header(http_client, "Authorization", auth_header);
-    esp_http_client_set_header(http_client, "Content-Type", "application/json");
-    esp_http_client_set_header(http_client, "User-Agent", "PlaiPin-AgentMail/1.0");
+/**
+ * Whether repeating a request can't take effect twice
+ */
+static bool method_idempotent(const char *method) {
+    return strcmp(method, "GET") == 0 || strcmp(method, "PUT") == 0 ||
+           strcmp(method, "DELETE") == 0 || strcmp(method, "HEAD") == 0;
+}
 
-    // Set body if provided
-    if (body != NULL) {
-        esp_http_client_set_post_field(http_client, body, strlen(body));
+/**
+ * Perform one attempt of a request and map the status code to an error
+ */
+static agentmail_err_t perform_http_attempt(
+    agentmail_client_t *client,
+    const agentmail_http_request_t *request,
+    const agentmail_http_sink_t *sink,
+    http_response_t *response,
+    int *status_code
+) {
+    // Initialize response buffer (not needed when streaming)
+    free(response->buffer);
+    response->buffer = NULL;
+    response->capacity = 0;
+    response->size = 0;
+    response->status_code = 0;
+    response->retry_after_ms = -1;
+    clear_validators(response);
+    if (response->on_data == NULL) {
+        response->buffer = (char *)calloc(1, 4096);
+        if (response->buffer == NULL) {
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        response->capacity = 4096;
     }
 
+    agentmail_mutex_lock(client->lock);
+    client->response = response;
+
     // Perform request
     agentmail_err_t result = AGENTMAIL_ERR_NONE;
-    esp_err_t err = esp_http_client_perform(http_client);
-    *status_code = esp_http_client_get_status_code(http_client);
-
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        result = (err == ESP_ERR_TIMEOUT) ? AGENTMAIL_ERR_TIMEOUT : AGENTMAIL_ERR_NETWORK;
-    } else {
-        if (client->enable_logging) {
-            ESP_LOGI(TAG, "Status: %d, Response size: %zu", *status_code, response->size);
-            if (response->size > 0 && response->size < 1024) {
-                ESP_LOGD(TAG, "Response: %s", response->buffer);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        *status_code = 0;
+        client->attempt_start_us = agentmail_time_us();
+        client->attempt_connected = false;
+        result = client->transport->perform(client->conn, request, sink, status_code);
+        bool reused = !client->attempt_connected;
+        if (result == AGENTMAIL_ERR_NONE) {
+            if (reused) {
+                agentmail_mutex_lock(client->stats_lock);
+                client->stats.connections_reused++;
+                agentmail_mutex_unlock(client->stats_lock);
             }
+            break;
+        }
+        // The server may have closed the idle keep-alive connection; a
+        // fresh connection is attempted once before reporting the error.
+        // A body that was already partly streamed can't be replayed, and
+        // neither can a POST the server may have processed before the
+        // connection dropped: that is left to retry_non_idempotent.
+        if (!reused || attempt > 0 || result != AGENTMAIL_ERR_NETWORK ||
+            !method_idempotent(request->method) ||
+            (response->on_data != NULL && response->size > 0)) {
+            break;
+        }
+        ESP_LOGD(TAG, "Kept-alive connection dropped, reconnecting");
+        client->transport->close(client->conn);
+        agentmail_mutex_lock(client->stats_lock);
+        client->stats.reconnects++;
+        agentmail_mutex_unlock(client->stats_lock);
+        response->size = 0;
+        response->status_code = 0;
+        response->retry_after_ms = -1;
+        clear_validators(response);
+        if (response->buffer != NULL) {
+            response->buffer[0] = '\0';
         }
+    }
 
-        // Map HTTP status codes to errors
-        if (*status_code >= 200 && *status_code < 300) {
-            result = AGENTMAIL_ERR_NONE;
-        } else if (*status_code == 401 || *status_code == 403) {
-            result = AGENTMAIL_ERR_AUTH;
-        } else if (*status_code == 404) {
-            result = AGENTMAIL_ERR_NOT_FOUND;
-        } else if (*status_code == 429) {
-            result = AGENTMAIL_ERR_RATE_LIMIT;
-        } else if (*status_code >= 500) {
-            result = AGENTMAIL_ERR_SERVER;
-        } else {
-            result = AGENTMAIL_ERR_OTHER;
+    client->response = NULL;
+    agentmail_mutex_unlock(client->lock);
+
+    if (result != AGENTMAIL_ERR_NONE) {
+        return result;
+    }
+
+    if (client->enable_logging) {
+        ESP_LOGI(TAG, "Status: %d, Response size: %zu", *status_code, response->size);
+        if (response->buffer != NULL && response->size > 0 && response->size < 1024) {
+            ESP_LOGD(TAG, "Response: %s", response->buffer);
         }
     }
 
-    esp_http_client_cleanup(http_client);
+    // Map HTTP status codes to errors
+    if (*status_code >= 200 && *status_code < 300) {
+        result = AGENTMAIL_ERR_NONE;
+    } else if (*status_code == 304) {
+        result = AGENTMAIL_ERR_NOT_MODIFIED;
+    } else if (*status_code == 401 || *status_code == 403) {
+        result = AGENTMAIL_ERR_AUTH;
+    } else if (*status_code == 404) {
+        result = AGENTMAIL_ERR_NOT_FOUND;
+    } else if (*status_code == 429) {
+        result = AGENTMAIL_ERR_RATE_LIMIT;
+    } else if (*status_code >= 500) {
+        result = AGENTMAIL_ERR_SERVER;
+    } else {
+        result = AGENTMAIL_ERR_OTHER;
+    }
+
     return result;
 }
 
-// ============================================================================
-// Public API Implementation
-// ============================================================================
-
-agentmail_err_t agentmail_init(
-    const agentmail_config_t *config,
-    agentmail_handle_t *handle
+/**
+ * Decide whether a failed attempt may be retried and after how long
+ */
+static bool retry_delay(
+    const agentmail_client_t *client,
+    const char *method,
+    agentmail_err_t err,
+    const http_response_t *response,
+    int attempt,
+    uint32_t *delay_ms
 ) {
-    if (config == NULL || config->api_key == NULL || handle == NULL) {
-        ESP_LOGE(TAG, "Invalid arguments");
-        return AGENTMAIL_ERR_INVALID_ARG;
+    const agentmail_retry_policy_t *policy = &client->retry;
+
+    // Part of a successful body already reached the caller
+    bool success = response->status_code >= 200 && response->status_code < 300;
+    if (response->on_data != NULL && success && response->size > 0) {
+        return false;
     }
 
-    agentmail_client_t *client = (agentmail_client_t *)calloc(1, sizeof(agentmail_client_t));
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate client");
-        return AGENTMAIL_ERR_NO_MEM;
+    // A 429 means the request was rejected unprocessed, so it is always
+    // safe to repeat. Other failures may have taken effect server-side.
+    bool idempotent = method_idempotent(method);
+    if (err == AGENTMAIL_ERR_RATE_LIMIT) {
+        // Always retryable
+    } else if (err == AGENTMAIL_ERR_SERVER || err == AGENTMAIL_ERR_NETWORK ||
+               err == AGENTMAIL_ERR_TIMEOUT) {
+        if (!idempotent && !policy->retry_non_idempotent) {
+            return false;
+        }
+    } else {
+        return false;
     }
 
-    client->api_key = strdup(config->api_key);
-    client->base_url = strdup(config->base_url ? config->base_url : DEFAULT_BASE_URL);
-    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : DEFAULT_TIMEOUT_MS;
-    client->enable_logging = config->enable_logging;
-    client->ctx = config->ctx;
+    uint32_t base = policy->base_delay_ms ? policy->base_delay_ms : DEFAULT_RETRY_BASE_DELAY_MS;
+    uint32_t cap = policy->max_delay_ms ? policy->max_delay_ms : DEFAULT_RETRY_MAX_DELAY_MS;
 
-    if (client->api_key == NULL || client->base_url == NULL) {
-        free(client->api_key);
-        free(client->base_url);
-        free(client);
-        return AGENTMAIL_ERR_NO_MEM;
+    if (response->retry_after_ms >= 0) {
+        // Wait exactly as long as the server asks, unless that exceeds
+        // what the caller is willing to wait
+        if (response->retry_after_ms > (int64_t)cap) {
+            return false;
+        }
+        *delay_ms = (uint32_t)response->retry_after_ms;
+        return true;
     }
 
-    *handle = (agentmail_handle_t)client;
-    ESP_LOGI(TAG, "AgentMail client initialized (base: %s)", client->base_url);
-
-    return AGENTMAIL_ERR_NONE;
+    // Exponential backoff with jitter over the upper half of the window
+    uint32_t window = base;
+    for (int i = 1; i < attempt && window < cap; i++) {
+        window *= 2;
+    }
+    if (window > cap) {
+        window = cap;
+    }
+    *delay_ms = window / 2 + agentmail_random() % (window / 2 + 1);
+    return true;
 }
 
-agentmail_err_t agentmail_destroy(agentmail_handle_t handle) {
-    if (handle == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
+static void rate_bucket_init(rate_bucket_t *bucket, const agentmail_rate_limit_t *limit) {
+    memset(bucket, 0, sizeof(rate_bucket_t));
+    if (limit->requests_per_sec > 0) {
+        uint32_t burst = limit->burst > 0 ? limit->burst : 1;
+        bucket->interval_us = (int64_t)(1000000.0f / limit->requests_per_sec);
+        bucket->tolerance_us = (int64_t)(burst - 1) * bucket->interval_us;
     }
+}
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    free(client->api_key);
-    free(client->base_url);
-    free(client);
-
-    ESP_LOGI(TAG, "AgentMail client destroyed");
-    return AGENTMAIL_ERR_NONE;
+/**
+ * Earliest time a token is available in the bucket
+ */
+static int64_t rate_bucket_available_at(const rate_bucket_t *bucket, int64_t now) {
+    if (bucket->interval_us == 0) return now;
+    int64_t at = bucket->full_at_us - bucket->tolerance_us;
+    return at > now ? at : now;
 }
 
-// ============================================================================
-// Inbox Operations
-// ============================================================================
+static void rate_bucket_take(rate_bucket_t *bucket, int64_t at) {
+    if (bucket->interval_us == 0) return;
+    int64_t full_at = bucket->full_at_us > at ? bucket->full_at_us : at;
+    bucket->full_at_us = full_at + bucket->interval_us;
+}
 
-agentmail_err_t agentmail_inbox_create(
-    agentmail_handle_t handle,
-    const agentmail_inbox_options_t *options,
-    agentmail_inbox_t *inbox
-) {
-    if (handle == NULL || inbox == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
+static agentmail_endpoint_class_t endpoint_class(const char *method, const char *path) {
+    if (strcmp(method, "GET") == 0) {
+        return AGENTMAIL_ENDPOINT_READ;
     }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    memset(inbox, 0, sizeof(agentmail_inbox_t));
-
-    // Build JSON payload
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
+    const char *last = strrchr(path, '/');
+    if (strcmp(method, "POST") == 0 && last != NULL &&
+        (strcmp(last, "/send") == 0 || strcmp(last, "/reply") == 0)) {
+        return AGENTMAIL_ENDPOINT_SEND;
     }
+    return AGENTMAIL_ENDPOINT_WRITE;
+}
 
-    if (options != NULL) {
-        if (options->name != NULL) {
-            cJSON_AddStringToObject(json, "name", options->name);
-        }
-        if (options->metadata != NULL) {
-            cJSON *metadata = cJSON_Parse(options->metadata);
-            if (metadata != NULL) {
-                cJSON_AddItemToObject(json, "metadata", metadata);
-            }
-        }
+/**
+ * Wait until both the shared and the endpoint class bucket have a token
+ *
+ * The tokens are reserved before sleeping, so concurrent callers are
+ * spaced out in arrival order rather than all waking at once.
+ */
+static void rate_limit_wait(agentmail_client_t *client, agentmail_endpoint_class_t cls) {
+    rate_bucket_t *class_bucket = &client->rate_class[cls];
+    if (client->rate_all.interval_us == 0 && class_bucket->interval_us == 0) {
+        return;
     }
 
-    char *payload = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-    if (payload == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
+    agentmail_mutex_lock(client->limiter_lock);
+    int64_t now = agentmail_time_us();
+    int64_t at = rate_bucket_available_at(&client->rate_all, now);
+    int64_t class_at = rate_bucket_available_at(class_bucket, now);
+    if (class_at > at) {
+        at = class_at;
     }
+    rate_bucket_take(&client->rate_all, at);
+    rate_bucket_take(class_bucket, at);
+    agentmail_mutex_unlock(client->limiter_lock);
+
+    if (at > now) {
+        uint32_t wait_ms = (uint32_t)((at - now + 999) / 1000);
+        ESP_LOGD(TAG, "Rate limited, waiting %lu ms", (unsigned long)wait_ms);
+        agentmail_delay_ms(wait_ms);
+
+        agentmail_mutex_lock(client->stats_lock);
+        client->stats.throttled++;
+        client->stats.throttle_wait_ms += wait_ms;
+        agentmail_mutex_unlock(client->stats_lock);
+    }
+}
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "POST", "/inboxes", payload, &response, &status_code
-    );
-    free(payload);
+/**
+ * Request body produced while it is sent, for payloads too large to
+ * buffer (see agentmail_http_request_t::write_body)
+ */
+typedef struct {
+    agentmail_err_t (*write)(void *ctx, agentmail_write_cb_t out, void *out_ctx);
+    void *ctx;
+    size_t len;                     // Exact number of bytes write produces
+} body_stream_t;
 
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+/**
+ * Helper function to perform HTTP request, retrying per the client's policy
+ *
+ * The body is either the string body or, when stream is set, produced
+ * afresh for every attempt. extra_headers is an optional NULL-terminated
+ * list of up to three name/value pairs sent with this request only.
+ */
+static agentmail_err_t perform_http_request_with_headers(
+    agentmail_client_t *client,
+    const char *method,
+    const char *path,
+    const char *body,
+    const body_stream_t *stream,
+    const char *const *extra_headers,
+    http_response_t *response,
+    int *status_code
+) {
+    if (client == NULL || path == NULL || response == NULL || status_code == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
     }
 
-    // Parse response
-    cJSON *res_json = cJSON_Parse(response.buffer);
-    free(response.buffer);
-    
-    if (res_json == NULL) {
-        ESP_LOGE(TAG, "Failed to parse response");
-        return AGENTMAIL_ERR_PARSE;
+    if (client->enable_logging) {
+        ESP_LOGI(TAG, "%s %s%s", method, client->base_url, path);
+        if (body) {
+            ESP_LOGD(TAG, "Body: %s", body);
+        } else if (stream) {
+            ESP_LOGD(TAG, "Body: %zu bytes, streamed", stream->len);
+        }
     }
 
-    // Extract inbox info from v0 API response
-    cJSON *inbox_id = cJSON_GetObjectItem(res_json, "inbox_id");
-    cJSON *address = cJSON_GetObjectItem(res_json, "address");
-    cJSON *name = cJSON_GetObjectItem(res_json, "name");
-    cJSON *created_at = cJSON_GetObjectItem(res_json, "created_at");
-    cJSON *metadata = cJSON_GetObjectItem(res_json, "metadata");
-
-    if (cJSON_IsString(inbox_id)) {
-        inbox->inbox_id = strdup(inbox_id->valuestring);
+    const char *headers[9];
+    size_t header_count = 0;
+    if (body || stream) {
+        headers[header_count++] = "Content-Type";
+        headers[header_count++] = "application/json";
     }
-    if (cJSON_IsString(address)) {
-        inbox->email_address = strdup(address->valuestring);
+    for (const char *const *h = extra_headers; h != NULL && h[0] != NULL && header_count < 8; h += 2) {
+        headers[header_count++] = h[0];
+        headers[header_count++] = h[1];
     }
-    if (cJSON_IsString(name)) {
-        inbox->name = strdup(name->valuestring);
+    headers[header_count] = NULL;
+
+    agentmail_http_request_t request = {};
+    request.method = method;
+    request.path = path;
+    request.body = body;
+    request.body_len = body ? strlen(body) : 0;
+    request.headers = header_count ? headers : NULL;
+    request.stream_response = response->stream_response;
+    if (stream != NULL) {
+        request.write_body = stream->write;
+        request.body_ctx = stream->ctx;
+        request.body_len = stream->len;
     }
-    if (cJSON_IsString(created_at)) {
-        inbox->created_at = strdup(created_at->valuestring);
-    }
-    if (cJSON_IsString(metadata)) {
-        inbox->metadata = strdup(metadata->valuestring);
-    } else if (cJSON_IsObject(metadata)) {
-        char *metadata_str = cJSON_PrintUnformatted(metadata);
-        if (metadata_str) {
-            inbox->metadata = metadata_str;
+
+    agentmail_http_sink_t sink = {};
+    sink.on_connected = http_on_connected;
+    sink.on_status = http_on_status;
+    sink.on_header = http_on_header;
+    sink.on_data = http_on_data;
+    sink.ctx = client;
+
+    agentmail_endpoint_class_t cls = endpoint_class(method, path);
+    int max_attempts = client->retry.max_attempts > 1 ? client->retry.max_attempts : 1;
+    agentmail_err_t result = AGENTMAIL_ERR_NONE;
+    uint32_t waited_ms = 0;
+    int attempt = 1;
+    for (;; attempt++) {
+        rate_limit_wait(client, cls);
+        result = perform_http_attempt(client, &request, &sink, response, status_code);
+        uint32_t delay_ms = 0;
+        if (result == AGENTMAIL_ERR_NONE || attempt >= max_attempts ||
+            !retry_delay(client, method, result, response, attempt, &delay_ms)) {
+            break;
         }
+        ESP_LOGW(TAG, "%s %s failed (%s), retrying in %lu ms (attempt %d/%d)", method, path,
+                 agentmail_err_to_str(result), (unsigned long)delay_ms, attempt + 1, max_attempts);
+        agentmail_delay_ms(delay_ms);
+        waited_ms += delay_ms;
     }
 
-    cJSON_Delete(res_json);
-
-    if (inbox->inbox_id) {
-        ESP_LOGI(TAG, "Created inbox: %s", inbox->inbox_id);
+    agentmail_mutex_lock(client->stats_lock);
+    client->stats.requests++;
+    client->stats.retries += attempt - 1;
+    client->stats.retry_wait_ms += waited_ms;
+    client->stats.last_attempts = attempt;
+    if (result == AGENTMAIL_ERR_NOT_MODIFIED) {
+        client->stats.not_modified++;
     }
+    agentmail_mutex_unlock(client->stats_lock);
 
-    return AGENTMAIL_ERR_NONE;
+    return result;
 }
 
-agentmail_err_t agentmail_inbox_get(
-    agentmail_handle_t handle,
-    const char *inbox_id,
-    agentmail_inbox_t *inbox
+static agentmail_err_t perform_http_request(
+    agentmail_client_t *client,
+    const char *method,
+    const char *path,
+    const char *body,
+    http_response_t *response,
+    int *status_code
 ) {
-    if (handle == NULL || inbox_id == NULL || inbox == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    memset(inbox, 0, sizeof(agentmail_inbox_t));
+    return perform_http_request_with_headers(client, method, path, body, NULL, NULL, response, status_code);
+}
 
-    // Build path
-    char path[256];
-    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
+/**
+ * Build the validator cache key of a list query: the request path plus
+ * the client-side projection, so a metadata-only poll and a full poll of
+ * the same inbox don't answer each other's 304s
+ */
+static void validator_key(char *key, size_t key_len, const char *path, uint32_t fields) {
+    snprintf(key, key_len, "%s#%08lx", path, (unsigned long)fields);
+}
+
+/**
+ * Find the validators cached for key and turn them into conditional
+ * request headers (If-None-Match preferred, If-Modified-Since otherwise)
+ *
+ * headers receives up to one name/value pair and a NULL terminator; the
+ * value is copied to value_buf so it stays valid outside the lock.
+ */
+static void validator_lookup(
+    agentmail_client_t *client,
+    const char *key,
+    char *value_buf,
+    size_t value_len,
+    const char **headers
+) {
+    headers[0] = NULL;
+    agentmail_mutex_lock(client->lock);
+    for (int i = 0; i < VALIDATOR_CACHE_SIZE; i++) {
+        validator_entry_t *entry = &client->validators[i];
+        if (entry->key == NULL || strcmp(entry->key, key) != 0) {
+            continue;
+        }
+        entry->last_used = ++client->validator_clock;
+        if (entry->etag != NULL) {
+            headers[0] = "If-None-Match";
+            snprintf(value_buf, value_len, "%s", entry->etag);
+        } else if (entry->last_modified != NULL) {
+            headers[0] = "If-Modified-Since";
+            snprintf(value_buf, value_len, "%s", entry->last_modified);
+        }
+        break;
+    }
+    agentmail_mutex_unlock(client->lock);
+    headers[1] = value_buf;
+    headers[2] = NULL;
+}
+
+/**
+ * Remember the validators of a successful response under key, evicting the
+ * least recently used entry when the cache is full. A response without
+ * validators removes the entry.
+ */
+static void validator_store(
+    agentmail_client_t *client,
+    const char *key,
+    const char *etag,
+    const char *last_modified
+) {
+    agentmail_mutex_lock(client->lock);
+    validator_entry_t *slot = NULL;
+    for (int i = 0; i < VALIDATOR_CACHE_SIZE; i++) {
+        validator_entry_t *entry = &client->validators[i];
+        if (entry->key != NULL && strcmp(entry->key, key) == 0) {
+            slot = entry;
+            break;
+        }
+        // Otherwise prefer a free slot, then the least recently used
+        if (slot == NULL || (slot->key != NULL &&
+            (entry->key == NULL || entry->last_used < slot->last_used))) {
+            slot = entry;
+        }
+    }
+
+    bool same_key = slot->key != NULL && strcmp(slot->key, key) == 0;
+    if (!same_key && etag == NULL && last_modified == NULL) {
+        agentmail_mutex_unlock(client->lock);
+        return;
+    }
+    free(slot->etag);
+    free(slot->last_modified);
+    slot->etag = NULL;
+    slot->last_modified = NULL;
+    if (!same_key) {
+        free(slot->key);
+        slot->key = strdup(key);
+    }
+    if (slot->key != NULL && (etag != NULL || last_modified != NULL)) {
+        slot->etag = etag ? strdup(etag) : NULL;
+        slot->last_modified = last_modified ? strdup(last_modified) : NULL;
+        slot->last_used = ++client->validator_clock;
+    } else {
+        free(slot->key);
+        slot->key = NULL;
+    }
+    agentmail_mutex_unlock(client->lock);
+}
+
+/**
+ * Copy a decoded JSON string value
+ */
+static char *dup_value(const char *value, size_t len) {
+    char *copy = (char *)malloc(len + 1);
+    if (copy != NULL) {
+        memcpy(copy, value, len + 1);
+    }
+    return copy;
+}
+
+/**
+ * Copy a string into a list result, from the list's arena when it has one
+ */
+static char *list_strndup(agentmail_arena_t *arena, const char *value, size_t len) {
+    return arena ? agentmail_arena_strndup(arena, value, len) : dup_value(value, len);
+}
+
+// ============================================================================
+// Field Tables
+// ============================================================================
+
+/**
+ * FNV-1a hash of a JSON member name, evaluated at compile time for the
+ * tables below and once per member while decoding
+ */
+static constexpr uint32_t key_hash(const char *key) {
+    uint32_t hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (uint8_t)*key) * 16777619u;
+    }
+    return hash;
+}
+
+typedef enum {
+    FIELD_STRING,                  // char *, from a string value
+    FIELD_JSON,                    // char *, from a string value or the text of an object/array
+    FIELD_BOOL,                    // bool, from true/false
+    FIELD_SIZE,                    // size_t, from a number
+    FIELD_ATTACHMENTS,             // agentmail_attachment_info_t * and its count, from an array of objects
+} field_type_t;
+
+/**
+ * One struct member filled in from a JSON object member
+ */
+typedef struct {
+    const char *key;
+    uint32_t hash;                 // key_hash(key)
+    uint16_t offset;               // Offset of the member in the struct
+    uint8_t type;                  // field_type_t
+    uint32_t mask;                 // agentmail_field_t bit (0: always decoded)
+} field_desc_t;
+
+typedef struct {
+    const field_desc_t *fields;
+    size_t count;
+} field_table_t;
+
+#define FIELD(type, key, member, kind, mask) \
+    { key, key_hash(key), (uint16_t)offsetof(type, member), kind, mask }
+
+static const field_desc_t INBOX_FIELDS[] = {
+    FIELD(agentmail_inbox_t, "inbox_id",   inbox_id,      FIELD_STRING, 0),
+    FIELD(agentmail_inbox_t, "address",    email_address, FIELD_STRING, 0),
+    FIELD(agentmail_inbox_t, "name",       name,          FIELD_STRING, 0),
+    FIELD(agentmail_inbox_t, "created_at", created_at,    FIELD_STRING, 0),
+    FIELD(agentmail_inbox_t, "metadata",   metadata,      FIELD_JSON,   0),
+};
+
+static const field_desc_t MESSAGE_FIELDS[] = {
+    FIELD(agentmail_message_t, "message_id", message_id, FIELD_STRING, AGENTMAIL_FIELD_MESSAGE_ID),
+    FIELD(agentmail_message_t, "thread_id",  thread_id,  FIELD_STRING, AGENTMAIL_FIELD_THREAD_ID),
+    FIELD(agentmail_message_t, "from",       from,       FIELD_STRING, AGENTMAIL_FIELD_FROM),
+    FIELD(agentmail_message_t, "to",         to,         FIELD_STRING, AGENTMAIL_FIELD_TO),
+    FIELD(agentmail_message_t, "subject",    subject,    FIELD_STRING, AGENTMAIL_FIELD_SUBJECT),
+    FIELD(agentmail_message_t, "text",       body_text,  FIELD_STRING, AGENTMAIL_FIELD_BODY_TEXT),
+    FIELD(agentmail_message_t, "html",       body_html,  FIELD_STRING, AGENTMAIL_FIELD_BODY_HTML),
+    FIELD(agentmail_message_t, "created_at", timestamp,  FIELD_STRING, AGENTMAIL_FIELD_TIMESTAMP),
+    FIELD(agentmail_message_t, "is_read",    is_read,    FIELD_BOOL,   0),
+    FIELD(agentmail_message_t, "attachments", attachments, FIELD_ATTACHMENTS, AGENTMAIL_FIELD_ATTACHMENTS),
+};
+
+static const field_desc_t ATTACHMENT_FIELDS[] = {
+    FIELD(agentmail_attachment_info_t, "attachment_id", attachment_id, FIELD_STRING, 0),
+    FIELD(agentmail_attachment_info_t, "filename",      filename,      FIELD_STRING, 0),
+    FIELD(agentmail_attachment_info_t, "content_type",  content_type,  FIELD_STRING, 0),
+    FIELD(agentmail_attachment_info_t, "size",          size,          FIELD_SIZE,   0),
+};
+
+// FIELD_ATTACHMENTS stores the count right after the array
+static_assert(offsetof(agentmail_message_t, attachment_count) ==
+              offsetof(agentmail_message_t, attachments) + sizeof(agentmail_attachment_info_t *),
+              "attachment_count must follow attachments");
+
+#undef FIELD
+
+static const field_table_t INBOX_TABLE = {INBOX_FIELDS, sizeof(INBOX_FIELDS) / sizeof(INBOX_FIELDS[0])};
+static const field_table_t MESSAGE_TABLE = {MESSAGE_FIELDS, sizeof(MESSAGE_FIELDS) / sizeof(MESSAGE_FIELDS[0])};
+static const field_table_t ATTACHMENT_TABLE = {ATTACHMENT_FIELDS,
+                                               sizeof(ATTACHMENT_FIELDS) / sizeof(ATTACHMENT_FIELDS[0])};
+
+/**
+ * Find the field for a member name: one hash of the name, then integer
+ * compares; the name itself is compared only on a hash match
+ */
+static const field_desc_t *field_find(const field_table_t *table, const char *key) {
+    uint32_t hash = key_hash(key);
+    for (size_t i = 0; i < table->count; i++) {
+        const field_desc_t *field = &table->fields[i];
+        if (field->hash == hash && strcmp(field->key, key) == 0) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Fills in one struct from the members of a JSON object as decoder events
+ * arrive. Each member is looked up once, on its key; the value event
+ * that follows is stored through the remembered field.
+ */
+typedef struct {
+    const field_table_t *table;
+    void *target;                  // Struct being filled (NULL outside its object)
+    int depth;                     // Depth of the object's members
+    uint32_t fields;               // agentmail_field_t mask of fields to keep
+    bool in_place;                 // Keep pointers into an in-place parsed document
+    agentmail_arena_t *arena;      // Copy strings here instead of malloc() (may be NULL)
+    const field_desc_t *member;    // Field of the member whose value comes next
+    char *attachments;             // FIELD_ATTACHMENTS member while inside its array (NULL otherwise)
+    size_t attachment_capacity;
+    agentmail_attachment_info_t *attachment; // Attachment entry being decoded
+} field_decoder_t;
+
+static agentmail_err_t field_set_string(const field_decoder_t *fd, char **field,
+                                        const char *value, size_t len) {
+    if (fd->in_place) {
+        // Unescaped and NUL-terminated inside the response body already
+        *field = (char *)value;
+        return AGENTMAIL_ERR_NONE;
+    }
+    if (fd->arena == NULL) {
+        free(*field);
+    }
+    *field = list_strndup(fd->arena, value, len);
+    return (*field != NULL) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+}
+
+/**
+ * Store a scalar value event through a table field
+ */
+static agentmail_err_t field_store(const field_decoder_t *fd, const field_desc_t *field, void *target,
+                                   agentmail_json_event_t event, const char *value, size_t len) {
+    char *member = (char *)target + field->offset;
+    switch (field->type) {
+        case FIELD_BOOL:
+            if (event == AGENTMAIL_JSON_TRUE || event == AGENTMAIL_JSON_FALSE) {
+                *(bool *)member = (event == AGENTMAIL_JSON_TRUE);
+            }
+            return AGENTMAIL_ERR_NONE;
+        case FIELD_SIZE:
+            if (event == AGENTMAIL_JSON_NUMBER) {
+                *(size_t *)member = (size_t)strtoull(value, NULL, 10);
+            }
+            return AGENTMAIL_ERR_NONE;
+        case FIELD_JSON:
+            if (event == AGENTMAIL_JSON_RAW) {
+                return field_set_string(fd, (char **)member, value, len);
+            }
+            // fall through
+        case FIELD_STRING:
+            if (event == AGENTMAIL_JSON_STRING) {
+                return field_set_string(fd, (char **)member, value, len);
+            }
+            return AGENTMAIL_ERR_NONE;
+        default:
+            return AGENTMAIL_ERR_NONE;
+    }
+}
+
+/**
+ * Events inside a FIELD_ATTACHMENTS array: one entry per object, filled
+ * in from ATTACHMENT_TABLE
+ */
+static agentmail_err_t field_decoder_on_attachment_event(
+    field_decoder_t *fd,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    agentmail_attachment_info_t **list = (agentmail_attachment_info_t **)fd->attachments;
+    size_t *count = (size_t *)(fd->attachments + sizeof(agentmail_attachment_info_t *));
+
+    if (depth == fd->depth && event == AGENTMAIL_JSON_ARRAY_END) {
+        fd->attachments = NULL;
+        fd->attachment = NULL;
+    } else if (depth == fd->depth + 1 && event == AGENTMAIL_JSON_OBJECT_BEGIN) {
+        if (*count == fd->attachment_capacity) {
+            size_t new_capacity = fd->attachment_capacity ? fd->attachment_capacity * 2 : 2;
+            size_t new_bytes = new_capacity * sizeof(agentmail_attachment_info_t);
+            agentmail_attachment_info_t *grown;
+            if (fd->arena != NULL) {
+                grown = (agentmail_attachment_info_t *)agentmail_arena_alloc(fd->arena, new_bytes);
+                if (grown != NULL && *count > 0) {
+                    memcpy(grown, *list, *count * sizeof(agentmail_attachment_info_t));
+                }
+            } else {
+                grown = (agentmail_attachment_info_t *)realloc(*list, new_bytes);
+            }
+            if (grown == NULL) {
+                return AGENTMAIL_ERR_NO_MEM;
+            }
+            *list = grown;
+            fd->attachment_capacity = new_capacity;
+        }
+        fd->attachment = &(*list)[*count];
+        memset(fd->attachment, 0, sizeof(agentmail_attachment_info_t));
+        (*count)++;
+    } else if (depth == fd->depth + 1 && event == AGENTMAIL_JSON_OBJECT_END) {
+        fd->attachment = NULL;
+    } else if (depth == fd->depth + 2 && fd->attachment != NULL && key != NULL) {
+        const field_desc_t *field = field_find(&ATTACHMENT_TABLE, key);
+        if (field != NULL) {
+            return field_store(fd, field, fd->attachment, event, value, len);
+        }
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t field_decoder_on_event(
+    field_decoder_t *fd,
+    agentmail_json_parser_t *parser,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    if (fd->target != NULL && fd->attachments != NULL) {
+        return field_decoder_on_attachment_event(fd, event, key, value, len, depth);
+    }
+    if (fd->target == NULL || depth != fd->depth) {
+        return AGENTMAIL_ERR_NONE;
+    }
+    if (event == AGENTMAIL_JSON_KEY) {
+        const field_desc_t *field = field_find(fd->table, key);
+        fd->member = field;
+        if (field != NULL && field->mask != 0 && !(fd->fields & field->mask)) {
+            // Projected out: skipped without being buffered
+            fd->member = NULL;
+            agentmail_json_skip_value(parser);
+        } else if (field != NULL && field->type == FIELD_JSON) {
+            agentmail_json_raw_value(parser);
+        }
+        return AGENTMAIL_ERR_NONE;
+    }
+
+    const field_desc_t *field = fd->member;
+    fd->member = NULL;
+    if (field == NULL) {
+        return AGENTMAIL_ERR_NONE;
+    }
+    if (field->type == FIELD_ATTACHMENTS) {
+        char *member = (char *)fd->target + field->offset;
+        // A repeated member is ignored rather than appended to
+        if (event == AGENTMAIL_JSON_ARRAY_BEGIN && *(agentmail_attachment_info_t **)member == NULL) {
+            fd->attachments = member;
+            fd->attachment_capacity = 0;
+        }
+        return AGENTMAIL_ERR_NONE;
+    }
+    return field_store(fd, field, fd->target, event, value, len);
+}
+
+// ============================================================================
+// Response Decoders
+// ============================================================================
+
+/**
+ * Streaming decoder state for message list responses
+ *
+ * Messages are filled in as the response arrives, so neither the raw
+ * body nor a cJSON tree is ever held in memory.
+ */
+typedef struct {
+    agentmail_json_parser_t parser;
+    agentmail_message_list_t *list;
+    bool use_arena;                // Allocate the list from an arena
+    agentmail_arena_t *arena;      // List arena, created when the body arrives
+    size_t page_size;              // Requested limit, used as the initial capacity
+    size_t capacity;
+    int array_depth;               // Depth of the messages array (-1 until seen)
+    bool in_array;
+    field_decoder_t message;       // Message object being decoded
+} message_list_decoder_t;
+
+static agentmail_err_t message_list_on_event(
+    void *ctx,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    message_list_decoder_t *dec = (message_list_decoder_t *)ctx;
+    agentmail_message_list_t *list = dec->list;
+
+    // Members of a message, including nested arrays such as attachments
+    if (dec->message.target != NULL && depth >= dec->message.depth) {
+        return field_decoder_on_event(&dec->message, &dec->parser, event, key, value, len, depth);
+    }
+
+    switch (event) {
+        case AGENTMAIL_JSON_ARRAY_BEGIN:
+            // v0 API returns messages in a "messages" field, or as the root array
+            if (!dec->in_array && dec->array_depth < 0 &&
+                (depth == 0 || (depth == 1 && key != NULL && strcmp(key, "messages") == 0))) {
+                dec->array_depth = depth;
+                dec->in_array = true;
+                dec->message.depth = depth + 2;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_ARRAY_END:
+            if (dec->in_array && depth == dec->array_depth) {
+                dec->in_array = false;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_OBJECT_BEGIN:
+            if (dec->in_array && depth == dec->array_depth + 1) {
+                if (list->count == dec->capacity) {
+                    size_t new_capacity = dec->capacity ? dec->capacity * 2 : dec->page_size;
+                    size_t new_bytes = new_capacity * sizeof(agentmail_message_t);
+                    agentmail_message_t *grown;
+                    if (dec->arena != NULL) {
+                        grown = (agentmail_message_t *)agentmail_arena_alloc(dec->arena, new_bytes);
+                        if (grown != NULL && list->count > 0) {
+                            memcpy(grown, list->messages, list->count * sizeof(agentmail_message_t));
+                        }
+                    } else {
+                        grown = (agentmail_message_t *)realloc(list->messages, new_bytes);
+                    }
+                    if (grown == NULL) {
+                        return AGENTMAIL_ERR_NO_MEM;
+                    }
+                    list->messages = grown;
+                    dec->capacity = new_capacity;
+                }
+                agentmail_message_t *message = &list->messages[list->count++];
+                memset(message, 0, sizeof(agentmail_message_t));
+                dec->message.target = message;
+                dec->message.arena = dec->arena;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_OBJECT_END:
+            if (dec->in_array && depth == dec->array_depth + 1) {
+                dec->message.target = NULL;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_STRING:
+            if (depth == 1 && key != NULL && strcmp(key, "next_page_token") == 0) {
+                if (dec->arena == NULL) {
+                    free(list->next_cursor);
+                }
+                list->next_cursor = list_strndup(dec->arena, value, len);
+                return (list->next_cursor != NULL) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+            }
+            break;
+        case AGENTMAIL_JSON_NUMBER:
+            if (depth == 1 && key != NULL && strcmp(key, "count") == 0) {
+                list->total = strtoul(value, NULL, 10);
+            }
+            break;
+        default:
+            break;
+    }
+    return field_decoder_on_event(&dec->message, &dec->parser, event, key, value, len, depth);
+}
+
+static agentmail_err_t message_list_on_data(void *ctx, const char *data, size_t len) {
+    message_list_decoder_t *dec = (message_list_decoder_t *)ctx;
+    // Nothing is allocated until a body actually arrives (none for a 304)
+    if (dec->use_arena && dec->arena == NULL) {
+        // Structs and strings share one arena, released in one call
+        dec->arena = agentmail_arena_create(dec->page_size * sizeof(agentmail_message_t) +
+                                            LIST_ARENA_BLOCK_SIZE);
+        dec->list->arena = dec->arena;
+        if (dec->arena == NULL) {
+            dec->parser.err = AGENTMAIL_ERR_NO_MEM;
+        }
+    }
+    // Decode errors are kept in the parser and reported after the status
+    // code is known, so an error page doesn't mask a 4xx/5xx result
+    agentmail_json_feed(&dec->parser, data, len);
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Decoder state for buffered inbox and message responses
+ *
+ * The body is parsed in place in the response buffer. Strings are copied
+ * out (into the list arena when there is one) or, in in-place mode, kept
+ * where the parser unescaped them, with the buffer becoming their
+ * backing store.
+ */
+typedef struct {
+    agentmail_json_parser_t parser;
+    field_decoder_t object;        // Single inbox or message, or the list entry being decoded
+    agentmail_inbox_list_t *inbox_list;
+    size_t page_size;              // Requested limit, used as the initial capacity
+    size_t capacity;
+    int array_depth;               // Depth of the inboxes array (-1 until seen)
+    bool in_array;
+} body_decoder_t;
+
+static agentmail_err_t object_on_event(
+    void *ctx,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    body_decoder_t *dec = (body_decoder_t *)ctx;
+    return field_decoder_on_event(&dec->object, &dec->parser, event, key, value, len, depth);
+}
+
+static agentmail_err_t inbox_list_on_event(
+    void *ctx,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    body_decoder_t *dec = (body_decoder_t *)ctx;
+    agentmail_inbox_list_t *list = dec->inbox_list;
+
+    switch (event) {
+        case AGENTMAIL_JSON_ARRAY_BEGIN:
+            // v0 API returns inboxes in an "inboxes" field, or as the root array
+            if (!dec->in_array && dec->array_depth < 0 &&
+                (depth == 0 || (depth == 1 && key != NULL && strcmp(key, "inboxes") == 0))) {
+                dec->array_depth = depth;
+                dec->in_array = true;
+                dec->object.depth = depth + 2;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_ARRAY_END:
+            if (dec->in_array && depth == dec->array_depth) {
+                dec->in_array = false;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_OBJECT_BEGIN:
+            if (dec->in_array && depth == dec->array_depth + 1) {
+                if (list->count == dec->capacity) {
+                    size_t new_capacity = dec->capacity ? dec->capacity * 2 : dec->page_size;
+                    size_t new_bytes = new_capacity * sizeof(agentmail_inbox_t);
+                    agentmail_inbox_t *grown;
+                    if (dec->object.arena != NULL) {
+                        grown = (agentmail_inbox_t *)agentmail_arena_alloc(dec->object.arena, new_bytes);
+                        if (grown != NULL && list->count > 0) {
+                            memcpy(grown, list->inboxes, list->count * sizeof(agentmail_inbox_t));
+                        }
+                    } else {
+                        grown = (agentmail_inbox_t *)realloc(list->inboxes, new_bytes);
+                    }
+                    if (grown == NULL) {
+                        return AGENTMAIL_ERR_NO_MEM;
+                    }
+                    list->inboxes = grown;
+                    dec->capacity = new_capacity;
+                }
+                agentmail_inbox_t *inbox = &list->inboxes[list->count++];
+                memset(inbox, 0, sizeof(agentmail_inbox_t));
+                dec->object.target = inbox;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_OBJECT_END:
+            if (dec->in_array && depth == dec->array_depth + 1) {
+                dec->object.target = NULL;
+            }
+            return AGENTMAIL_ERR_NONE;
+        case AGENTMAIL_JSON_STRING:
+            if (depth == 1 && key != NULL && strcmp(key, "next_page_token") == 0) {
+                return field_set_string(&dec->object, &list->next_cursor, value, len);
+            }
+            break;
+        default:
+            break;
+    }
+    return field_decoder_on_event(&dec->object, &dec->parser, event, key, value, len, depth);
+}
+
+/**
+ * Parse a buffered response body in place
+ *
+ * In in-place mode the buffer is first trimmed to the body, since it is
+ * kept as the backing store of the result.
+ */
+static agentmail_err_t body_decode(body_decoder_t *dec, http_response_t *response,
+                                   agentmail_json_cb_t cb) {
+    if (dec->object.in_place) {
+        char *trimmed = (char *)realloc(response->buffer, response->size + 1);
+        if (trimmed != NULL) {
+            response->buffer = trimmed;
+            response->capacity = response->size + 1;
+        }
+    }
+    agentmail_json_init(&dec->parser, cb, dec);
+    agentmail_err_t err = agentmail_json_parse_in_place(&dec->parser, response->buffer, response->size);
+    agentmail_json_free(&dec->parser);
+    return err;
+}
+
+/**
+ * Fill in an inbox from a buffered response body, consuming the buffer
+ */
+static agentmail_err_t inbox_from_body(agentmail_client_t *client, http_response_t *response,
+                                       agentmail_inbox_t *inbox) {
+    body_decoder_t dec = {};
+    dec.object.table = &INBOX_TABLE;
+    dec.object.target = inbox;
+    dec.object.depth = 1;
+    dec.object.in_place = client->decode_in_place;
+    agentmail_err_t err = body_decode(&dec, response, object_on_event);
+    if (err == AGENTMAIL_ERR_NONE && dec.object.in_place) {
+        inbox->backing = response->buffer;  // Freed by agentmail_inbox_free()
+        response->buffer = NULL;
+    } else if (err != AGENTMAIL_ERR_NONE) {
+        if (!dec.object.in_place) {
+            agentmail_inbox_free(inbox);
+        }
+        memset(inbox, 0, sizeof(agentmail_inbox_t));
+    }
+    free(response->buffer);
+    response->buffer = NULL;
+    return err;
+}
+
+/**
+ * Fill in a message from a buffered response body, consuming the buffer
+ */
+static agentmail_err_t message_from_body(agentmail_client_t *client, http_response_t *response,
+                                         agentmail_message_t *message) {
+    body_decoder_t dec = {};
+    dec.object.table = &MESSAGE_TABLE;
+    dec.object.target = message;
+    dec.object.depth = 1;
+    dec.object.fields = UINT32_MAX;
+    dec.object.in_place = client->decode_in_place;
+    agentmail_err_t err = body_decode(&dec, response, object_on_event);
+    if (err == AGENTMAIL_ERR_NONE && dec.object.in_place) {
+        message->backing = response->buffer;  // Freed by agentmail_message_free()
+        response->buffer = NULL;
+    } else if (err != AGENTMAIL_ERR_NONE) {
+        if (!dec.object.in_place) {
+            agentmail_message_free(message);
+        } else {
+            free(message->attachments);
+        }
+        memset(message, 0, sizeof(agentmail_message_t));
+    }
+    free(response->buffer);
+    response->buffer = NULL;
+    return err;
+}
+
+// ============================================================================
+// Message Cache
+// ============================================================================
+
+/**
+ * Bytes of the strings of a struct's FIELD_STRING members, terminators
+ * included
+ */
+static size_t fields_string_size(const field_table_t *table, const void *src) {
+    size_t size = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        const field_desc_t *field = &table->fields[i];
+        if (field->type != FIELD_STRING) {
+            continue;
+        }
+        const char *value = *(char *const *)((const char *)src + field->offset);
+        if (value != NULL) {
+            size += strlen(value) + 1;
+        }
+    }
+    return size;
+}
+
+/**
+ * Copy the FIELD_STRING members of src into dst, either packed one after
+ * another at out (returns the end) or each strdup()ed when out is NULL
+ * (ok is cleared if a copy failed; the others are still set)
+ */
+static char *fields_copy_strings(const field_table_t *table, const void *src, void *dst, char *out,
+                                 bool *ok) {
+    for (size_t i = 0; i < table->count; i++) {
+        const field_desc_t *field = &table->fields[i];
+        if (field->type != FIELD_STRING) {
+            continue;
+        }
+        const char *value = *(char *const *)((const char *)src + field->offset);
+        char **member = (char **)((char *)dst + field->offset);
+        if (value == NULL) {
+            *member = NULL;
+        } else if (out != NULL) {
+            size_t len = strlen(value) + 1;
+            memcpy(out, value, len);
+            *member = out;
+            out += len;
+        } else {
+            *member = strdup(value);
+            *ok = *ok && *member != NULL;
+        }
+    }
+    return out;
+}
+
+static size_t message_string_size(const agentmail_message_t *message) {
+    size_t size = fields_string_size(&MESSAGE_TABLE, message);
+    for (size_t i = 0; i < message->attachment_count; i++) {
+        size += fields_string_size(&ATTACHMENT_TABLE, &message->attachments[i]);
+    }
+    return size;
+}
+
+/**
+ * Copy a message, with its strings packed at strings (or strdup()ed when
+ * strings is NULL) and its attachment array at attachments
+ *
+ * @return false if a strdup() failed (dst can still be freed)
+ */
+static bool message_copy(const agentmail_message_t *src, agentmail_message_t *dst,
+                         agentmail_attachment_info_t *attachments, char *strings) {
+    bool ok = true;
+    *dst = *src;
+    dst->backing = NULL;
+    dst->attachments = (src->attachment_count > 0) ? attachments : NULL;
+    for (size_t i = 0; i < src->attachment_count; i++) {
+        attachments[i] = src->attachments[i];
+        strings = fields_copy_strings(&ATTACHMENT_TABLE, &src->attachments[i], &attachments[i], strings, &ok);
+    }
+    fields_copy_strings(&MESSAGE_TABLE, src, dst, strings, &ok);
+    return ok;
+}
+
+static message_cache_entry_t *message_cache_find(message_cache_t *cache, const char *message_id,
+                                                 uint32_t hash) {
+    for (message_cache_entry_t *entry = cache->head; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->message.message_id, message_id) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void message_cache_unlink(message_cache_t *cache, message_cache_entry_t *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    cache->used -= entry->size;
+}
+
+static void message_cache_push_front(message_cache_t *cache, message_cache_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+    cache->used += entry->size;
+}
+
+/**
+ * Serve a message from the cache, copied the way a response would have
+ * been decoded (in-place mode: one block of strings)
+ */
+static bool message_cache_get(agentmail_client_t *client, const char *message_id,
+                              agentmail_message_t *message) {
+    message_cache_t *cache = &client->cache;
+    if (cache->capacity == 0) {
+        return false;
+    }
+    bool hit = false;
+    agentmail_mutex_lock(client->cache_lock);
+    message_cache_entry_t *entry = message_cache_find(cache, message_id, key_hash(message_id));
+    if (entry != NULL) {
+        message_cache_unlink(cache, entry);
+        message_cache_push_front(cache, entry);
+
+        const agentmail_message_t *cached = &entry->message;
+        agentmail_attachment_info_t *attachments = NULL;
+        if (cached->attachment_count > 0) {
+            attachments = (agentmail_attachment_info_t *)malloc(
+                cached->attachment_count * sizeof(agentmail_attachment_info_t));
+        }
+        char *strings = NULL;
+        if (client->decode_in_place) {
+            strings = (char *)malloc(message_string_size(cached));
+        }
+        if ((cached->attachment_count == 0 || attachments != NULL) &&
+            (!client->decode_in_place || strings != NULL)) {
+            hit = message_copy(cached, message, attachments, strings);
+            message->backing = strings;
+            if (!hit) {
+                agentmail_message_free(message);
+            }
+        } else {
+            free(attachments);
+            free(strings);
+        }
+    }
+    if (hit) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    agentmail_mutex_unlock(client->cache_lock);
+    return hit;
+}
+
+/**
+ * Add or replace a message in the cache, evicting the least recently
+ * used entries beyond the size limit
+ */
+static void message_cache_put(agentmail_client_t *client, const agentmail_message_t *message) {
+    message_cache_t *cache = &client->cache;
+    if (cache->capacity == 0 || message->message_id == NULL) {
+        return;
+    }
+    size_t size = sizeof(message_cache_entry_t) +
+                  message->attachment_count * sizeof(agentmail_attachment_info_t) +
+                  message_string_size(message);
+    message_cache_entry_t *entry = NULL;
+    if (size <= cache->capacity) {
+        entry = (message_cache_entry_t *)malloc(size);
+    }
+    if (entry != NULL) {
+        agentmail_attachment_info_t *attachments = (agentmail_attachment_info_t *)(entry + 1);
+        message_copy(message, &entry->message, attachments, (char *)(attachments + message->attachment_count));
+        entry->hash = key_hash(message->message_id);
+        entry->size = size;
+    }
+
+    agentmail_mutex_lock(client->cache_lock);
+    // A message too large to cache still replaces a stale copy
+    message_cache_entry_t *old = message_cache_find(cache, message->message_id,
+                                                    key_hash(message->message_id));
+    if (old != NULL) {
+        message_cache_unlink(cache, old);
+        free(old);
+    }
+    if (entry != NULL) {
+        message_cache_push_front(cache, entry);
+        while (cache->used > cache->capacity) {
+            message_cache_entry_t *victim = cache->tail;
+            message_cache_unlink(cache, victim);
+            free(victim);
+        }
+    }
+    agentmail_mutex_unlock(client->cache_lock);
+}
+
+/**
+ * Drop a message from the cache after it changed server-side
+ */
+static void message_cache_remove(agentmail_client_t *client, const char *message_id) {
+    message_cache_t *cache = &client->cache;
+    if (cache->capacity == 0) {
+        return;
+    }
+    agentmail_mutex_lock(client->cache_lock);
+    message_cache_entry_t *entry = message_cache_find(cache, message_id, key_hash(message_id));
+    if (entry != NULL) {
+        message_cache_unlink(cache, entry);
+        free(entry);
+    }
+    agentmail_mutex_unlock(client->cache_lock);
+}
+
+/**
+ * Update the read state of a cached message, so marking it read keeps it
+ * cached
+ */
+static void message_cache_set_read(agentmail_client_t *client, const char *message_id, bool is_read) {
+    message_cache_t *cache = &client->cache;
+    if (cache->capacity == 0) {
+        return;
+    }
+    agentmail_mutex_lock(client->cache_lock);
+    message_cache_entry_t *entry = message_cache_find(cache, message_id, key_hash(message_id));
+    if (entry != NULL) {
+        entry->message.is_read = is_read;
+    }
+    agentmail_mutex_unlock(client->cache_lock);
+}
+
+static void message_cache_clear(agentmail_client_t *client) {
+    message_cache_t *cache = &client->cache;
+    agentmail_mutex_lock(client->cache_lock);
+    while (cache->head != NULL) {
+        message_cache_entry_t *entry = cache->head;
+        message_cache_unlink(cache, entry);
+        free(entry);
+    }
+    agentmail_mutex_unlock(client->cache_lock);
+}
+
+// ============================================================================
+// Request Payloads
+// ============================================================================
+
+typedef void (*payload_writer_t)(agentmail_json_writer_t *writer, const void *arg);
+
+/**
+ * Payload streamed through the client's payload buffer
+ */
+typedef struct {
+    payload_writer_t write;
+    const void *arg;
+    char *window;
+    size_t window_size;
+} payload_stream_t;
+
+static agentmail_err_t payload_stream_body(void *ctx, agentmail_write_cb_t out, void *out_ctx) {
+    const payload_stream_t *stream = (const payload_stream_t *)ctx;
+    agentmail_json_writer_t writer;
+    agentmail_json_writer_init_stream(&writer, stream->window, stream->window_size, out, out_ctx);
+    stream->write(&writer, stream->arg);
+    return agentmail_json_writer_flush(&writer);
+}
+
+/**
+ * Perform a request whose JSON body is serialized by write
+ *
+ * The writer goes straight into the client's reusable payload buffer. If
+ * it doesn't fit, that run has measured the exact size: a payload of up to
+ * PAYLOAD_BUFFER_MAX bytes gets the buffer grown once and written again,
+ * and anything larger (typically a long body_html) is streamed to the
+ * connection through the buffer instead, escaping straight from the
+ * caller's strings, so memory use stays flat whatever the message size.
+ * payload_lock is held until the request completes.
+ */
+static agentmail_err_t perform_payload_request(
+    agentmail_client_t *client,
+    const char *method,
+    const char *path,
+    payload_writer_t write,
+    const void *arg,
+    http_response_t *response,
+    int *status_code
+) {
+    agentmail_mutex_lock(client->payload_lock);
+    if (client->payload == NULL) {
+        client->payload = (char *)malloc(PAYLOAD_BUFFER_SIZE);
+        if (client->payload == NULL) {
+            agentmail_mutex_unlock(client->payload_lock);
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        client->payload_cap = PAYLOAD_BUFFER_SIZE;
+    }
+
+    agentmail_json_writer_t writer;
+    agentmail_json_writer_init(&writer, client->payload, client->payload_cap);
+    write(&writer, arg);
+    bool fits = agentmail_json_writer_finish(&writer);
+
+    size_t needed = writer.len + 1;
+    if (!fits && needed <= PAYLOAD_BUFFER_MAX) {
+        char *grown = (char *)realloc(client->payload, needed);
+        if (grown == NULL) {
+            agentmail_mutex_unlock(client->payload_lock);
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        client->payload = grown;
+        client->payload_cap = needed;
+        agentmail_json_writer_init(&writer, client->payload, client->payload_cap);
+        write(&writer, arg);
+        fits = agentmail_json_writer_finish(&writer);
+    }
+
+    // An attachment small enough to be buffered has been read already
+    agentmail_err_t err = writer.err;
+    if (err != AGENTMAIL_ERR_NONE) {
+        ESP_LOGE(TAG, "Failed to read attachment: %s", agentmail_err_to_str(err));
+    } else if (fits) {
+        err = perform_http_request_with_headers(client, method, path, client->payload, NULL, NULL,
+                                                response, status_code);
+    } else {
+        payload_stream_t payload = {write, arg, client->payload, client->payload_cap};
+        body_stream_t stream = {payload_stream_body, &payload, writer.len};
+        err = perform_http_request_with_headers(client, method, path, NULL, &stream, NULL,
+                                                response, status_code);
+    }
+    agentmail_mutex_unlock(client->payload_lock);
+    return err;
+}
+
+static void write_string_member(agentmail_json_writer_t *writer, const char *key, const char *value) {
+    if (value != NULL) {
+        agentmail_json_write_key(writer, key);
+        agentmail_json_write_string(writer, value);
+    }
+}
+
+static void write_string_array_member(agentmail_json_writer_t *writer, const char *key,
+                                      const char **values, size_t count) {
+    if (values == NULL || count == 0) {
+        return;
+    }
+    agentmail_json_write_key(writer, key);
+    agentmail_json_write_array_begin(writer);
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] != NULL) {
+            agentmail_json_write_string(writer, values[i]);
+        }
+    }
+    agentmail_json_write_array_end(writer);
+}
+
+/**
+ * Inbox create/update payload; arg is agentmail_inbox_options_t (may be NULL)
+ */
+static void write_inbox_payload(agentmail_json_writer_t *writer, const void *arg) {
+    const agentmail_inbox_options_t *options = (const agentmail_inbox_options_t *)arg;
+    agentmail_json_write_object_begin(writer);
+    if (options != NULL) {
+        write_string_member(writer, "name", options->name);
+        // Metadata is embedded as JSON; text that doesn't parse is left out
+        if (options->metadata != NULL && agentmail_json_valid(options->metadata)) {
+            agentmail_json_write_key(writer, "metadata");
+            agentmail_json_write_raw(writer, options->metadata);
+        }
+    }
+    agentmail_json_write_object_end(writer);
+}
+
+/**
+ * Send and reply payload argument
+ */
+typedef struct {
+    const agentmail_send_options_t *options;
+    size_t *attachment_sizes;       // Content size of each attachment, resolved once
+} send_payload_t;
+
+/**
+ * Check the attachments and resolve their sizes up front, so every pass
+ * over the payload (measuring, then each attempt) sees the same lengths
+ */
+static agentmail_err_t send_payload_init(send_payload_t *payload, const agentmail_send_options_t *options) {
+    payload->options = options;
+    payload->attachment_sizes = NULL;
+    if (options->attachments == NULL || options->attachment_count == 0) {
+        return AGENTMAIL_ERR_NONE;
+    }
+    payload->attachment_sizes = (size_t *)malloc(options->attachment_count * sizeof(size_t));
+    if (payload->attachment_sizes == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < options->attachment_count; i++) {
+        const agentmail_attachment_t *attachment = &options->attachments[i];
+        if (attachment->filename == NULL || (attachment->path == NULL && attachment->read == NULL)) {
+            ESP_LOGE(TAG, "Attachment %zu needs a filename and a path or read callback", i);
+            free(payload->attachment_sizes);
+            return AGENTMAIL_ERR_INVALID_ARG;
+        }
+        payload->attachment_sizes[i] = attachment->size;
+        if (attachment->path != NULL) {
+            struct stat st;
+            if (stat(attachment->path, &st) != 0) {
+                ESP_LOGE(TAG, "Attachment not found: %s", attachment->path);
+                free(payload->attachment_sizes);
+                return AGENTMAIL_ERR_IO;
+            }
+            payload->attachment_sizes[i] = (size_t)st.st_size;
+        }
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Attachment file, opened on the first read of a pass
+ */
+typedef struct {
+    const char *path;
+    FILE *file;
+} file_source_t;
+
+static agentmail_err_t file_source_read(void *ctx, size_t offset, uint8_t *buf, size_t len) {
+    file_source_t *source = (file_source_t *)ctx;
+    if (source->file == NULL) {
+        source->file = fopen(source->path, "rb");
+        if (source->file == NULL) {
+            ESP_LOGE(TAG, "Can't open attachment %s", source->path);
+            return AGENTMAIL_ERR_IO;
+        }
+    }
+    // Reads within a pass are sequential, so this only seeks on the first
+    if (ftell(source->file) != (long)offset && fseek(source->file, (long)offset, SEEK_SET) != 0) {
+        return AGENTMAIL_ERR_IO;
+    }
+    if (fread(buf, 1, len, source->file) != len) {
+        ESP_LOGE(TAG, "Short read from attachment %s", source->path);
+        return AGENTMAIL_ERR_IO;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static void write_attachments_member(agentmail_json_writer_t *writer, const send_payload_t *payload) {
+    const agentmail_send_options_t *options = payload->options;
+    if (payload->attachment_sizes == NULL) {
+        return;
+    }
+    agentmail_json_write_key(writer, "attachments");
+    agentmail_json_write_array_begin(writer);
+    for (size_t i = 0; i < options->attachment_count; i++) {
+        const agentmail_attachment_t *attachment = &options->attachments[i];
+        agentmail_json_write_object_begin(writer);
+        write_string_member(writer, "filename", attachment->filename);
+        write_string_member(writer, "content_type", attachment->content_type);
+        agentmail_json_write_key(writer, "content");
+        if (attachment->path != NULL) {
+            file_source_t source = {attachment->path, NULL};
+            agentmail_json_write_base64(writer, file_source_read, &source, payload->attachment_sizes[i]);
+            if (source.file != NULL) {
+                fclose(source.file);
+            }
+        } else {
+            agentmail_json_write_base64(writer, attachment->read, attachment->read_ctx,
+                                        payload->attachment_sizes[i]);
+        }
+        agentmail_json_write_object_end(writer);
+    }
+    agentmail_json_write_array_end(writer);
+}
+
+/**
+ * Send payload; arg is send_payload_t
+ */
+static void write_send_payload(agentmail_json_writer_t *writer, const void *arg) {
+    const send_payload_t *payload = (const send_payload_t *)arg;
+    const agentmail_send_options_t *options = payload->options;
+    agentmail_json_write_object_begin(writer);
+    write_string_member(writer, "from", options->from);
+    write_string_member(writer, "to", options->to);
+    write_string_member(writer, "subject", options->subject);
+    write_string_member(writer, "body_text", options->body_text);
+    write_string_member(writer, "body_html", options->body_html);
+    write_string_member(writer, "thread_id", options->thread_id);
+    write_string_member(writer, "reply_to", options->reply_to);
+    write_string_array_member(writer, "cc", options->cc, options->cc_count);
+    write_string_array_member(writer, "bcc", options->bcc, options->bcc_count);
+    write_attachments_member(writer, payload);
+    agentmail_json_write_object_end(writer);
+}
+
+/**
+ * Reply payload; arg is send_payload_t
+ */
+static void write_reply_payload(agentmail_json_writer_t *writer, const void *arg) {
+    const send_payload_t *payload = (const send_payload_t *)arg;
+    const agentmail_send_options_t *options = payload->options;
+    agentmail_json_write_object_begin(writer);
+    write_string_member(writer, "to", options->to);
+    write_string_member(writer, "subject", options->subject);
+    write_string_member(writer, "text", options->body_text);
+    write_string_member(writer, "html", options->body_html);
+    write_attachments_member(writer, payload);
+    agentmail_json_write_object_end(writer);
+}
+
+/**
+ * Mark-read payload; arg is a bool
+ */
+static void write_mark_read_payload(agentmail_json_writer_t *writer, const void *arg) {
+    agentmail_json_write_object_begin(writer);
+    agentmail_json_write_key(writer, "is_read");
+    agentmail_json_write_bool(writer, *(const bool *)arg);
+    agentmail_json_write_object_end(writer);
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+agentmail_err_t agentmail_init(
+    const agentmail_config_t *config,
+    agentmail_handle_t *handle
+) {
+    if (config == NULL || config->api_key == NULL || handle == NULL) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)calloc(1, sizeof(agentmail_client_t));
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate client");
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+
+    client->api_key = strdup(config->api_key);
+    client->base_url = strdup(config->base_url ? config->base_url : DEFAULT_BASE_URL);
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : DEFAULT_TIMEOUT_MS;
+    client->enable_logging = config->enable_logging;
+    client->use_arena = config->use_arena;
+    client->decode_in_place = config->decode_in_place;
+    client->retry = config->retry;
+    client->ctx = config->ctx;
+    client->transport = config->transport ? config->transport : agentmail_transport_default();
+    client->lock = agentmail_mutex_create();
+    client->async_queue_len = config->async_queue_len > 0 ? config->async_queue_len : DEFAULT_ASYNC_QUEUE_LEN;
+    client->async_lock = agentmail_mutex_create();
+    client->limiter_lock = agentmail_mutex_create();
+    client->payload_lock = agentmail_mutex_create();
+    client->cache_lock = agentmail_mutex_create();
+    client->stats_lock = agentmail_mutex_create();
+    client->cache.capacity = config->message_cache_size;
+    rate_bucket_init(&client->rate_all, &config->rate_limit);
+    for (int i = 0; i < AGENTMAIL_ENDPOINT_CLASS_COUNT; i++) {
+        rate_bucket_init(&client->rate_class[i], &config->endpoint_rate_limits[i]);
+    }
+
+    size_t auth_len = strlen(config->api_key) + sizeof("Bearer ");
+    client->auth_header = (char *)malloc(auth_len);
+    if (client->auth_header != NULL) {
+        snprintf(client->auth_header, auth_len, "Bearer %s", config->api_key);
+    }
+    client->headers[0] = "Authorization";
+    client->headers[1] = client->auth_header;
+    client->headers[2] = "User-Agent";
+    client->headers[3] = "PlaiPin-AgentMail/1.0";
+    client->headers[4] = NULL;
+
+    agentmail_err_t err = AGENTMAIL_ERR_NO_MEM;
+    if (client->api_key != NULL && client->base_url != NULL &&
+        client->auth_header != NULL && client->lock != NULL && client->async_lock != NULL &&
+        client->limiter_lock != NULL && client->payload_lock != NULL && client->cache_lock != NULL &&
+        client->stats_lock != NULL) {
+        agentmail_transport_config_t transport_config = {};
+        transport_config.base_url = client->base_url;
+        transport_config.timeout_ms = client->timeout_ms;
+        transport_config.headers = client->headers;
+        err = client->transport->create(&transport_config, &client->conn);
+    }
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(client->api_key);
+        free(client->base_url);
+        free(client->auth_header);
+        if (client->lock != NULL) {
+            agentmail_mutex_delete(client->lock);
+        }
+        if (client->async_lock != NULL) {
+            agentmail_mutex_delete(client->async_lock);
+        }
+        if (client->limiter_lock != NULL) {
+            agentmail_mutex_delete(client->limiter_lock);
+        }
+        if (client->payload_lock != NULL) {
+            agentmail_mutex_delete(client->payload_lock);
+        }
+        if (client->cache_lock != NULL) {
+            agentmail_mutex_delete(client->cache_lock);
+        }
+        if (client->stats_lock != NULL) {
+            agentmail_mutex_delete(client->stats_lock);
+        }
+        free(client);
+        return err;
+    }
+
+    *handle = (agentmail_handle_t)client;
+    ESP_LOGI(TAG, "AgentMail client initialized (base: %s, transport: %s)",
+             client->base_url, client->transport->name);
+
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_destroy(agentmail_handle_t handle) {
+    if (handle == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Let the worker drain the queue, then stop it
+    if (client->async_worker != NULL) {
+        agentmail_queue_send(client->async_queue, NULL, true);
+        agentmail_task_join(client->async_worker);
+        agentmail_queue_delete(client->async_queue);
+    }
+    agentmail_mutex_delete(client->async_lock);
+    agentmail_mutex_delete(client->limiter_lock);
+    agentmail_mutex_delete(client->payload_lock);
+    free(client->payload);
+    message_cache_clear(client);
+    agentmail_mutex_delete(client->cache_lock);
+
+    client->transport->destroy(client->conn);
+    agentmail_mutex_delete(client->lock);
+    agentmail_mutex_delete(client->stats_lock);
+    for (int i = 0; i < VALIDATOR_CACHE_SIZE; i++) {
+        free(client->validators[i].key);
+        free(client->validators[i].etag);
+        free(client->validators[i].last_modified);
+    }
+    free(client->api_key);
+    free(client->base_url);
+    free(client->auth_header);
+    free(client);
+
+    ESP_LOGI(TAG, "AgentMail client destroyed");
+    return AGENTMAIL_ERR_NONE;
+}
+
+// ============================================================================
+// Inbox Operations
+// ============================================================================
+
+agentmail_err_t agentmail_inbox_create(
+    agentmail_handle_t handle,
+    const agentmail_inbox_options_t *options,
+    agentmail_inbox_t *inbox
+) {
+    if (handle == NULL || inbox == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    memset(inbox, 0, sizeof(agentmail_inbox_t));
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_payload_request(
+        client, "POST", "/inboxes", write_inbox_payload, options, &response, &status_code
+    );
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Parse response
+    err = inbox_from_body(client, &response, inbox);
+    if (err != AGENTMAIL_ERR_NONE) {
+        ESP_LOGE(TAG, "Failed to parse response");
+        return err;
+    }
+
+    if (inbox->inbox_id) {
+        ESP_LOGI(TAG, "Created inbox: %s", inbox->inbox_id);
+    }
+
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_inbox_get(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    agentmail_inbox_t *inbox
+) {
+    if (handle == NULL || inbox_id == NULL || inbox == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    memset(inbox, 0, sizeof(agentmail_inbox_t));
+
+    // Build path
+    char path[256];
+    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "GET", path, NULL, &response, &status_code
+    );
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Parse response
+    return inbox_from_body(client, &response, inbox);
+}
+
+agentmail_err_t agentmail_inbox_list(
+    agentmail_handle_t handle,
+    int limit,
+    const char *cursor,
+    agentmail_inbox_list_t *inboxes
+) {
+    if (handle == NULL || inboxes == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    memset(inboxes, 0, sizeof(agentmail_inbox_list_t));
+
+    if (limit <= 0) {
+        limit = 20;
+    }
+
+    // Build path with query params
+    char path[512];
+    int offset = snprintf(path, sizeof(path), "/inboxes?limit=%d", limit);
+    if (cursor != NULL) {
+        snprintf(path + offset, sizeof(path) - offset, "&cursor=%s", cursor);
+    }
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "GET", path, NULL, &response, &status_code
+    );
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Entries decoded in place point into the body, so such a list always
+    // gets an arena to own it
+    body_decoder_t dec = {};
+    dec.object.table = &INBOX_TABLE;
+    dec.object.in_place = client->decode_in_place;
+    dec.array_depth = -1;
+    dec.inbox_list = inboxes;
+    dec.page_size = limit;
+    if (client->use_arena || dec.object.in_place) {
+        dec.object.arena = agentmail_arena_create(limit * sizeof(agentmail_inbox_t) + LIST_ARENA_BLOCK_SIZE);
+        if (dec.object.arena == NULL) {
+            free(response.buffer);
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        inboxes->arena = dec.object.arena;
+    }
+
+    err = body_decode(&dec, &response, inbox_list_on_event);
+    if (err == AGENTMAIL_ERR_NONE && dec.object.in_place) {
+        if (agentmail_arena_adopt(dec.object.arena, response.buffer) == 0) {
+            response.buffer = NULL;
+        } else {
+            err = AGENTMAIL_ERR_NO_MEM;
+        }
+    }
+    free(response.buffer);
+    if (err != AGENTMAIL_ERR_NONE) {
+        agentmail_inbox_list_free(inboxes);
+        return err;
+    }
+
+    if (inboxes->count == 0) {
+        if (inboxes->arena == NULL) {
+            free(inboxes->inboxes);
+        }
+        inboxes->inboxes = NULL;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_inbox_update(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const agentmail_inbox_options_t *options
+) {
+    if (handle == NULL || inbox_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[256];
+    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_payload_request(
+        client, "PATCH", path, write_inbox_payload, options, &response, &status_code
+    );
+
+    free(response.buffer);
+    
+    if (err == AGENTMAIL_ERR_NONE) {
+        ESP_LOGI(TAG, "Updated inbox: %s", inbox_id);
+    }
+
+    return err;
+}
+
+agentmail_err_t agentmail_inbox_delete(
+    agentmail_handle_t handle,
+    const char *inbox_id
+) {
+    if (handle == NULL || inbox_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[256];
+    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "DELETE", path, NULL, &response, &status_code
+    );
+
+    free(response.buffer);
+    
+    if (err == AGENTMAIL_ERR_NONE) {
+        ESP_LOGI(TAG, "Deleted inbox: %s", inbox_id);
+        message_cache_clear(client);  // Cached messages aren't indexed by inbox
+    }
+
+    return err;
+}
+
+// ============================================================================
+// Message Operations
+// ============================================================================
+
+agentmail_err_t agentmail_send(
+    agentmail_handle_t handle,
+    const agentmail_send_options_t *options,
+    char **message_id
+) {
+    if (handle == NULL || options == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    if (options->from == NULL || options->to == NULL) {
+        ESP_LOGE(TAG, "from and to are required");
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build v0 API path: /inboxes/:inbox_id/messages/send (URL encode inbox_id)
+    char* encoded_inbox_id = url_encode(options->from);
+    if (encoded_inbox_id == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/send", encoded_inbox_id);
+    free(encoded_inbox_id);
+
+    send_payload_t payload;
+    agentmail_err_t err = send_payload_init(&payload, options);
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    err = perform_payload_request(
+        client, "POST", path, write_send_payload, &payload, &response, &status_code
+    );
+    free(payload.attachment_sizes);
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Parse response to get message ID (v0 API)
+    if (message_id != NULL) {
+        cJSON *res_json = cJSON_Parse(response.buffer);
+        if (res_json != NULL) {
+            cJSON *msg_id = cJSON_GetObjectItem(res_json, "message_id");
+            if (cJSON_IsString(msg_id)) {
+                *message_id = strdup(msg_id->valuestring);
+                ESP_LOGI(TAG, "Sent message: %s", *message_id);
+            }
+            cJSON_Delete(res_json);
+        }
+    }
+
+    free(response.buffer);
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * List messages
+ *
+ * With own_etag set the caller keeps the validator instead of the client's
+ * validator cache (query->if_changed is ignored): *own_etag, if not NULL,
+ * is sent as If-None-Match, and on success it is replaced by the
+ * response's ETag (NULL if it had none).
+ */
+static agentmail_err_t messages_list(
+    agentmail_client_t *client,
+    const char *inbox_id,
+    const agentmail_message_query_t *query,
+    char **own_etag,
+    agentmail_message_list_t *messages
+) {
+    memset(messages, 0, sizeof(agentmail_message_list_t));
+
+    // URL encode inbox_id (may contain @ symbol)
+    char* encoded_inbox_id = url_encode(inbox_id);
+    if (encoded_inbox_id == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+
+    // Build path with query params
+    char path[1024];
+    int limit = (query != NULL && query->limit > 0) ? query->limit : 20;
+    int offset = snprintf(path, sizeof(path), "/inboxes/%s/messages?limit=%d", 
+                          encoded_inbox_id, limit);
+    
+    if (query != NULL) {
+        if (query->cursor != NULL) {
+            offset += snprintf(path + offset, sizeof(path) - offset, 
+                               "&cursor=%s", query->cursor);
+        }
+        if (query->unread_only) {
+            offset += snprintf(path + offset, sizeof(path) - offset, 
+                               "&unread=true");
+        }
+        if (query->thread_id != NULL) {
+            offset += snprintf(path + offset, sizeof(path) - offset, 
+                               "&thread_id=%s", query->thread_id);
+        }
+    }
+
+    free(encoded_inbox_id); // Free URL-encoded string
+
+    // Decode the response as it streams in. The page size bounds the
+    // message count, so the array is sized for it on the first message.
+    message_list_decoder_t decoder = {};
+    decoder.list = messages;
+    decoder.use_arena = client->use_arena;
+    decoder.array_depth = -1;
+    decoder.message.table = &MESSAGE_TABLE;
+    decoder.message.fields = (query != NULL && query->fields != 0) ? query->fields : UINT32_MAX;
+    decoder.page_size = limit;
+    agentmail_json_init(&decoder.parser, message_list_on_event, &decoder);
+
+    // Revalidate against the previous response to the same query
+    bool conditional = (own_etag == NULL && query != NULL && query->if_changed);
+    char key[sizeof(path) + 16];
+    char validator[VALIDATOR_MAX_LEN];
+    const char *validator_headers[3] = {NULL, NULL, NULL};
+    if (conditional) {
+        validator_key(key, sizeof(key), path, decoder.message.fields);
+        validator_lookup(client, key, validator, sizeof(validator), validator_headers);
+    } else if (own_etag != NULL && *own_etag != NULL) {
+        validator_headers[0] = "If-None-Match";
+        validator_headers[1] = *own_etag;
+    }
+
+    // Perform request
+    http_response_t response = {};
+    response.on_data = message_list_on_data;
+    response.on_data_ctx = &decoder;
+    response.want_validators = conditional || own_etag != NULL;
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request_with_headers(
+        client, "GET", path, NULL, NULL, validator_headers, &response, &status_code
+    );
+    free(response.buffer);  // Error body, if any
+
+    if (err == AGENTMAIL_ERR_NONE && agentmail_json_finish(&decoder.parser) != AGENTMAIL_ERR_NONE) {
+        err = (decoder.parser.err == AGENTMAIL_ERR_NO_MEM) ? AGENTMAIL_ERR_NO_MEM : AGENTMAIL_ERR_PARSE;
+    }
+    agentmail_json_free(&decoder.parser);
+
+    if (conditional && err == AGENTMAIL_ERR_NONE) {
+        validator_store(client, key, response.etag, response.last_modified);
+    } else if (own_etag != NULL && err == AGENTMAIL_ERR_NONE) {
+        free(*own_etag);
+        *own_etag = response.etag;
+        response.etag = NULL;
+    }
+    free(response.etag);
+    free(response.last_modified);
+
+    if (err == AGENTMAIL_ERR_NOT_MODIFIED) {
+        ESP_LOGD(TAG, "Messages in inbox %s not modified", inbox_id);
+        return err;
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        agentmail_message_list_free(messages);
+        return err;
+    }
+
+    if (messages->count == 0) {
+        if (messages->arena == NULL) {
+            free(messages->messages);
+        }
+        messages->messages = NULL;
+    }
+
+    // Complete messages can serve later agentmail_message_get() calls;
+    // list items without a body (or projected ones) can't
+    if (query == NULL || query->fields == 0) {
+        for (size_t i = 0; i < messages->count; i++) {
+            const agentmail_message_t *message = &messages->messages[i];
+            if (message->body_text != NULL || message->body_html != NULL) {
+                message_cache_put(client, message);
+            }
+        }
+    }
+    
+    ESP_LOGI(TAG, "Retrieved %zu messages from inbox %s", messages->count, inbox_id);
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_messages_get(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const agentmail_message_query_t *query,
+    agentmail_message_list_t *messages
+) {
+    if (handle == NULL || inbox_id == NULL || messages == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    return messages_list((agentmail_client_t *)handle, inbox_id, query, NULL, messages);
+}
+
+agentmail_err_t agentmail_message_get(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_message_t *message
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || message == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    memset(message, 0, sizeof(agentmail_message_t));
+
+    if (message_cache_get(client, message_id, message)) {
+        ESP_LOGD(TAG, "Message %s served from cache", message_id);
+        return AGENTMAIL_ERR_NONE;
+    }
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "GET", path, NULL, &response, &status_code
+    );
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Parse response
+    err = message_from_body(client, &response, message);
+    if (err == AGENTMAIL_ERR_NONE) {
+        message_cache_put(client, message);
+    }
+    return err;
+}
+
+agentmail_err_t agentmail_message_mark_read(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    bool is_read
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
+
+    // Perform request (PATCH or PUT depending on API)
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_payload_request(
+        client, "PATCH", path, write_mark_read_payload, &is_read, &response, &status_code
+    );
+
+    free(response.buffer);
+    
+    if (err == AGENTMAIL_ERR_NONE) {
+        ESP_LOGI(TAG, "Marked message %s as %s", message_id, is_read ? "read" : "unread");
+        message_cache_set_read(client, message_id, is_read);
+    } else {
+        message_cache_remove(client, message_id);  // The change may have been applied
+    }
+
+    return err;
+}
+
+agentmail_err_t agentmail_message_delete(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "DELETE", path, NULL, &response, &status_code
+    );
+
+    free(response.buffer);
+    message_cache_remove(client, message_id);
+    
+    if (err == AGENTMAIL_ERR_NONE) {
+        ESP_LOGI(TAG, "Deleted message: %s", message_id);
+    }
+
+    return err;
+}
+
+agentmail_err_t agentmail_send_reply(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    const agentmail_send_options_t *options,
+    char **reply_message_id
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || options == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build v0 API path: /inboxes/:inbox_id/messages/:message_id/reply
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/reply", inbox_id, message_id);
+
+    send_payload_t payload;
+    agentmail_err_t err = send_payload_init(&payload, options);
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+
+    // Perform request
+    http_response_t response = {};
+    int status_code = 0;
+    err = perform_payload_request(
+        client, "POST", path, write_reply_payload, &payload, &response, &status_code
+    );
+    free(payload.attachment_sizes);
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        free(response.buffer);
+        return err;
+    }
+
+    // Parse response to get message ID
+    if (reply_message_id != NULL) {
+        cJSON *res_json = cJSON_Parse(response.buffer);
+        if (res_json != NULL) {
+            cJSON *msg_id = cJSON_GetObjectItem(res_json, "message_id");
+            if (cJSON_IsString(msg_id)) {
+                *reply_message_id = strdup(msg_id->valuestring);
+                ESP_LOGI(TAG, "Sent reply: %s", *reply_message_id);
+            }
+            cJSON_Delete(res_json);
+        }
+    }
+
+    free(response.buffer);
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_message_get_raw(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    char **raw_content,
+    size_t *raw_size
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || 
+        raw_content == NULL || raw_size == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/raw", inbox_id, message_id);
 
     // Perform request
     http_response_t response = {};
@@ -414,690 +2614,1596 @@ agentmail_err_t agentmail_inbox_get(
     );
 
     if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
+        free(response.buffer);
+        return err;
+    }
+
+    // Return the raw content
+    *raw_content = response.buffer;
+    *raw_size = response.size;
+    
+    ESP_LOGI(TAG, "Retrieved raw message: %s (%zu bytes)", message_id, response.size);
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_message_get_raw_stream(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_write_cb_t write_cb,
+    void *ctx,
+    size_t *raw_size
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || write_cb == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/raw", inbox_id, message_id);
+
+    // Perform request, handing the body straight to the caller
+    http_response_t response = {};
+    response.on_data = write_cb;
+    response.on_data_ctx = ctx;
+    response.stream_response = true;
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "GET", path, NULL, &response, &status_code
+    );
+    if (raw_size != NULL) {
+        // A buffered body is an error response that was never delivered
+        *raw_size = (response.buffer == NULL) ? response.size : 0;
+    }
+    free(response.buffer);
+
+    if (err != AGENTMAIL_ERR_NONE) {
         return err;
     }
 
-    // Parse response
-    cJSON *res_json = cJSON_Parse(response.buffer);
+    ESP_LOGI(TAG, "Streamed raw message: %s (%zu bytes)", message_id, response.size);
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t mime_on_data(void *ctx, const char *data, size_t len) {
+    agentmail_mime_parser_t *parser = (agentmail_mime_parser_t *)ctx;
+    agentmail_err_t err = agentmail_mime_feed(parser, data, len);
+    if (err == AGENTMAIL_ERR_NONE && parser->stopped) {
+        // Abort the transfer; the rest of the message isn't needed
+        return AGENTMAIL_ERR_OTHER;
+    }
+    return err;
+}
+
+agentmail_err_t agentmail_message_get_mime(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_mime_parser_t *parser
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || parser == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/raw", inbox_id, message_id);
+
+    http_response_t response = {};
+    response.on_data = mime_on_data;
+    response.on_data_ctx = parser;
+    response.stream_response = true;  // agentmail_mime_stop() ends the download
+    int status_code = 0;
+    agentmail_err_t err = perform_http_request(
+        client, "GET", path, NULL, &response, &status_code
+    );
     free(response.buffer);
-    
-    if (res_json == NULL) {
-        return AGENTMAIL_ERR_PARSE;
+
+    if (parser->stopped) {
+        ESP_LOGI(TAG, "Stopped parsing raw message %s after %zu bytes", message_id, response.size);
+        return AGENTMAIL_ERR_NONE;
+    }
+    if (err == AGENTMAIL_ERR_NONE) {
+        err = agentmail_mime_finish(parser);
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Parsed raw message: %s (%zu bytes)", message_id, response.size);
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Attachment download state across resumed requests
+ */
+typedef struct {
+    agentmail_write_cb_t write_cb;
+    void *ctx;
+    const http_response_t *response;
+    size_t skip;                    // Leading bytes to drop (server ignored the Range)
+} download_t;
+
+static agentmail_err_t download_on_data(void *ctx, const char *data, size_t len) {
+    download_t *download = (download_t *)ctx;
+    // A 200 instead of a 206 repeats the content from the first byte
+    if (download->skip > 0 && download->response->status_code == 200) {
+        size_t n = (len < download->skip) ? len : download->skip;
+        download->skip -= n;
+        data += n;
+        len -= n;
+        if (len == 0) {
+            return AGENTMAIL_ERR_NONE;
+        }
+    }
+    return download->write_cb(download->ctx, data, len);
+}
+
+agentmail_err_t agentmail_attachment_download(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    const char *attachment_id,
+    size_t offset,
+    agentmail_write_cb_t write_cb,
+    void *ctx,
+    size_t *received
+) {
+    if (received != NULL) {
+        *received = 0;
+    }
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || attachment_id == NULL ||
+        write_cb == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+
+    // Build path
+    char path[512];
+    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/attachments/%s",
+             inbox_id, message_id, attachment_id);
+
+    download_t download = {};
+    download.write_cb = write_cb;
+    download.ctx = ctx;
+    size_t delivered = 0;
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    for (int resumes = 0;; resumes++) {
+        // Continue where the content (or the previous attempt) stopped
+        size_t start = offset + delivered;
+        char range[40];
+        const char *headers[3] = {NULL, NULL, NULL};
+        if (start > 0) {
+            snprintf(range, sizeof(range), "bytes=%zu-", start);
+            headers[0] = "Range";
+            headers[1] = range;
+        }
+
+        http_response_t response = {};
+        response.on_data = download_on_data;
+        response.on_data_ctx = &download;
+        response.stream_response = true;
+        download.response = &response;
+        download.skip = start;
+        int status_code = 0;
+        err = perform_http_request_with_headers(
+            client, "GET", path, NULL, NULL, headers, &response, &status_code
+        );
+        bool streamed = (response.buffer == NULL);  // A buffered body is an error response
+        size_t progress = 0;
+        if (streamed) {
+            // Bytes the caller got from this response (any repeated prefix was dropped)
+            progress = (status_code == 200) ? response.size - (start - download.skip) : response.size;
+            delivered += progress;
+        }
+        free(response.buffer);
+
+        if (status_code == 416) {
+            ESP_LOGE(TAG, "Offset %zu is past the end of attachment %s", start, attachment_id);
+            err = AGENTMAIL_ERR_INVALID_ARG;
+        }
+        // Resume only after a dropped connection that delivered new bytes,
+        // so a dead link (or a server that ignores Range and drops within
+        // the repeated prefix) doesn't loop
+        bool dropped = (err == AGENTMAIL_ERR_NETWORK || err == AGENTMAIL_ERR_TIMEOUT);
+        if (!dropped || progress == 0 || resumes >= DOWNLOAD_MAX_RESUMES) {
+            break;
+        }
+        ESP_LOGW(TAG, "Attachment download interrupted at %zu bytes, resuming", offset + delivered);
+        agentmail_mutex_lock(client->stats_lock);
+        client->stats.resumed_downloads++;
+        agentmail_mutex_unlock(client->stats_lock);
+    }
+
+    if (received != NULL) {
+        *received = delivered;
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Downloaded attachment: %s (%zu bytes)", attachment_id, delivered);
+    return AGENTMAIL_ERR_NONE;
+}
+
+// ============================================================================
+// Asynchronous Operations
+// ============================================================================
+
+typedef enum {
+    ASYNC_SEND,
+    ASYNC_MESSAGES_GET,
+    ASYNC_MESSAGE_GET,
+    ASYNC_MARK_READ,
+} async_op_t;
+
+/**
+ * Queued request
+ *
+ * The job and copies of all its arguments live in one arena, so queueing
+ * a request is a single allocation in the common case and completing it
+ * is a single free.
+ */
+typedef struct {
+    agentmail_arena_t *arena;
+    async_op_t op;
+    bool oom;                       // A copy failed while building the job
+    const char *inbox_id;
+    const char *message_id;
+    agentmail_send_options_t send;
+    agentmail_message_query_t query;
+    bool has_query;
+    bool is_read;
+    union {
+        agentmail_send_cb_t send;
+        agentmail_messages_cb_t messages;
+        agentmail_message_cb_t message;
+        agentmail_done_cb_t done;
+    } cb;
+} async_job_t;
+
+static async_job_t *async_job_new(async_op_t op) {
+    agentmail_arena_t *arena = agentmail_arena_create(512);
+    if (arena == NULL) return NULL;
+    async_job_t *job = (async_job_t *)agentmail_arena_alloc(arena, sizeof(async_job_t));
+    if (job == NULL) {
+        agentmail_arena_destroy(arena);
+        return NULL;
+    }
+    memset(job, 0, sizeof(async_job_t));
+    job->arena = arena;
+    job->op = op;
+    return job;
+}
+
+/**
+ * Copy a request argument into the job (NULL stays NULL)
+ */
+static const char *async_job_strdup(async_job_t *job, const char *str) {
+    if (str == NULL) return NULL;
+    char *copy = agentmail_arena_strndup(job->arena, str, strlen(str));
+    if (copy == NULL) job->oom = true;
+    return copy;
+}
+
+static const char **async_job_strdup_array(async_job_t *job, const char **strs, size_t count) {
+    if (strs == NULL || count == 0) return NULL;
+    const char **copy = (const char **)agentmail_arena_alloc(job->arena, count * sizeof(char *));
+    if (copy == NULL) {
+        job->oom = true;
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        copy[i] = async_job_strdup(job, strs[i]);
+    }
+    return copy;
+}
+
+static void async_run(agentmail_client_t *client, async_job_t *job) {
+    agentmail_handle_t handle = (agentmail_handle_t)client;
+    switch (job->op) {
+        case ASYNC_SEND: {
+            char *message_id = NULL;
+            agentmail_err_t err = agentmail_send(handle, &job->send, &message_id);
+            if (job->cb.send) job->cb.send(client->ctx, err, message_id);
+            free(message_id);
+            break;
+        }
+        case ASYNC_MESSAGES_GET: {
+            agentmail_message_list_t messages = {};
+            agentmail_err_t err = agentmail_messages_get(handle, job->inbox_id,
+                                                         job->has_query ? &job->query : NULL, &messages);
+            job->cb.messages(client->ctx, err, &messages);
+            agentmail_message_list_free(&messages);
+            break;
+        }
+        case ASYNC_MESSAGE_GET: {
+            agentmail_message_t message = {};
+            agentmail_err_t err = agentmail_message_get(handle, job->inbox_id, job->message_id, &message);
+            job->cb.message(client->ctx, err, &message);
+            agentmail_message_free(&message);
+            break;
+        }
+        case ASYNC_MARK_READ: {
+            agentmail_err_t err = agentmail_message_mark_read(handle, job->inbox_id,
+                                                              job->message_id, job->is_read);
+            if (job->cb.done) job->cb.done(client->ctx, err);
+            break;
+        }
+    }
+}
+
+/**
+ * Worker task: performs queued requests in order until a NULL job arrives
+ */
+static void async_worker_task(void *arg) {
+    agentmail_client_t *client = (agentmail_client_t *)arg;
+    while (true) {
+        async_job_t *job = (async_job_t *)agentmail_queue_receive(client->async_queue);
+        if (job == NULL) {
+            break;
+        }
+        async_run(client, job);
+        agentmail_arena_destroy(job->arena);
+    }
+}
+
+/**
+ * Hand a job to the worker, starting it on first use
+ */
+static agentmail_err_t async_submit(agentmail_client_t *client, async_job_t *job) {
+    if (job->oom) {
+        agentmail_arena_destroy(job->arena);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(client->async_lock);
+    if (client->async_worker == NULL) {
+        client->async_queue = agentmail_queue_create(client->async_queue_len);
+        if (client->async_queue != NULL) {
+            client->async_worker = agentmail_task_create(async_worker_task, client, "agentmail_async",
+                                                         ASYNC_TASK_STACK_SIZE, ASYNC_TASK_PRIORITY);
+            if (client->async_worker == NULL) {
+                agentmail_queue_delete(client->async_queue);
+                client->async_queue = NULL;
+            }
+        }
+        if (client->async_worker == NULL) {
+            ESP_LOGE(TAG, "Failed to start async worker");
+            err = AGENTMAIL_ERR_NO_MEM;
+        }
+    }
+    if (err == AGENTMAIL_ERR_NONE && !agentmail_queue_send(client->async_queue, job, false)) {
+        err = AGENTMAIL_ERR_BUSY;
+    }
+    agentmail_mutex_unlock(client->async_lock);
+
+    if (err != AGENTMAIL_ERR_NONE) {
+        agentmail_arena_destroy(job->arena);
+    }
+    return err;
+}
+
+agentmail_err_t agentmail_send_async(
+    agentmail_handle_t handle,
+    const agentmail_send_options_t *options,
+    agentmail_send_cb_t cb
+) {
+    if (handle == NULL || options == NULL || options->from == NULL || options->to == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    async_job_t *job = async_job_new(ASYNC_SEND);
+    if (job == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    job->send.from = async_job_strdup(job, options->from);
+    job->send.to = async_job_strdup(job, options->to);
+    job->send.subject = async_job_strdup(job, options->subject);
+    job->send.body_text = async_job_strdup(job, options->body_text);
+    job->send.body_html = async_job_strdup(job, options->body_html);
+    job->send.thread_id = async_job_strdup(job, options->thread_id);
+    job->send.reply_to = async_job_strdup(job, options->reply_to);
+    job->send.cc = async_job_strdup_array(job, options->cc, options->cc_count);
+    job->send.cc_count = job->send.cc ? options->cc_count : 0;
+    job->send.bcc = async_job_strdup_array(job, options->bcc, options->bcc_count);
+    job->send.bcc_count = job->send.bcc ? options->bcc_count : 0;
+    if (options->attachments != NULL && options->attachment_count > 0) {
+        size_t count = options->attachment_count;
+        agentmail_attachment_t *attachments = (agentmail_attachment_t *)agentmail_arena_alloc(
+            job->arena, count * sizeof(agentmail_attachment_t));
+        if (attachments == NULL) {
+            job->oom = true;
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                attachments[i] = options->attachments[i];
+                attachments[i].filename = async_job_strdup(job, options->attachments[i].filename);
+                attachments[i].content_type = async_job_strdup(job, options->attachments[i].content_type);
+                attachments[i].path = async_job_strdup(job, options->attachments[i].path);
+            }
+            job->send.attachments = attachments;
+            job->send.attachment_count = count;
+        }
+    }
+    job->cb.send = cb;
+
+    return async_submit((agentmail_client_t *)handle, job);
+}
+
+agentmail_err_t agentmail_messages_get_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const agentmail_message_query_t *query,
+    agentmail_messages_cb_t cb
+) {
+    if (handle == NULL || inbox_id == NULL || cb == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    async_job_t *job = async_job_new(ASYNC_MESSAGES_GET);
+    if (job == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    job->inbox_id = async_job_strdup(job, inbox_id);
+    if (query != NULL) {
+        job->query = *query;
+        job->query.cursor = async_job_strdup(job, query->cursor);
+        job->query.thread_id = async_job_strdup(job, query->thread_id);
+        job->has_query = true;
+    }
+    job->cb.messages = cb;
+
+    return async_submit((agentmail_client_t *)handle, job);
+}
+
+agentmail_err_t agentmail_message_get_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_message_cb_t cb
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL || cb == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    async_job_t *job = async_job_new(ASYNC_MESSAGE_GET);
+    if (job == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    job->inbox_id = async_job_strdup(job, inbox_id);
+    job->message_id = async_job_strdup(job, message_id);
+    job->cb.message = cb;
+
+    return async_submit((agentmail_client_t *)handle, job);
+}
+
+agentmail_err_t agentmail_message_mark_read_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    bool is_read,
+    agentmail_done_cb_t cb
+) {
+    if (handle == NULL || inbox_id == NULL || message_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    async_job_t *job = async_job_new(ASYNC_MARK_READ);
+    if (job == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    job->inbox_id = async_job_strdup(job, inbox_id);
+    job->message_id = async_job_strdup(job, message_id);
+    job->is_read = is_read;
+    job->cb.done = cb;
+
+    return async_submit((agentmail_client_t *)handle, job);
+}
+
+// ============================================================================
+// Event Subscription
+// ============================================================================
+
+/**
+ * Subscription state
+ */
+typedef struct {
+    agentmail_client_t *client;
+    agentmail_event_cb_t cb;
+    const agentmail_ws_transport_t *transport;
+    char *url;
+    char **inbox_ids;
+    char **last_ids;                // Newest message seen per inbox ("" = inbox was empty)
+    char **last_times;              // Its timestamp (NULL if unknown)
+    size_t inbox_count;
+    char *subscribe_msg;            // Sent on every (re)connect
+    uint32_t reconnect_delay_ms;
+    uint32_t reconnect_max_delay_ms;
+    uint32_t ping_interval_ms;
+    char *frame;                    // Message being received (NUL-terminated)
+    size_t frame_len;
+    size_t frame_cap;
+    char *recent[RECENT_EVENT_IDS]; // Recently delivered message IDs, for de-duplication
+    int recent_pos;
+    agentmail_mutex_t lock;         // Guards stopping
+    bool stopping;
+    agentmail_task_t task;
+} subscription_t;
+
+static bool subscription_stopping(subscription_t *sub) {
+    agentmail_mutex_lock(sub->lock);
+    bool stopping = sub->stopping;
+    agentmail_mutex_unlock(sub->lock);
+    return stopping;
+}
+
+static void subscription_emit(subscription_t *sub, agentmail_event_type_t type) {
+    agentmail_event_t event = {};
+    event.type = type;
+    sub->cb(sub->client->ctx, &event);
+}
+
+/**
+ * Transport callback collecting a message's payload
+ */
+static agentmail_err_t subscription_on_data(void *ctx, const char *data, size_t len) {
+    subscription_t *sub = (subscription_t *)ctx;
+    size_t needed = sub->frame_len + len + 1;
+    if (needed > (size_t)MAX_HTTP_RESPONSE_SIZE) {
+        ESP_LOGE(TAG, "Event exceeds %d bytes", MAX_HTTP_RESPONSE_SIZE);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    if (needed > sub->frame_cap) {
+        size_t new_cap = sub->frame_cap ? sub->frame_cap : 1024;
+        while (new_cap < needed) {
+            new_cap *= 2;
+        }
+        char *frame = (char *)realloc(sub->frame, new_cap);
+        if (frame == NULL) {
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        sub->frame = frame;
+        sub->frame_cap = new_cap;
+    }
+    memcpy(sub->frame + sub->frame_len, data, len);
+    sub->frame_len += len;
+    sub->frame[sub->frame_len] = '\0';
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Hand a message to the callback unless it was delivered recently (a
+ * message can arrive both pushed and through catch-up)
+ */
+static void subscription_deliver(subscription_t *sub, size_t inbox, const agentmail_message_t *message,
+                                 bool resumed) {
+    if (message->message_id != NULL) {
+        for (int i = 0; i < RECENT_EVENT_IDS; i++) {
+            if (sub->recent[i] != NULL && strcmp(sub->recent[i], message->message_id) == 0) {
+                return;
+            }
+        }
+        free(sub->recent[sub->recent_pos]);
+        sub->recent[sub->recent_pos] = strdup(message->message_id);
+        sub->recent_pos = (sub->recent_pos + 1) % RECENT_EVENT_IDS;
+
+        char *last_id = strdup(message->message_id);
+        if (last_id != NULL) {
+            free(sub->last_ids[inbox]);
+            free(sub->last_times[inbox]);
+            sub->last_ids[inbox] = last_id;
+            sub->last_times[inbox] = message->timestamp ? strdup(message->timestamp) : NULL;
+        }
+    }
+
+    agentmail_client_t *client = sub->client;
+    agentmail_mutex_lock(client->stats_lock);
+    if (resumed) {
+        client->stats.events_resumed++;
+    } else {
+        client->stats.events++;
     }
+    agentmail_mutex_unlock(client->stats_lock);
+
+    agentmail_event_t event = {};
+    event.type = AGENTMAIL_EVENT_MESSAGE_RECEIVED;
+    event.inbox_id = sub->inbox_ids[inbox];
+    event.message = message;
+    event.resumed = resumed;
+    sub->cb(client->ctx, &event);
+}
+
+/**
+ * Fetch what arrived while disconnected, oldest first. The first time an
+ * inbox is seen only its newest message is recorded, as the point to
+ * resume from.
+ */
+static void subscription_catch_up(subscription_t *sub) {
+    for (size_t i = 0; i < sub->inbox_count && !subscription_stopping(sub); i++) {
+        bool baseline = (sub->last_ids[i] == NULL);
+        agentmail_message_query_t query = {};
+        query.limit = baseline ? 1 : CATCH_UP_LIMIT;
+        query.fields = baseline ? (AGENTMAIL_FIELD_MESSAGE_ID | AGENTMAIL_FIELD_TIMESTAMP) : 0;
+
+        agentmail_message_list_t messages = {};
+        agentmail_err_t err = agentmail_messages_get(sub->client, sub->inbox_ids[i], &query, &messages);
+        if (err != AGENTMAIL_ERR_NONE) {
+            ESP_LOGW(TAG, "Catch-up for %s failed: %s", sub->inbox_ids[i], agentmail_err_to_str(err));
+            continue;
+        }
 
-    // Extract inbox info from v0 API response
-    cJSON *json_inbox_id = cJSON_GetObjectItem(res_json, "inbox_id");
-    cJSON *json_address = cJSON_GetObjectItem(res_json, "address");
-    cJSON *json_name = cJSON_GetObjectItem(res_json, "name");
-    cJSON *json_created_at = cJSON_GetObjectItem(res_json, "created_at");
-    cJSON *json_metadata = cJSON_GetObjectItem(res_json, "metadata");
+        if (baseline) {
+            const agentmail_message_t *newest = (messages.count > 0) ? &messages.messages[0] : NULL;
+            sub->last_ids[i] = strdup((newest && newest->message_id) ? newest->message_id : "");
+            sub->last_times[i] = (newest && newest->timestamp) ? strdup(newest->timestamp) : NULL;
+        } else {
+            // Newest first: everything before the last message seen is new.
+            // Should that message have been deleted meanwhile, its timestamp
+            // still marks where the new ones end; messages sharing it are
+            // left to the de-duplication of recent IDs.
+            const char *last_time = sub->last_times[i];
+            size_t end = messages.count;
+            for (size_t k = 0; k < messages.count; k++) {
+                const agentmail_message_t *message = &messages.messages[k];
+                if ((message->message_id != NULL && strcmp(message->message_id, sub->last_ids[i]) == 0) ||
+                    (last_time != NULL && message->timestamp != NULL &&
+                     strcmp(message->timestamp, last_time) < 0)) {
+                    end = k;
+                    break;
+                }
+            }
+            if (end == (size_t)CATCH_UP_LIMIT && sub->last_ids[i][0] != '\0') {
+                ESP_LOGW(TAG, "More than %d messages missed in %s; delivering the newest",
+                         CATCH_UP_LIMIT, sub->inbox_ids[i]);
+            }
+            for (size_t k = end; k-- > 0;) {
+                subscription_deliver(sub, i, &messages.messages[k], true);
+            }
+        }
+        agentmail_message_list_free(&messages);
+    }
+}
 
-    if (cJSON_IsString(json_inbox_id)) {
-        inbox->inbox_id = strdup(json_inbox_id->valuestring);
+/**
+ * Decoder state for event payloads, which arrive over the WebSocket and in
+ * webhook POSTs alike:
+ * {"type":"event","event_type":"message.received","message":{...}}
+ *
+ * The payload is parsed in place and its "message" object decoded through
+ * MESSAGE_TABLE like an agentmail_message_get() body, so the message's
+ * strings point into the payload.
+ */
+typedef struct {
+    agentmail_json_parser_t parser;
+    field_decoder_t message;       // The "message" object while inside it
+    agentmail_message_t *target;
+    bool has_message;
+    const char *type;
+    const char *event_type;
+    const char *inbox_id;          // Top-level inbox_id
+    const char *message_inbox_id;  // inbox_id inside the message (preferred)
+    const char *text;              // Top-level "message" string, e.g. of an error
+} event_decoder_t;
+
+static agentmail_err_t event_on_event(
+    void *ctx,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+) {
+    event_decoder_t *dec = (event_decoder_t *)ctx;
+    if (dec->message.target != NULL && depth >= dec->message.depth) {
+        if (depth == dec->message.depth && event == AGENTMAIL_JSON_STRING && strcmp(key, "inbox_id") == 0) {
+            dec->message_inbox_id = value;
+        }
+        return field_decoder_on_event(&dec->message, &dec->parser, event, key, value, len, depth);
     }
-    if (cJSON_IsString(json_address)) {
-        inbox->email_address = strdup(json_address->valuestring);
+    if (depth != 1) {
+        return AGENTMAIL_ERR_NONE;
     }
-    if (cJSON_IsString(json_name)) {
-        inbox->name = strdup(json_name->valuestring);
+    if (event == AGENTMAIL_JSON_OBJECT_END) {
+        dec->message.target = NULL;
+        return AGENTMAIL_ERR_NONE;
     }
-    if (cJSON_IsString(json_created_at)) {
-        inbox->created_at = strdup(json_created_at->valuestring);
+    if (key == NULL) {
+        return AGENTMAIL_ERR_NONE;  // Not an object at the root
     }
-    if (cJSON_IsString(json_metadata)) {
-        inbox->metadata = strdup(json_metadata->valuestring);
-    } else if (cJSON_IsObject(json_metadata)) {
-        char *metadata_str = cJSON_PrintUnformatted(json_metadata);
-        if (metadata_str) {
-            inbox->metadata = metadata_str;
+
+    if (event == AGENTMAIL_JSON_OBJECT_BEGIN && strcmp(key, "message") == 0 && !dec->has_message) {
+        dec->has_message = true;
+        dec->message.target = dec->target;
+    } else if (event == AGENTMAIL_JSON_STRING) {
+        if (strcmp(key, "type") == 0) {
+            dec->type = value;
+        } else if (strcmp(key, "event_type") == 0) {
+            dec->event_type = value;
+        } else if (strcmp(key, "inbox_id") == 0) {
+            dec->inbox_id = value;
+        } else if (strcmp(key, "message") == 0) {
+            dec->text = value;
         }
     }
-
-    cJSON_Delete(res_json);
     return AGENTMAIL_ERR_NONE;
 }
 
-agentmail_err_t agentmail_inbox_list(
-    agentmail_handle_t handle,
-    int limit,
-    const char *cursor,
-    agentmail_inbox_list_t *inboxes
-) {
-    if (handle == NULL || inboxes == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
+/**
+ * Decode an event payload in place (doc[len] must be '\0')
+ *
+ * @return true for a message.received event, with message filled in and
+ *         *inbox_id set; message->attachments must be freed afterwards.
+ *         false for a malformed payload (*err set) or any other event.
+ */
+static bool event_decode(event_decoder_t *dec, char *doc, size_t len, agentmail_message_t *message,
+                         const char **inbox_id, agentmail_err_t *err) {
+    memset(dec, 0, sizeof(event_decoder_t));
+    memset(message, 0, sizeof(agentmail_message_t));
+    dec->target = message;
+    dec->message.table = &MESSAGE_TABLE;
+    dec->message.depth = 2;
+    dec->message.fields = UINT32_MAX;
+    dec->message.in_place = true;
+    agentmail_json_init(&dec->parser, event_on_event, dec);
+    *err = agentmail_json_parse_in_place(&dec->parser, doc, len);
+    agentmail_json_free(&dec->parser);
+
+    bool received = (*err == AGENTMAIL_ERR_NONE && dec->has_message &&
+                     dec->type != NULL && strcmp(dec->type, "event") == 0 &&
+                     dec->event_type != NULL && strcmp(dec->event_type, "message.received") == 0);
+    if (!received) {
+        free(message->attachments);
+        memset(message, 0, sizeof(agentmail_message_t));
+        return false;
     }
+    *inbox_id = dec->message_inbox_id ? dec->message_inbox_id : dec->inbox_id;
+    return true;
+}
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    memset(inboxes, 0, sizeof(agentmail_inbox_list_t));
-
-    // Build path with query params
-    char path[512];
-    int offset = snprintf(path, sizeof(path), "/inboxes?limit=%d", limit > 0 ? limit : 20);
-    if (cursor != NULL) {
-        snprintf(path + offset, sizeof(path) - offset, "&cursor=%s", cursor);
+/**
+ * Dispatch one received message
+ */
+static void subscription_handle(subscription_t *sub) {
+    event_decoder_t dec;
+    agentmail_message_t message;
+    const char *inbox_id = NULL;
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    if (event_decode(&dec, sub->frame, sub->frame_len, &message, &inbox_id, &err)) {
+        for (size_t i = 0; i < sub->inbox_count; i++) {
+            if (inbox_id != NULL && strcmp(inbox_id, sub->inbox_ids[i]) == 0) {
+                subscription_deliver(sub, i, &message, false);
+                break;
+            }
+        }
+        free(message.attachments);  // The strings point into the frame
+    } else if (err != AGENTMAIL_ERR_NONE) {
+        ESP_LOGW(TAG, "Ignoring malformed event");
+    } else if (dec.type != NULL && strcmp(dec.type, "error") == 0) {
+        ESP_LOGW(TAG, "Subscription error: %s", dec.text ? dec.text : "unknown");
     }
+}
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "GET", path, NULL, &response, &status_code
-    );
-
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+/**
+ * Receive events until the connection fails or the subscription stops
+ */
+static agentmail_err_t subscription_run(subscription_t *sub, void *conn) {
+    int64_t last_rx_us = agentmail_time_us();
+    bool ping_sent = false;
+    while (!subscription_stopping(sub)) {
+        sub->frame_len = 0;
+        agentmail_err_t err = sub->transport->receive(conn, SUBSCRIBE_RECEIVE_SLICE_MS,
+                                                      subscription_on_data, sub);
+        int64_t now_us = agentmail_time_us();
+        if (err == AGENTMAIL_ERR_TIMEOUT) {
+            // Half-open connections are only noticed by pinging
+            int64_t idle_ms = (now_us - last_rx_us) / 1000;
+            if (idle_ms >= 2 * (int64_t)sub->ping_interval_ms) {
+                return AGENTMAIL_ERR_TIMEOUT;
+            }
+            if (idle_ms >= (int64_t)sub->ping_interval_ms && !ping_sent) {
+                err = sub->transport->ping(conn);
+                if (err != AGENTMAIL_ERR_NONE) {
+                    return err;
+                }
+                ping_sent = true;
+            }
+            continue;
+        }
+        if (err != AGENTMAIL_ERR_NONE) {
+            return err;
+        }
+        last_rx_us = now_us;
+        ping_sent = false;
+        if (sub->frame_len > 0) {
+            subscription_handle(sub);
+        }
     }
+    return AGENTMAIL_ERR_NONE;
+}
 
-    // Parse response (adjust based on actual API response format)
-    cJSON *res_json = cJSON_Parse(response.buffer);
-    free(response.buffer);
-    
-    if (res_json == NULL) {
-        return AGENTMAIL_ERR_PARSE;
-    }
+/**
+ * Subscription task: connect, subscribe, catch up and receive, then
+ * reconnect with jittered exponential backoff until unsubscribed
+ */
+static void subscription_task(void *arg) {
+    subscription_t *sub = (subscription_t *)arg;
+    agentmail_client_t *client = sub->client;
+
+    agentmail_ws_config_t config = {};
+    config.url = sub->url;
+    config.headers = client->headers;
+    config.timeout_ms = client->timeout_ms;
+
+    int failures = 0;
+    while (!subscription_stopping(sub)) {
+        void *conn = NULL;
+        agentmail_err_t err = sub->transport->connect(&config, &conn);
+        if (err == AGENTMAIL_ERR_NONE) {
+            err = sub->transport->send_text(conn, sub->subscribe_msg, strlen(sub->subscribe_msg));
+            if (err != AGENTMAIL_ERR_NONE) {
+                sub->transport->close(conn);
+            }
+        }
 
-    // v0 API returns array of inboxes directly or in "inboxes" field
-    cJSON *data = cJSON_GetObjectItem(res_json, "inboxes");
-    if (!data || !cJSON_IsArray(data)) {
-        // Try root array
-        data = res_json;
-    }
-    
-    if (cJSON_IsArray(data)) {
-        size_t count = cJSON_GetArraySize(data);
-        if (count > 0) {
-            inboxes->inboxes = (agentmail_inbox_t *)calloc(count, sizeof(agentmail_inbox_t));
-            if (inboxes->inboxes != NULL) {
-                inboxes->count = count;
-                for (size_t i = 0; i < count; i++) {
-                    cJSON *item = cJSON_GetArrayItem(data, i);
-                    cJSON *inbox_id = cJSON_GetObjectItem(item, "inbox_id");
-                    cJSON *address = cJSON_GetObjectItem(item, "address");
-                    cJSON *name = cJSON_GetObjectItem(item, "name");
-                    cJSON *created_at = cJSON_GetObjectItem(item, "created_at");
-                    
-                    if (cJSON_IsString(inbox_id)) {
-                        inboxes->inboxes[i].inbox_id = strdup(inbox_id->valuestring);
-                    }
-                    if (cJSON_IsString(address)) {
-                        inboxes->inboxes[i].email_address = strdup(address->valuestring);
-                    }
-                    if (cJSON_IsString(name)) {
-                        inboxes->inboxes[i].name = strdup(name->valuestring);
-                    }
-                    if (cJSON_IsString(created_at)) {
-                        inboxes->inboxes[i].created_at = strdup(created_at->valuestring);
-                    }
-                }
+        if (err == AGENTMAIL_ERR_NONE) {
+            failures = 0;
+            agentmail_mutex_lock(client->stats_lock);
+            client->stats.ws_connects++;
+            agentmail_mutex_unlock(client->stats_lock);
+            ESP_LOGI(TAG, "Subscribed to %zu inbox(es) via %s", sub->inbox_count, sub->url);
+
+            subscription_emit(sub, AGENTMAIL_EVENT_CONNECTED);
+            subscription_catch_up(sub);
+            err = subscription_run(sub, conn);
+            sub->transport->close(conn);
+            if (subscription_stopping(sub)) {
+                break;
             }
+            subscription_emit(sub, AGENTMAIL_EVENT_DISCONNECTED);
         }
-    }
 
-    cJSON *next_page_token = cJSON_GetObjectItem(res_json, "next_page_token");
-    if (cJSON_IsString(next_page_token)) {
-        inboxes->next_cursor = strdup(next_page_token->valuestring);
+        // Back off over the upper half of a doubling window
+        uint32_t window = sub->reconnect_delay_ms;
+        for (int i = 0; i < failures && window < sub->reconnect_max_delay_ms; i++) {
+            window *= 2;
+        }
+        if (window > sub->reconnect_max_delay_ms) {
+            window = sub->reconnect_max_delay_ms;
+        }
+        uint32_t delay_ms = window / 2 + agentmail_random() % (window / 2 + 1);
+        failures++;
+        ESP_LOGW(TAG, "Subscription connection lost (%s), reconnecting in %lu ms",
+                 agentmail_err_to_str(err), (unsigned long)delay_ms);
+
+        for (uint32_t waited = 0; waited < delay_ms && !subscription_stopping(sub);
+             waited += SUBSCRIBE_RECEIVE_SLICE_MS) {
+            uint32_t left = delay_ms - waited;
+            agentmail_delay_ms(left < (uint32_t)SUBSCRIBE_RECEIVE_SLICE_MS ? left : SUBSCRIBE_RECEIVE_SLICE_MS);
+        }
     }
+}
 
-    cJSON_Delete(res_json);
-    return AGENTMAIL_ERR_NONE;
+static void subscription_free(subscription_t *sub) {
+    for (size_t i = 0; i < sub->inbox_count; i++) {
+        if (sub->inbox_ids) free(sub->inbox_ids[i]);
+        if (sub->last_ids) free(sub->last_ids[i]);
+        if (sub->last_times) free(sub->last_times[i]);
+    }
+    for (int i = 0; i < RECENT_EVENT_IDS; i++) {
+        free(sub->recent[i]);
+    }
+    free(sub->inbox_ids);
+    free(sub->last_ids);
+    free(sub->last_times);
+    free(sub->url);
+    free(sub->subscribe_msg);
+    free(sub->frame);
+    if (sub->lock != NULL) {
+        agentmail_mutex_delete(sub->lock);
+    }
+    free(sub);
 }
 
-agentmail_err_t agentmail_inbox_update(
+agentmail_err_t agentmail_subscribe(
     agentmail_handle_t handle,
-    const char *inbox_id,
-    const agentmail_inbox_options_t *options
+    const agentmail_subscribe_options_t *options,
+    agentmail_event_cb_t cb,
+    agentmail_subscription_t *subscription
 ) {
-    if (handle == NULL || inbox_id == NULL) {
+    if (handle == NULL || options == NULL || options->inbox_ids == NULL ||
+        options->inbox_count == 0 || cb == NULL || subscription == NULL) {
         return AGENTMAIL_ERR_INVALID_ARG;
     }
+    *subscription = NULL;
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-
-    // Build JSON payload
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
+    subscription_t *sub = (subscription_t *)calloc(1, sizeof(subscription_t));
+    if (sub == NULL) {
         return AGENTMAIL_ERR_NO_MEM;
     }
-
-    if (options != NULL) {
-        if (options->name != NULL) {
-            cJSON_AddStringToObject(json, "name", options->name);
-        }
-        if (options->metadata != NULL) {
-            cJSON *metadata = cJSON_Parse(options->metadata);
-            if (metadata != NULL) {
-                cJSON_AddItemToObject(json, "metadata", metadata);
-            }
+    sub->client = (agentmail_client_t *)handle;
+    sub->cb = cb;
+    sub->transport = options->transport ? options->transport : agentmail_ws_transport_default();
+    sub->url = strdup(options->url ? options->url : DEFAULT_WS_URL);
+    sub->reconnect_delay_ms = options->reconnect_delay_ms ? options->reconnect_delay_ms
+                                                          : DEFAULT_RECONNECT_DELAY_MS;
+    sub->reconnect_max_delay_ms = options->reconnect_max_delay_ms ? options->reconnect_max_delay_ms
+                                                                  : DEFAULT_RECONNECT_MAX_DELAY_MS;
+    sub->ping_interval_ms = options->ping_interval_ms ? options->ping_interval_ms
+                                                      : DEFAULT_PING_INTERVAL_MS;
+    sub->lock = agentmail_mutex_create();
+    sub->inbox_ids = (char **)calloc(options->inbox_count, sizeof(char *));
+    sub->last_ids = (char **)calloc(options->inbox_count, sizeof(char *));
+    sub->last_times = (char **)calloc(options->inbox_count, sizeof(char *));
+
+    // {"type":"subscribe","inbox_ids":[...],"event_types":["message.received"]}
+    cJSON *json = cJSON_CreateObject();
+    cJSON *inbox_ids = cJSON_CreateArray();
+    cJSON *event_types = cJSON_CreateArray();
+    bool oom = (sub->url == NULL || sub->lock == NULL || sub->inbox_ids == NULL ||
+                sub->last_ids == NULL || sub->last_times == NULL || json == NULL || inbox_ids == NULL ||
+                event_types == NULL);
+    if (!oom) {
+        sub->inbox_count = options->inbox_count;
+        for (size_t i = 0; i < options->inbox_count; i++) {
+            const char *inbox_id = options->inbox_ids[i] ? options->inbox_ids[i] : "";
+            sub->inbox_ids[i] = strdup(inbox_id);
+            oom |= (sub->inbox_ids[i] == NULL);
+            cJSON_AddItemToArray(inbox_ids, cJSON_CreateString(inbox_id));
         }
+        cJSON_AddItemToArray(event_types, cJSON_CreateString("message.received"));
+        cJSON_AddStringToObject(json, "type", "subscribe");
+        cJSON_AddItemToObject(json, "inbox_ids", inbox_ids);
+        cJSON_AddItemToObject(json, "event_types", event_types);
+        inbox_ids = NULL;
+        event_types = NULL;
+        sub->subscribe_msg = cJSON_PrintUnformatted(json);
+        oom |= (sub->subscribe_msg == NULL);
     }
-
-    char *payload = cJSON_PrintUnformatted(json);
     cJSON_Delete(json);
-    if (payload == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
-    }
-
-    // Build path
-    char path[256];
-    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
-
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "PATCH", path, payload, &response, &status_code
-    );
+    cJSON_Delete(inbox_ids);
+    cJSON_Delete(event_types);
 
-    free(payload);
-    free(response.buffer);
-    
-    if (err == AGENTMAIL_ERR_NONE) {
-        ESP_LOGI(TAG, "Updated inbox: %s", inbox_id);
+    if (!oom) {
+        sub->task = agentmail_task_create(subscription_task, sub, "agentmail_sub",
+                                          SUBSCRIBE_TASK_STACK_SIZE, ASYNC_TASK_PRIORITY);
+    }
+    if (sub->task == NULL) {
+        ESP_LOGE(TAG, "Failed to start subscription");
+        subscription_free(sub);
+        return AGENTMAIL_ERR_NO_MEM;
     }
 
-    return err;
+    *subscription = (agentmail_subscription_t)sub;
+    return AGENTMAIL_ERR_NONE;
 }
 
-agentmail_err_t agentmail_inbox_delete(
-    agentmail_handle_t handle,
-    const char *inbox_id
-) {
-    if (handle == NULL || inbox_id == NULL) {
+agentmail_err_t agentmail_unsubscribe(agentmail_subscription_t subscription) {
+    if (subscription == NULL) {
         return AGENTMAIL_ERR_INVALID_ARG;
     }
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-
-    // Build path
-    char path[256];
-    snprintf(path, sizeof(path), "/inboxes/%s", inbox_id);
-
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "DELETE", path, NULL, &response, &status_code
-    );
-
-    free(response.buffer);
-    
-    if (err == AGENTMAIL_ERR_NONE) {
-        ESP_LOGI(TAG, "Deleted inbox: %s", inbox_id);
-    }
+    subscription_t *sub = (subscription_t *)subscription;
+    agentmail_mutex_lock(sub->lock);
+    sub->stopping = true;
+    agentmail_mutex_unlock(sub->lock);
 
-    return err;
+    // The task notices within one receive slice
+    agentmail_task_join(sub->task);
+    subscription_free(sub);
+    return AGENTMAIL_ERR_NONE;
 }
 
 // ============================================================================
-// Message Operations
+// Webhook Receiver
 // ============================================================================
 
-agentmail_err_t agentmail_send(
-    agentmail_handle_t handle,
-    const agentmail_send_options_t *options,
-    char **message_id
-) {
-    if (handle == NULL || options == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
-    if (options->from == NULL || options->to == NULL) {
-        ESP_LOGE(TAG, "from and to are required");
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
+/**
+ * Signature headers (Svix scheme), captured by the server backend in this
+ * order
+ */
+enum {
+    WEBHOOK_HEADER_ID,
+    WEBHOOK_HEADER_TIMESTAMP,
+    WEBHOOK_HEADER_SIGNATURE,
+};
+
+static const char *const WEBHOOK_HEADERS[] = {
+    "svix-id",
+    "svix-timestamp",
+    "svix-signature",
+    NULL
+};
 
-    // Build JSON payload
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
+/**
+ * Webhook listener state. The server backend calls in one request at a
+ * time, so nothing here needs a lock.
+ */
+typedef struct {
+    agentmail_client_t *client;
+    agentmail_event_cb_t cb;
+    const agentmail_http_server_t *backend;
+    void *server;
+    char *path;
+    uint8_t *key;                   // Decoded signing secret (NULL = unsigned)
+    size_t key_len;
+    uint32_t tolerance_s;
+    char *recent[RECENT_EVENT_IDS]; // Recently handled webhook IDs; retries are acknowledged only
+    int recent_pos;
+} webhook_t;
+
+static void base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = (uint32_t)in[i] << 16;
+        if (i + 1 < len) n |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) n |= in[i + 2];
+        out[pos++] = ALPHABET[(n >> 18) & 0x3F];
+        out[pos++] = ALPHABET[(n >> 12) & 0x3F];
+        out[pos++] = (i + 1 < len) ? ALPHABET[(n >> 6) & 0x3F] : '=';
+        out[pos++] = (i + 2 < len) ? ALPHABET[n & 0x3F] : '=';
     }
+    out[pos] = '\0';
+}
 
-    cJSON_AddStringToObject(json, "from", options->from);
-    cJSON_AddStringToObject(json, "to", options->to);
-    
-    if (options->subject != NULL) {
-        cJSON_AddStringToObject(json, "subject", options->subject);
-    }
-    if (options->body_text != NULL) {
-        cJSON_AddStringToObject(json, "body_text", options->body_text);
-    }
-    if (options->body_html != NULL) {
-        cJSON_AddStringToObject(json, "body_html", options->body_html);
-    }
-    if (options->thread_id != NULL) {
-        cJSON_AddStringToObject(json, "thread_id", options->thread_id);
-    }
-    if (options->reply_to != NULL) {
-        cJSON_AddStringToObject(json, "reply_to", options->reply_to);
+/**
+ * Decode standard base64 into a new buffer
+ *
+ * @return Decoded bytes (caller must free()), or NULL if malformed
+ */
+static uint8_t *base64_decode(const char *in, size_t *out_len) {
+    size_t len = strlen(in);
+    uint8_t *out = (uint8_t *)malloc(len / 4 * 3 + 3);
+    if (out == NULL || len % 4 != 0) {
+        free(out);
+        return NULL;
     }
 
-    // Add CC recipients
-    if (options->cc != NULL && options->cc_count > 0) {
-        cJSON *cc_array = cJSON_CreateArray();
-        for (size_t i = 0; i < options->cc_count; i++) {
-            cJSON_AddItemToArray(cc_array, cJSON_CreateString(options->cc[i]));
+    size_t pos = 0;
+    uint32_t bits = 0;
+    int nbits = 0;
+    for (size_t i = 0; i < len && in[i] != '='; i++) {
+        char c = in[i];
+        int v = (c >= 'A' && c <= 'Z') ? c - 'A'
+              : (c >= 'a' && c <= 'z') ? c - 'a' + 26
+              : (c >= '0' && c <= '9') ? c - '0' + 52
+              : (c == '+') ? 62 : (c == '/') ? 63 : -1;
+        if (v < 0) {
+            free(out);
+            return NULL;
         }
-        cJSON_AddItemToObject(json, "cc", cc_array);
-    }
-
-    // Add BCC recipients
-    if (options->bcc != NULL && options->bcc_count > 0) {
-        cJSON *bcc_array = cJSON_CreateArray();
-        for (size_t i = 0; i < options->bcc_count; i++) {
-            cJSON_AddItemToArray(bcc_array, cJSON_CreateString(options->bcc[i]));
+        bits = (bits << 6) | v;
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            out[pos++] = (uint8_t)(bits >> nbits);
         }
-        cJSON_AddItemToObject(json, "bcc", bcc_array);
-    }
-
-    char *payload = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-    if (payload == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
     }
+    *out_len = pos;
+    return out;
+}
 
-    // Build v0 API path: /inboxes/:inbox_id/messages/send (URL encode inbox_id)
-    char* encoded_inbox_id = url_encode(options->from);
-    if (encoded_inbox_id == NULL) {
-        free(payload);
-        return AGENTMAIL_ERR_NO_MEM;
+/**
+ * Check the signature over "<id>.<timestamp>.<body>" against every "v1,"
+ * entry of the signature header, and the timestamp against the tolerance
+ * when the clock is set
+ */
+static bool webhook_verify(webhook_t *wh, const agentmail_http_server_request_t *request) {
+    const char *id = request->header_values[WEBHOOK_HEADER_ID];
+    const char *timestamp = request->header_values[WEBHOOK_HEADER_TIMESTAMP];
+    const char *signatures = request->header_values[WEBHOOK_HEADER_SIGNATURE];
+    if (id == NULL || timestamp == NULL || signatures == NULL) {
+        ESP_LOGW(TAG, "Unsigned webhook rejected");
+        return false;
     }
-    
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/send", encoded_inbox_id);
-
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "POST", path, payload, &response, &status_code
-    );
-    free(payload);
-    free(encoded_inbox_id);
 
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+    time_t now = time(NULL);
+    if (now >= MIN_VALID_UNIX_TIME) {
+        long long age = (long long)now - strtoll(timestamp, NULL, 10);
+        if (age > (long long)wh->tolerance_s || age < -(long long)wh->tolerance_s) {
+            ESP_LOGW(TAG, "Webhook timestamp outside tolerance (%llds)", age);
+            return false;
+        }
     }
 
-    // Parse response to get message ID (v0 API)
-    if (message_id != NULL) {
-        cJSON *res_json = cJSON_Parse(response.buffer);
-        if (res_json != NULL) {
-            cJSON *msg_id = cJSON_GetObjectItem(res_json, "message_id");
-            if (cJSON_IsString(msg_id)) {
-                *message_id = strdup(msg_id->valuestring);
-                ESP_LOGI(TAG, "Sent message: %s", *message_id);
+    const void *parts[] = { id, ".", timestamp, ".", request->body };
+    size_t part_lens[] = { strlen(id), 1, strlen(timestamp), 1, request->body_len };
+    uint8_t mac[AGENTMAIL_HMAC_SHA256_LEN];
+    agentmail_hmac_sha256(wh->key, wh->key_len, parts, part_lens, 5, mac);
+    char expected[(AGENTMAIL_HMAC_SHA256_LEN + 2) / 3 * 4 + 1];
+    base64_encode(mac, sizeof(mac), expected);
+    size_t expected_len = strlen(expected);
+
+    // Space-separated "v1,<base64>" entries (several during secret rotation)
+    const char *p = signatures;
+    while (*p != '\0') {
+        while (*p == ' ') p++;
+        const char *end = p;
+        while (*end != '\0' && *end != ' ') end++;
+        if (end - p == (ptrdiff_t)(3 + expected_len) && strncmp(p, "v1,", 3) == 0) {
+            // Constant time, so the comparison leaks nothing about the MAC
+            uint8_t diff = 0;
+            for (size_t i = 0; i < expected_len; i++) {
+                diff |= (uint8_t)(p[3 + i] ^ expected[i]);
+            }
+            if (diff == 0) {
+                return true;
             }
-            cJSON_Delete(res_json);
         }
+        p = end;
     }
-
-    free(response.buffer);
-    return AGENTMAIL_ERR_NONE;
+    ESP_LOGW(TAG, "Webhook signature mismatch");
+    return false;
 }
 
-agentmail_err_t agentmail_messages_get(
-    agentmail_handle_t handle,
-    const char *inbox_id,
-    const agentmail_message_query_t *query,
-    agentmail_message_list_t *messages
-) {
-    if (handle == NULL || inbox_id == NULL || messages == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    memset(messages, 0, sizeof(agentmail_message_list_t));
-
-    // URL encode inbox_id (may contain @ symbol)
-    char* encoded_inbox_id = url_encode(inbox_id);
-    if (encoded_inbox_id == NULL) {
-        return AGENTMAIL_ERR_NO_MEM;
+/**
+ * @return true if this webhook ID was handled recently (a retry)
+ */
+static bool webhook_seen(webhook_t *wh, const char *id) {
+    if (id == NULL) {
+        return false;
     }
-
-    // Build path with query params
-    char path[1024];
-    int limit = (query != NULL && query->limit > 0) ? query->limit : 20;
-    int offset = snprintf(path, sizeof(path), "/inboxes/%s/messages?limit=%d", 
-                          encoded_inbox_id, limit);
-    
-    if (query != NULL) {
-        if (query->cursor != NULL) {
-            offset += snprintf(path + offset, sizeof(path) - offset, 
-                               "&cursor=%s", query->cursor);
-        }
-        if (query->unread_only) {
-            offset += snprintf(path + offset, sizeof(path) - offset, 
-                               "&unread=true");
-        }
-        if (query->thread_id != NULL) {
-            offset += snprintf(path + offset, sizeof(path) - offset, 
-                               "&thread_id=%s", query->thread_id);
+    for (int i = 0; i < RECENT_EVENT_IDS; i++) {
+        if (wh->recent[i] != NULL && strcmp(wh->recent[i], id) == 0) {
+            return true;
         }
     }
+    return false;
+}
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "GET", path, NULL, &response, &status_code
-    );
-
-    free(encoded_inbox_id); // Free URL-encoded string
+static void webhook_remember(webhook_t *wh, const char *id) {
+    if (id == NULL) {
+        return;
+    }
+    free(wh->recent[wh->recent_pos]);
+    wh->recent[wh->recent_pos] = strdup(id);
+    wh->recent_pos = (wh->recent_pos + 1) % RECENT_EVENT_IDS;
+}
 
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+static void webhook_reject(webhook_t *wh) {
+    agentmail_mutex_lock(wh->client->stats_lock);
+    wh->client->stats.webhook_rejected++;
+    agentmail_mutex_unlock(wh->client->stats_lock);
+}
+
+/**
+ * Server callback: verify, parse and dispatch one POST
+ */
+static int webhook_on_request(void *ctx, const agentmail_http_server_request_t *request) {
+    webhook_t *wh = (webhook_t *)ctx;
+    if (strcmp(request->path, wh->path) != 0) {
+        return 404;
+    }
+    if (strcmp(request->method, "POST") != 0) {
+        return 405;
+    }
+    if (wh->key != NULL && !webhook_verify(wh, request)) {
+        webhook_reject(wh);
+        return 401;
     }
 
-    // Parse response
-    cJSON *res_json = cJSON_Parse(response.buffer);
-    free(response.buffer);
-    
-    if (res_json == NULL) {
-        return AGENTMAIL_ERR_PARSE;
+    const char *id = request->header_values[WEBHOOK_HEADER_ID];
+    if (webhook_seen(wh, id)) {
+        return 200;
     }
 
-    // v0 API returns array of messages in "messages" field
-    cJSON *data = cJSON_GetObjectItem(res_json, "messages");
-    if (!data || !cJSON_IsArray(data)) {
-        // Try root array
-        data = res_json;
+    // Parsed in place, so into a copy of the request body
+    char *doc = (char *)malloc(request->body_len + 1);
+    if (doc == NULL) {
+        return 503;
     }
-    
-    if (cJSON_IsArray(data)) {
-        size_t count = cJSON_GetArraySize(data);
-        if (count > 0) {
-            messages->messages = (agentmail_message_t *)calloc(count, sizeof(agentmail_message_t));
-            if (messages->messages != NULL) {
-                messages->count = count;
-                for (size_t i = 0; i < count; i++) {
-                    cJSON *item = cJSON_GetArrayItem(data, i);
-                    agentmail_message_t *msg = &messages->messages[i];
-                    
-                    cJSON *json_message_id = cJSON_GetObjectItem(item, "message_id");
-                    cJSON *json_thread_id = cJSON_GetObjectItem(item, "thread_id");
-                    cJSON *json_from = cJSON_GetObjectItem(item, "from");
-                    cJSON *json_to = cJSON_GetObjectItem(item, "to");
-                    cJSON *json_subject = cJSON_GetObjectItem(item, "subject");
-                    cJSON *json_text = cJSON_GetObjectItem(item, "text");
-                    cJSON *json_html = cJSON_GetObjectItem(item, "html");
-                    cJSON *json_created_at = cJSON_GetObjectItem(item, "created_at");
-                    cJSON *json_is_read = cJSON_GetObjectItem(item, "is_read");
-                    
-                    if (cJSON_IsString(json_message_id)) msg->message_id = strdup(json_message_id->valuestring);
-                    if (cJSON_IsString(json_thread_id)) msg->thread_id = strdup(json_thread_id->valuestring);
-                    if (cJSON_IsString(json_from)) msg->from = strdup(json_from->valuestring);
-                    if (cJSON_IsString(json_to)) msg->to = strdup(json_to->valuestring);
-                    if (cJSON_IsString(json_subject)) msg->subject = strdup(json_subject->valuestring);
-                    if (cJSON_IsString(json_text)) msg->body_text = strdup(json_text->valuestring);
-                    if (cJSON_IsString(json_html)) msg->body_html = strdup(json_html->valuestring);
-                    if (cJSON_IsString(json_created_at)) msg->timestamp = strdup(json_created_at->valuestring);
-                    if (cJSON_IsBool(json_is_read)) msg->is_read = cJSON_IsTrue(json_is_read);
-                }
-            }
-        }
+    memcpy(doc, request->body, request->body_len);
+    doc[request->body_len] = '\0';
+
+    event_decoder_t dec;
+    agentmail_message_t message;
+    const char *inbox_id = NULL;
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    bool received = event_decode(&dec, doc, request->body_len, &message, &inbox_id, &err);
+    if (err != AGENTMAIL_ERR_NONE) {
+        ESP_LOGW(TAG, "Malformed webhook payload");
+        free(doc);
+        webhook_reject(wh);
+        return 400;
     }
 
-    cJSON *next_page_token = cJSON_GetObjectItem(res_json, "next_page_token");
-    if (cJSON_IsString(next_page_token)) {
-        messages->next_cursor = strdup(next_page_token->valuestring);
+    // Other event types are acknowledged so they are not redelivered
+    if (received) {
+        agentmail_mutex_lock(wh->client->stats_lock);
+        wh->client->stats.webhook_events++;
+        agentmail_mutex_unlock(wh->client->stats_lock);
+
+        agentmail_event_t event = {};
+        event.type = AGENTMAIL_EVENT_MESSAGE_RECEIVED;
+        event.inbox_id = inbox_id;
+        event.message = &message;
+        wh->cb(wh->client->ctx, &event);
+        message.backing = doc;  // Freed along with the attachment array
+        agentmail_message_free(&message);
+    } else {
+        free(doc);
     }
 
-    cJSON *count = cJSON_GetObjectItem(res_json, "count");
-    if (cJSON_IsNumber(count)) {
-        messages->total = count->valueint;
-    }
+    webhook_remember(wh, id);
+    return 200;
+}
 
-    cJSON_Delete(res_json);
-    
-    ESP_LOGI(TAG, "Retrieved %zu messages from inbox %s", messages->count, inbox_id);
-    return AGENTMAIL_ERR_NONE;
+static void webhook_free(webhook_t *wh) {
+    for (int i = 0; i < RECENT_EVENT_IDS; i++) {
+        free(wh->recent[i]);
+    }
+    free(wh->path);
+    free(wh->key);
+    free(wh);
 }
 
-agentmail_err_t agentmail_message_get(
+agentmail_err_t agentmail_webhook_start(
     agentmail_handle_t handle,
-    const char *inbox_id,
-    const char *message_id,
-    agentmail_message_t *message
+    const agentmail_webhook_options_t *options,
+    agentmail_event_cb_t cb,
+    agentmail_webhook_t *webhook
 ) {
-    if (handle == NULL || inbox_id == NULL || message_id == NULL || message == NULL) {
+    if (handle == NULL || cb == NULL || webhook == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    *webhook = NULL;
+    agentmail_webhook_options_t defaults = {};
+    if (options == NULL) {
+        options = &defaults;
+    }
+    // The listener binds to every interface: without a signature anyone
+    // who can reach the port could inject messages
+    if (options->secret == NULL && !options->allow_unsigned) {
+        ESP_LOGE(TAG, "Webhook listener needs a secret (or allow_unsigned)");
         return AGENTMAIL_ERR_INVALID_ARG;
     }
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-    memset(message, 0, sizeof(agentmail_message_t));
-
-    // Build path
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
+    webhook_t *wh = (webhook_t *)calloc(1, sizeof(webhook_t));
+    if (wh == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    wh->client = (agentmail_client_t *)handle;
+    wh->cb = cb;
+    wh->backend = options->server ? options->server : agentmail_http_server_default();
+    wh->tolerance_s = options->tolerance_s ? options->tolerance_s : DEFAULT_WEBHOOK_TOLERANCE_S;
+    wh->path = strdup(options->path ? options->path : DEFAULT_WEBHOOK_PATH);
+    if (wh->path == NULL) {
+        webhook_free(wh);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "GET", path, NULL, &response, &status_code
-    );
+    if (options->secret != NULL) {
+        // "whsec_" followed by the base64 key
+        const char *secret = options->secret;
+        if (strncmp(secret, "whsec_", 6) == 0) {
+            secret += 6;
+        }
+        wh->key = base64_decode(secret, &wh->key_len);
+        if (wh->key == NULL) {
+            ESP_LOGE(TAG, "Webhook secret is not valid base64");
+            webhook_free(wh);
+            return AGENTMAIL_ERR_INVALID_ARG;
+        }
+    }
 
+    agentmail_http_server_config_t config = {};
+    config.port = options->port;
+    config.header_names = WEBHOOK_HEADERS;
+    config.max_body_len = options->max_body_len ? options->max_body_len : MAX_HTTP_RESPONSE_SIZE;
+    config.handler = webhook_on_request;
+    config.ctx = wh;
+    agentmail_err_t err = wh->backend->start(&config, &wh->server);
     if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
+        webhook_free(wh);
         return err;
     }
 
-    // Parse response
-    cJSON *res_json = cJSON_Parse(response.buffer);
-    free(response.buffer);
-    
-    if (res_json == NULL) {
-        return AGENTMAIL_ERR_PARSE;
-    }
-
-    // Extract message info (v0 API)
-    cJSON *json_message_id = cJSON_GetObjectItem(res_json, "message_id");
-    cJSON *json_thread_id = cJSON_GetObjectItem(res_json, "thread_id");
-    cJSON *json_from = cJSON_GetObjectItem(res_json, "from");
-    cJSON *json_to = cJSON_GetObjectItem(res_json, "to");
-    cJSON *json_subject = cJSON_GetObjectItem(res_json, "subject");
-    cJSON *json_text = cJSON_GetObjectItem(res_json, "text");
-    cJSON *json_html = cJSON_GetObjectItem(res_json, "html");
-    cJSON *json_created_at = cJSON_GetObjectItem(res_json, "created_at");
-    cJSON *json_is_read = cJSON_GetObjectItem(res_json, "is_read");
-    
-    if (cJSON_IsString(json_message_id)) message->message_id = strdup(json_message_id->valuestring);
-    if (cJSON_IsString(json_thread_id)) message->thread_id = strdup(json_thread_id->valuestring);
-    if (cJSON_IsString(json_from)) message->from = strdup(json_from->valuestring);
-    if (cJSON_IsString(json_to)) message->to = strdup(json_to->valuestring);
-    if (cJSON_IsString(json_subject)) message->subject = strdup(json_subject->valuestring);
-    if (cJSON_IsString(json_text)) message->body_text = strdup(json_text->valuestring);
-    if (cJSON_IsString(json_html)) message->body_html = strdup(json_html->valuestring);
-    if (cJSON_IsString(json_created_at)) message->timestamp = strdup(json_created_at->valuestring);
-    if (cJSON_IsBool(json_is_read)) message->is_read = cJSON_IsTrue(json_is_read);
-
-    cJSON_Delete(res_json);
+    ESP_LOGI(TAG, "Webhook listener on port %u%s (%s)", wh->backend->port(wh->server), wh->path,
+             wh->key ? "signed" : "unsigned");
+    *webhook = (agentmail_webhook_t)wh;
     return AGENTMAIL_ERR_NONE;
 }
 
-agentmail_err_t agentmail_message_mark_read(
-    agentmail_handle_t handle,
-    const char *inbox_id,
-    const char *message_id,
-    bool is_read
-) {
-    if (handle == NULL || inbox_id == NULL || message_id == NULL) {
-        return AGENTMAIL_ERR_INVALID_ARG;
-    }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-
-    // Build path
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
-
-    // Build JSON payload
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddBoolToObject(json, "is_read", is_read);
-    char *payload = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-
-    // Perform request (PATCH or PUT depending on API)
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "PATCH", path, payload, &response, &status_code
-    );
-
-    free(payload);
-    free(response.buffer);
-    
-    if (err == AGENTMAIL_ERR_NONE) {
-        ESP_LOGI(TAG, "Marked message %s as %s", message_id, is_read ? "read" : "unread");
+uint16_t agentmail_webhook_port(agentmail_webhook_t webhook) {
+    if (webhook == NULL) {
+        return 0;
     }
-
-    return err;
+    webhook_t *wh = (webhook_t *)webhook;
+    return wh->backend->port(wh->server);
 }
 
-agentmail_err_t agentmail_message_delete(
-    agentmail_handle_t handle,
-    const char *inbox_id,
-    const char *message_id
-) {
-    if (handle == NULL || inbox_id == NULL || message_id == NULL) {
+agentmail_err_t agentmail_webhook_stop(agentmail_webhook_t webhook) {
+    if (webhook == NULL) {
         return AGENTMAIL_ERR_INVALID_ARG;
     }
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
+    webhook_t *wh = (webhook_t *)webhook;
+    wh->backend->stop(wh->server);
+    webhook_free(wh);
+    return AGENTMAIL_ERR_NONE;
+}
 
-    // Build path
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s", inbox_id, message_id);
+// ============================================================================
+// Delta Sync
+// ============================================================================
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "DELETE", path, NULL, &response, &status_code
-    );
+/**
+ * Sync state
+ */
+typedef struct {
+    agentmail_client_t *client;
+    agentmail_store_t *store;       // Known messages; the newest one is the high-water mark
+    bool own_store;                 // Private store, closed with the sync
+    int page_size;
+    int max_pages;
+    uint32_t fields;
+} sync_t;
+
+static agentmail_err_t memory_storage_load(const char *key, char **data, size_t *len) {
+    (void)key;
+    (void)data;
+    (void)len;
+    return AGENTMAIL_ERR_NOT_FOUND;
+}
 
-    free(response.buffer);
-    
-    if (err == AGENTMAIL_ERR_NONE) {
-        ESP_LOGI(TAG, "Deleted message: %s", message_id);
-    }
+static agentmail_err_t memory_storage_save(const char *key, const char *data, size_t len) {
+    (void)key;
+    (void)data;
+    (void)len;
+    return AGENTMAIL_ERR_NONE;
+}
 
-    return err;
+// Backs the private store of a sync without one: known messages stay in RAM
+static const agentmail_storage_t MEMORY_STORAGE = {
+    .name = "memory",
+    .default_key = "sync",
+    .load = memory_storage_load,
+    .save = memory_storage_save,
+};
+
+static void sync_emit(sync_t *sync, agentmail_event_cb_t cb, agentmail_event_type_t type,
+                      const char *inbox_id, const agentmail_message_t *message) {
+    agentmail_event_t event = {};
+    event.type = type;
+    event.inbox_id = inbox_id;
+    event.message = message;
+    cb(sync->client->ctx, &event);
 }
 
-agentmail_err_t agentmail_send_reply(
+agentmail_err_t agentmail_sync_create(
     agentmail_handle_t handle,
-    const char *inbox_id,
-    const char *message_id,
-    const agentmail_send_options_t *options,
-    char **reply_message_id
+    const agentmail_sync_options_t *options,
+    agentmail_sync_t *sync
 ) {
-    if (handle == NULL || inbox_id == NULL || message_id == NULL || options == NULL) {
+    if (handle == NULL || sync == NULL) {
         return AGENTMAIL_ERR_INVALID_ARG;
     }
+    agentmail_sync_options_t defaults = {};
+    if (options == NULL) {
+        options = &defaults;
+    }
 
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-
-    // Build JSON payload
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
+    sync_t *s = (sync_t *)calloc(1, sizeof(sync_t));
+    if (s == NULL) {
         return AGENTMAIL_ERR_NO_MEM;
     }
-
-    // Add reply fields
-    if (options->to != NULL) {
-        cJSON_AddStringToObject(json, "to", options->to);
+    s->client = (agentmail_client_t *)handle;
+    s->page_size = options->page_size > 0 ? options->page_size : DEFAULT_SYNC_PAGE_SIZE;
+    s->max_pages = options->max_pages > 0 ? options->max_pages : DEFAULT_SYNC_MAX_PAGES;
+    // Matching known messages needs their IDs and timestamps
+    s->fields = (options->fields ? options->fields : (uint32_t)AGENTMAIL_FIELDS_METADATA) |
+                AGENTMAIL_FIELD_MESSAGE_ID | AGENTMAIL_FIELD_TIMESTAMP;
+    s->store = options->store;
+    if (s->store == NULL) {
+        agentmail_store_options_t store_options = {};
+        store_options.storage = &MEMORY_STORAGE;
+        agentmail_err_t err = agentmail_store_open(&store_options, &s->store);
+        if (err != AGENTMAIL_ERR_NONE) {
+            free(s);
+            return err;
+        }
+        s->own_store = true;
     }
-    if (options->subject != NULL) {
-        cJSON_AddStringToObject(json, "subject", options->subject);
+
+    *sync = (agentmail_sync_t)s;
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Whether a listed message is at or past the mark: a known message, or
+ * one older than the newest known. Marks known messages seen.
+ */
+static bool sync_reached(const agentmail_message_list_t *known, bool *seen, const char *mark,
+                         const agentmail_message_t *message) {
+    for (size_t k = 0; k < known->count; k++) {
+        if (!seen[k] && message->message_id != NULL &&
+            strcmp(known->messages[k].message_id, message->message_id) == 0) {
+            seen[k] = true;
+            return true;
+        }
     }
-    if (options->body_text != NULL) {
-        cJSON_AddStringToObject(json, "text", options->body_text);
+    // Timestamps alone don't tell: a burst can share its millisecond
+    return mark != NULL && message->timestamp != NULL && strcmp(message->timestamp, mark) < 0;
+}
+
+/**
+ * Merge the pages of a finished walk into the store and report them; the
+ * first fresh messages listed are the ones ahead of the mark
+ */
+static agentmail_err_t sync_commit(sync_t *sync, const char *inbox_id, agentmail_event_cb_t cb,
+                                   agentmail_message_list_t *pages, int page_count, size_t fresh,
+                                   size_t *received, size_t *changed) {
+    size_t index = 0;
+    for (int p = 0; p < page_count; p++) {
+        agentmail_message_list_t *page = &pages[p];
+        if (page->count == 0) {
+            continue;
+        }
+        agentmail_store_change_t *changes =
+            (agentmail_store_change_t *)malloc(page->count * sizeof(agentmail_store_change_t));
+        if (changes == NULL) {
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        agentmail_err_t err = agentmail_store_merge_messages(sync->store, inbox_id, page->messages,
+                                                             page->count, changes);
+        for (size_t i = 0; err == AGENTMAIL_ERR_NONE && i < page->count; i++, index++) {
+            // Unknown messages past the mark only fill gaps in the window
+            if (changes[i] == AGENTMAIL_STORE_ADDED && index < fresh) {
+                sync_emit(sync, cb, AGENTMAIL_EVENT_MESSAGE_RECEIVED, inbox_id, &page->messages[i]);
+                (*received)++;
+            } else if (changes[i] == AGENTMAIL_STORE_UPDATED) {
+                sync_emit(sync, cb, AGENTMAIL_EVENT_MESSAGE_CHANGED, inbox_id, &page->messages[i]);
+                (*changed)++;
+            }
+        }
+        free(changes);
+        if (err != AGENTMAIL_ERR_NONE) {
+            return err;
+        }
     }
-    if (options->body_html != NULL) {
-        cJSON_AddStringToObject(json, "html", options->body_html);
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_sync_inbox(agentmail_sync_t handle, const char *inbox_id, agentmail_event_cb_t cb) {
+    if (handle == NULL || inbox_id == NULL || cb == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
     }
+    sync_t *sync = (sync_t *)handle;
 
-    char *payload = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
-    if (payload == NULL) {
+    // Known messages, newest first; the newest one's timestamp is the mark
+    agentmail_message_list_t known = {};
+    agentmail_err_t err = agentmail_store_get_messages(sync->store, inbox_id, &known);
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+    const char *mark = (known.count > 0) ? known.messages[0].timestamp : NULL;
+    bool *seen = (known.count > 0) ? (bool *)calloc(known.count, sizeof(bool)) : NULL;
+    // Pages are held until the walk gets back to the mark, and only then
+    // merged: a walk cut short by an error leaves the store as it was, so
+    // the next sync starts over instead of taking the newest page for the
+    // mark and the mail under it for gap fill
+    agentmail_message_list_t *pages =
+        (agentmail_message_list_t *)calloc(sync->max_pages, sizeof(agentmail_message_list_t));
+    if ((known.count > 0 && seen == NULL) || pages == NULL) {
+        free(seen);
+        free(pages);
+        agentmail_message_list_free(&known);
         return AGENTMAIL_ERR_NO_MEM;
     }
 
-    // Build v0 API path: /inboxes/:inbox_id/messages/:message_id/reply
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/reply", inbox_id, message_id);
+    // The sync keeps its own validator in the store: the client's cache is
+    // keyed by path and shared with any other poller of the same listing.
+    // With nothing stored there is nothing to revalidate.
+    char *etag = NULL;
+    if (known.count > 0) {
+        agentmail_store_get_etag(sync->store, inbox_id, &etag);
+    }
 
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "POST", path, payload, &response, &status_code
-    );
-    free(payload);
+    agentmail_message_query_t query = {};
+    query.limit = sync->page_size;
+    query.fields = sync->fields;
+    const char *cursor = NULL;
+    const char *oldest = NULL;      // Timestamp of the oldest message fetched
+    bool unchanged = false;
+    bool reached = false;           // Fetched back to the mark
+    bool complete = false;          // Fetched to the end of the listing
+    size_t fresh = 0;               // Messages listed ahead of the mark
+    size_t received = 0, changed = 0, deleted = 0;
+    int page_count = 0;
+    while (page_count < sync->max_pages) {
+        agentmail_message_list_t *page = &pages[page_count];
+        query.cursor = cursor;
+        // An unchanged first page answers 304 without a body
+        err = messages_list(sync->client, inbox_id, &query, (page_count == 0) ? &etag : NULL, page);
+        if (err == AGENTMAIL_ERR_NOT_MODIFIED) {
+            err = AGENTMAIL_ERR_NONE;
+            unchanged = true;
+            break;
+        }
+        if (err != AGENTMAIL_ERR_NONE) {
+            break;
+        }
+        page_count++;
 
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+        for (size_t i = 0; i < page->count; i++) {
+            if (sync_reached(&known, seen, mark, &page->messages[i])) {
+                reached = true;
+            } else if (!reached) {
+                fresh++;
+            }
+        }
+        if (page->count > 0 && page->messages[page->count - 1].timestamp != NULL) {
+            oldest = page->messages[page->count - 1].timestamp;
+        }
+        cursor = page->next_cursor;
+        complete = (cursor == NULL);
+        if (reached || complete || mark == NULL) {
+            break;  // A first sync takes the newest page only
+        }
     }
 
-    // Parse response to get message ID
-    if (reply_message_id != NULL) {
-        cJSON *res_json = cJSON_Parse(response.buffer);
-        if (res_json != NULL) {
-            cJSON *msg_id = cJSON_GetObjectItem(res_json, "message_id");
-            if (cJSON_IsString(msg_id)) {
-                *reply_message_id = strdup(msg_id->valuestring);
-                ESP_LOGI(TAG, "Sent reply: %s", *reply_message_id);
+    if (err == AGENTMAIL_ERR_NONE && !unchanged) {
+        if (mark != NULL && !reached && !complete) {
+            ESP_LOGW(TAG, "More than %d pages of new messages in %s; older ones were skipped",
+                     sync->max_pages, inbox_id);
+        }
+        err = sync_commit(sync, inbox_id, cb, pages, page_count, fresh, &received, &changed);
+
+        // Known messages within the range fetched that weren't listed
+        for (size_t k = 0; err == AGENTMAIL_ERR_NONE && k < known.count; k++) {
+            const agentmail_message_t *message = &known.messages[k];
+            bool covered = complete || (oldest != NULL && message->timestamp != NULL &&
+                                        strcmp(message->timestamp, oldest) > 0);
+            if (!seen[k] && covered) {
+                agentmail_store_remove_message(sync->store, inbox_id, message->message_id);
+                sync_emit(sync, cb, AGENTMAIL_EVENT_MESSAGE_DELETED, inbox_id, message);
+                deleted++;
             }
-            cJSON_Delete(res_json);
+        }
+        if (err == AGENTMAIL_ERR_NONE && mark == NULL) {
+            // Where loading older messages continues
+            err = agentmail_store_set_cursor(sync->store, inbox_id, cursor);
+        }
+        if (err == AGENTMAIL_ERR_NONE) {
+            err = agentmail_store_set_etag(sync->store, inbox_id, etag);
+        }
+        if (err == AGENTMAIL_ERR_NONE) {
+            err = agentmail_store_flush(sync->store);
+        }
+
+        if (err != AGENTMAIL_ERR_NONE) {
+            ESP_LOGE(TAG, "Failed to record sync of %s: %s", inbox_id, agentmail_err_to_str(err));
+        } else {
+            ESP_LOGI(TAG, "Synced %s in %d requests: %zu new, %zu changed, %zu deleted", inbox_id,
+                     page_count, received, changed, deleted);
         }
     }
 
-    free(response.buffer);
-    return AGENTMAIL_ERR_NONE;
+    for (int p = 0; p < page_count; p++) {
+        agentmail_message_list_free(&pages[p]);
+    }
+    free(pages);
+    free(etag);
+    free(seen);
+    agentmail_message_list_free(&known);
+    return err;
 }
 
-agentmail_err_t agentmail_message_get_raw(
-    agentmail_handle_t handle,
-    const char *inbox_id,
-    const char *message_id,
-    char **raw_content,
-    size_t *raw_size
-) {
-    if (handle == NULL || inbox_id == NULL || message_id == NULL || 
-        raw_content == NULL || raw_size == NULL) {
+agentmail_err_t agentmail_sync_destroy(agentmail_sync_t handle) {
+    if (handle == NULL) {
         return AGENTMAIL_ERR_INVALID_ARG;
     }
-
-    agentmail_client_t *client = (agentmail_client_t *)handle;
-
-    // Build path
-    char path[512];
-    snprintf(path, sizeof(path), "/inboxes/%s/messages/%s/raw", inbox_id, message_id);
-
-    // Perform request
-    http_response_t response = {};
-    int status_code = 0;
-    agentmail_err_t err = perform_http_request(
-        client, "GET", path, NULL, &response, &status_code
-    );
-
-    if (err != AGENTMAIL_ERR_NONE) {
-        free(response.buffer);
-        return err;
+    sync_t *sync = (sync_t *)handle;
+    if (sync->own_store) {
+        agentmail_store_close(sync->store);
     }
-
-    // Return the raw content
-    *raw_content = response.buffer;
-    *raw_size = response.size;
-    
-    ESP_LOGI(TAG, "Retrieved raw message: %s (%zu bytes)", message_id, response.size);
+    free(sync);
     return AGENTMAIL_ERR_NONE;
 }
 
@@ -1108,6 +4214,13 @@ agentmail_err_t agentmail_message_get_raw(
 void agentmail_inbox_free(agentmail_inbox_t *inbox) {
     if (inbox == NULL) return;
     
+    if (inbox->backing != NULL) {
+        // Decoded in place: every string points into the response body
+        free(inbox->backing);
+        memset(inbox, 0, sizeof(agentmail_inbox_t));
+        return;
+    }
+    
     free(inbox->inbox_id);
     free(inbox->name);
     free(inbox->email_address);
@@ -1120,6 +4233,13 @@ void agentmail_inbox_free(agentmail_inbox_t *inbox) {
 void agentmail_inbox_list_free(agentmail_inbox_list_t *list) {
     if (list == NULL) return;
     
+    if (list->arena != NULL) {
+        // Everything lives in the arena
+        agentmail_arena_destroy((agentmail_arena_t *)list->arena);
+        memset(list, 0, sizeof(agentmail_inbox_list_t));
+        return;
+    }
+    
     if (list->inboxes != NULL) {
         for (size_t i = 0; i < list->count; i++) {
             agentmail_inbox_free(&list->inboxes[i]);
@@ -1134,21 +4254,24 @@ void agentmail_inbox_list_free(agentmail_inbox_list_t *list) {
 void agentmail_message_free(agentmail_message_t *message) {
     if (message == NULL) return;
     
-    free(message->message_id);
-    free(message->thread_id);
-    free(message->from);
-    free(message->to);
-    free(message->subject);
-    free(message->body_text);
-    free(message->body_html);
-    free(message->timestamp);
-    
-    if (message->attachments != NULL) {
+    if (message->backing == NULL) {
+        free(message->message_id);
+        free(message->thread_id);
+        free(message->from);
+        free(message->to);
+        free(message->subject);
+        free(message->body_text);
+        free(message->body_html);
+        free(message->timestamp);
         for (size_t i = 0; i < message->attachment_count; i++) {
-            free(message->attachments[i]);
+            free(message->attachments[i].attachment_id);
+            free(message->attachments[i].filename);
+            free(message->attachments[i].content_type);
         }
-        free(message->attachments);
     }
+    // Decoded in place, every string points into the response body
+    free(message->attachments);
+    free(message->backing);
     
     memset(message, 0, sizeof(agentmail_message_t));
 }
@@ -1156,6 +4279,13 @@ void agentmail_message_free(agentmail_message_t *message) {
 void agentmail_message_list_free(agentmail_message_list_t *list) {
     if (list == NULL) return;
     
+    if (list->arena != NULL) {
+        // Everything lives in the arena
+        agentmail_arena_destroy((agentmail_arena_t *)list->arena);
+        memset(list, 0, sizeof(agentmail_message_list_t));
+        return;
+    }
+    
     if (list->messages != NULL) {
         for (size_t i = 0; i < list->count; i++) {
             agentmail_message_free(&list->messages[i]);
@@ -1171,6 +4301,62 @@ void agentmail_message_list_free(agentmail_message_list_t *list) {
 // Utility Functions
 // ============================================================================
 
+const agentmail_transport_t *agentmail_transport_default(void) {
+#ifdef ESP_PLATFORM
+    return agentmail_transport_esp();
+#else
+    return agentmail_transport_posix();
+#endif
+}
+
+const agentmail_ws_transport_t *agentmail_ws_transport_default(void) {
+#ifdef ESP_PLATFORM
+    return agentmail_ws_transport_esp();
+#else
+    return agentmail_ws_transport_posix();
+#endif
+}
+
+const agentmail_http_server_t *agentmail_http_server_default(void) {
+#ifdef ESP_PLATFORM
+    return agentmail_http_server_esp();
+#else
+    return agentmail_http_server_posix();
+#endif
+}
+
+agentmail_err_t agentmail_get_stats(agentmail_handle_t handle, agentmail_stats_t *stats) {
+    if (handle == NULL || stats == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    agentmail_mutex_lock(client->stats_lock);
+    *stats = client->stats;
+    agentmail_mutex_unlock(client->stats_lock);
+    agentmail_mutex_lock(client->cache_lock);
+    stats->cache_hits = client->cache.hits;
+    stats->cache_misses = client->cache.misses;
+    agentmail_mutex_unlock(client->cache_lock);
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_reset_stats(agentmail_handle_t handle) {
+    if (handle == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    agentmail_client_t *client = (agentmail_client_t *)handle;
+    agentmail_mutex_lock(client->stats_lock);
+    memset(&client->stats, 0, sizeof(agentmail_stats_t));
+    agentmail_mutex_unlock(client->stats_lock);
+    agentmail_mutex_lock(client->cache_lock);
+    client->cache.hits = 0;
+    client->cache.misses = 0;
+    agentmail_mutex_unlock(client->cache_lock);
+    return AGENTMAIL_ERR_NONE;
+}
+
 const char* agentmail_err_to_str(agentmail_err_t err) {
     switch (err) {
         case AGENTMAIL_ERR_NONE:        return "No error";
@@ -1185,6 +4371,9 @@ const char* agentmail_err_to_str(agentmail_err_t err) {
         case AGENTMAIL_ERR_NETWORK:     return "Network error";
         case AGENTMAIL_ERR_TIMEOUT:     return "Request timeout";
         case AGENTMAIL_ERR_OTHER:       return "Unknown error";
+        case AGENTMAIL_ERR_BUSY:        return "Request queue full";
+        case AGENTMAIL_ERR_NOT_MODIFIED: return "Not modified (304)";
+        case AGENTMAIL_ERR_IO:          return "I/O error";
         default:                        return "Invalid error code";
     }
 }
@@ -2,6 +2,7 @@
 #define AGENTMAIL_H
 
 #include "agentmail_types.h"
+#include "agentmail_mime.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,10 +18,13 @@ extern "C" {
  * @brief Initialize AgentMail client
  * 
  * Creates a new AgentMail client instance with the provided configuration.
+ * Per-client request state (header block, parsed base URL, TLS
+ * configuration) is built here once, so requests only append their path.
  * 
  * @param[in] config Configuration options (must not be NULL)
  * @param[out] handle Output client handle (must not be NULL)
- * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ * @return AGENTMAIL_ERR_NONE on success, AGENTMAIL_ERR_INVALID_ARG if
+ *         base_url can't be parsed, error code otherwise
  * 
  * @note config->api_key must be provided
  * @note Call agentmail_destroy() when done
@@ -179,6 +183,8 @@ agentmail_err_t agentmail_inbox_delete(
  * 
  * @note options->from and options->to are required
  * @note If message_id is not NULL, caller must free() it
+ * @note Attachments are streamed from their file or read callback and
+ *       base64-encoded on the fly; AGENTMAIL_ERR_IO means one couldn't be read
  * 
  * Example:
  * @code
@@ -237,13 +243,20 @@ agentmail_err_t agentmail_send_reply(
  * @return AGENTMAIL_ERR_NONE on success, error code otherwise
  * 
  * @note Call agentmail_message_list_free() when done
+ * @note Set query->fields to fill in only the listed fields; unwanted
+ *       strings (e.g. bodies) are skipped while decoding and never allocated
+ * @note Set query->if_changed when polling: the request carries the ETag
+ *       of the previous identical query (same fields) and returns AGENTMAIL_ERR_NOT_MODIFIED
+ *       (with nothing allocated) if the server answers 304
  * 
  * Example:
  * @code
  * agentmail_message_query_t query = {
  *     .limit = 10,
  *     .cursor = NULL,
- *     .unread_only = true
+ *     .unread_only = true,
+ *     .thread_id = NULL,
+ *     .fields = AGENTMAIL_FIELDS_METADATA  // from/subject/... without bodies
  * };
  * agentmail_message_list_t messages = {};
  * agentmail_err_t err = agentmail_messages_get(client, "abc@agentmail.to", &query, &messages);
@@ -275,6 +288,8 @@ agentmail_err_t agentmail_messages_get(
  * @return AGENTMAIL_ERR_NONE on success, error code otherwise
  * 
  * @note Call agentmail_message_free() when done
+ * @note With agentmail_config_t::message_cache_size set, a message fetched
+ *       before is served from the cache without a request
  */
 agentmail_err_t agentmail_message_get(
     agentmail_handle_t handle,
@@ -329,7 +344,11 @@ agentmail_err_t agentmail_message_delete(
  * @param[in] message_id Message ID
  * @param[out] raw_content Output raw content (caller must free())
  * @param[out] raw_size Output size of raw content
- * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ * @return AGENTMAIL_ERR_NONE on success, AGENTMAIL_ERR_NO_MEM if the
+ *         content doesn't fit the 32KB response buffer, error code otherwise
+ *
+ * @note Use agentmail_message_get_raw_stream() for messages with
+ *       attachments
  */
 agentmail_err_t agentmail_message_get_raw(
     agentmail_handle_t handle,
@@ -339,8 +358,401 @@ agentmail_err_t agentmail_message_get_raw(
     size_t *raw_size
 );
 
+/**
+ * @brief Stream raw message content
+ * 
+ * Retrieves the raw email content (MIME format) and passes it to write_cb
+ * piece by piece as it arrives, so messages of any size can be written to
+ * a file or parsed without holding them in memory.
+ * 
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] message_id Message ID
+ * @param[in] write_cb Callback receiving the content
+ * @param[in] ctx User context passed to write_cb
+ * @param[out] raw_size Output number of bytes delivered (optional)
+ * @return AGENTMAIL_ERR_NONE on success, the error returned by write_cb if
+ *         it aborted the transfer, error code otherwise
+ *
+ * @note write_cb is only called for a successful response. If the
+ *       connection drops mid-transfer an error is returned after part of
+ *       the content was delivered; the caller must discard it.
+ */
+agentmail_err_t agentmail_message_get_raw_stream(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_write_cb_t write_cb,
+    void *ctx,
+    size_t *raw_size
+);
+
+/**
+ * @brief Parse raw message content as it streams in
+ *
+ * Feeds the raw email content to an incremental MIME parser (see
+ * agentmail_mime.h) while it downloads, so headers, part boundaries and
+ * decoded base64/quoted-printable bodies are reported without buffering
+ * the message. Once the callback calls agentmail_mime_stop() the transfer
+ * is cut off, e.g. after the headers of a message with large attachments.
+ *
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] message_id Message ID
+ * @param[in] parser Parser initialized with agentmail_mime_init()
+ * @return AGENTMAIL_ERR_NONE on success (including a stop), the error
+ *         returned by the parser callback if it aborted, error code otherwise
+ *
+ * @note The parser is finished (agentmail_mime_finish()) unless it was
+ *       stopped or an error occurred. Its callback runs during the
+ *       transfer and, like an agentmail_write_cb_t, must not call back
+ *       into the same client.
+ */
+agentmail_err_t agentmail_message_get_mime(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_mime_parser_t *parser
+);
+
+/**
+ * @brief Download attachment content
+ *
+ * Streams the content of an attachment listed in
+ * agentmail_message_t::attachments to write_cb as it arrives, holding no
+ * more than one network buffer. If the connection drops mid-transfer the
+ * download continues with a Range request from the last byte delivered
+ * (up to 5 times, as long as each attempt made progress), so write_cb
+ * sees every byte exactly once.
+ *
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] message_id Message ID
+ * @param[in] attachment_id Attachment ID
+ * @param[in] offset First byte to download (0 for all; e.g. the size of a
+ *            partial file kept from an earlier call)
+ * @param[in] write_cb Callback receiving the content
+ * @param[in] ctx User context passed to write_cb
+ * @param[out] received Output number of bytes delivered by this call (optional)
+ * @return AGENTMAIL_ERR_NONE on success, AGENTMAIL_ERR_INVALID_ARG if offset
+ *         is past the end, the error returned by write_cb if it aborted the
+ *         transfer, error code otherwise
+ *
+ * @note After an error, the received bytes are valid content: call again
+ *       with offset increased by received to continue.
+ */
+agentmail_err_t agentmail_attachment_download(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    const char *attachment_id,
+    size_t offset,
+    agentmail_write_cb_t write_cb,
+    void *ctx,
+    size_t *received
+);
+
 /** @} */ // end of Messages group
 
+/**
+ * @defgroup Async Asynchronous Operations
+ * @brief Non-blocking variants of the message operations
+ *
+ * Requests are copied into a bounded queue and performed in order by a
+ * worker task owned by the client, which is started on the first async
+ * call. The completion callback runs on that worker task with the ctx
+ * from agentmail_config_t, so it should hand results off quickly rather
+ * than block. Pending requests still complete (with their callbacks) when
+ * agentmail_destroy() is called.
+ * @{
+ */
+
+/**
+ * @brief Queue an email for sending
+ * 
+ * @param[in] handle Client handle
+ * @param[in] options Send options (copied; need not outlive the call, but
+ *            attachment files and read_ctx must stay available until the
+ *            callback runs)
+ * @param[in] cb Completion callback (optional)
+ * @return AGENTMAIL_ERR_NONE if queued, AGENTMAIL_ERR_BUSY if the queue is
+ *         full, error code otherwise
+ */
+agentmail_err_t agentmail_send_async(
+    agentmail_handle_t handle,
+    const agentmail_send_options_t *options,
+    agentmail_send_cb_t cb
+);
+
+/**
+ * @brief Queue a message list request
+ * 
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] query Query options (copied; can be NULL for defaults)
+ * @param[in] cb Completion callback
+ * @return AGENTMAIL_ERR_NONE if queued, AGENTMAIL_ERR_BUSY if the queue is
+ *         full, error code otherwise
+ */
+agentmail_err_t agentmail_messages_get_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const agentmail_message_query_t *query,
+    agentmail_messages_cb_t cb
+);
+
+/**
+ * @brief Queue a single message request
+ * 
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] message_id Message ID
+ * @param[in] cb Completion callback
+ * @return AGENTMAIL_ERR_NONE if queued, AGENTMAIL_ERR_BUSY if the queue is
+ *         full, error code otherwise
+ */
+agentmail_err_t agentmail_message_get_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    agentmail_message_cb_t cb
+);
+
+/**
+ * @brief Queue a read status update
+ * 
+ * @param[in] handle Client handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] message_id Message ID
+ * @param[in] is_read Read status to set
+ * @param[in] cb Completion callback (optional)
+ * @return AGENTMAIL_ERR_NONE if queued, AGENTMAIL_ERR_BUSY if the queue is
+ *         full, error code otherwise
+ */
+agentmail_err_t agentmail_message_mark_read_async(
+    agentmail_handle_t handle,
+    const char *inbox_id,
+    const char *message_id,
+    bool is_read,
+    agentmail_done_cb_t cb
+);
+
+/** @} */ // end of Async group
+
+/**
+ * @defgroup Events Event Subscription
+ * @brief Push delivery of new messages over a WebSocket
+ *
+ * A subscription keeps a WebSocket open to the AgentMail event endpoint
+ * and calls back for every message.received event in the watched
+ * inboxes, so new mail arrives without polling. A task owned by the
+ * subscription reconnects with jittered exponential backoff when the
+ * connection drops, pings an idle connection to detect half-open sockets,
+ * and after each reconnect fetches the messages that arrived in between
+ * (oldest first, flagged as resumed), so none are missed or repeated.
+ *
+ * Devices reachable from the internet (or behind a tunnel) can instead
+ * receive the same events as webhook POSTs through a webhook listener,
+ * which needs no outbound connection at all while idle.
+ * @{
+ */
+
+/**
+ * @brief Start receiving events for a set of inboxes
+ * 
+ * @param[in] handle Client handle
+ * @param[in] options Subscription options (copied; need not outlive the call)
+ * @param[in] cb Event callback, run on the subscription task with the
+ *            ctx from agentmail_config_t
+ * @param[out] subscription Output subscription handle
+ * @return AGENTMAIL_ERR_NONE if the subscription task was started, error
+ *         code otherwise. Connection errors are retried in the background
+ *         and reported as AGENTMAIL_EVENT_DISCONNECTED.
+ * 
+ * @note Call agentmail_unsubscribe() before agentmail_destroy()
+ * 
+ * Example:
+ * @code
+ * static void on_event(void *ctx, const agentmail_event_t *event) {
+ *     if (event->type == AGENTMAIL_EVENT_MESSAGE_RECEIVED) {
+ *         ESP_LOGI(TAG, "New mail from %s", event->message->from);
+ *     }
+ * }
+ * 
+ * const char *inboxes[] = { "abc@agentmail.to" };
+ * agentmail_subscribe_options_t options = {
+ *     .inbox_ids = inboxes,
+ *     .inbox_count = 1,
+ * };
+ * agentmail_subscription_t subscription = NULL;
+ * agentmail_subscribe(client, &options, on_event, &subscription);
+ * @endcode
+ */
+agentmail_err_t agentmail_subscribe(
+    agentmail_handle_t handle,
+    const agentmail_subscribe_options_t *options,
+    agentmail_event_cb_t cb,
+    agentmail_subscription_t *subscription
+);
+
+/**
+ * @brief Stop a subscription and free it
+ * 
+ * Closes the connection and waits for the subscription task to exit, so
+ * no callback runs after this returns. Must not be called from the event
+ * callback.
+ * 
+ * @param[in] subscription Subscription handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_unsubscribe(agentmail_subscription_t subscription);
+
+/**
+ * @brief Start a webhook listener
+ * 
+ * Serves POSTs on options->path and dispatches each message.received
+ * payload as an AGENTMAIL_EVENT_MESSAGE_RECEIVED event. Requests without
+ * a valid svix-signature (or older than the tolerance) are answered 401;
+ * redelivered webhook IDs are acknowledged without calling back again.
+ * 
+ * @param[in] handle Client handle
+ * @param[in] options Listener options (NULL for defaults; copied)
+ * @param[in] cb Event callback, run on the server task with the ctx from
+ *            agentmail_config_t. Keep it short: the sender times out and
+ *            retries if the response is slow.
+ * @param[out] webhook Output listener handle
+ * @return AGENTMAIL_ERR_NONE if listening, AGENTMAIL_ERR_INVALID_ARG if
+ *         options->secret is missing (without allow_unsigned) or not
+ *         valid, error code otherwise
+ * 
+ * @note Call agentmail_webhook_stop() before agentmail_destroy()
+ * 
+ * Example:
+ * @code
+ * agentmail_webhook_options_t options = {
+ *     .port = 8080,
+ *     .secret = "whsec_...",  // From the webhook's settings
+ * };
+ * agentmail_webhook_t webhook = NULL;
+ * agentmail_webhook_start(client, &options, on_event, &webhook);
+ * // Register http://<device>:8080/agentmail/webhook for message.received
+ * @endcode
+ */
+agentmail_err_t agentmail_webhook_start(
+    agentmail_handle_t handle,
+    const agentmail_webhook_options_t *options,
+    agentmail_event_cb_t cb,
+    agentmail_webhook_t *webhook
+);
+
+/**
+ * @brief Get the port a webhook listener is bound to
+ * 
+ * @param[in] webhook Listener handle
+ * @return Port number (0 if webhook is NULL)
+ */
+uint16_t agentmail_webhook_port(agentmail_webhook_t webhook);
+
+/**
+ * @brief Stop a webhook listener and free it
+ * 
+ * Waits for a request in progress, so no callback runs after this
+ * returns. Must not be called from the event callback.
+ * 
+ * @param[in] webhook Listener handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_webhook_stop(agentmail_webhook_t webhook);
+
+/** @} */ // end of Events group
+
+/**
+ * @defgroup Sync Delta Sync
+ * @brief Polling that transfers and reports only what changed
+ *
+ * A sync remembers the messages it has seen per inbox in an
+ * agentmail_store_t; the newest one's timestamp is the inbox's high-water
+ * mark. Each agentmail_sync_inbox() call pages through the inbox newest
+ * first only until it gets back to the mark, and compares what it fetched
+ * with what it knew: unknown messages listed ahead of every known one and
+ * not older than the mark are reported as received (others only fill gaps
+ * in the stored window), known ones whose metadata or read state differ
+ * as changed, and known ones missing from the range fetched as deleted.
+ * The sync keeps the first page's ETag with the inbox in the store and
+ * sends it back as If-None-Match, so a poll while nothing changed costs
+ * one 304 without a body.
+ *
+ * With a store on flash (see agentmail_store.h) the marks survive a
+ * reboot, and the first sync after it reports only what arrived while the
+ * device was off.
+ * @{
+ */
+
+/**
+ * @brief Create a sync
+ *
+ * @param[in] handle Client handle
+ * @param[in] options Sync options (NULL for defaults)
+ * @param[out] sync Output sync handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ *
+ * @note Call agentmail_sync_destroy() before agentmail_destroy()
+ */
+agentmail_err_t agentmail_sync_create(
+    agentmail_handle_t handle,
+    const agentmail_sync_options_t *options,
+    agentmail_sync_t *sync
+);
+
+/**
+ * @brief Fetch and report what changed in an inbox since the last sync
+ *
+ * Events are reported newest first, on the calling task with the ctx
+ * from agentmail_config_t. The first sync of an inbox fetches only its
+ * newest page and reports those messages as received; its next_cursor is
+ * saved as the inbox's store cursor for loading older messages. Pages are
+ * held until the walk gets back to the mark (or to the end of the inbox)
+ * and only then merged into the store and reported, and the store is
+ * flushed afterwards (a no-op when nothing changed).
+ *
+ * @param[in] sync Sync handle
+ * @param[in] inbox_id Inbox ID
+ * @param[in] cb Event callback (AGENTMAIL_EVENT_MESSAGE_RECEIVED, _CHANGED
+ *            and _DELETED)
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise. A failed
+ *         request reports and records nothing, so the next sync fetches the
+ *         same changes again. A store error (e.g. AGENTMAIL_ERR_IO from the
+ *         flush) is returned after the events, with the store left dirty
+ *         for the next flush.
+ *
+ * @note One task at a time per sync
+ *
+ * Example:
+ * @code
+ * static void on_sync(void *ctx, const agentmail_event_t *event) {
+ *     if (event->type == AGENTMAIL_EVENT_MESSAGE_RECEIVED) {
+ *         ESP_LOGI(TAG, "New mail from %s", event->message->from);
+ *     }
+ * }
+ *
+ * agentmail_sync_options_t options = { .store = store };  // From agentmail_store_open()
+ * agentmail_sync_t sync = NULL;
+ * agentmail_sync_create(client, &options, &sync);
+ * agentmail_sync_inbox(sync, inbox_id, on_sync);  // Every poll
+ * @endcode
+ */
+agentmail_err_t agentmail_sync_inbox(agentmail_sync_t sync, const char *inbox_id, agentmail_event_cb_t cb);
+
+/**
+ * @brief Free a sync (a store passed in options is not closed)
+ *
+ * @param[in] sync Sync handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_sync_destroy(agentmail_sync_t sync);
+
+/** @} */ // end of Sync group
+
 /**
  * @defgroup Memory Memory Management
  * @brief Functions for freeing allocated resources
@@ -350,7 +762,9 @@ agentmail_err_t agentmail_message_get_raw(
 /**
  * @brief Free inbox structure
  * 
- * Frees all memory allocated within an inbox structure.
+ * Frees all memory allocated within an inbox structure. For an inbox
+ * decoded in place (agentmail_config_t::decode_in_place) this is a single
+ * free of the response body its strings point into.
  * 
  * @param[in] inbox Inbox structure to free
  * 
@@ -362,6 +776,8 @@ void agentmail_inbox_free(agentmail_inbox_t *inbox);
  * @brief Free inbox list
  * 
  * Frees all memory allocated within an inbox list structure.
+ * In arena mode (agentmail_config_t::use_arena) this is a single free of
+ * the list's arena.
  * 
  * @param[in] list Inbox list to free
  */
@@ -370,11 +786,15 @@ void agentmail_inbox_list_free(agentmail_inbox_list_t *list);
 /**
  * @brief Free message structure
  * 
- * Frees all memory allocated within a message structure.
+ * Frees all memory allocated within a message structure. For a message
+ * decoded in place (agentmail_config_t::decode_in_place) this is a single
+ * free of the response body its strings point into.
  * 
  * @param[in] message Message structure to free
  * 
  * @note Does not free the message pointer itself if it was allocated separately
+ * @warning Must not be called on messages of a list returned in arena mode;
+ *          free the whole list with agentmail_message_list_free() instead
  */
 void agentmail_message_free(agentmail_message_t *message);
 
@@ -382,6 +802,8 @@ void agentmail_message_free(agentmail_message_t *message);
  * @brief Free message list
  * 
  * Frees all memory allocated within a message list structure.
+ * In arena mode (agentmail_config_t::use_arena) this is a single free of
+ * the list's arena.
  * 
  * @param[in] list Message list to free
  */
@@ -405,6 +827,27 @@ void agentmail_message_list_free(agentmail_message_list_t *list);
  */
 const char* agentmail_err_to_str(agentmail_err_t err);
 
+/**
+ * @brief Get connection statistics
+ * 
+ * The client keeps one HTTP/1.1 keep-alive connection open between
+ * requests. Comparing handshakes against requests shows how often the
+ * TCP/TLS setup was avoided.
+ * 
+ * @param[in] handle Client handle
+ * @param[out] stats Output statistics
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_get_stats(agentmail_handle_t handle, agentmail_stats_t *stats);
+
+/**
+ * @brief Reset connection statistics
+ * 
+ * @param[in] handle Client handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_reset_stats(agentmail_handle_t handle);
+
 /** @} */ // end of Utilities group
 
 /** @} */ // end of AgentMail group
@@ -0,0 +1,139 @@
+/**
+ * AgentMail Arena Allocator
+ *
+ * Blocks are chained newest-first; the arena header lives at the start of
+ * the first block so creating an arena is a single allocation.
+ */
+
+#include "agentmail_arena.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const size_t ARENA_ALIGN = sizeof(void *) > sizeof(double) ? sizeof(void *) : sizeof(double);
+static const size_t ARENA_MAX_GROWTH = 16384; // Cap on geometric block growth
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;                  // Usable bytes after the header
+    size_t used;
+} arena_block_t;
+
+typedef struct adopted {
+    struct adopted *next;
+    void *ptr;
+} adopted_t;
+
+struct agentmail_arena {
+    arena_block_t *head;          // Block currently being filled
+    size_t block_count;
+    adopted_t *adopted;           // Buffers freed along with the arena
+};
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// Keeps block data aligned, given malloc's own alignment
+static const size_t BLOCK_HEADER = (sizeof(arena_block_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+static char *block_data(arena_block_t *block) {
+    return (char *)block + BLOCK_HEADER;
+}
+
+static arena_block_t *block_new(size_t size) {
+    arena_block_t *block = (arena_block_t *)malloc(BLOCK_HEADER + size);
+    if (block == NULL) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+agentmail_arena_t *agentmail_arena_create(size_t block_size) {
+    size_t header = align_up(sizeof(agentmail_arena_t));
+    if (block_size < header + 64) {
+        block_size = header + 64;
+    }
+    arena_block_t *block = block_new(block_size);
+    if (block == NULL) return NULL;
+
+    agentmail_arena_t *arena = (agentmail_arena_t *)block_data(block);
+    block->used = header;
+    arena->head = block;
+    arena->block_count = 1;
+    arena->adopted = NULL;
+    return arena;
+}
+
+void *agentmail_arena_alloc(agentmail_arena_t *arena, size_t size) {
+    if (arena == NULL) return NULL;
+    size = align_up(size ? size : 1);
+
+    arena_block_t *block = arena->head;
+    if (block->size - block->used < size) {
+        // Grow geometrically (up to a cap) so long lists need only a few blocks
+        size_t new_size = block->size * 2;
+        if (new_size > ARENA_MAX_GROWTH) {
+            new_size = ARENA_MAX_GROWTH;
+        }
+
+        if (size >= new_size) {
+            // Oversized value (e.g. a long body): give it a block of its own
+            // behind the current one, which keeps filling
+            arena_block_t *big = block_new(size);
+            if (big == NULL) return NULL;
+            big->used = size;
+            big->next = block->next;
+            block->next = big;
+            arena->block_count++;
+            return block_data(big);
+        }
+
+        arena_block_t *grown = block_new(new_size);
+        if (grown == NULL) return NULL;
+        grown->next = block;
+        arena->head = grown;
+        arena->block_count++;
+        block = grown;
+    }
+
+    void *ptr = block_data(block) + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *agentmail_arena_strndup(agentmail_arena_t *arena, const char *str, size_t len) {
+    char *copy = (char *)agentmail_arena_alloc(arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+int agentmail_arena_adopt(agentmail_arena_t *arena, void *ptr) {
+    adopted_t *node = (adopted_t *)agentmail_arena_alloc(arena, sizeof(adopted_t));
+    if (node == NULL) return -1;
+    node->ptr = ptr;
+    node->next = arena->adopted;
+    arena->adopted = node;
+    return 0;
+}
+
+size_t agentmail_arena_block_count(const agentmail_arena_t *arena) {
+    return arena ? arena->block_count : 0;
+}
+
+void agentmail_arena_destroy(agentmail_arena_t *arena) {
+    if (arena == NULL) return;
+    for (adopted_t *node = arena->adopted; node != NULL; node = node->next) {
+        free(node->ptr);
+    }
+    // The arena header lives in the oldest block, which is freed last
+    arena_block_t *block = arena->head;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef AGENTMAIL_ARENA_H
+#define AGENTMAIL_ARENA_H
+
+/**
+ * @file agentmail_arena.h
+ * @brief Bump allocator backing list results in arena mode
+ *
+ * Memory is carved sequentially out of a short chain of large blocks and
+ * released all at once, so a whole message list costs a handful of heap
+ * allocations instead of one per string.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct agentmail_arena agentmail_arena_t;
+
+/**
+ * @brief Create an arena
+ *
+ * @param block_size Size of the first block; later blocks grow as needed
+ * @return Arena, or NULL on allocation failure
+ */
+agentmail_arena_t *agentmail_arena_create(size_t block_size);
+
+/**
+ * @brief Allocate size bytes aligned for any type
+ *
+ * @return Pointer into the arena, or NULL on allocation failure
+ */
+void *agentmail_arena_alloc(agentmail_arena_t *arena, size_t size);
+
+/**
+ * @brief Copy len bytes into the arena and NUL-terminate them
+ */
+char *agentmail_arena_strndup(agentmail_arena_t *arena, const char *str, size_t len);
+
+/**
+ * @brief Hand a malloc()ed buffer over to the arena
+ *
+ * The buffer is freed together with the arena, so list entries can point
+ * into it (e.g. a response body decoded in place).
+ *
+ * @return 0 on success, -1 on allocation failure (the buffer is not taken over)
+ */
+int agentmail_arena_adopt(agentmail_arena_t *arena, void *ptr);
+
+/**
+ * @brief Number of heap blocks backing the arena
+ */
+size_t agentmail_arena_block_count(const agentmail_arena_t *arena);
+
+/**
+ * @brief Free every allocation made from the arena, and the arena itself
+ */
+void agentmail_arena_destroy(agentmail_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_ARENA_H
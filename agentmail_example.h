@@ -10,7 +10,9 @@
  */
 
 #include "agentmail.h"
+#include "agentmail_store.h"
 #include <esp_log.h>
+#include <atomic>
 #include <string>
 #include <functional>
 
@@ -21,12 +23,22 @@ namespace agentmail {
  */
 class AgentMailManager {
 public:
-    AgentMailManager() : client_(nullptr), inbox_id_("") {}
+    AgentMailManager() : client_(nullptr), store_(nullptr), sync_(nullptr), inbox_id_(""),
+                         subscription_(nullptr), webhook_(nullptr), push_connected_(false),
+                         sync_count_(0) {}
     
     ~AgentMailManager() {
+        Unsubscribe();
+        StopWebhook();
+        if (sync_) {
+            agentmail_sync_destroy(sync_);
+        }
         if (client_) {
             agentmail_destroy(client_);
         }
+        if (store_) {
+            agentmail_store_close(store_);
+        }
     }
     
     /**
@@ -45,7 +57,14 @@ public:
             .base_url = nullptr,  // Use default
             .timeout_ms = 10000,
             .enable_logging = true,
-            .ctx = this
+            .ctx = this,
+            // Ride out 429s and transient 5xx/network errors in the client
+            // instead of failing the whole check
+            .retry = {
+                .max_attempts = 4,
+            },
+            // Reopening a message (detail view, reply) skips the round trip
+            .message_cache_size = 16 * 1024
         };
         
         agentmail_err_t err = agentmail_init(&config, &client_);
@@ -55,6 +74,12 @@ public:
             return false;
         }
         
+        // Inbox and messages seen before the last reboot (NVS, needs
+        // nvs_flash_init()); the manager works without it
+        if (agentmail_store_open(nullptr, &store_) != AGENTMAIL_ERR_NONE) {
+            ESP_LOGW(TAG, "No persistent store; state is fetched on every start");
+        }
+        
         ESP_LOGI(TAG, "AgentMail client initialized");
         return true;
     }
@@ -69,9 +94,22 @@ public:
             return inbox_id_;
         }
         
-        // Try to load from settings first
-        // inbox_id_ = settings.GetString("agentmail_inbox");
-        // if (!inbox_id_.empty()) return inbox_id_;
+        // Reuse the inbox created before the last reboot
+        if (store_) {
+            agentmail_inbox_list_t inboxes = {};
+            agentmail_store_get_inboxes(store_, &inboxes);
+            for (size_t i = 0; i < inboxes.count; i++) {
+                if (inboxes.inboxes[i].name && device_name == inboxes.inboxes[i].name) {
+                    inbox_id_ = inboxes.inboxes[i].inbox_id;
+                    break;
+                }
+            }
+            agentmail_inbox_list_free(&inboxes);
+            if (!inbox_id_.empty()) {
+                ESP_LOGI(TAG, "Using stored inbox: %s", inbox_id_.c_str());
+                return inbox_id_;
+            }
+        }
         
         // Create new inbox
         agentmail_inbox_options_t opts = {
@@ -88,8 +126,10 @@ public:
                      inbox_id_.c_str(), 
                      inbox.email_address ? inbox.email_address : "");
             
-            // Save to settings
-            // settings.SetString("agentmail_inbox", inbox_id_);
+            if (store_) {
+                agentmail_store_put_inbox(store_, &inbox);
+                agentmail_store_flush(store_);
+            }
             
             agentmail_inbox_free(&inbox);
             return inbox_id_;
@@ -145,49 +185,166 @@ public:
     
     /**
      * @brief Check for new messages
-     * @param callback Function to call for each unread message
-     * @return Number of unread messages found
+     * @param callback Function to call for each unread message that arrived
+     *        since the last check and wasn't pushed already, newest first
+     * @param fields Message fields the callback needs (agentmail_field_t
+     *        mask, 0 = all; the first call's mask is kept)
+     * @return Number of new messages found
      */
-    int CheckMessages(std::function<void(const agentmail_message_t&)> callback) {
+    int CheckMessages(std::function<void(const agentmail_message_t&)> callback,
+                      uint32_t fields = 0) {
         if (inbox_id_.empty()) {
             ESP_LOGE(TAG, "No inbox ID set");
             return 0;
         }
         
-        agentmail_message_query_t query = {
-            .limit = 10,
-            .cursor = nullptr,
-            .unread_only = true,
-            .thread_id = nullptr
-        };
-        
-        agentmail_message_list_t messages = {};
-        agentmail_err_t err = agentmail_messages_get(client_, inbox_id_.c_str(), 
-                                                      &query, &messages);
+        // Fetches only what is newer than the last message seen (kept in
+        // the store across reboots, along with pushed messages), so nothing
+        // has to be marked read to avoid reporting it twice
+        if (!sync_) {
+            agentmail_sync_options_t opts = {
+                .store = store_,
+                .page_size = 10,
+                .max_pages = 5,
+                .fields = fields ? fields : (uint32_t)(AGENTMAIL_FIELDS_METADATA |
+                                                       AGENTMAIL_FIELD_BODY_TEXT |
+                                                       AGENTMAIL_FIELD_BODY_HTML)
+            };
+            agentmail_err_t err = agentmail_sync_create(client_, &opts, &sync_);
+            if (err != AGENTMAIL_ERR_NONE) {
+                ESP_LOGE(TAG, "Failed to create sync: %s", agentmail_err_to_str(err));
+                return 0;
+            }
+        }
         
+        on_sync_message_ = callback;
+        sync_count_ = 0;
+        agentmail_err_t err = agentmail_sync_inbox(sync_, inbox_id_.c_str(), OnSyncEvent);
+        on_sync_message_ = nullptr;
         if (err != AGENTMAIL_ERR_NONE) {
-            ESP_LOGE(TAG, "Failed to get messages: %s", agentmail_err_to_str(err));
-            return 0;
+            ESP_LOGE(TAG, "Failed to sync messages: %s", agentmail_err_to_str(err));
         }
         
-        ESP_LOGI(TAG, "Retrieved %zu unread messages", messages.count);
+        return sync_count_;
+    }
+    
+    /**
+     * @brief Show the messages stored before the last reboot, without a request
+     * @param callback Function to call for each stored message, newest
+     *        first (metadata only, no bodies)
+     * @return Number of stored messages
+     */
+    int GetStoredMessages(std::function<void(const agentmail_message_t&)> callback) {
+        if (!store_ || inbox_id_.empty()) {
+            return 0;
+        }
         
+        agentmail_message_list_t messages = {};
+        if (agentmail_store_get_messages(store_, inbox_id_.c_str(), &messages) != AGENTMAIL_ERR_NONE) {
+            return 0;
+        }
         for (size_t i = 0; i < messages.count; i++) {
             if (callback) {
                 callback(messages.messages[i]);
             }
-            
-            // Mark as read
-            agentmail_message_mark_read(client_, inbox_id_.c_str(),
-                                        messages.messages[i].message_id, true);
         }
         
         int count = messages.count;
         agentmail_message_list_free(&messages);
-        
         return count;
     }
     
+    /**
+     * @brief Receive new messages as they arrive instead of polling
+     * @param callback Function to call for each new message (runs on the
+     *        subscription task; messages already reported by CheckMessages()
+     *        or a webhook are skipped)
+     * @return true if the subscription was started
+     */
+    bool Subscribe(std::function<void(const agentmail_message_t&)> callback) {
+        if (inbox_id_.empty()) {
+            ESP_LOGE(TAG, "No inbox ID set");
+            return false;
+        }
+        if (subscription_) {
+            return true;
+        }
+        
+        on_message_ = callback;
+        const char *inbox_ids[] = { inbox_id_.c_str() };
+        agentmail_subscribe_options_t opts = {
+            .url = nullptr,  // Use default
+            .inbox_ids = inbox_ids,
+            .inbox_count = 1
+        };
+        
+        agentmail_err_t err = agentmail_subscribe(client_, &opts, OnEvent, &subscription_);
+        if (err != AGENTMAIL_ERR_NONE) {
+            ESP_LOGE(TAG, "Failed to subscribe: %s", agentmail_err_to_str(err));
+            return false;
+        }
+        return true;
+    }
+    
+    /**
+     * @brief Stop receiving pushed messages
+     */
+    void Unsubscribe() {
+        if (subscription_) {
+            agentmail_unsubscribe(subscription_);
+            subscription_ = nullptr;
+            push_connected_ = false;
+        }
+    }
+    
+    /**
+     * @brief Receive new messages as webhook POSTs (devices reachable on the LAN)
+     * @param callback Function to call for each new message (runs on the
+     *        server task; duplicates are skipped as for Subscribe())
+     * @param secret Webhook signing secret ("whsec_...")
+     * @param port Port to listen on
+     * @return true if the listener was started
+     */
+    bool StartWebhook(std::function<void(const agentmail_message_t&)> callback,
+                      const std::string& secret, uint16_t port = 8080) {
+        if (webhook_) {
+            return true;
+        }
+        
+        on_message_ = callback;
+        agentmail_webhook_options_t opts = {
+            .port = port,
+            .path = nullptr,  // Use default
+            .secret = secret.empty() ? nullptr : secret.c_str()
+        };
+        
+        agentmail_err_t err = agentmail_webhook_start(client_, &opts, OnEvent, &webhook_);
+        if (err != AGENTMAIL_ERR_NONE) {
+            ESP_LOGE(TAG, "Failed to start webhook listener: %s", agentmail_err_to_str(err));
+            return false;
+        }
+        return true;
+    }
+    
+    /**
+     * @brief Stop the webhook listener
+     */
+    void StopWebhook() {
+        if (webhook_) {
+            agentmail_webhook_stop(webhook_);
+            webhook_ = nullptr;
+        }
+    }
+    
+    /**
+     * @brief Whether new messages are currently being pushed
+     * @return true while the subscription is connected or a webhook
+     *         listener is running (polling can pause)
+     */
+    bool IsPushConnected() const {
+        return push_connected_ || webhook_ != nullptr;
+    }
+    
     /**
      * @brief Get inbox ID
      * @return Current inbox ID
@@ -197,9 +354,86 @@ public:
     }
 
 private:
+    static void OnEvent(void *ctx, const agentmail_event_t *event) {
+        AgentMailManager *self = static_cast<AgentMailManager *>(ctx);
+        switch (event->type) {
+            case AGENTMAIL_EVENT_CONNECTED:
+                self->push_connected_ = true;
+                break;
+            case AGENTMAIL_EVENT_DISCONNECTED:
+                self->push_connected_ = false;
+                break;
+            case AGENTMAIL_EVENT_MESSAGE_RECEIVED:
+                // Pushed messages are recorded in the sync's store, so the
+                // next CheckMessages() or a catch-up replay skips them
+                if (event->inbox_id && self->IsNew(event->inbox_id, *event->message)) {
+                    if (self->on_message_) {
+                        self->on_message_(*event->message);
+                    }
+                    self->Delivered(event->inbox_id, *event->message);
+                }
+                break;
+            case AGENTMAIL_EVENT_MESSAGE_CHANGED:
+            case AGENTMAIL_EVENT_MESSAGE_DELETED:
+                break;
+        }
+    }
+    
+    // Runs on the task calling CheckMessages()
+    static void OnSyncEvent(void *ctx, const agentmail_event_t *event) {
+        AgentMailManager *self = static_cast<AgentMailManager *>(ctx);
+        // Already merged into the store by the sync; read elsewhere isn't new
+        if (event->type == AGENTMAIL_EVENT_MESSAGE_RECEIVED && !event->message->is_read) {
+            self->sync_count_++;
+            if (self->on_sync_message_) {
+                self->on_sync_message_(*event->message);
+            }
+            self->Delivered(event->inbox_id, *event->message);
+        }
+    }
+    
+    /**
+     * Whether a pushed message is new: unread, and not yet in the store
+     * (where it is merged, as the sync does with what it fetches)
+     */
+    bool IsNew(const char *inbox_id, const agentmail_message_t& message) {
+        if (message.is_read) {
+            return false;
+        }
+        if (!store_) {
+            return true;
+        }
+        agentmail_store_change_t change = AGENTMAIL_STORE_UNCHANGED;
+        if (agentmail_store_merge_messages(store_, inbox_id, &message, 1, &change) != AGENTMAIL_ERR_NONE) {
+            return true;  // Rather report it twice than lose it
+        }
+        if (change == AGENTMAIL_STORE_ADDED) {
+            agentmail_store_flush(store_);
+        }
+        return change == AGENTMAIL_STORE_ADDED;
+    }
+    
+    /**
+     * Without a store, marking reported messages read is what keeps the
+     * other delivery path from reporting them again
+     */
+    void Delivered(const char *inbox_id, const agentmail_message_t& message) {
+        if (!store_ && message.message_id) {
+            agentmail_message_mark_read(client_, inbox_id, message.message_id, true);
+        }
+    }
+    
     static constexpr const char* TAG = "AgentMailManager";
     agentmail_handle_t client_;
+    agentmail_store_t *store_;
+    agentmail_sync_t sync_;
     std::string inbox_id_;
+    agentmail_subscription_t subscription_;
+    agentmail_webhook_t webhook_;
+    std::atomic<bool> push_connected_;
+    std::function<void(const agentmail_message_t&)> on_message_;
+    std::function<void(const agentmail_message_t&)> on_sync_message_;
+    int sync_count_;
 };
 
 } // namespace agentmail
@@ -0,0 +1,168 @@
+/**
+ * AgentMail HMAC-SHA256
+ *
+ * The host implementation follows FIPS 180-4 and RFC 2104 directly; it is
+ * only used for webhook payloads of a few kilobytes, so it favours size
+ * over speed.
+ */
+
+#include "agentmail_hmac.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+
+#include <mbedtls/md.h>
+
+void agentmail_hmac_sha256(const uint8_t *key, size_t key_len,
+                           const void *const *parts, const size_t *part_lens, size_t part_count,
+                           uint8_t out[AGENTMAIL_HMAC_SHA256_LEN]) {
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    if (mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0) {
+        memset(out, 0, AGENTMAIL_HMAC_SHA256_LEN);
+        mbedtls_md_free(&ctx);
+        return;
+    }
+    mbedtls_md_hmac_starts(&ctx, key, key_len);
+    for (size_t i = 0; i < part_count; i++) {
+        mbedtls_md_hmac_update(&ctx, (const unsigned char *)parts[i], part_lens[i]);
+    }
+    mbedtls_md_hmac_finish(&ctx, out);
+    mbedtls_md_free(&ctx);
+}
+
+#else
+
+static const size_t SHA256_BLOCK_SIZE = 64;
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t total_len;
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t block_len;
+} sha256_t;
+
+static uint32_t ror(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_compress(sha256_t *sha, const uint8_t *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+               (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = sha->h[0], b = sha->h[1], c = sha->h[2], d = sha->h[3];
+    uint32_t e = sha->h[4], f = sha->h[5], g = sha->h[6], h = sha->h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    sha->h[0] += a; sha->h[1] += b; sha->h[2] += c; sha->h[3] += d;
+    sha->h[4] += e; sha->h[5] += f; sha->h[6] += g; sha->h[7] += h;
+}
+
+static void sha256_init(sha256_t *sha) {
+    static const uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(sha->h, H0, sizeof(H0));
+    sha->total_len = 0;
+    sha->block_len = 0;
+}
+
+static void sha256_update(sha256_t *sha, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    sha->total_len += len;
+    while (len > 0) {
+        size_t take = SHA256_BLOCK_SIZE - sha->block_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(sha->block + sha->block_len, p, take);
+        sha->block_len += take;
+        p += take;
+        len -= take;
+        if (sha->block_len == SHA256_BLOCK_SIZE) {
+            sha256_compress(sha, sha->block);
+            sha->block_len = 0;
+        }
+    }
+}
+
+static void sha256_finish(sha256_t *sha, uint8_t out[AGENTMAIL_HMAC_SHA256_LEN]) {
+    uint64_t bits = sha->total_len * 8;
+    uint8_t pad = 0x80;
+    sha256_update(sha, &pad, 1);
+    pad = 0;
+    while (sha->block_len != SHA256_BLOCK_SIZE - 8) {
+        sha256_update(sha, &pad, 1);
+    }
+    uint8_t len_be[8];
+    for (int i = 0; i < 8; i++) {
+        len_be[i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_update(sha, len_be, sizeof(len_be));
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = (uint8_t)(sha->h[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(sha->h[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(sha->h[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)sha->h[i];
+    }
+}
+
+void agentmail_hmac_sha256(const uint8_t *key, size_t key_len,
+                           const void *const *parts, const size_t *part_lens, size_t part_count,
+                           uint8_t out[AGENTMAIL_HMAC_SHA256_LEN]) {
+    // Keys longer than a block are hashed first
+    uint8_t block_key[SHA256_BLOCK_SIZE] = {};
+    sha256_t sha;
+    if (key_len > SHA256_BLOCK_SIZE) {
+        sha256_init(&sha);
+        sha256_update(&sha, key, key_len);
+        sha256_finish(&sha, block_key);
+    } else if (key_len > 0) {
+        memcpy(block_key, key, key_len);
+    }
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block_key[i] ^ 0x36;
+    }
+    uint8_t inner[AGENTMAIL_HMAC_SHA256_LEN];
+    sha256_init(&sha);
+    sha256_update(&sha, pad, sizeof(pad));
+    for (size_t i = 0; i < part_count; i++) {
+        sha256_update(&sha, parts[i], part_lens[i]);
+    }
+    sha256_finish(&sha, inner);
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block_key[i] ^ 0x5c;
+    }
+    sha256_init(&sha);
+    sha256_update(&sha, pad, sizeof(pad));
+    sha256_update(&sha, inner, sizeof(inner));
+    sha256_finish(&sha, out);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef AGENTMAIL_HMAC_H
+#define AGENTMAIL_HMAC_H
+
+/**
+ * @file agentmail_hmac.h
+ * @brief HMAC-SHA256 used internally to verify webhook signatures
+ *
+ * Backed by mbedTLS on ESP-IDF (hardware SHA where available) and by a
+ * small portable SHA-256 on a Linux host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGENTMAIL_HMAC_SHA256_LEN 32
+
+/**
+ * @brief Compute HMAC-SHA256 over the concatenation of several pieces
+ *
+ * @param key Secret key
+ * @param key_len Key length in bytes
+ * @param parts Pieces of the message, hashed in order
+ * @param part_lens Length of each piece
+ * @param part_count Number of pieces
+ * @param out Output MAC
+ */
+void agentmail_hmac_sha256(const uint8_t *key, size_t key_len,
+                           const void *const *parts, const size_t *part_lens, size_t part_count,
+                           uint8_t out[AGENTMAIL_HMAC_SHA256_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_HMAC_H
@@ -0,0 +1,938 @@
+/**
+ * AgentMail Incremental JSON Decoder
+ *
+ * Byte-at-a-time state machine so that a document can be split at any
+ * point between network reads, plus a recursive-descent variant for
+ * documents already in memory that decodes them in place, and a writer
+ * for request payloads.
+ */
+
+#include "agentmail_json.h"
+#include <string.h>
+#include <stdlib.h>
+
+enum {
+    ST_VALUE,           // Expecting a value
+    ST_ARRAY_FIRST,     // After '[': value or ']'
+    ST_OBJECT_FIRST,    // After '{': key or '}'
+    ST_KEY,             // After ',' in an object: key
+    ST_COLON,           // After a key: ':'
+    ST_AFTER_VALUE,     // After a value: ',' or closing bracket
+    ST_STRING,
+    ST_STRING_ESCAPE,
+    ST_STRING_UNICODE,
+    ST_NUMBER,
+    ST_LITERAL,
+    ST_DONE,            // Root value complete
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool buf_reserve(char **buf, size_t *cap, size_t needed) {
+    if (needed <= *cap) return true;
+    size_t new_cap = *cap ? *cap : 64;
+    while (new_cap < needed) new_cap *= 2;
+    char *new_buf = (char *)realloc(*buf, new_cap);
+    if (new_buf == NULL) return false;
+    *buf = new_buf;
+    *cap = new_cap;
+    return true;
+}
+
+static bool buf_push(agentmail_json_parser_t *p, char c) {
+    if (p->skip) return true;
+    if (!buf_reserve(&p->buf, &p->cap, p->len + 2)) return false;
+    p->buf[p->len++] = c;
+    return true;
+}
+
+static bool buf_push_utf8(agentmail_json_parser_t *p, uint32_t cp) {
+    if (cp < 0x80) {
+        return buf_push(p, (char)cp);
+    } else if (cp < 0x800) {
+        return buf_push(p, (char)(0xC0 | (cp >> 6))) &&
+               buf_push(p, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        return buf_push(p, (char)(0xE0 | (cp >> 12))) &&
+               buf_push(p, (char)(0x80 | ((cp >> 6) & 0x3F))) &&
+               buf_push(p, (char)(0x80 | (cp & 0x3F)));
+    }
+    return buf_push(p, (char)(0xF0 | (cp >> 18))) &&
+           buf_push(p, (char)(0x80 | ((cp >> 12) & 0x3F))) &&
+           buf_push(p, (char)(0x80 | ((cp >> 6) & 0x3F))) &&
+           buf_push(p, (char)(0x80 | (cp & 0x3F)));
+}
+
+/**
+ * Key of the value about to be emitted (NULL inside arrays)
+ */
+static const char *current_key(const agentmail_json_parser_t *p) {
+    return (p->depth > 0 && p->stack[p->depth - 1] == '{') ? p->key : NULL;
+}
+
+static agentmail_err_t emit(agentmail_json_parser_t *p, agentmail_json_event_t event,
+                            const char *value, size_t len, int depth) {
+    return p->cb(p->ctx, event, current_key(p), value, len, depth);
+}
+
+/**
+ * A scalar value or a closing bracket completed the current value
+ */
+static void value_done(agentmail_json_parser_t *p) {
+    p->state = (p->depth == 0) ? ST_DONE : ST_AFTER_VALUE;
+}
+
+static agentmail_err_t finish_string(agentmail_json_parser_t *p) {
+    if (p->high_surrogate) {
+        // Unpaired high surrogate
+        if (!buf_push_utf8(p, 0xFFFD)) return AGENTMAIL_ERR_NO_MEM;
+        p->high_surrogate = 0;
+    }
+    if (!buf_reserve(&p->buf, &p->cap, p->len + 1)) return AGENTMAIL_ERR_NO_MEM;
+    p->buf[p->len] = '\0';
+
+    if (p->in_key) {
+        if (!buf_reserve(&p->key, &p->key_cap, p->len + 1)) return AGENTMAIL_ERR_NO_MEM;
+        memcpy(p->key, p->buf, p->len + 1);
+        p->in_key = false;
+        p->state = ST_COLON;
+        return p->cb(p->ctx, AGENTMAIL_JSON_KEY, p->key, NULL, 0, p->depth);
+    }
+
+    if (p->skip) {
+        // Value was skipped by the callback; nothing to report
+        p->skip = false;
+        value_done(p);
+        return AGENTMAIL_ERR_NONE;
+    }
+
+    agentmail_err_t err = emit(p, AGENTMAIL_JSON_STRING, p->buf, p->len, p->depth);
+    value_done(p);
+    return err;
+}
+
+static agentmail_err_t finish_number(agentmail_json_parser_t *p) {
+    if (!buf_reserve(&p->buf, &p->cap, p->len + 1)) return AGENTMAIL_ERR_NO_MEM;
+    p->buf[p->len] = '\0';
+    agentmail_err_t err = emit(p, AGENTMAIL_JSON_NUMBER, p->buf, p->len, p->depth);
+    value_done(p);
+    return err;
+}
+
+static agentmail_err_t open_container(agentmail_json_parser_t *p, char c) {
+    if (p->depth >= AGENTMAIL_JSON_MAX_DEPTH) return AGENTMAIL_ERR_PARSE;
+    agentmail_err_t err = emit(p, c == '{' ? AGENTMAIL_JSON_OBJECT_BEGIN : AGENTMAIL_JSON_ARRAY_BEGIN,
+                               NULL, 0, p->depth);
+    p->stack[p->depth++] = c;
+    p->state = (c == '{') ? ST_OBJECT_FIRST : ST_ARRAY_FIRST;
+    return err;
+}
+
+static agentmail_err_t close_container(agentmail_json_parser_t *p, char c) {
+    char open = (c == '}') ? '{' : '[';
+    if (p->depth == 0 || p->stack[p->depth - 1] != open) return AGENTMAIL_ERR_PARSE;
+    p->depth--;
+    agentmail_err_t err = p->cb(p->ctx, c == '}' ? AGENTMAIL_JSON_OBJECT_END : AGENTMAIL_JSON_ARRAY_END,
+                                NULL, NULL, 0, p->depth);
+    value_done(p);
+    return err;
+}
+
+/**
+ * Start a value at character c (state ST_VALUE or ST_ARRAY_FIRST)
+ */
+static agentmail_err_t begin_value(agentmail_json_parser_t *p, char c) {
+    if (c != '"') {
+        // Only string values can be skipped
+        p->skip = false;
+    }
+    switch (c) {
+        case '{':
+        case '[':
+            return open_container(p, c);
+        case '"':
+            p->len = 0;
+            p->in_key = false;
+            p->state = ST_STRING;
+            return AGENTMAIL_ERR_NONE;
+        case 't':
+            p->literal = "true";
+            break;
+        case 'f':
+            p->literal = "false";
+            break;
+        case 'n':
+            p->literal = "null";
+            break;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                p->len = 0;
+                if (!buf_push(p, c)) return AGENTMAIL_ERR_NO_MEM;
+                p->state = ST_NUMBER;
+                return AGENTMAIL_ERR_NONE;
+            }
+            return AGENTMAIL_ERR_PARSE;
+    }
+    p->literal_pos = 1;
+    p->state = ST_LITERAL;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static agentmail_err_t feed_char(agentmail_json_parser_t *p, char c) {
+    switch (p->state) {
+        case ST_VALUE:
+            if (is_space(c)) return AGENTMAIL_ERR_NONE;
+            return begin_value(p, c);
+
+        case ST_ARRAY_FIRST:
+            if (is_space(c)) return AGENTMAIL_ERR_NONE;
+            if (c == ']') return close_container(p, c);
+            return begin_value(p, c);
+
+        case ST_OBJECT_FIRST:
+        case ST_KEY:
+            if (is_space(c)) return AGENTMAIL_ERR_NONE;
+            if (c == '}' && p->state == ST_OBJECT_FIRST) return close_container(p, c);
+            if (c != '"') return AGENTMAIL_ERR_PARSE;
+            p->len = 0;
+            p->in_key = true;
+            p->state = ST_STRING;
+            return AGENTMAIL_ERR_NONE;
+
+        case ST_COLON:
+            if (is_space(c)) return AGENTMAIL_ERR_NONE;
+            if (c != ':') return AGENTMAIL_ERR_PARSE;
+            p->state = ST_VALUE;
+            return AGENTMAIL_ERR_NONE;
+
+        case ST_AFTER_VALUE:
+            if (is_space(c)) return AGENTMAIL_ERR_NONE;
+            if (c == ',') {
+                p->state = (p->stack[p->depth - 1] == '{') ? ST_KEY : ST_VALUE;
+                return AGENTMAIL_ERR_NONE;
+            }
+            if (c == '}' || c == ']') return close_container(p, c);
+            return AGENTMAIL_ERR_PARSE;
+
+        case ST_STRING:
+            if (c == '"') return finish_string(p);
+            if (c == '\\') {
+                p->state = ST_STRING_ESCAPE;
+                return AGENTMAIL_ERR_NONE;
+            }
+            if ((unsigned char)c < 0x20) return AGENTMAIL_ERR_PARSE;
+            if (p->high_surrogate) {
+                if (!buf_push_utf8(p, 0xFFFD)) return AGENTMAIL_ERR_NO_MEM;
+                p->high_surrogate = 0;
+            }
+            return buf_push(p, c) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+
+        case ST_STRING_ESCAPE: {
+            char out;
+            switch (c) {
+                case '"':  out = '"';  break;
+                case '\\': out = '\\'; break;
+                case '/':  out = '/';  break;
+                case 'b':  out = '\b'; break;
+                case 'f':  out = '\f'; break;
+                case 'n':  out = '\n'; break;
+                case 'r':  out = '\r'; break;
+                case 't':  out = '\t'; break;
+                case 'u':
+                    p->unicode = 0;
+                    p->unicode_digits = 0;
+                    p->state = ST_STRING_UNICODE;
+                    return AGENTMAIL_ERR_NONE;
+                default:
+                    return AGENTMAIL_ERR_PARSE;
+            }
+            p->state = ST_STRING;
+            return buf_push(p, out) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+        }
+
+        case ST_STRING_UNICODE: {
+            int v = hex_value(c);
+            if (v < 0) return AGENTMAIL_ERR_PARSE;
+            p->unicode = (p->unicode << 4) | v;
+            if (++p->unicode_digits < 4) return AGENTMAIL_ERR_NONE;
+
+            p->state = ST_STRING;
+            uint32_t cp = p->unicode;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (p->high_surrogate && !buf_push_utf8(p, 0xFFFD)) return AGENTMAIL_ERR_NO_MEM;
+                p->high_surrogate = cp;
+                return AGENTMAIL_ERR_NONE;
+            }
+            if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                if (!p->high_surrogate) {
+                    cp = 0xFFFD;
+                } else {
+                    cp = 0x10000 + ((p->high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+                    p->high_surrogate = 0;
+                }
+            } else if (p->high_surrogate) {
+                if (!buf_push_utf8(p, 0xFFFD)) return AGENTMAIL_ERR_NO_MEM;
+                p->high_surrogate = 0;
+            }
+            return buf_push_utf8(p, cp) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+        }
+
+        case ST_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                return buf_push(p, c) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+            } else {
+                agentmail_err_t err = finish_number(p);
+                if (err != AGENTMAIL_ERR_NONE) return err;
+                // The terminating character belongs to the enclosing state
+                return feed_char(p, c);
+            }
+
+        case ST_LITERAL:
+            if (c != p->literal[p->literal_pos]) return AGENTMAIL_ERR_PARSE;
+            if (p->literal[++p->literal_pos] == '\0') {
+                agentmail_json_event_t event = (p->literal[0] == 't') ? AGENTMAIL_JSON_TRUE
+                                             : (p->literal[0] == 'f') ? AGENTMAIL_JSON_FALSE
+                                             : AGENTMAIL_JSON_NULL;
+                agentmail_err_t err = emit(p, event, NULL, 0, p->depth);
+                value_done(p);
+                return err;
+            }
+            return AGENTMAIL_ERR_NONE;
+
+        case ST_DONE:
+            return is_space(c) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_PARSE;
+
+        default:
+            return AGENTMAIL_ERR_PARSE;
+    }
+}
+
+void agentmail_json_init(agentmail_json_parser_t *parser, agentmail_json_cb_t cb, void *ctx) {
+    memset(parser, 0, sizeof(agentmail_json_parser_t));
+    parser->cb = cb;
+    parser->ctx = ctx;
+    parser->state = ST_VALUE;
+}
+
+agentmail_err_t agentmail_json_feed(agentmail_json_parser_t *parser, const char *data, size_t len) {
+    if (parser->err != AGENTMAIL_ERR_NONE) {
+        return parser->err;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        // Fast path: copy runs of plain string characters in one go
+        if (parser->state == ST_STRING && c != '"' && c != '\\' &&
+            (unsigned char)c >= 0x20 && !parser->high_surrogate) {
+            size_t end = i + 1;
+            while (end < len && data[end] != '"' && data[end] != '\\' &&
+                   (unsigned char)data[end] >= 0x20) {
+                end++;
+            }
+            size_t run = end - i;
+            if (parser->skip) {
+                i = end - 1;
+                continue;
+            }
+            if (!buf_reserve(&parser->buf, &parser->cap, parser->len + run + 1)) {
+                parser->err = AGENTMAIL_ERR_NO_MEM;
+                return parser->err;
+            }
+            memcpy(parser->buf + parser->len, data + i, run);
+            parser->len += run;
+            i = end - 1;
+            continue;
+        }
+
+        agentmail_err_t err = feed_char(parser, c);
+        if (err != AGENTMAIL_ERR_NONE) {
+            parser->err = err;
+            return err;
+        }
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+void agentmail_json_skip_value(agentmail_json_parser_t *parser) {
+    parser->skip = true;
+}
+
+// ============================================================================
+// In-Place Parsing
+// ============================================================================
+
+typedef struct {
+    agentmail_json_parser_t *p;
+    char *begin;
+    char *pos;
+    char *end;                    // Points at the terminating '\0'
+} insitu_t;
+
+static void insitu_space(insitu_t *r) {
+    while (r->pos < r->end && is_space(*r->pos)) r->pos++;
+}
+
+static size_t put_utf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/**
+ * Unescape the string whose opening quote is at r->pos. The output never
+ * outgrows the escaped input, so it is written over it and terminated at
+ * (or before) the closing quote.
+ */
+static agentmail_err_t insitu_string(insitu_t *r, char **out, size_t *len) {
+    char *start = r->pos + 1;
+    char *src = start;
+
+    // Fast path: nothing to unescape up to the closing quote
+    while (src < r->end && *src != '"' && *src != '\\' && (unsigned char)*src >= 0x20) {
+        src++;
+    }
+    char *dst = src;
+    uint32_t high_surrogate = 0;
+    for (;;) {
+        if (src >= r->end || (unsigned char)*src < 0x20) return AGENTMAIL_ERR_PARSE;
+        char c = *src++;
+        if (c == '"') break;
+        if (c != '\\') {
+            if (high_surrogate) {
+                dst += put_utf8(dst, 0xFFFD);
+                high_surrogate = 0;
+            }
+            *dst++ = c;
+            continue;
+        }
+        if (src >= r->end) return AGENTMAIL_ERR_PARSE;
+        char e = *src++;
+        char plain;
+        switch (e) {
+            case '"':  plain = '"';  break;
+            case '\\': plain = '\\'; break;
+            case '/':  plain = '/';  break;
+            case 'b':  plain = '\b'; break;
+            case 'f':  plain = '\f'; break;
+            case 'n':  plain = '\n'; break;
+            case 'r':  plain = '\r'; break;
+            case 't':  plain = '\t'; break;
+            case 'u': {
+                if (r->end - src < 4) return AGENTMAIL_ERR_PARSE;
+                uint32_t cp = 0;
+                for (int i = 0; i < 4; i++) {
+                    int v = hex_value(src[i]);
+                    if (v < 0) return AGENTMAIL_ERR_PARSE;
+                    cp = (cp << 4) | v;
+                }
+                src += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (high_surrogate) dst += put_utf8(dst, 0xFFFD);
+                    high_surrogate = cp;
+                    continue;
+                }
+                if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = high_surrogate ? 0x10000 + ((high_surrogate - 0xD800) << 10) + (cp - 0xDC00)
+                                        : 0xFFFD;
+                } else if (high_surrogate) {
+                    dst += put_utf8(dst, 0xFFFD);
+                }
+                high_surrogate = 0;
+                dst += put_utf8(dst, cp);
+                continue;
+            }
+            default:
+                return AGENTMAIL_ERR_PARSE;
+        }
+        if (high_surrogate) {
+            dst += put_utf8(dst, 0xFFFD);
+            high_surrogate = 0;
+        }
+        *dst++ = plain;
+    }
+    if (high_surrogate) {
+        dst += put_utf8(dst, 0xFFFD);
+    }
+    *dst = '\0';
+    *out = start;
+    *len = dst - start;
+    r->pos = src;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static bool is_scalar_char(char c) {
+    return c != '\0' && c != ',' && c != '}' && c != ']' && c != ':' && !is_space(c);
+}
+
+/**
+ * Step over the value at r->pos without modifying it
+ */
+static agentmail_err_t insitu_scan(insitu_t *r) {
+    char stack[AGENTMAIL_JSON_MAX_DEPTH];
+    int depth = 0;
+    do {
+        insitu_space(r);
+        if (r->pos >= r->end) return AGENTMAIL_ERR_PARSE;
+        char c = *r->pos;
+        if (c == '"') {
+            r->pos++;
+            while (r->pos < r->end && *r->pos != '"') {
+                r->pos += (*r->pos == '\\') ? 2 : 1;
+            }
+            if (r->pos >= r->end) return AGENTMAIL_ERR_PARSE;
+            r->pos++;
+        } else if (c == '{' || c == '[') {
+            if (depth >= AGENTMAIL_JSON_MAX_DEPTH) return AGENTMAIL_ERR_PARSE;
+            stack[depth++] = c;
+            r->pos++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || stack[depth - 1] != (c == '}' ? '{' : '[')) return AGENTMAIL_ERR_PARSE;
+            depth--;
+            r->pos++;
+        } else if (c == ',' || c == ':') {
+            if (depth == 0) return AGENTMAIL_ERR_PARSE;
+            r->pos++;
+        } else {
+            char *start = r->pos;
+            while (r->pos < r->end && is_scalar_char(*r->pos)) r->pos++;
+            if (r->pos == start) return AGENTMAIL_ERR_PARSE;
+        }
+    } while (depth > 0);
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * NUL-terminate the text [start, r->pos) of a value that is not followed
+ * by a spare byte: it moves one byte left over the already consumed ':',
+ * ',' or '[' before it. A root value takes the whitespace or terminator
+ * after it instead.
+ */
+static agentmail_err_t insitu_terminate(insitu_t *r, char *start, char **out) {
+    size_t len = r->pos - start;
+    if (start > r->begin) {
+        memmove(start - 1, start, len);
+        start[len - 1] = '\0';
+        *out = start - 1;
+        return AGENTMAIL_ERR_NONE;
+    }
+    if (r->pos < r->end) {
+        if (!is_space(*r->pos)) return AGENTMAIL_ERR_PARSE;
+        *r->pos++ = '\0';
+    }
+    *out = start;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t insitu_value(insitu_t *r, const char *key, int depth);
+
+static agentmail_err_t insitu_container(insitu_t *r, const char *key, int depth) {
+    agentmail_json_parser_t *p = r->p;
+    bool object = (*r->pos == '{');
+    char close = object ? '}' : ']';
+    if (depth >= AGENTMAIL_JSON_MAX_DEPTH) return AGENTMAIL_ERR_PARSE;
+    agentmail_err_t err = p->cb(p->ctx, object ? AGENTMAIL_JSON_OBJECT_BEGIN : AGENTMAIL_JSON_ARRAY_BEGIN,
+                                key, NULL, 0, depth);
+    if (err != AGENTMAIL_ERR_NONE) return err;
+    r->pos++;
+
+    insitu_space(r);
+    if (r->pos < r->end && *r->pos == close) {
+        r->pos++;
+    } else {
+        for (;;) {
+            const char *member = NULL;
+            if (object) {
+                insitu_space(r);
+                if (r->pos >= r->end || *r->pos != '"') return AGENTMAIL_ERR_PARSE;
+                char *name;
+                size_t name_len;
+                err = insitu_string(r, &name, &name_len);
+                if (err != AGENTMAIL_ERR_NONE) return err;
+                insitu_space(r);
+                if (r->pos >= r->end || *r->pos != ':') return AGENTMAIL_ERR_PARSE;
+                r->pos++;
+                p->skip = false;
+                p->raw = false;
+                err = p->cb(p->ctx, AGENTMAIL_JSON_KEY, name, NULL, 0, depth + 1);
+                if (err != AGENTMAIL_ERR_NONE) return err;
+                member = name;
+            }
+            err = insitu_value(r, member, depth + 1);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+
+            insitu_space(r);
+            if (r->pos >= r->end) return AGENTMAIL_ERR_PARSE;
+            char c = *r->pos++;
+            if (c == close) break;
+            if (c != ',') return AGENTMAIL_ERR_PARSE;
+        }
+    }
+    return p->cb(p->ctx, object ? AGENTMAIL_JSON_OBJECT_END : AGENTMAIL_JSON_ARRAY_END,
+                 NULL, NULL, 0, depth);
+}
+
+static agentmail_err_t insitu_value(insitu_t *r, const char *key, int depth) {
+    agentmail_json_parser_t *p = r->p;
+    insitu_space(r);
+    if (r->pos >= r->end) return AGENTMAIL_ERR_PARSE;
+
+    char c = *r->pos;
+    bool raw = p->raw && (c == '{' || c == '[');
+    bool skip = p->skip;
+    p->skip = false;
+    p->raw = false;
+    if (skip || raw) {
+        char *start = r->pos;
+        agentmail_err_t err = insitu_scan(r);
+        if (err != AGENTMAIL_ERR_NONE || !raw) return err;
+        char *text;
+        err = insitu_terminate(r, start, &text);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+        return p->cb(p->ctx, AGENTMAIL_JSON_RAW, key, text, strlen(text), depth);
+    }
+
+    if (c == '{' || c == '[') {
+        return insitu_container(r, key, depth);
+    }
+    if (c == '"') {
+        char *value;
+        size_t len;
+        agentmail_err_t err = insitu_string(r, &value, &len);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+        return p->cb(p->ctx, AGENTMAIL_JSON_STRING, key, value, len, depth);
+    }
+
+    char *start = r->pos;
+    while (r->pos < r->end && is_scalar_char(*r->pos)) r->pos++;
+    size_t len = r->pos - start;
+    if ((len == 4 && memcmp(start, "true", 4) == 0) || (len == 5 && memcmp(start, "false", 5) == 0) ||
+        (len == 4 && memcmp(start, "null", 4) == 0)) {
+        agentmail_json_event_t event = (c == 't') ? AGENTMAIL_JSON_TRUE
+                                     : (c == 'f') ? AGENTMAIL_JSON_FALSE
+                                     : AGENTMAIL_JSON_NULL;
+        return p->cb(p->ctx, event, key, NULL, 0, depth);
+    }
+    if (len == 0 || !(c == '-' || (c >= '0' && c <= '9'))) return AGENTMAIL_ERR_PARSE;
+    for (size_t i = 1; i < len; i++) {
+        char d = start[i];
+        if (!((d >= '0' && d <= '9') || d == '.' || d == 'e' || d == 'E' || d == '+' || d == '-')) {
+            return AGENTMAIL_ERR_PARSE;
+        }
+    }
+    char *text;
+    agentmail_err_t err = insitu_terminate(r, start, &text);
+    if (err != AGENTMAIL_ERR_NONE) return err;
+    return p->cb(p->ctx, AGENTMAIL_JSON_NUMBER, key, text, len, depth);
+}
+
+agentmail_err_t agentmail_json_parse_in_place(agentmail_json_parser_t *parser, char *doc, size_t len) {
+    if (parser->err != AGENTMAIL_ERR_NONE) {
+        return parser->err;
+    }
+    insitu_t r = {parser, doc, doc, doc + len};
+    parser->skip = false;
+    parser->raw = false;
+    agentmail_err_t err = insitu_value(&r, NULL, 0);
+    if (err == AGENTMAIL_ERR_NONE) {
+        insitu_space(&r);
+        if (r.pos != r.end) err = AGENTMAIL_ERR_PARSE;
+    }
+    parser->err = err;
+    parser->state = ST_DONE;
+    return err;
+}
+
+void agentmail_json_raw_value(agentmail_json_parser_t *parser) {
+    parser->raw = true;
+}
+
+agentmail_err_t agentmail_json_finish(agentmail_json_parser_t *parser) {
+    if (parser->err != AGENTMAIL_ERR_NONE) {
+        return parser->err;
+    }
+    if (parser->state == ST_NUMBER && parser->depth == 0) {
+        parser->err = finish_number(parser);
+        if (parser->err != AGENTMAIL_ERR_NONE) return parser->err;
+    }
+    if (parser->state != ST_DONE) {
+        parser->err = AGENTMAIL_ERR_PARSE;
+    }
+    return parser->err;
+}
+
+void agentmail_json_free(agentmail_json_parser_t *parser) {
+    free(parser->buf);
+    free(parser->key);
+    parser->buf = NULL;
+    parser->key = NULL;
+    parser->cap = 0;
+    parser->key_cap = 0;
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+static void flush_pending(agentmail_json_writer_t *w) {
+    size_t pending = w->len - w->flushed;
+    if (pending > 0 && w->err == AGENTMAIL_ERR_NONE) {
+        w->err = w->flush(w->flush_ctx, w->buf, pending);
+    }
+    w->flushed = w->len;
+}
+
+static void stream_bytes(agentmail_json_writer_t *w, const char *data, size_t len) {
+    if (w->len - w->flushed + len > w->cap) {
+        flush_pending(w);
+    }
+    if (len >= w->cap) {
+        if (w->err == AGENTMAIL_ERR_NONE) {
+            w->err = w->flush(w->flush_ctx, data, len);
+        }
+        w->len += len;
+        w->flushed = w->len;
+        return;
+    }
+    memcpy(w->buf + (w->len - w->flushed), data, len);
+    w->len += len;
+}
+
+static void write_bytes(agentmail_json_writer_t *w, const char *data, size_t len) {
+    if (w->flush != NULL) {
+        stream_bytes(w, data, len);
+        return;
+    }
+    // Once a piece doesn't fit nothing later does either, so the buffer
+    // only ever holds a prefix of the document
+    if (w->buf != NULL && w->len + len < w->cap) {
+        memcpy(w->buf + w->len, data, len);
+    }
+    w->len += len;
+}
+
+static void write_separator(agentmail_json_writer_t *w) {
+    if (w->need_comma) {
+        write_bytes(w, ",", 1);
+    }
+}
+
+void agentmail_json_writer_init(agentmail_json_writer_t *writer, char *buf, size_t cap) {
+    writer->buf = buf;
+    writer->cap = buf ? cap : 0;
+    writer->len = 0;
+    writer->flushed = 0;
+    writer->flush = NULL;
+    writer->flush_ctx = NULL;
+    writer->err = AGENTMAIL_ERR_NONE;
+    writer->need_comma = false;
+}
+
+void agentmail_json_writer_init_stream(agentmail_json_writer_t *writer, char *buf, size_t cap,
+                                       agentmail_write_cb_t flush, void *ctx) {
+    agentmail_json_writer_init(writer, buf, cap);
+    writer->flush = flush;
+    writer->flush_ctx = ctx;
+}
+
+void agentmail_json_write_object_begin(agentmail_json_writer_t *writer) {
+    write_separator(writer);
+    write_bytes(writer, "{", 1);
+    writer->need_comma = false;
+}
+
+void agentmail_json_write_object_end(agentmail_json_writer_t *writer) {
+    write_bytes(writer, "}", 1);
+    writer->need_comma = true;
+}
+
+void agentmail_json_write_array_begin(agentmail_json_writer_t *writer) {
+    write_separator(writer);
+    write_bytes(writer, "[", 1);
+    writer->need_comma = false;
+}
+
+void agentmail_json_write_array_end(agentmail_json_writer_t *writer) {
+    write_bytes(writer, "]", 1);
+    writer->need_comma = true;
+}
+
+static void write_quoted(agentmail_json_writer_t *w, const char *str) {
+    static const char HEX[] = "0123456789abcdef";
+    write_bytes(w, "\"", 1);
+    const char *run = str;
+    for (const char *c = str; *c != '\0'; c++) {
+        unsigned char u = (unsigned char)*c;
+        if (u >= 0x20 && u != '"' && u != '\\') {
+            continue;
+        }
+        write_bytes(w, run, c - run);
+        run = c + 1;
+        char esc[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t esc_len = 2;
+        switch (u) {
+            case '"':  esc[1] = '"';  break;
+            case '\\': esc[1] = '\\'; break;
+            case '\b': esc[1] = 'b';  break;
+            case '\f': esc[1] = 'f';  break;
+            case '\n': esc[1] = 'n';  break;
+            case '\r': esc[1] = 'r';  break;
+            case '\t': esc[1] = 't';  break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = HEX[u >> 4];
+                esc[5] = HEX[u & 0xF];
+                esc_len = 6;
+                break;
+        }
+        write_bytes(w, esc, esc_len);
+    }
+    write_bytes(w, run, strlen(run));
+    write_bytes(w, "\"", 1);
+}
+
+void agentmail_json_write_key(agentmail_json_writer_t *writer, const char *key) {
+    write_separator(writer);
+    write_quoted(writer, key);
+    write_bytes(writer, ":", 1);
+    writer->need_comma = false;
+}
+
+void agentmail_json_write_string(agentmail_json_writer_t *writer, const char *value) {
+    write_separator(writer);
+    write_quoted(writer, value);
+    writer->need_comma = true;
+}
+
+void agentmail_json_write_bool(agentmail_json_writer_t *writer, bool value) {
+    write_separator(writer);
+    if (value) {
+        write_bytes(writer, "true", 4);
+    } else {
+        write_bytes(writer, "false", 5);
+    }
+    writer->need_comma = true;
+}
+
+/**
+ * Encode len bytes; only the last block of a value may be partial
+ */
+static size_t base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *o = out;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t n = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        o[0] = ALPHABET[n >> 18];
+        o[1] = ALPHABET[(n >> 12) & 0x3F];
+        o[2] = ALPHABET[(n >> 6) & 0x3F];
+        o[3] = ALPHABET[n & 0x3F];
+        o += 4;
+    }
+    if (i < len) {
+        uint32_t n = (uint32_t)in[i] << 16;
+        if (i + 1 < len) n |= (uint32_t)in[i + 1] << 8;
+        o[0] = ALPHABET[n >> 18];
+        o[1] = ALPHABET[(n >> 12) & 0x3F];
+        o[2] = (i + 1 < len) ? ALPHABET[(n >> 6) & 0x3F] : '=';
+        o[3] = '=';
+        o += 4;
+    }
+    return o - out;
+}
+
+void agentmail_json_write_base64(agentmail_json_writer_t *writer, agentmail_read_cb_t read, void *ctx,
+                                 size_t size) {
+    // Chunks must be whole 3-byte groups so no padding appears mid-value
+    static_assert(AGENTMAIL_JSON_BASE64_CHUNK % 3 == 0, "base64 chunk must be a multiple of 3");
+    write_separator(writer);
+    write_bytes(writer, "\"", 1);
+
+    size_t encoded_len = (size + 2) / 3 * 4;
+    bool output = (writer->flush != NULL) ||
+                  (writer->buf != NULL && writer->len + encoded_len < writer->cap);
+    size_t offset = 0;
+    while (output && writer->err == AGENTMAIL_ERR_NONE && offset < size) {
+        uint8_t in[AGENTMAIL_JSON_BASE64_CHUNK];
+        char out[AGENTMAIL_JSON_BASE64_CHUNK / 3 * 4];
+        size_t n = size - offset;
+        if (n > sizeof(in)) n = sizeof(in);
+        writer->err = read(ctx, offset, in, n);
+        if (writer->err == AGENTMAIL_ERR_NONE) {
+            write_bytes(writer, out, base64_encode(in, n, out));
+            offset += n;
+        }
+    }
+    // Whatever wasn't encoded is still counted, so len stays exact
+    if (offset < size) {
+        writer->len += encoded_len - offset / 3 * 4;
+        if (writer->flush != NULL) {
+            writer->flushed = writer->len;
+        }
+    }
+
+    write_bytes(writer, "\"", 1);
+    writer->need_comma = true;
+}
+
+void agentmail_json_write_raw(agentmail_json_writer_t *writer, const char *json) {
+    write_separator(writer);
+    write_bytes(writer, json, strlen(json));
+    writer->need_comma = true;
+}
+
+bool agentmail_json_writer_finish(agentmail_json_writer_t *writer) {
+    if (writer->buf == NULL || writer->len >= writer->cap) {
+        return false;
+    }
+    writer->buf[writer->len] = '\0';
+    return true;
+}
+
+agentmail_err_t agentmail_json_writer_flush(agentmail_json_writer_t *writer) {
+    flush_pending(writer);
+    return writer->err;
+}
+
+static agentmail_err_t ignore_event(void *ctx, agentmail_json_event_t event, const char *key,
+                                    const char *value, size_t len, int depth) {
+    (void)ctx; (void)event; (void)key; (void)value; (void)len; (void)depth;
+    return AGENTMAIL_ERR_NONE;
+}
+
+bool agentmail_json_valid(const char *json) {
+    agentmail_json_parser_t parser;
+    agentmail_json_init(&parser, ignore_event, NULL);
+    agentmail_err_t err = agentmail_json_feed(&parser, json, strlen(json));
+    if (err == AGENTMAIL_ERR_NONE) {
+        err = agentmail_json_finish(&parser);
+    }
+    agentmail_json_free(&parser);
+    return err == AGENTMAIL_ERR_NONE;
+}
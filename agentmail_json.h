@@ -0,0 +1,259 @@
+#ifndef AGENTMAIL_JSON_H
+#define AGENTMAIL_JSON_H
+
+/**
+ * @file agentmail_json.h
+ * @brief Incremental (push) JSON decoder used internally by the client
+ *
+ * Bytes are fed in arbitrary pieces as they arrive from the network and
+ * values are reported through a SAX-style callback. Only the string or
+ * number currently being decoded is buffered, so memory use is bounded by
+ * the largest single value rather than the whole document.
+ *
+ * A document that is already in memory can instead be parsed in place,
+ * reporting the same events with strings unescaped inside the document
+ * itself, so nothing is buffered or copied at all.
+ *
+ * The writer serializes request payloads straight into a caller-provided
+ * buffer without building a tree, or streams them through a small window
+ * buffer to a callback so payload size doesn't bound memory use.
+ */
+
+#include "agentmail_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGENTMAIL_JSON_MAX_DEPTH 32
+#define AGENTMAIL_JSON_BASE64_CHUNK 480   // Bytes read per step by agentmail_json_write_base64()
+
+/**
+ * @brief Decoder events
+ */
+typedef enum {
+    AGENTMAIL_JSON_OBJECT_BEGIN,
+    AGENTMAIL_JSON_OBJECT_END,
+    AGENTMAIL_JSON_ARRAY_BEGIN,
+    AGENTMAIL_JSON_ARRAY_END,
+    AGENTMAIL_JSON_STRING,        ///< value/len hold the unescaped string (NUL-terminated)
+    AGENTMAIL_JSON_NUMBER,        ///< value/len hold the number text
+    AGENTMAIL_JSON_TRUE,
+    AGENTMAIL_JSON_FALSE,
+    AGENTMAIL_JSON_NULL,
+    AGENTMAIL_JSON_KEY,           ///< key holds a member name; its value follows
+    AGENTMAIL_JSON_RAW,           ///< value/len hold the undecoded text of a value (in-place parsing only)
+} agentmail_json_event_t;
+
+/**
+ * @brief Event callback
+ *
+ * @param ctx User context
+ * @param event Event type
+ * @param key Member name when the value is inside an object, NULL otherwise
+ *            (always NULL for OBJECT_END/ARRAY_END)
+ * @param value String or number text (STRING/NUMBER only), valid during the call
+ * @param len Length of value
+ * @param depth Nesting depth of the value (root value = 0)
+ * @return AGENTMAIL_ERR_NONE to continue, anything else stops decoding
+ */
+typedef agentmail_err_t (*agentmail_json_cb_t)(
+    void *ctx,
+    agentmail_json_event_t event,
+    const char *key,
+    const char *value,
+    size_t len,
+    int depth
+);
+
+/**
+ * @brief Decoder state (treat as opaque)
+ */
+typedef struct {
+    agentmail_json_cb_t cb;
+    void *ctx;
+    int state;
+    int depth;
+    bool in_key;
+    bool skip;                            // Discard the string value being decoded
+    bool raw;                             // Report the next value as AGENTMAIL_JSON_RAW
+    char stack[AGENTMAIL_JSON_MAX_DEPTH]; // '{' or '[' per open container
+    char *buf;                            // Value being decoded
+    size_t len;
+    size_t cap;
+    char *key;                            // Current member name
+    size_t key_cap;
+    const char *literal;                  // "true", "false" or "null" being matched
+    int literal_pos;
+    uint32_t unicode;                     // \uXXXX accumulator
+    int unicode_digits;
+    uint32_t high_surrogate;
+    agentmail_err_t err;
+} agentmail_json_parser_t;
+
+/**
+ * @brief Initialize a decoder
+ */
+void agentmail_json_init(agentmail_json_parser_t *parser, agentmail_json_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed the next piece of the document
+ *
+ * @return AGENTMAIL_ERR_NONE, AGENTMAIL_ERR_PARSE on malformed input, or the
+ *         error returned by the callback
+ */
+agentmail_err_t agentmail_json_feed(agentmail_json_parser_t *parser, const char *data, size_t len);
+
+/**
+ * @brief Skip the value of the member just reported
+ *
+ * Call from the AGENTMAIL_JSON_KEY callback. If the value is a string it
+ * is consumed without being buffered and no STRING event is emitted, so
+ * unwanted large values cost no memory. Other value types are reported
+ * as usual.
+ */
+void agentmail_json_skip_value(agentmail_json_parser_t *parser);
+
+/**
+ * @brief Parse a complete document in place
+ *
+ * Reports the same events as agentmail_json_feed(), but string values and
+ * member names are unescaped inside doc and NUL-terminated there, and
+ * number text is NUL-terminated by shifting it one byte left. Every
+ * value and key pointer therefore stays valid for as long as doc does
+ * and can be kept instead of copied. The original text is destroyed.
+ *
+ * agentmail_json_skip_value() skips a value of any type here (nothing is
+ * reported for it), and agentmail_json_raw_value() is supported.
+ *
+ * @param parser Decoder initialized with agentmail_json_init()
+ * @param doc Document to decode; doc[len] must be '\0'
+ * @param len Length of doc
+ * @return AGENTMAIL_ERR_NONE, AGENTMAIL_ERR_PARSE on malformed input, or the
+ *         error returned by the callback
+ */
+agentmail_err_t agentmail_json_parse_in_place(agentmail_json_parser_t *parser, char *doc, size_t len);
+
+/**
+ * @brief Report the value of the member just reported as raw text
+ *
+ * Call from the AGENTMAIL_JSON_KEY callback during in-place parsing. If
+ * the value is an object or array it is not decoded; a single
+ * AGENTMAIL_JSON_RAW event carries its original text, NUL-terminated in
+ * place. Scalar values are reported as usual.
+ */
+void agentmail_json_raw_value(agentmail_json_parser_t *parser);
+
+/**
+ * @brief Signal end of input
+ *
+ * @return AGENTMAIL_ERR_NONE if exactly one complete value was decoded
+ */
+agentmail_err_t agentmail_json_finish(agentmail_json_parser_t *parser);
+
+/**
+ * @brief Free decoder buffers
+ */
+void agentmail_json_free(agentmail_json_parser_t *parser);
+
+/**
+ * @brief Writer state (treat as opaque)
+ *
+ * Output that does not fit is counted but not stored, so after a run
+ * len is the exact size the document needs, whatever the buffer size.
+ * A streaming writer instead passes the output on whenever buf fills up.
+ */
+typedef struct {
+    char *buf;                            // Output (may be NULL to only measure)
+    size_t cap;
+    size_t len;                           // Length of the document so far
+    size_t flushed;                       // Streaming: bytes already passed to flush
+    agentmail_write_cb_t flush;           // Streaming output (NULL when writing into buf)
+    void *flush_ctx;
+    agentmail_err_t err;                  // First error returned by flush or a base64 source
+    bool need_comma;                      // A value precedes the next key or element
+} agentmail_json_writer_t;
+
+/**
+ * @brief Initialize a writer
+ *
+ * @param buf Output buffer, or NULL to only measure
+ * @param cap Size of buf
+ */
+void agentmail_json_writer_init(agentmail_json_writer_t *writer, char *buf, size_t cap);
+
+/**
+ * @brief Initialize a writer that streams its output
+ *
+ * Small pieces are gathered in buf and passed to flush whenever it fills;
+ * pieces at least cap bytes long (e.g. the run of a long string between
+ * two escapes) go to flush directly from the caller's memory. Once flush
+ * fails nothing more is passed on.
+ *
+ * @param buf Window buffer
+ * @param cap Size of buf (must not be 0)
+ * @param flush Output callback
+ * @param ctx Passed to flush
+ */
+void agentmail_json_writer_init_stream(agentmail_json_writer_t *writer, char *buf, size_t cap,
+                                       agentmail_write_cb_t flush, void *ctx);
+
+void agentmail_json_write_object_begin(agentmail_json_writer_t *writer);
+void agentmail_json_write_object_end(agentmail_json_writer_t *writer);
+void agentmail_json_write_array_begin(agentmail_json_writer_t *writer);
+void agentmail_json_write_array_end(agentmail_json_writer_t *writer);
+
+/**
+ * @brief Write a member name; the member's value must follow
+ */
+void agentmail_json_write_key(agentmail_json_writer_t *writer, const char *key);
+
+/**
+ * @brief Write a string value, escaping it as needed
+ */
+void agentmail_json_write_string(agentmail_json_writer_t *writer, const char *value);
+
+void agentmail_json_write_bool(agentmail_json_writer_t *writer, bool value);
+
+/**
+ * @brief Write a string value holding the base64 encoding of size bytes
+ *        obtained from read
+ *
+ * The content is read and encoded AGENTMAIL_JSON_BASE64_CHUNK bytes at a
+ * time. A writer that only measures (or whose buffer is too small anyway)
+ * doesn't read at all. The first error read returns is kept in err, like
+ * a flush error.
+ */
+void agentmail_json_write_base64(agentmail_json_writer_t *writer, agentmail_read_cb_t read, void *ctx,
+                                 size_t size);
+
+/**
+ * @brief Write a value that is already serialized JSON, as is
+ */
+void agentmail_json_write_raw(agentmail_json_writer_t *writer, const char *json);
+
+/**
+ * @brief NUL-terminate the document
+ *
+ * @return true if the whole document fit in the buffer; otherwise a
+ *         buffer of len + 1 bytes is needed
+ */
+bool agentmail_json_writer_finish(agentmail_json_writer_t *writer);
+
+/**
+ * @brief Pass the rest of a streamed document to flush
+ *
+ * @return AGENTMAIL_ERR_NONE, or the first error flush returned
+ */
+agentmail_err_t agentmail_json_writer_flush(agentmail_json_writer_t *writer);
+
+/**
+ * @brief Check that text is one well-formed JSON value
+ */
+bool agentmail_json_valid(const char *json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_JSON_H
@@ -0,0 +1,541 @@
+/**
+ * AgentMail Incremental MIME Parser
+ *
+ * Headers are read byte by byte into one field buffer and unfolded as
+ * they arrive. Bodies are scanned a line at a time for boundaries: only
+ * the first bytes of a line are gathered (a boundary line is short), the
+ * rest of a long line passes straight through to the decoder. The line
+ * break before a boundary belongs to the boundary, so each body line's
+ * break is held back until the next line turns out not to be one.
+ */
+
+#include "agentmail_mime.h"
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+enum {
+    ST_HEADER_LINE_START,   // Next byte starts a header line (or a continuation)
+    ST_HEADER_LINE,         // Inside a header line
+    ST_HEADER_END,          // Blank line after the headers started with '\r'
+    ST_BODY,
+    ST_DONE,                // Input ended
+};
+
+static bool is_wsp(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static void emit(agentmail_mime_parser_t *p, agentmail_mime_event_t event, const char *name,
+                 const char *value, size_t len) {
+    if (p->err != AGENTMAIL_ERR_NONE || p->stopped) return;
+    p->err = p->cb(p->ctx, event, &p->parts[p->depth], name, value, len);
+}
+
+static bool running(const agentmail_mime_parser_t *p) {
+    return p->err == AGENTMAIL_ERR_NONE && !p->stopped;
+}
+
+/**
+ * Copy s into out lowercased and NUL-terminated, truncating to cap - 1
+ */
+static void copy_lower(char *out, size_t cap, const char *s, size_t len) {
+    if (len >= cap) len = cap - 1;
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (char)tolower((unsigned char)s[i]);
+    }
+    out[len] = '\0';
+}
+
+/**
+ * Find a parameter of a structured header value ("type; name=value; ...")
+ * and copy its (unquoted) value to out
+ */
+static bool header_param(const char *value, const char *name, char *out, size_t cap) {
+    size_t name_len = strlen(name);
+    const char *s = strchr(value, ';');
+    while (s != NULL) {
+        s++;
+        while (is_wsp(*s)) s++;
+        if (strncasecmp(s, name, name_len) == 0) {
+            const char *v = s + name_len;
+            while (is_wsp(*v)) v++;
+            if (*v == '=') {
+                v++;
+                while (is_wsp(*v)) v++;
+                size_t len = 0;
+                if (*v == '"') {
+                    for (v++; *v != '\0' && *v != '"'; v++) {
+                        if (*v == '\\' && v[1] != '\0') v++;
+                        if (len + 1 < cap) out[len++] = *v;
+                    }
+                } else {
+                    for (; *v != '\0' && *v != ';' && !is_wsp(*v); v++) {
+                        if (len + 1 < cap) out[len++] = *v;
+                    }
+                }
+                out[len] = '\0';
+                return true;
+            }
+        }
+        // Next parameter, skipping separators inside quoted values
+        bool quoted = false;
+        for (; *s != '\0' && (quoted || *s != ';'); s++) {
+            if (*s == '"') quoted = !quoted;
+            else if (*s == '\\' && quoted && s[1] != '\0') s++;
+        }
+        s = (*s == ';') ? s : NULL;
+    }
+    return false;
+}
+
+/**
+ * Length of the leading token of a structured header value
+ */
+static size_t header_token_len(const char *value) {
+    size_t len = strcspn(value, ";");
+    while (len > 0 && is_wsp(value[len - 1])) len--;
+    return len;
+}
+
+/**
+ * Report the header field in p->header and pick up the fields that
+ * describe the part
+ */
+static void header_complete(agentmail_mime_parser_t *p) {
+    size_t len = p->header_len;
+    p->header_len = 0;
+    while (len > 0 && is_wsp(p->header[len - 1])) len--;
+    p->header[len] = '\0';
+    char *colon = (char *)memchr(p->header, ':', len);
+    if (colon == NULL) {
+        return;
+    }
+    char *name_end = colon;
+    while (name_end > p->header && is_wsp(name_end[-1])) name_end--;
+    *name_end = '\0';
+    char *value = colon + 1;
+    while (is_wsp(*value)) value++;
+
+    agentmail_mime_part_t *part = &p->parts[p->depth];
+    if (strcasecmp(p->header, "Content-Type") == 0) {
+        copy_lower(part->content_type, sizeof(part->content_type), value, header_token_len(value));
+        part->multipart = strncmp(part->content_type, "multipart/", 10) == 0;
+        char charset[sizeof(part->charset)];
+        if (header_param(value, "charset", charset, sizeof(charset))) {
+            copy_lower(part->charset, sizeof(part->charset), charset, strlen(charset));
+        }
+        if (!header_param(value, "boundary", p->boundaries[p->depth], sizeof(p->boundaries[0]))) {
+            p->boundaries[p->depth][0] = '\0';
+        }
+        if (part->filename[0] == '\0') {
+            header_param(value, "name", part->filename, sizeof(part->filename));
+        }
+    } else if (strcasecmp(p->header, "Content-Transfer-Encoding") == 0) {
+        size_t token_len = header_token_len(value);
+        if (token_len == 6 && strncasecmp(value, "base64", 6) == 0) {
+            part->encoding = AGENTMAIL_MIME_BASE64;
+        } else if (token_len == 16 && strncasecmp(value, "quoted-printable", 16) == 0) {
+            part->encoding = AGENTMAIL_MIME_QUOTED_PRINTABLE;
+        } else {
+            part->encoding = AGENTMAIL_MIME_IDENTITY;
+        }
+    } else if (strcasecmp(p->header, "Content-Disposition") == 0) {
+        part->attachment = header_token_len(value) == 10 && strncasecmp(value, "attachment", 10) == 0;
+        header_param(value, "filename", part->filename, sizeof(part->filename));
+    }
+    emit(p, AGENTMAIL_MIME_HEADER, p->header, value, strlen(value));
+}
+
+static void part_begin(agentmail_mime_parser_t *p, int depth, int index) {
+    p->depth = depth;
+    agentmail_mime_part_t *part = &p->parts[depth];
+    memset(part, 0, sizeof(*part));
+    part->depth = depth;
+    part->index = index;
+    p->boundaries[depth][0] = '\0';
+    p->state = ST_HEADER_LINE_START;
+    p->header_len = 0;
+}
+
+static void headers_end(agentmail_mime_parser_t *p) {
+    agentmail_mime_part_t *part = &p->parts[p->depth];
+    if (part->content_type[0] == '\0') {
+        strcpy(part->content_type, "text/plain");
+    }
+    // Without a usable boundary a multipart body is reported as is
+    if (part->multipart && (p->boundaries[p->depth][0] == '\0' || p->depth + 1 >= AGENTMAIL_MIME_MAX_DEPTH)) {
+        part->multipart = false;
+    }
+    if (!part->multipart) {
+        p->boundaries[p->depth][0] = '\0';
+    }
+    p->children[p->depth] = 0;
+    p->skip_body = false;
+    p->state = ST_BODY;
+    p->line_start = true;
+    p->line_len = 0;
+    p->eol_len = 0;
+    p->cr_pending = false;
+    p->quantum = 0;
+    p->quantum_bits = 0;
+    p->qp_state = 0;
+    p->out_len = 0;
+    emit(p, AGENTMAIL_MIME_HEADERS_END, NULL, NULL, 0);
+}
+
+// ============================================================================
+// Body Decoding
+// ============================================================================
+
+static bool decoding(const agentmail_mime_parser_t *p) {
+    return !p->skip_body && !p->parts[p->depth].multipart && running(p);
+}
+
+static void out_flush(agentmail_mime_parser_t *p) {
+    if (p->out_len > 0) {
+        size_t len = p->out_len;
+        p->out_len = 0;
+        emit(p, AGENTMAIL_MIME_BODY, NULL, p->out, len);
+    }
+}
+
+static void out_push(agentmail_mime_parser_t *p, char c) {
+    if (p->out_len == sizeof(p->out)) {
+        out_flush(p);
+    }
+    p->out[p->out_len++] = c;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/**
+ * Decode body bytes from within a line (line breaks go through
+ * decode_eol())
+ */
+static void decode_text(agentmail_mime_parser_t *p, const char *s, size_t len) {
+    if (!decoding(p) || len == 0) return;
+    switch (p->parts[p->depth].encoding) {
+        case AGENTMAIL_MIME_BASE64:
+            for (size_t i = 0; i < len; i++) {
+                int v = base64_value(s[i]);
+                if (v < 0) continue;  // Padding, whitespace, garbage
+                p->quantum = (p->quantum << 6) | (uint32_t)v;
+                p->quantum_bits += 6;
+                if (p->quantum_bits >= 8) {
+                    p->quantum_bits -= 8;
+                    out_push(p, (char)(p->quantum >> p->quantum_bits));
+                }
+            }
+            break;
+        case AGENTMAIL_MIME_QUOTED_PRINTABLE:
+            for (size_t i = 0; i < len; i++) {
+                char c = s[i];
+                if (p->qp_state == 1) {
+                    if (hex_value(c) >= 0) {
+                        p->qp_high = c;
+                        p->qp_state = 2;
+                        continue;
+                    }
+                    out_push(p, '=');  // Not an escape: kept literally
+                } else if (p->qp_state == 2) {
+                    if (hex_value(c) >= 0) {
+                        out_push(p, (char)(hex_value(p->qp_high) << 4 | hex_value(c)));
+                        p->qp_state = 0;
+                        continue;
+                    }
+                    out_push(p, '=');
+                    out_push(p, p->qp_high);
+                }
+                p->qp_state = 0;
+                if (c == '=') {
+                    p->qp_state = 1;
+                } else {
+                    out_push(p, c);
+                }
+            }
+            break;
+        default:
+            out_flush(p);
+            emit(p, AGENTMAIL_MIME_BODY, NULL, s, len);
+            break;
+    }
+}
+
+/**
+ * Decode the line break held back in p->eol
+ */
+static void decode_eol(agentmail_mime_parser_t *p) {
+    size_t len = p->eol_len;
+    p->eol_len = 0;
+    if (!decoding(p) || len == 0) return;
+    switch (p->parts[p->depth].encoding) {
+        case AGENTMAIL_MIME_BASE64:
+            break;
+        case AGENTMAIL_MIME_QUOTED_PRINTABLE:
+            if (p->qp_state == 1) {
+                p->qp_state = 0;  // Soft line break
+                break;
+            }
+            if (p->qp_state == 2) {
+                out_push(p, '=');
+                out_push(p, p->qp_high);
+                p->qp_state = 0;
+            }
+            for (size_t i = 0; i < len; i++) {
+                out_push(p, p->eol[i]);
+            }
+            break;
+        default:
+            out_flush(p);
+            emit(p, AGENTMAIL_MIME_BODY, NULL, p->eol, len);
+            break;
+    }
+}
+
+/**
+ * Pass on a piece of a body line; a piece that ends the line includes
+ * its '\n'
+ */
+static void body_piece(agentmail_mime_parser_t *p, const char *s, size_t len, bool ends_line) {
+    if (ends_line) {
+        len--;
+        bool crlf = false;
+        if (len > 0 && s[len - 1] == '\r') {
+            crlf = true;
+            len--;
+        } else if (len == 0 && p->cr_pending) {
+            crlf = true;
+            p->cr_pending = false;
+        }
+        if (p->cr_pending) {
+            p->cr_pending = false;
+            decode_text(p, "\r", 1);
+        }
+        decode_text(p, s, len);
+        p->eol_len = 0;
+        if (crlf) {
+            p->eol[p->eol_len++] = '\r';
+        }
+        p->eol[p->eol_len++] = '\n';
+        p->line_start = true;
+        return;
+    }
+    if (p->cr_pending) {
+        p->cr_pending = false;
+        decode_text(p, "\r", 1);
+    }
+    if (len > 0 && s[len - 1] == '\r') {
+        p->cr_pending = true;  // Maybe the first half of a CRLF
+        len--;
+    }
+    decode_text(p, s, len);
+}
+
+/**
+ * Find the multipart level whose boundary the line is, if any
+ *
+ * @return Level, or -1 if the line is body content
+ */
+static int boundary_level(const agentmail_mime_parser_t *p, const char *line, size_t len, bool *close) {
+    while (len > 0 && is_wsp(line[len - 1])) len--;
+    if (len < 3 || line[0] != '-' || line[1] != '-') {
+        return -1;
+    }
+    for (int level = p->depth; level >= 0; level--) {
+        const char *boundary = p->boundaries[level];
+        size_t boundary_len = strlen(boundary);
+        if (boundary_len == 0 || len < 2 + boundary_len || memcmp(line + 2, boundary, boundary_len) != 0) {
+            continue;
+        }
+        size_t rest = len - 2 - boundary_len;
+        if (rest == 0 || (rest == 2 && line[len - 2] == '-' && line[len - 1] == '-')) {
+            *close = (rest == 2);
+            return level;
+        }
+    }
+    return -1;
+}
+
+/**
+ * End every part nested in the multipart at level, then start its next
+ * part (or its epilogue after the closing boundary)
+ */
+static void boundary_reached(agentmail_mime_parser_t *p, int level, bool close) {
+    p->eol_len = 0;  // The line break belongs to the boundary
+    if (decoding(p)) {
+        out_flush(p);
+    }
+    for (; p->depth > level; p->depth--) {
+        emit(p, AGENTMAIL_MIME_PART_END, NULL, NULL, 0);
+    }
+    if (close) {
+        p->boundaries[level][0] = '\0';
+        p->line_start = true;
+        p->line_len = 0;
+        p->cr_pending = false;
+    } else {
+        part_begin(p, level + 1, p->children[level]++);
+    }
+}
+
+/**
+ * Handle the gathered start of a body line
+ */
+static void line_complete(agentmail_mime_parser_t *p, bool ends_line) {
+    size_t len = p->line_len;
+    p->line_len = 0;
+    if (ends_line) {
+        bool close = false;
+        size_t content_len = len - 1;
+        if (content_len > 0 && p->line[content_len - 1] == '\r') content_len--;
+        int level = boundary_level(p, p->line, content_len, &close);
+        if (level >= 0) {
+            boundary_reached(p, level, close);
+            return;
+        }
+    }
+    decode_eol(p);
+    p->line_start = ends_line;
+    body_piece(p, p->line, len, ends_line);
+}
+
+static size_t feed_body(agentmail_mime_parser_t *p, const char *data, size_t len) {
+    const char *nl = (const char *)memchr(data, '\n', len);
+    if (p->line_start) {
+        // Gather just enough of the line to tell whether it is a boundary
+        size_t room = sizeof(p->line) - p->line_len;
+        size_t take = (nl != NULL) ? (size_t)(nl - data) + 1 : len;
+        if (take > room) take = room;
+        memcpy(p->line + p->line_len, data, take);
+        p->line_len += take;
+        bool ends_line = (take > 0 && data[take - 1] == '\n');
+        if (ends_line || p->line_len == sizeof(p->line)) {
+            line_complete(p, ends_line);
+        }
+        return take;
+    }
+    size_t take = (nl != NULL) ? (size_t)(nl - data) + 1 : len;
+    body_piece(p, data, take, nl != NULL);
+    return take;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void agentmail_mime_init(agentmail_mime_parser_t *parser, agentmail_mime_cb_t cb, void *ctx) {
+    memset(parser, 0, sizeof(*parser));
+    parser->cb = cb;
+    parser->ctx = ctx;
+    part_begin(parser, 0, 0);
+}
+
+agentmail_err_t agentmail_mime_feed(agentmail_mime_parser_t *parser, const char *data, size_t len) {
+    agentmail_mime_parser_t *p = parser;
+    while (len > 0 && running(p) && p->state != ST_DONE) {
+        size_t used = 1;
+        char c = data[0];
+        switch (p->state) {
+            case ST_HEADER_LINE_START:
+                if (is_wsp(c)) {
+                    // Folded continuation of the previous field
+                    p->state = ST_HEADER_LINE;
+                    used = 0;
+                    break;
+                }
+                if (p->header_len > 0) {
+                    header_complete(p);
+                }
+                if (c == '\n') {
+                    headers_end(p);
+                } else if (c == '\r') {
+                    p->state = ST_HEADER_END;
+                } else {
+                    p->state = ST_HEADER_LINE;
+                    used = 0;
+                }
+                break;
+            case ST_HEADER_LINE: {
+                const char *nl = (const char *)memchr(data, '\n', len);
+                used = (nl != NULL) ? (size_t)(nl - data) : len;
+                size_t room = AGENTMAIL_MIME_HEADER_MAX - p->header_len;
+                memcpy(p->header + p->header_len, data, used < room ? used : room);
+                p->header_len += used < room ? used : room;
+                if (nl != NULL) {
+                    used++;
+                    if (p->header_len > 0 && p->header[p->header_len - 1] == '\r') {
+                        p->header_len--;
+                    }
+                    p->state = ST_HEADER_LINE_START;
+                }
+                break;
+            }
+            case ST_HEADER_END:
+                if (c == '\n') {
+                    headers_end(p);
+                }
+                break;
+            case ST_BODY:
+                used = feed_body(p, data, len);
+                break;
+        }
+        data += used;
+        len -= used;
+    }
+    return p->err;
+}
+
+agentmail_err_t agentmail_mime_finish(agentmail_mime_parser_t *parser) {
+    agentmail_mime_parser_t *p = parser;
+    if (p->state == ST_DONE) {
+        return p->err;
+    }
+    if (p->state != ST_BODY) {
+        // Input ended inside the headers
+        if (p->header_len > 0) {
+            header_complete(p);
+        }
+        headers_end(p);
+    } else if (p->line_len > 0) {
+        line_complete(p, false);
+    } else {
+        decode_eol(p);
+    }
+    if (p->cr_pending) {
+        p->cr_pending = false;
+        decode_text(p, "\r", 1);
+    }
+    if (decoding(p)) {
+        out_flush(p);
+    }
+    for (; p->depth > 0; p->depth--) {
+        emit(p, AGENTMAIL_MIME_PART_END, NULL, NULL, 0);
+    }
+    emit(p, AGENTMAIL_MIME_PART_END, NULL, NULL, 0);
+    p->state = ST_DONE;
+    return p->err;
+}
+
+void agentmail_mime_stop(agentmail_mime_parser_t *parser) {
+    parser->stopped = true;
+}
+
+void agentmail_mime_skip_body(agentmail_mime_parser_t *parser) {
+    parser->skip_body = true;
+    parser->out_len = 0;
+}
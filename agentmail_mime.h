@@ -0,0 +1,181 @@
+#ifndef AGENTMAIL_MIME_H
+#define AGENTMAIL_MIME_H
+
+/**
+ * @file agentmail_mime.h
+ * @brief Incremental (push) MIME parser for raw messages
+ *
+ * Raw message bytes are fed in arbitrary pieces, e.g. straight from
+ * agentmail_message_get_raw_stream(), and reported through a callback:
+ * each header field, the start of each part's body with its content type,
+ * filename and transfer encoding, the decoded body bytes, and the end of
+ * each part. Base64 and quoted-printable bodies are decoded on the fly.
+ *
+ * The parser never allocates. Its state is one fixed-size struct holding
+ * the header field being read, the start of the current body line (enough
+ * to recognize a boundary) and a small decode buffer, so memory use does
+ * not depend on message size.
+ *
+ * Example (print the subject, then stop):
+ * @code
+ * static agentmail_err_t on_mime(void *ctx, agentmail_mime_event_t event,
+ *                                const agentmail_mime_part_t *part,
+ *                                const char *name, const char *value, size_t len) {
+ *     agentmail_mime_parser_t *parser = (agentmail_mime_parser_t *)ctx;
+ *     if (event == AGENTMAIL_MIME_HEADER && strcasecmp(name, "Subject") == 0) {
+ *         printf("Subject: %s\n", value);
+ *     } else if (event == AGENTMAIL_MIME_HEADERS_END) {
+ *         agentmail_mime_stop(parser);  // The body isn't needed
+ *     }
+ *     return AGENTMAIL_ERR_NONE;
+ * }
+ *
+ * agentmail_mime_parser_t parser;
+ * agentmail_mime_init(&parser, on_mime, &parser);
+ * agentmail_message_get_mime(client, inbox_id, message_id, &parser);
+ * @endcode
+ */
+
+#include "agentmail_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGENTMAIL_MIME_MAX_DEPTH 8      // Multipart nesting levels tracked
+#define AGENTMAIL_MIME_HEADER_MAX 512   // Longest header field kept (unfolded); longer ones are truncated
+#define AGENTMAIL_MIME_BOUNDARY_MAX 70  // Longest boundary allowed by RFC 2046
+
+/**
+ * @brief Parser events
+ */
+typedef enum {
+    AGENTMAIL_MIME_HEADER,        ///< name/value hold one header field of the part (unfolded, NUL-terminated)
+    AGENTMAIL_MIME_HEADERS_END,   ///< The part's header block ended; part describes it
+    AGENTMAIL_MIME_BODY,          ///< value/len hold decoded body bytes of a non-multipart part
+    AGENTMAIL_MIME_PART_END,      ///< The part (and all parts nested in it) ended
+} agentmail_mime_event_t;
+
+/**
+ * @brief Content-Transfer-Encoding of a part
+ */
+typedef enum {
+    AGENTMAIL_MIME_IDENTITY,      ///< 7bit, 8bit or binary: body passed on as is
+    AGENTMAIL_MIME_BASE64,
+    AGENTMAIL_MIME_QUOTED_PRINTABLE,
+} agentmail_mime_encoding_t;
+
+/**
+ * @brief Part being reported
+ *
+ * depth and index are set from the first HEADER event on; the other
+ * fields are filled in from the headers by the time of HEADERS_END.
+ */
+typedef struct {
+    int depth;                    ///< 0 for the message itself, 1 for its parts, ...
+    int index;                    ///< Position among the parts of the enclosing multipart
+    char content_type[64];        ///< Lowercase media type ("text/plain" if not given)
+    char charset[24];             ///< Lowercase charset parameter (empty if not given)
+    char filename[96];            ///< Content-Disposition filename or Content-Type name (empty if none)
+    agentmail_mime_encoding_t encoding;
+    bool multipart;               ///< Body is a list of parts (reported as nested parts, no BODY events)
+    bool attachment;              ///< Content-Disposition: attachment
+} agentmail_mime_part_t;
+
+/**
+ * @brief Event callback
+ *
+ * @param ctx User context
+ * @param event Event type
+ * @param part Part the event belongs to, valid during the call
+ * @param name Header field name (HEADER only)
+ * @param value Header field value (HEADER) or decoded body bytes (BODY)
+ * @param len Length of value
+ * @return AGENTMAIL_ERR_NONE to continue, anything else stops parsing and
+ *         is returned by agentmail_mime_feed()
+ */
+typedef agentmail_err_t (*agentmail_mime_cb_t)(
+    void *ctx,
+    agentmail_mime_event_t event,
+    const agentmail_mime_part_t *part,
+    const char *name,
+    const char *value,
+    size_t len
+);
+
+/**
+ * @brief Parser state (treat as opaque)
+ */
+typedef struct {
+    agentmail_mime_cb_t cb;
+    void *ctx;
+    int state;
+    int depth;                                    // Depth of the current part
+    bool stopped;                                 // agentmail_mime_stop() was called
+    bool skip_body;                               // No BODY events for the current part
+    bool cr_pending;                              // Body piece ended with '\r' (may start a CRLF)
+    bool line_start;                              // Next body byte starts a line
+    char eol[2];                                  // Line break held back until the next line
+    size_t eol_len;                               // (the break before a boundary belongs to it)
+    agentmail_mime_part_t parts[AGENTMAIL_MIME_MAX_DEPTH];
+    char boundaries[AGENTMAIL_MIME_MAX_DEPTH][AGENTMAIL_MIME_BOUNDARY_MAX + 1]; // "" if not multipart
+    int children[AGENTMAIL_MIME_MAX_DEPTH];       // Parts seen so far per multipart level
+    char header[AGENTMAIL_MIME_HEADER_MAX + 1];   // Header field being read
+    size_t header_len;
+    char line[AGENTMAIL_MIME_BOUNDARY_MAX + 8];   // Start of a body line that may be a boundary
+    size_t line_len;
+    uint32_t quantum;                             // Base64 bits being assembled
+    int quantum_bits;
+    int qp_state;                                 // Quoted-printable: 0, after '=', after '=' and a digit
+    char qp_high;
+    char out[192];                                // Decoded bytes not yet reported
+    size_t out_len;
+    agentmail_err_t err;
+} agentmail_mime_parser_t;
+
+/**
+ * @brief Initialize a parser
+ */
+void agentmail_mime_init(agentmail_mime_parser_t *parser, agentmail_mime_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed the next piece of the raw message
+ *
+ * @return AGENTMAIL_ERR_NONE, or the error returned by the callback
+ *
+ * @note Input after agentmail_mime_stop() is ignored.
+ */
+agentmail_err_t agentmail_mime_feed(agentmail_mime_parser_t *parser, const char *data, size_t len);
+
+/**
+ * @brief Signal end of input
+ *
+ * Reports the rest of the current body and PART_END for every part still
+ * open (a truncated message is not an error).
+ *
+ * @return AGENTMAIL_ERR_NONE, or the error returned by the callback
+ */
+agentmail_err_t agentmail_mime_finish(agentmail_mime_parser_t *parser);
+
+/**
+ * @brief Stop parsing
+ *
+ * Call from the callback once everything needed was reported. No further
+ * events are reported, and agentmail_message_get_mime() stops the
+ * transfer instead of downloading the rest of the message.
+ */
+void agentmail_mime_stop(agentmail_mime_parser_t *parser);
+
+/**
+ * @brief Skip the body of the part just reported
+ *
+ * Call from the HEADERS_END callback. The body is scanned for boundaries
+ * but not decoded, and no BODY events are reported for it.
+ */
+void agentmail_mime_skip_body(agentmail_mime_parser_t *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_MIME_H
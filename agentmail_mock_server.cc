@@ -0,0 +1,1365 @@
+/**
+ * AgentMail Mock Server
+ *
+ * In-memory implementation of the AgentMail v0 REST API for Linux host
+ * builds. One thread per connection, HTTP/1.1 keep-alive, JSON via cJSON.
+ * WebSocket upgrades on any path act as the event endpoint: subscribers
+ * get a message.received event as each message is delivered. Registered
+ * webhook URLs get the same event as a signed POST from a sender thread.
+ *
+ * Build standalone with -DAGENTMAIL_MOCK_SERVER_MAIN to get a server
+ * binary: ./agentmail_mock_server [port]
+ */
+
+#ifndef ESP_PLATFORM
+
+#include "agentmail_mock_server.h"
+#include "agentmail_hmac.h"
+#include "agentmail_port.h"
+#include <cJSON.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *TAG = "agentmail_mock";
+
+struct MockAttachment {
+    std::string attachment_id;
+    std::string filename;
+    std::string content_type;
+    std::string content;              // Decoded bytes
+};
+
+struct MockMessage {
+    std::string message_id;
+    std::string thread_id;
+    std::string from;
+    std::string to;
+    std::string subject;
+    std::string text;
+    std::string html;
+    std::string created_at;
+    bool is_read = false;
+    std::vector<MockAttachment> attachments;
+};
+
+struct MockInbox {
+    std::string inbox_id;
+    std::string name;
+    std::string created_at;
+    std::string metadata;             // Raw JSON (empty if none)
+    std::vector<MockMessage> messages; // Newest first
+};
+
+struct MockRequest {
+    std::string method;
+    std::string path;                 // Without query string
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers; // Lower-case names
+    std::string body;
+};
+
+struct MockResponse {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string extra_headers;        // Complete "Name: value\r\n" lines
+    std::string body;
+};
+
+struct MockSubscriber {
+    int fd;
+    std::mutex write_mutex;           // Frames from the connection and delivery threads
+    std::vector<std::string> inbox_ids; // Guarded by the server mutex
+};
+
+struct MockWebhook {
+    std::string host;
+    std::string port;
+    std::string path;
+    std::string key;                  // Decoded signing secret (empty = unsigned)
+};
+
+struct MockWebhookJob {
+    MockWebhook target;
+    std::string id;
+    std::string payload;
+};
+
+struct agentmail_mock_server {
+    int listen_fd = -1;
+    uint16_t port = 0;
+    std::atomic<bool> running{false};
+    std::thread accept_thread;
+
+    std::mutex conn_mutex;            // Guards conn_fds
+    std::condition_variable conn_done;
+    std::vector<int> conn_fds;        // Open connections (one detached thread each)
+
+    std::atomic<size_t> chunk_size{0}; // Serve bodies chunked when non-zero
+
+    std::mutex mutex;                 // Guards everything below
+    std::vector<MockInbox> inboxes;
+    std::vector<std::shared_ptr<MockSubscriber>> subscribers;
+    uint64_t next_id = 1;
+    agentmail_mock_stats_t stats = {};
+    uint32_t fail_count = 0;          // Injected failures still to serve
+    int fail_status = 0;
+    int fail_retry_after = -1;        // Seconds, -1 for no Retry-After
+    uint32_t cut_count = 0;           // Responses still to cut off mid-body
+    size_t cut_after = 0;             // Body bytes sent before cutting
+
+    std::mutex webhook_mutex;         // Guards everything below (taken after mutex, never before)
+    std::vector<MockWebhook> webhooks;
+    std::deque<MockWebhookJob> webhook_jobs;
+    std::condition_variable webhook_ready;
+    std::thread webhook_thread;       // Started by the first agentmail_mock_server_add_webhook()
+    bool webhook_stop = false;
+};
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+/**
+ * Current time with millisecond precision, strictly increasing so that
+ * messages delivered in a burst still sort newest first by timestamp
+ */
+static std::string now_iso8601() {
+    static std::atomic<int64_t> last_ms(0);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    int64_t prev = last_ms.load();
+    do {
+        if (ms <= prev) {
+            ms = prev + 1;
+        }
+    } while (!last_ms.compare_exchange_weak(prev, ms));
+
+    time_t secs = (time_t)(ms / 1000);
+    struct tm tm_utc;
+    gmtime_r(&secs, &tm_utc);
+    char buf[40];
+    size_t len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    snprintf(buf + len, sizeof(buf) - len, ".%03dZ", (int)(ms % 1000));
+    return buf;
+}
+
+static std::string url_decode(const std::string &in) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        if (in[i] == '%' && i + 2 < in.size()) {
+            out += (char)strtol(in.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        } else if (in[i] == '+') {
+            out += ' ';
+        } else {
+            out += in[i];
+        }
+    }
+    return out;
+}
+
+static std::vector<std::string> split_path(const std::string &path) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos < path.size()) {
+        size_t next = path.find('/', pos);
+        if (next == std::string::npos) next = path.size();
+        if (next > pos) parts.push_back(url_decode(path.substr(pos, next - pos)));
+        pos = next + 1;
+    }
+    // Accept both "/v0/inboxes" and "/inboxes"
+    if (!parts.empty() && parts[0] == "v0") {
+        parts.erase(parts.begin());
+    }
+    return parts;
+}
+
+static std::string json_string(const cJSON *obj, const char *key) {
+    const cJSON *item = cJSON_GetObjectItem(obj, key);
+    return cJSON_IsString(item) ? item->valuestring : "";
+}
+
+static MockResponse json_response(int status, cJSON *json) {
+    MockResponse res;
+    res.status = status;
+    char *text = cJSON_PrintUnformatted(json);
+    res.body = text ? text : "{}";
+    free(text);
+    cJSON_Delete(json);
+    return res;
+}
+
+static MockResponse error_response(int status, const char *name, const char *message) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "name", name);
+    cJSON_AddStringToObject(json, "message", message);
+    return json_response(status, json);
+}
+
+static cJSON *inbox_to_json(const MockInbox &inbox) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "inbox_id", inbox.inbox_id.c_str());
+    cJSON_AddStringToObject(json, "address", inbox.inbox_id.c_str());
+    cJSON_AddStringToObject(json, "name", inbox.name.c_str());
+    cJSON_AddStringToObject(json, "created_at", inbox.created_at.c_str());
+    if (!inbox.metadata.empty()) {
+        cJSON *metadata = cJSON_Parse(inbox.metadata.c_str());
+        if (metadata) cJSON_AddItemToObject(json, "metadata", metadata);
+    }
+    return json;
+}
+
+static cJSON *message_to_json(const MockMessage &msg) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "inbox_id", msg.to.c_str());
+    cJSON_AddStringToObject(json, "message_id", msg.message_id.c_str());
+    cJSON_AddStringToObject(json, "thread_id", msg.thread_id.c_str());
+    cJSON_AddStringToObject(json, "from", msg.from.c_str());
+    cJSON_AddStringToObject(json, "to", msg.to.c_str());
+    cJSON_AddStringToObject(json, "subject", msg.subject.c_str());
+    cJSON_AddStringToObject(json, "text", msg.text.c_str());
+    if (!msg.html.empty()) {
+        cJSON_AddStringToObject(json, "html", msg.html.c_str());
+    }
+    cJSON_AddStringToObject(json, "created_at", msg.created_at.c_str());
+    cJSON_AddBoolToObject(json, "is_read", msg.is_read);
+    if (!msg.attachments.empty()) {
+        cJSON *attachments = cJSON_CreateArray();
+        for (const MockAttachment &attachment : msg.attachments) {
+            cJSON *item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "attachment_id", attachment.attachment_id.c_str());
+            cJSON_AddStringToObject(item, "filename", attachment.filename.c_str());
+            cJSON_AddStringToObject(item, "content_type", attachment.content_type.c_str());
+            cJSON_AddNumberToObject(item, "size", (double)attachment.content.size());
+            cJSON_AddItemToArray(attachments, item);
+        }
+        cJSON_AddItemToObject(json, "attachments", attachments);
+    }
+    return json;
+}
+
+static MockInbox *find_inbox(agentmail_mock_server_t *server, const std::string &inbox_id) {
+    for (auto &inbox : server->inboxes) {
+        if (inbox.inbox_id == inbox_id) return &inbox;
+    }
+    return nullptr;
+}
+
+static MockMessage *find_message(MockInbox *inbox, const std::string &message_id) {
+    for (auto &msg : inbox->messages) {
+        if (msg.message_id == message_id) return &msg;
+    }
+    return nullptr;
+}
+
+static MockInbox &create_inbox(agentmail_mock_server_t *server, const std::string &inbox_id,
+                               const std::string &name) {
+    MockInbox inbox;
+    inbox.inbox_id = inbox_id.empty()
+        ? "mock" + std::to_string(server->next_id++) + "@agentmail.to"
+        : inbox_id;
+    inbox.name = name;
+    inbox.created_at = now_iso8601();
+    server->inboxes.push_back(inbox);
+    return server->inboxes.back();
+}
+
+static std::string sha1(const std::string &data) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string msg = data;
+    msg += (char)0x80;
+    while (msg.size() % 64 != 56) msg += (char)0;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    for (int shift = 56; shift >= 0; shift -= 8) msg += (char)(bits >> shift);
+
+    auto rol = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+    for (size_t off = 0; off < msg.size(); off += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char *p = (const unsigned char *)msg.data() + off + i * 4;
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    std::string out;
+    for (uint32_t v : h) {
+        for (int shift = 24; shift >= 0; shift -= 8) out += (char)(v >> shift);
+    }
+    return out;
+}
+
+static std::string base64(const std::string &in) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < in.size(); i += 3) {
+        uint32_t n = (uint32_t)(unsigned char)in[i] << 16;
+        if (i + 1 < in.size()) n |= (uint32_t)(unsigned char)in[i + 1] << 8;
+        if (i + 2 < in.size()) n |= (unsigned char)in[i + 2];
+        out += ALPHABET[(n >> 18) & 0x3F];
+        out += ALPHABET[(n >> 12) & 0x3F];
+        out += (i + 1 < in.size()) ? ALPHABET[(n >> 6) & 0x3F] : '=';
+        out += (i + 2 < in.size()) ? ALPHABET[n & 0x3F] : '=';
+    }
+    return out;
+}
+
+static std::string base64_decode(const std::string &in) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    uint32_t bits = 0;
+    int nbits = 0;
+    for (char c : in) {
+        const char *pos = c ? strchr(ALPHABET, c) : nullptr;
+        if (pos == nullptr) break;
+        bits = (bits << 6) | (uint32_t)(pos - ALPHABET);
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            out += (char)(bits >> nbits);
+        }
+    }
+    return out;
+}
+
+/**
+ * Quoted-printable encoding with soft line breaks at 76 columns
+ */
+static std::string quoted_printable(const std::string &in) {
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string out;
+    size_t column = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        unsigned char c = (unsigned char)in[i];
+        if (c == '\n') {
+            out += "\r\n";
+            column = 0;
+            continue;
+        }
+        if (c == '\r' && i + 1 < in.size() && in[i + 1] == '\n') {
+            continue;
+        }
+        bool trailing_space = (c == ' ' || c == '\t') && (i + 1 == in.size() || in[i + 1] == '\r' || in[i + 1] == '\n');
+        bool literal = c >= 32 && c < 127 && c != '=' && !trailing_space;
+        size_t width = literal ? 1 : 3;
+        if (column + width > 75) {
+            out += "=\r\n";
+            column = 0;
+        }
+        if (literal) {
+            out += (char)c;
+        } else {
+            out += '=';
+            out += HEX[c >> 4];
+            out += HEX[c & 0x0F];
+        }
+        column += width;
+    }
+    return out;
+}
+
+/**
+ * RFC 5322 rendering of a message: a single text part, or multipart with
+ * quoted-printable text/HTML alternatives and base64 attachments
+ */
+static std::string raw_message(const MockMessage &msg) {
+    std::string raw;
+    raw += "From: " + msg.from + "\r\n";
+    raw += "To: " + msg.to + "\r\n";
+    raw += "Subject: " + msg.subject + "\r\n";
+    raw += "Date: " + msg.created_at + "\r\n";
+    raw += "Message-ID: <" + msg.message_id + ">\r\n";
+    raw += "MIME-Version: 1.0\r\n";
+    if (msg.html.empty() && msg.attachments.empty()) {
+        raw += "Content-Type: text/plain; charset=utf-8\r\n";
+        raw += "\r\n";
+        raw += msg.text;
+        return raw;
+    }
+
+    std::string mixed = "mixed_" + msg.message_id;
+    std::string alternative = "alt_" + msg.message_id;
+    if (!msg.attachments.empty()) {
+        raw += "Content-Type: multipart/mixed; boundary=\"" + mixed + "\"\r\n\r\n";
+        raw += "--" + mixed + "\r\n";
+    }
+    if (!msg.html.empty()) {
+        raw += "Content-Type: multipart/alternative; boundary=\"" + alternative + "\"\r\n\r\n";
+        raw += "--" + alternative + "\r\n";
+    }
+    raw += "Content-Type: text/plain; charset=utf-8\r\n";
+    raw += "Content-Transfer-Encoding: quoted-printable\r\n\r\n";
+    raw += quoted_printable(msg.text) + "\r\n";
+    if (!msg.html.empty()) {
+        raw += "--" + alternative + "\r\n";
+        raw += "Content-Type: text/html; charset=utf-8\r\n";
+        raw += "Content-Transfer-Encoding: quoted-printable\r\n\r\n";
+        raw += quoted_printable(msg.html) + "\r\n";
+        raw += "--" + alternative + "--\r\n";
+    }
+    for (const MockAttachment &attachment : msg.attachments) {
+        raw += "--" + mixed + "\r\n";
+        std::string content_type = attachment.content_type.empty() ? "application/octet-stream"
+                                                                   : attachment.content_type;
+        raw += "Content-Type: " + content_type + "; name=\"" + attachment.filename + "\"\r\n";
+        raw += "Content-Disposition: attachment; filename=\"" + attachment.filename + "\"\r\n";
+        raw += "Content-Transfer-Encoding: base64\r\n\r\n";
+        std::string encoded = base64(attachment.content);
+        for (size_t i = 0; i < encoded.size(); i += 76) {
+            raw += encoded.substr(i, 76) + "\r\n";
+        }
+    }
+    if (!msg.attachments.empty()) {
+        raw += "--" + mixed + "--\r\n";
+    }
+    return raw;
+}
+
+/**
+ * Attachments of a send or reply request ({filename, content_type, content})
+ */
+static std::vector<MockAttachment> json_attachments(agentmail_mock_server_t *server, const cJSON *body) {
+    std::vector<MockAttachment> attachments;
+    const cJSON *item = nullptr;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(body, "attachments")) {
+        MockAttachment attachment;
+        attachment.attachment_id = "att_" + std::to_string(server->next_id++);
+        attachment.filename = json_string(item, "filename");
+        attachment.content_type = json_string(item, "content_type");
+        attachment.content = base64_decode(json_string(item, "content"));
+        attachments.push_back(attachment);
+    }
+    return attachments;
+}
+
+static bool send_all(int fd, const std::string &data);
+
+/**
+ * Send one unmasked (server) WebSocket frame
+ */
+static bool ws_send(MockSubscriber &sub, uint8_t opcode, const std::string &payload) {
+    std::string frame;
+    frame += (char)(0x80 | opcode);
+    if (payload.size() <= 125) {
+        frame += (char)payload.size();
+    } else if (payload.size() <= 65535) {
+        frame += (char)126;
+        frame += (char)(payload.size() >> 8);
+        frame += (char)payload.size();
+    } else {
+        frame += (char)127;
+        for (int shift = 56; shift >= 0; shift -= 8) frame += (char)((uint64_t)payload.size() >> shift);
+    }
+    frame += payload;
+    std::lock_guard<std::mutex> lock(sub.write_mutex);
+    return send_all(sub.fd, frame);
+}
+
+static std::string event_json(const MockMessage &msg) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "type", "event");
+    cJSON_AddStringToObject(json, "event_type", "message.received");
+    cJSON_AddStringToObject(json, "event_id", ("evt_" + msg.message_id).c_str());
+    cJSON_AddItemToObject(json, "message", message_to_json(msg));
+    char *text = cJSON_PrintUnformatted(json);
+    std::string event = text ? text : "";
+    free(text);
+    cJSON_Delete(json);
+    return event;
+}
+
+/**
+ * Push a message.received event to the subscribers of its inbox and queue
+ * it for every webhook
+ */
+static void publish(agentmail_mock_server_t *server, const MockMessage &msg) {
+    std::string event;
+    for (auto &sub : server->subscribers) {
+        if (std::find(sub->inbox_ids.begin(), sub->inbox_ids.end(), msg.to) == sub->inbox_ids.end()) {
+            continue;
+        }
+        if (event.empty()) {
+            event = event_json(msg);
+        }
+        if (ws_send(*sub, 0x1, event)) {
+            server->stats.events_sent++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(server->webhook_mutex);
+    for (const auto &target : server->webhooks) {
+        if (event.empty()) {
+            event = event_json(msg);
+        }
+        server->webhook_jobs.push_back({target, "msg_wh_" + std::to_string(server->next_id++), event});
+    }
+    server->webhook_ready.notify_one();
+}
+
+/**
+ * Store a message in the recipient inbox (if it is one of ours)
+ */
+static MockMessage deliver(agentmail_mock_server_t *server, MockMessage msg) {
+    msg.message_id = "msg_" + std::to_string(server->next_id++);
+    if (msg.thread_id.empty()) {
+        msg.thread_id = "thread-" + std::to_string(server->next_id++);
+    }
+    msg.created_at = now_iso8601();
+    MockInbox *inbox = find_inbox(server, msg.to);
+    if (inbox != nullptr) {
+        inbox->messages.insert(inbox->messages.begin(), msg);
+        publish(server, msg);
+    }
+    return msg;
+}
+
+// ============================================================================
+// Routing
+// ============================================================================
+
+static MockResponse handle_inboxes(agentmail_mock_server_t *server, const MockRequest &req,
+                                   const std::vector<std::string> &parts) {
+    // /inboxes
+    if (parts.size() == 1) {
+        if (req.method == "POST") {
+            cJSON *body = cJSON_Parse(req.body.empty() ? "{}" : req.body.c_str());
+            std::string name = body ? json_string(body, "name") : "";
+            MockInbox &inbox = create_inbox(server, "", name);
+            cJSON *metadata = body ? cJSON_GetObjectItem(body, "metadata") : nullptr;
+            if (metadata) {
+                char *text = cJSON_PrintUnformatted(metadata);
+                if (text) inbox.metadata = text;
+                free(text);
+            }
+            cJSON_Delete(body);
+            return json_response(200, inbox_to_json(inbox));
+        }
+        if (req.method == "GET") {
+            size_t limit = req.query.count("limit") ? strtoul(req.query.at("limit").c_str(), NULL, 10) : 20;
+            size_t start = req.query.count("cursor") ? strtoul(req.query.at("cursor").c_str(), NULL, 10) : 0;
+            cJSON *json = cJSON_CreateObject();
+            cJSON *array = cJSON_CreateArray();
+            size_t i = start;
+            for (; i < server->inboxes.size() && i - start < limit; i++) {
+                cJSON_AddItemToArray(array, inbox_to_json(server->inboxes[i]));
+            }
+            cJSON_AddNumberToObject(json, "count", (double)server->inboxes.size());
+            cJSON_AddItemToObject(json, "inboxes", array);
+            if (i < server->inboxes.size()) {
+                cJSON_AddStringToObject(json, "next_page_token", std::to_string(i).c_str());
+            }
+            return json_response(200, json);
+        }
+        return error_response(405, "MethodNotAllowed", "Method not allowed");
+    }
+
+    MockInbox *inbox = find_inbox(server, parts[1]);
+    if (inbox == nullptr) {
+        return error_response(404, "NotFoundError", "Inbox not found");
+    }
+
+    // /inboxes/{inbox_id}
+    if (parts.size() == 2) {
+        if (req.method == "GET") {
+            return json_response(200, inbox_to_json(*inbox));
+        }
+        if (req.method == "PATCH") {
+            cJSON *body = cJSON_Parse(req.body.c_str());
+            if (body == nullptr) return error_response(400, "ValidationError", "Invalid JSON");
+            if (cJSON_IsString(cJSON_GetObjectItem(body, "name"))) {
+                inbox->name = json_string(body, "name");
+            }
+            cJSON *metadata = cJSON_GetObjectItem(body, "metadata");
+            if (metadata) {
+                char *text = cJSON_PrintUnformatted(metadata);
+                if (text) inbox->metadata = text;
+                free(text);
+            }
+            cJSON_Delete(body);
+            return json_response(200, inbox_to_json(*inbox));
+        }
+        if (req.method == "DELETE") {
+            server->inboxes.erase(server->inboxes.begin() + (inbox - server->inboxes.data()));
+            return json_response(200, cJSON_CreateObject());
+        }
+        return error_response(405, "MethodNotAllowed", "Method not allowed");
+    }
+
+    if (parts[2] != "messages") {
+        return error_response(404, "NotFoundError", "Not found");
+    }
+
+    // /inboxes/{inbox_id}/messages
+    if (parts.size() == 3 && req.method == "GET") {
+        size_t limit = req.query.count("limit") ? strtoul(req.query.at("limit").c_str(), NULL, 10) : 20;
+        size_t start = req.query.count("cursor") ? strtoul(req.query.at("cursor").c_str(), NULL, 10) : 0;
+        bool unread_only = req.query.count("unread") && req.query.at("unread") == "true";
+        std::string thread_id = req.query.count("thread_id") ? req.query.at("thread_id") : "";
+
+        std::vector<const MockMessage *> matches;
+        for (const auto &msg : inbox->messages) {
+            if (unread_only && msg.is_read) continue;
+            if (!thread_id.empty() && msg.thread_id != thread_id) continue;
+            matches.push_back(&msg);
+        }
+
+        cJSON *json = cJSON_CreateObject();
+        cJSON *array = cJSON_CreateArray();
+        size_t i = start;
+        for (; i < matches.size() && i - start < limit; i++) {
+            cJSON_AddItemToArray(array, message_to_json(*matches[i]));
+        }
+        cJSON_AddNumberToObject(json, "count", (double)matches.size());
+        cJSON_AddItemToObject(json, "messages", array);
+        if (i < matches.size()) {
+            cJSON_AddStringToObject(json, "next_page_token", std::to_string(i).c_str());
+        }
+        MockResponse res = json_response(200, json);
+
+        // Strong validator over the page contents
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : res.body) {
+            hash = (hash ^ c) * 16777619u;
+        }
+        char etag[16];
+        snprintf(etag, sizeof(etag), "\"%08x\"", hash);
+        auto match = req.headers.find("if-none-match");
+        if (match != req.headers.end() && match->second == etag) {
+            res.status = 304;
+            res.body.clear();
+            server->stats.not_modified++;
+        }
+        res.extra_headers = std::string("ETag: ") + etag + "\r\n";
+        return res;
+    }
+
+    // /inboxes/{inbox_id}/messages/send
+    if (parts.size() == 4 && parts[3] == "send" && req.method == "POST") {
+        cJSON *body = cJSON_Parse(req.body.c_str());
+        if (body == nullptr) return error_response(400, "ValidationError", "Invalid JSON");
+        MockMessage msg;
+        msg.from = inbox->inbox_id;
+        msg.to = json_string(body, "to");
+        msg.subject = json_string(body, "subject");
+        msg.text = json_string(body, "body_text");
+        if (msg.text.empty()) msg.text = json_string(body, "text");
+        msg.html = json_string(body, "body_html");
+        if (msg.html.empty()) msg.html = json_string(body, "html");
+        msg.thread_id = json_string(body, "thread_id");
+        msg.attachments = json_attachments(server, body);
+        cJSON_Delete(body);
+        if (msg.to.empty()) return error_response(400, "ValidationError", "to is required");
+
+        msg = deliver(server, msg);
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "message_id", msg.message_id.c_str());
+        cJSON_AddStringToObject(json, "thread_id", msg.thread_id.c_str());
+        return json_response(200, json);
+    }
+
+    if (parts.size() < 4) {
+        return error_response(404, "NotFoundError", "Not found");
+    }
+    MockMessage *msg = find_message(inbox, parts[3]);
+    if (msg == nullptr) {
+        return error_response(404, "NotFoundError", "Message not found");
+    }
+
+    // /inboxes/{inbox_id}/messages/{message_id}
+    if (parts.size() == 4) {
+        if (req.method == "GET") {
+            return json_response(200, message_to_json(*msg));
+        }
+        if (req.method == "PATCH") {
+            cJSON *body = cJSON_Parse(req.body.c_str());
+            if (body == nullptr) return error_response(400, "ValidationError", "Invalid JSON");
+            cJSON *is_read = cJSON_GetObjectItem(body, "is_read");
+            if (cJSON_IsBool(is_read)) msg->is_read = cJSON_IsTrue(is_read);
+            cJSON_Delete(body);
+            return json_response(200, message_to_json(*msg));
+        }
+        if (req.method == "DELETE") {
+            inbox->messages.erase(inbox->messages.begin() + (msg - inbox->messages.data()));
+            return json_response(200, cJSON_CreateObject());
+        }
+        return error_response(405, "MethodNotAllowed", "Method not allowed");
+    }
+
+    // /inboxes/{inbox_id}/messages/{message_id}/raw
+    if (parts.size() == 5 && parts[4] == "raw" && req.method == "GET") {
+        MockResponse res;
+        res.content_type = "message/rfc822";
+        res.body = raw_message(*msg);
+        return res;
+    }
+
+    // /inboxes/{inbox_id}/messages/{message_id}/attachments/{attachment_id}
+    if (parts.size() == 6 && parts[4] == "attachments" && req.method == "GET") {
+        const MockAttachment *attachment = nullptr;
+        for (const MockAttachment &a : msg->attachments) {
+            if (a.attachment_id == parts[5]) attachment = &a;
+        }
+        if (attachment == nullptr) {
+            return error_response(404, "NotFoundError", "Attachment not found");
+        }
+        MockResponse res;
+        res.content_type = attachment->content_type.empty() ? "application/octet-stream"
+                                                            : attachment->content_type;
+        size_t total = attachment->content.size();
+        auto range = req.headers.find("range");
+        unsigned long long first = 0, last = 0;
+        int fields = (range != req.headers.end())
+            ? sscanf(range->second.c_str(), "bytes=%llu-%llu", &first, &last) : 0;
+        if (fields < 1) {
+            res.body = attachment->content;
+            return res;
+        }
+        if (first >= total) {
+            res.status = 416;
+            res.extra_headers = "Content-Range: bytes */" + std::to_string(total) + "\r\n";
+            return res;
+        }
+        if (fields < 2 || last >= total) last = total - 1;
+        res.status = 206;
+        res.body = attachment->content.substr(first, last - first + 1);
+        res.extra_headers = "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) +
+                            "/" + std::to_string(total) + "\r\n";
+        server->stats.partial_responses++;
+        return res;
+    }
+
+    // /inboxes/{inbox_id}/messages/{message_id}/reply
+    if (parts.size() == 5 && parts[4] == "reply" && req.method == "POST") {
+        cJSON *body = cJSON_Parse(req.body.c_str());
+        if (body == nullptr) return error_response(400, "ValidationError", "Invalid JSON");
+        MockMessage reply;
+        reply.from = inbox->inbox_id;
+        reply.to = json_string(body, "to");
+        if (reply.to.empty()) reply.to = msg->from;
+        reply.subject = json_string(body, "subject");
+        if (reply.subject.empty()) reply.subject = "Re: " + msg->subject;
+        reply.text = json_string(body, "text");
+        reply.html = json_string(body, "html");
+        reply.thread_id = msg->thread_id;
+        reply.attachments = json_attachments(server, body);
+        cJSON_Delete(body);
+
+        reply = deliver(server, reply);
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "message_id", reply.message_id.c_str());
+        cJSON_AddStringToObject(json, "thread_id", reply.thread_id.c_str());
+        return json_response(200, json);
+    }
+
+    return error_response(404, "NotFoundError", "Not found");
+}
+
+static MockResponse route(agentmail_mock_server_t *server, const MockRequest &req) {
+    auto auth = req.headers.find("authorization");
+    if (auth == req.headers.end() || auth->second.compare(0, 7, "Bearer ") != 0) {
+        return error_response(401, "UnauthorizedError", "Missing API key");
+    }
+
+    std::vector<std::string> parts = split_path(req.path);
+    if (parts.empty() || parts[0] != "inboxes") {
+        return error_response(404, "NotFoundError", "Not found");
+    }
+
+    std::lock_guard<std::mutex> lock(server->mutex);
+    return handle_inboxes(server, req, parts);
+}
+
+// ============================================================================
+// HTTP Server
+// ============================================================================
+
+/**
+ * Buffered reader over a connected socket
+ */
+struct MockReader {
+    int fd;
+    char buf[4096];
+    size_t pos = 0;
+    size_t len = 0;
+
+    bool fill() {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        pos = 0;
+        len = n;
+        return true;
+    }
+
+    bool read_line(std::string &line) {
+        line.clear();
+        while (true) {
+            if (pos == len && !fill()) return false;
+            char c = buf[pos++];
+            if (c == '\n') {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                return true;
+            }
+            line += c;
+        }
+    }
+
+    bool read_bytes(std::string &out, size_t n) {
+        out.clear();
+        out.reserve(n);
+        while (out.size() < n) {
+            if (pos == len && !fill()) return false;
+            size_t take = std::min(n - out.size(), len - pos);
+            out.append(buf + pos, take);
+            pos += take;
+        }
+        return true;
+    }
+};
+
+static bool read_request(MockReader &reader, MockRequest &req) {
+    std::string line;
+    if (!reader.read_line(line) || line.empty()) return false;
+
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) return false;
+    req.method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    size_t qmark = target.find('?');
+    req.path = target.substr(0, qmark);
+    if (qmark != std::string::npos) {
+        std::string query = target.substr(qmark + 1);
+        size_t pos = 0;
+        while (pos <= query.size()) {
+            size_t amp = query.find('&', pos);
+            if (amp == std::string::npos) amp = query.size();
+            std::string pair = query.substr(pos, amp - pos);
+            size_t eq = pair.find('=');
+            if (!pair.empty()) {
+                req.query[url_decode(pair.substr(0, eq))] =
+                    eq == std::string::npos ? "" : url_decode(pair.substr(eq + 1));
+            }
+            pos = amp + 1;
+        }
+    }
+
+    while (reader.read_line(line) && !line.empty()) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        for (auto &c : name) c = (char)tolower((unsigned char)c);
+        size_t vstart = line.find_first_not_of(" \t", colon + 1);
+        req.headers[name] = vstart == std::string::npos ? "" : line.substr(vstart);
+    }
+
+    size_t content_length = 0;
+    auto it = req.headers.find("content-length");
+    if (it != req.headers.end()) content_length = strtoul(it->second.c_str(), NULL, 10);
+    return reader.read_bytes(req.body, content_length);
+}
+
+static bool send_all(int fd, const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+    }
+}
+
+/**
+ * Read one client frame (always masked); fragments are not supported
+ */
+static bool ws_read(MockReader &reader, uint8_t &opcode, std::string &payload) {
+    std::string head;
+    if (!reader.read_bytes(head, 2)) return false;
+    opcode = head[0] & 0x0F;
+    uint64_t len = head[1] & 0x7F;
+    if (len >= 126) {
+        std::string ext;
+        if (!reader.read_bytes(ext, len == 126 ? 2 : 8)) return false;
+        len = 0;
+        for (unsigned char c : ext) len = (len << 8) | c;
+    }
+    std::string mask;
+    if ((head[1] & 0x80) && !reader.read_bytes(mask, 4)) return false;
+    if (!reader.read_bytes(payload, len)) return false;
+    for (size_t i = 0; i < payload.size() && !mask.empty(); i++) payload[i] ^= mask[i % 4];
+    return true;
+}
+
+/**
+ * Event endpoint: complete the upgrade, then serve subscribe requests and
+ * pings until the client goes away
+ */
+static void serve_websocket(agentmail_mock_server_t *server, MockReader &reader, const MockRequest &req) {
+    auto auth = req.headers.find("authorization");
+    auto key = req.headers.find("sec-websocket-key");
+    if (auth == req.headers.end() || auth->second.compare(0, 7, "Bearer ") != 0 ||
+        key == req.headers.end()) {
+        send_all(reader.fd, "HTTP/1.1 401 Unauthorized\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return;
+    }
+    std::string accept = base64(sha1(key->second + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+    if (!send_all(reader.fd, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                             "Connection: Upgrade\r\nSec-WebSocket-Accept: " + accept + "\r\n\r\n")) {
+        return;
+    }
+
+    auto sub = std::make_shared<MockSubscriber>();
+    sub->fd = reader.fd;
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        server->subscribers.push_back(sub);
+        server->stats.ws_connections++;
+    }
+
+    uint8_t opcode = 0;
+    std::string payload;
+    while (server->running && ws_read(reader, opcode, payload)) {
+        if (opcode == 0x8) {
+            ws_send(*sub, 0x8, payload.substr(0, 2));
+            break;
+        } else if (opcode == 0x9) {
+            ws_send(*sub, 0xA, payload);
+        } else if (opcode == 0x1) {
+            cJSON *json = cJSON_Parse(payload.c_str());
+            if (json != nullptr && json_string(json, "type") == "subscribe") {
+                std::vector<std::string> inbox_ids;
+                cJSON *item = nullptr;
+                cJSON_ArrayForEach(item, cJSON_GetObjectItem(json, "inbox_ids")) {
+                    if (cJSON_IsString(item)) inbox_ids.push_back(item->valuestring);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(server->mutex);
+                    sub->inbox_ids = inbox_ids;
+                }
+                cJSON *reply = cJSON_CreateObject();
+                cJSON *array = cJSON_CreateArray();
+                for (const auto &inbox_id : inbox_ids) {
+                    cJSON_AddItemToArray(array, cJSON_CreateString(inbox_id.c_str()));
+                }
+                cJSON_AddStringToObject(reply, "type", "subscribed");
+                cJSON_AddItemToObject(reply, "inbox_ids", array);
+                char *text = cJSON_PrintUnformatted(reply);
+                ws_send(*sub, 0x1, text ? text : "");
+                free(text);
+                cJSON_Delete(reply);
+            }
+            cJSON_Delete(json);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(server->mutex);
+    server->subscribers.erase(std::find(server->subscribers.begin(), server->subscribers.end(), sub));
+}
+
+static void serve_connection(agentmail_mock_server_t *server, int fd) {
+    MockReader reader;
+    reader.fd = fd;
+
+    while (server->running) {
+        MockRequest req;
+        if (!read_request(reader, req)) break;
+
+        auto upgrade = req.headers.find("upgrade");
+        if (upgrade != req.headers.end() && strcasecmp(upgrade->second.c_str(), "websocket") == 0) {
+            serve_websocket(server, reader, req);
+            break;
+        }
+
+        // Injected failures reject the request before it is processed
+        MockResponse res;
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            server->stats.requests++;
+            if (server->fail_count > 0) {
+                server->fail_count--;
+                failed = true;
+                res.status = server->fail_status;
+                res.body = "{\"error\":\"injected failure\"}";
+                if (server->fail_retry_after >= 0) {
+                    res.extra_headers = "Retry-After: " + std::to_string(server->fail_retry_after) + "\r\n";
+                }
+            }
+        }
+        if (!failed) {
+            res = route(server, req);
+        }
+
+        auto conn = req.headers.find("connection");
+        bool close_after = conn != req.headers.end() && strcasecmp(conn->second.c_str(), "close") == 0;
+
+        size_t chunk_size = (res.status == 304) ? 0 : server->chunk_size.load(); // 304 has no body
+        std::string head = "HTTP/1.1 " + std::to_string(res.status) + " " + status_text(res.status) + "\r\n";
+        head += "Content-Type: " + res.content_type + "\r\n";
+        head += res.extra_headers;
+        if (chunk_size > 0) {
+            head += "Transfer-Encoding: chunked\r\n";
+        } else {
+            head += "Content-Length: " + std::to_string(res.body.size()) + "\r\n";
+        }
+        head += close_after ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+        head += "\r\n";
+
+        std::string out = head;
+        if (chunk_size > 0) {
+            char size_line[24];
+            for (size_t pos = 0; pos < res.body.size(); pos += chunk_size) {
+                size_t n = std::min(chunk_size, res.body.size() - pos);
+                snprintf(size_line, sizeof(size_line), "%zx\r\n", n);
+                out += size_line;
+                out.append(res.body, pos, n);
+                out += "\r\n";
+            }
+            out += "0\r\n\r\n";
+        } else {
+            out += res.body;
+        }
+
+        // Injected cut: part of the body, then the connection drops
+        bool cut = false;
+        if (res.status >= 200 && res.status < 300) {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            if (server->cut_count > 0 && out.size() > head.size() + server->cut_after) {
+                server->cut_count--;
+                out.resize(head.size() + server->cut_after);
+                cut = true;
+            }
+        }
+        if (!send_all(fd, out) || close_after || cut) break;
+    }
+
+    std::lock_guard<std::mutex> lock(server->conn_mutex);
+    server->conn_fds.erase(std::find(server->conn_fds.begin(), server->conn_fds.end(), fd));
+    close(fd);
+    server->conn_done.notify_all();
+}
+
+static void accept_loop(agentmail_mock_server_t *server) {
+    while (server->running) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (!server->running) break;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            server->stats.connections++;
+        }
+        std::lock_guard<std::mutex> lock(server->conn_mutex);
+        server->conn_fds.push_back(fd);
+        std::thread(serve_connection, server, fd).detach();
+    }
+}
+
+// ============================================================================
+// Webhook Sender
+// ============================================================================
+
+/**
+ * POST one webhook, signed the way AgentMail (Svix) signs them
+ *
+ * @return The response status, or 0 if the receiver could not be reached
+ */
+static int post_webhook(const MockWebhookJob &job) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(job.target.host.c_str(), job.target.port.c_str(), &hints, &res) != 0) {
+        return 0;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    bool connected = fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!connected) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    std::string timestamp = std::to_string((long long)time(NULL));
+    std::string request = "POST " + job.target.path + " HTTP/1.1\r\nHost: " + job.target.host +
+                          "\r\nContent-Type: application/json\r\nContent-Length: " +
+                          std::to_string(job.payload.size()) + "\r\nConnection: close\r\n" +
+                          "svix-id: " + job.id + "\r\nsvix-timestamp: " + timestamp + "\r\n";
+    if (!job.target.key.empty()) {
+        std::string signed_content = job.id + "." + timestamp + "." + job.payload;
+        const void *parts[] = { signed_content.data() };
+        size_t part_lens[] = { signed_content.size() };
+        uint8_t mac[AGENTMAIL_HMAC_SHA256_LEN];
+        agentmail_hmac_sha256((const uint8_t *)job.target.key.data(), job.target.key.size(),
+                              parts, part_lens, 1, mac);
+        request += "svix-signature: v1," + base64(std::string((const char *)mac, sizeof(mac))) + "\r\n";
+    }
+    request += "\r\n" + job.payload;
+
+    int status = 0;
+    MockReader reader;
+    reader.fd = fd;
+    std::string line;
+    if (send_all(fd, request) && reader.read_line(line) && line.size() > 12) {
+        status = atoi(line.c_str() + 9); // "HTTP/1.1 200 OK"
+    }
+    close(fd);
+    return status;
+}
+
+static void webhook_loop(agentmail_mock_server_t *server) {
+    std::unique_lock<std::mutex> lock(server->webhook_mutex);
+    while (true) {
+        server->webhook_ready.wait(lock, [server] {
+            return server->webhook_stop || !server->webhook_jobs.empty();
+        });
+        if (server->webhook_jobs.empty()) break;
+        MockWebhookJob job = server->webhook_jobs.front();
+        server->webhook_jobs.pop_front();
+        lock.unlock();
+
+        int status = post_webhook(job);
+        {
+            std::lock_guard<std::mutex> stats_lock(server->mutex);
+            if (status >= 200 && status < 300) {
+                server->stats.webhooks_sent++;
+            } else {
+                server->stats.webhooks_failed++;
+            }
+        }
+        lock.lock();
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+agentmail_err_t agentmail_mock_server_start(uint16_t port, agentmail_mock_server_t **out) {
+    if (out == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return AGENTMAIL_ERR_NETWORK;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %u", port);
+        close(fd);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    agentmail_mock_server_t *server = new agentmail_mock_server_t();
+    server->listen_fd = fd;
+    server->port = ntohs(addr.sin_port);
+    server->running = true;
+    server->accept_thread = std::thread(accept_loop, server);
+
+    ESP_LOGI(TAG, "Mock AgentMail server listening on http://127.0.0.1:%u", server->port);
+    *out = server;
+    return AGENTMAIL_ERR_NONE;
+}
+
+uint16_t agentmail_mock_server_port(const agentmail_mock_server_t *server) {
+    return server ? server->port : 0;
+}
+
+agentmail_err_t agentmail_mock_server_deliver(
+    agentmail_mock_server_t *server,
+    const char *inbox_id,
+    const char *from,
+    const char *subject,
+    const char *text,
+    char **message_id
+) {
+    if (server == NULL || inbox_id == NULL || from == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    std::lock_guard<std::mutex> lock(server->mutex);
+    if (find_inbox(server, inbox_id) == nullptr) {
+        create_inbox(server, inbox_id, "");
+    }
+
+    MockMessage msg;
+    msg.from = from;
+    msg.to = inbox_id;
+    msg.subject = subject ? subject : "";
+    msg.text = text ? text : "";
+    msg = deliver(server, msg);
+
+    if (message_id != NULL) {
+        *message_id = strdup(msg.message_id.c_str());
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+void agentmail_mock_server_set_chunked(agentmail_mock_server_t *server, size_t chunk_size) {
+    if (server == NULL) return;
+    server->chunk_size = chunk_size;
+}
+
+void agentmail_mock_server_fail_next(agentmail_mock_server_t *server, uint32_t count, int status,
+                                     int retry_after_s) {
+    if (server == NULL) return;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    server->fail_count = count;
+    server->fail_status = status;
+    server->fail_retry_after = retry_after_s;
+}
+
+void agentmail_mock_server_cut_next(agentmail_mock_server_t *server, uint32_t count, size_t after_bytes) {
+    if (server == NULL) return;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    server->cut_count = count;
+    server->cut_after = after_bytes;
+}
+
+void agentmail_mock_server_drop_subscribers(agentmail_mock_server_t *server) {
+    if (server == NULL) return;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    for (auto &sub : server->subscribers) {
+        shutdown(sub->fd, SHUT_RDWR);
+    }
+}
+
+agentmail_err_t agentmail_mock_server_add_webhook(agentmail_mock_server_t *server, const char *url,
+                                                 const char *secret) {
+    if (server == NULL || url == NULL || strncmp(url, "http://", 7) != 0) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    // http://host[:port][/path]
+    std::string rest = url + 7;
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    MockWebhook target;
+    target.path = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = authority.find(':');
+    target.host = authority.substr(0, colon);
+    target.port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+    if (secret != NULL) {
+        std::string encoded = secret;
+        if (encoded.compare(0, 6, "whsec_") == 0) encoded.erase(0, 6);
+        target.key = base64_decode(encoded);
+    }
+
+    std::lock_guard<std::mutex> lock(server->webhook_mutex);
+    server->webhooks.push_back(target);
+    if (!server->webhook_thread.joinable()) {
+        server->webhook_thread = std::thread(webhook_loop, server);
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+void agentmail_mock_server_get_stats(agentmail_mock_server_t *server, agentmail_mock_stats_t *stats) {
+    if (server == NULL || stats == NULL) return;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    *stats = server->stats;
+}
+
+void agentmail_mock_server_stop(agentmail_mock_server_t *server) {
+    if (server == NULL) return;
+
+    server->running = false;
+    shutdown(server->listen_fd, SHUT_RDWR);
+    close(server->listen_fd);
+    server->accept_thread.join();
+
+    // Wake connection threads blocked in recv() and wait for them to exit
+    std::unique_lock<std::mutex> lock(server->conn_mutex);
+    for (int fd : server->conn_fds) {
+        shutdown(fd, SHUT_RDWR);
+    }
+    server->conn_done.wait(lock, [server] { return server->conn_fds.empty(); });
+    lock.unlock();
+
+    // Queued webhooks are still sent
+    {
+        std::lock_guard<std::mutex> webhook_lock(server->webhook_mutex);
+        server->webhook_stop = true;
+        server->webhook_ready.notify_one();
+    }
+    if (server->webhook_thread.joinable()) {
+        server->webhook_thread.join();
+    }
+
+    delete server;
+}
+
+#ifdef AGENTMAIL_MOCK_SERVER_MAIN
+int main(int argc, char **argv) {
+    uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : 8080;
+    agentmail_mock_server_t *server = NULL;
+    if (agentmail_mock_server_start(port, &server) != AGENTMAIL_ERR_NONE) {
+        return 1;
+    }
+    while (true) {
+        pause();
+    }
+    return 0;
+}
+#endif
+
+#endif // !ESP_PLATFORM
@@ -0,0 +1,171 @@
+#ifndef AGENTMAIL_MOCK_SERVER_H
+#define AGENTMAIL_MOCK_SERVER_H
+
+/**
+ * @file agentmail_mock_server.h
+ * @brief Local AgentMail API stand-in for Linux host builds
+ *
+ * Serves the v0 REST endpoints used by agentmail.h (inboxes, messages,
+ * send, reply, raw, attachments with Range support) from memory over
+ * plain HTTP/1.1 with keep-alive, so the client can be exercised and
+ * load-tested without network access.
+ * A WebSocket upgrade on any path (e.g. "ws://127.0.0.1:<port>/v0") is
+ * served as the event endpoint used by agentmail_subscribe(), and
+ * webhook URLs registered with agentmail_mock_server_add_webhook() get a
+ * signed POST for every delivered message, as agentmail_webhook_start()
+ * expects.
+ *
+ * Example:
+ * @code
+ * agentmail_mock_server_t *server = NULL;
+ * agentmail_mock_server_start(0, &server);
+ *
+ * char base_url[64];
+ * snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%u/v0",
+ *          agentmail_mock_server_port(server));
+ * agentmail_config_t config = {
+ *     .api_key = "test",
+ *     .base_url = base_url,
+ * };
+ * // ... agentmail_init(&config, &client) and use the API as usual
+ *
+ * agentmail_mock_server_stop(server);
+ * @endcode
+ */
+
+#include "agentmail_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque mock server instance
+ */
+typedef struct agentmail_mock_server agentmail_mock_server_t;
+
+/**
+ * @brief Mock server counters
+ */
+typedef struct {
+    uint32_t connections;         ///< TCP connections accepted
+    uint32_t requests;            ///< HTTP requests served
+    uint32_t not_modified;        ///< Message list requests answered 304 (If-None-Match matched)
+    uint32_t ws_connections;      ///< WebSocket upgrades accepted
+    uint32_t events_sent;         ///< message.received events pushed to subscribers
+    uint32_t webhooks_sent;       ///< Webhook POSTs answered with a 2xx
+    uint32_t webhooks_failed;     ///< Webhook POSTs refused or unreachable (not retried)
+    uint32_t partial_responses;   ///< Range requests answered 206
+} agentmail_mock_stats_t;
+
+/**
+ * @brief Start the mock server on 127.0.0.1
+ *
+ * @param[in] port TCP port (0 picks a free port)
+ * @param[out] server Output server instance
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ *
+ * @note The server accepts any "Bearer" API key and serves paths with or
+ *       without a "/v0" prefix
+ */
+agentmail_err_t agentmail_mock_server_start(uint16_t port, agentmail_mock_server_t **server);
+
+/**
+ * @brief Get the port the server is listening on
+ */
+uint16_t agentmail_mock_server_port(const agentmail_mock_server_t *server);
+
+/**
+ * @brief Simulate an inbound email to one of the mock inboxes
+ *
+ * @param[in] server Server instance
+ * @param[in] inbox_id Recipient inbox ID (created if it doesn't exist)
+ * @param[in] from Sender address
+ * @param[in] subject Subject
+ * @param[in] text Plain text body
+ * @param[out] message_id Output message ID (optional, caller must free())
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_mock_server_deliver(
+    agentmail_mock_server_t *server,
+    const char *inbox_id,
+    const char *from,
+    const char *subject,
+    const char *text,
+    char **message_id
+);
+
+/**
+ * @brief Serve response bodies with Transfer-Encoding: chunked
+ *
+ * @param[in] server Server instance
+ * @param[in] chunk_size Bytes per chunk (0 restores Content-Length responses)
+ */
+void agentmail_mock_server_set_chunked(agentmail_mock_server_t *server, size_t chunk_size);
+
+/**
+ * @brief Reject the next requests with an error status
+ *
+ * Simulates transient failures such as rate limiting or an overloaded
+ * server. The rejected requests are not processed.
+ *
+ * @param[in] server Server instance
+ * @param[in] count Number of requests to reject
+ * @param[in] status HTTP status to return (e.g. 429 or 503)
+ * @param[in] retry_after_s Retry-After value in seconds (-1 to omit the header)
+ */
+void agentmail_mock_server_fail_next(agentmail_mock_server_t *server, uint32_t count, int status,
+                                     int retry_after_s);
+
+/**
+ * @brief Cut the next successful responses off mid-body
+ *
+ * Simulates a connection dropping during a download: after after_bytes
+ * body bytes the connection is closed. Bodies no longer than that are
+ * served normally and don't count.
+ *
+ * @param[in] server Server instance
+ * @param[in] count Number of responses to cut
+ * @param[in] after_bytes Body bytes sent before the connection drops
+ */
+void agentmail_mock_server_cut_next(agentmail_mock_server_t *server, uint32_t count, size_t after_bytes);
+
+/**
+ * @brief Drop every WebSocket subscriber connection
+ *
+ * Simulates a network outage so clients reconnect and resume.
+ *
+ * @param[in] server Server instance
+ */
+void agentmail_mock_server_drop_subscribers(agentmail_mock_server_t *server);
+
+/**
+ * @brief Register a webhook receiving message.received events
+ *
+ * Every message delivered afterwards is POSTed to url from a sender
+ * thread, in order, with svix-id/svix-timestamp headers and, when secret
+ * is set, an svix-signature header.
+ *
+ * @param[in] server Server instance
+ * @param[in] url http:// URL of the receiver
+ * @param[in] secret Signing secret ("whsec_<base64>", NULL for unsigned)
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_mock_server_add_webhook(agentmail_mock_server_t *server, const char *url,
+                                                 const char *secret);
+
+/**
+ * @brief Get server counters
+ */
+void agentmail_mock_server_get_stats(agentmail_mock_server_t *server, agentmail_mock_stats_t *stats);
+
+/**
+ * @brief Stop the server and free all resources
+ */
+void agentmail_mock_server_stop(agentmail_mock_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_MOCK_SERVER_H
@@ -0,0 +1,277 @@
+#ifndef AGENTMAIL_PORT_H
+#define AGENTMAIL_PORT_H
+
+/**
+ * @file agentmail_port.h
+ * @brief Platform shims used internally by the AgentMail client
+ *
+ * On ESP-IDF this maps onto esp_log, FreeRTOS and esp_timer. On a Linux
+ * host the same names are provided with stdio, pthreads and std::thread so
+ * the client can be built, profiled and benchmarked off-device.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+typedef SemaphoreHandle_t agentmail_mutex_t;
+
+static inline agentmail_mutex_t agentmail_mutex_create(void) {
+    return xSemaphoreCreateMutex();
+}
+
+static inline void agentmail_mutex_lock(agentmail_mutex_t mutex) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+}
+
+static inline void agentmail_mutex_unlock(agentmail_mutex_t mutex) {
+    xSemaphoreGive(mutex);
+}
+
+static inline void agentmail_mutex_delete(agentmail_mutex_t mutex) {
+    vSemaphoreDelete(mutex);
+}
+
+static inline int64_t agentmail_time_us(void) {
+    return esp_timer_get_time();
+}
+
+static inline void agentmail_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static inline uint32_t agentmail_random(void) {
+    return esp_random();
+}
+
+/**
+ * Bounded FIFO of pointers
+ */
+typedef QueueHandle_t agentmail_queue_t;
+
+static inline agentmail_queue_t agentmail_queue_create(size_t length) {
+    return xQueueCreate(length, sizeof(void *));
+}
+
+/**
+ * Append an item; returns false if the queue is full and wait is false
+ */
+static inline bool agentmail_queue_send(agentmail_queue_t queue, void *item, bool wait) {
+    return xQueueSend(queue, &item, wait ? portMAX_DELAY : 0) == pdTRUE;
+}
+
+static inline void *agentmail_queue_receive(agentmail_queue_t queue) {
+    void *item = NULL;
+    xQueueReceive(queue, &item, portMAX_DELAY);
+    return item;
+}
+
+static inline void agentmail_queue_delete(agentmail_queue_t queue) {
+    vQueueDelete(queue);
+}
+
+/**
+ * Joinable worker task
+ */
+typedef struct {
+    void (*fn)(void *arg);
+    void *arg;
+    SemaphoreHandle_t done;
+} agentmail_task_state_t;
+
+typedef agentmail_task_state_t *agentmail_task_t;
+
+static inline void agentmail_task_entry(void *param) {
+    agentmail_task_t task = (agentmail_task_t)param;
+    task->fn(task->arg);
+    xSemaphoreGive(task->done);
+    vTaskDelete(NULL);
+}
+
+static inline agentmail_task_t agentmail_task_create(void (*fn)(void *arg), void *arg,
+                                                     const char *name, uint32_t stack_size,
+                                                     int priority) {
+    agentmail_task_t task = (agentmail_task_t)calloc(1, sizeof(agentmail_task_state_t));
+    if (task == NULL) return NULL;
+    task->fn = fn;
+    task->arg = arg;
+    task->done = xSemaphoreCreateBinary();
+    if (task->done == NULL ||
+        xTaskCreate(agentmail_task_entry, name, stack_size, task, priority, NULL) != pdPASS) {
+        if (task->done != NULL) vSemaphoreDelete(task->done);
+        free(task);
+        return NULL;
+    }
+    return task;
+}
+
+/**
+ * Wait for the task function to return, then free the task
+ */
+static inline void agentmail_task_join(agentmail_task_t task) {
+    xSemaphoreTake(task->done, portMAX_DELAY);
+    vSemaphoreDelete(task->done);
+    free(task);
+}
+
+#else // Linux host
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <thread>
+
+/**
+ * Host log level: 1=error, 2=warning, 3=info, 4=debug, 5=verbose
+ */
+#ifndef AGENTMAIL_HOST_LOG_LEVEL
+#define AGENTMAIL_HOST_LOG_LEVEL 3
+#endif
+
+#define AGENTMAIL_HOST_LOG(level, letter, tag, format, ...)                     \
+    do {                                                                        \
+        if ((level) <= AGENTMAIL_HOST_LOG_LEVEL) {                              \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);  \
+        }                                                                       \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) AGENTMAIL_HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) AGENTMAIL_HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) AGENTMAIL_HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) AGENTMAIL_HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) AGENTMAIL_HOST_LOG(5, "V", tag, format, ##__VA_ARGS__)
+
+typedef pthread_mutex_t *agentmail_mutex_t;
+
+static inline agentmail_mutex_t agentmail_mutex_create(void) {
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+    if (mutex != NULL && pthread_mutex_init(mutex, NULL) != 0) {
+        free(mutex);
+        mutex = NULL;
+    }
+    return mutex;
+}
+
+static inline void agentmail_mutex_lock(agentmail_mutex_t mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+static inline void agentmail_mutex_unlock(agentmail_mutex_t mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+static inline void agentmail_mutex_delete(agentmail_mutex_t mutex) {
+    pthread_mutex_destroy(mutex);
+    free(mutex);
+}
+
+static inline int64_t agentmail_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void agentmail_delay_ms(uint32_t ms) {
+    usleep((useconds_t)ms * 1000);
+}
+
+static inline uint32_t agentmail_random(void) {
+    return (uint32_t)random();
+}
+
+/**
+ * Bounded FIFO of pointers
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;         // Signalled when an item is added
+    pthread_cond_t space;         // Signalled when an item is removed
+    std::deque<void *> items;
+    size_t length;
+} agentmail_queue_state_t;
+
+typedef agentmail_queue_state_t *agentmail_queue_t;
+
+static inline agentmail_queue_t agentmail_queue_create(size_t length) {
+    agentmail_queue_t queue = new agentmail_queue_state_t();
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->ready, NULL);
+    pthread_cond_init(&queue->space, NULL);
+    queue->length = length;
+    return queue;
+}
+
+/**
+ * Append an item; returns false if the queue is full and wait is false
+ */
+static inline bool agentmail_queue_send(agentmail_queue_t queue, void *item, bool wait) {
+    pthread_mutex_lock(&queue->mutex);
+    while (wait && queue->items.size() >= queue->length) {
+        pthread_cond_wait(&queue->space, &queue->mutex);
+    }
+    bool queued = queue->items.size() < queue->length;
+    if (queued) {
+        queue->items.push_back(item);
+        pthread_cond_signal(&queue->ready);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return queued;
+}
+
+static inline void *agentmail_queue_receive(agentmail_queue_t queue) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->items.empty()) {
+        pthread_cond_wait(&queue->ready, &queue->mutex);
+    }
+    void *item = queue->items.front();
+    queue->items.pop_front();
+    pthread_cond_signal(&queue->space);
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+static inline void agentmail_queue_delete(agentmail_queue_t queue) {
+    pthread_cond_destroy(&queue->space);
+    pthread_cond_destroy(&queue->ready);
+    pthread_mutex_destroy(&queue->mutex);
+    delete queue;
+}
+
+/**
+ * Joinable worker task (name, stack size and priority only apply on device)
+ */
+typedef std::thread *agentmail_task_t;
+
+static inline agentmail_task_t agentmail_task_create(void (*fn)(void *arg), void *arg,
+                                                     const char *name, uint32_t stack_size,
+                                                     int priority) {
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    return new std::thread(fn, arg);
+}
+
+/**
+ * Wait for the task function to return, then free the task
+ */
+static inline void agentmail_task_join(agentmail_task_t task) {
+    task->join();
+    delete task;
+}
+
+#endif // ESP_PLATFORM
+
+#endif // AGENTMAIL_PORT_H
@@ -0,0 +1,1109 @@
+/**
+ * AgentMail Persistent Store
+ *
+ * Record layout (n = unsigned LEB128 varint; s = string written as
+ * n(length + 1) followed by its bytes and terminator, n(0) for NULL):
+ *
+ *   "AMS" version(1) crc32(4, little-endian, of everything after it)
+ *   n(inbox count), then per inbox:
+ *     s(inbox_id) s(name) s(email_address) s(created_at) s(metadata) s(cursor)
+ *     s(etag) (version 2 on; version 1 records are read without it)
+ *     n(message count), then per message, newest first:
+ *       s(message_id) s(thread_id) s(from) s(to) s(subject) s(timestamp)
+ *       flags(1, bit 0: is_read) n(attachment count), then per attachment:
+ *         s(attachment_id) s(filename) s(content_type) n(size)
+ *
+ * Strings keep their terminator so they can be used straight out of the
+ * record while loading. In RAM each stored message is a single block
+ * holding the message, its attachment array and its strings.
+ */
+
+#include "agentmail_store.h"
+#include "agentmail.h"
+#include "agentmail_arena.h"
+#include "agentmail_port.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+#include <nvs.h>
+#endif
+
+static const char *TAG = "agentmail_store";
+
+static const uint8_t STORE_MAGIC[3] = {'A', 'M', 'S'};
+static const uint8_t STORE_VERSION = 2;
+static const size_t STORE_HEADER_LEN = 8;
+static const size_t STORE_DEFAULT_MAX_MESSAGES = 50;
+
+// String members kept for each record type (message bodies are not kept)
+static const size_t INBOX_STRINGS[] = {
+    offsetof(agentmail_inbox_t, inbox_id),
+    offsetof(agentmail_inbox_t, name),
+    offsetof(agentmail_inbox_t, email_address),
+    offsetof(agentmail_inbox_t, created_at),
+    offsetof(agentmail_inbox_t, metadata),
+};
+static const size_t MESSAGE_STRINGS[] = {
+    offsetof(agentmail_message_t, message_id),
+    offsetof(agentmail_message_t, thread_id),
+    offsetof(agentmail_message_t, from),
+    offsetof(agentmail_message_t, to),
+    offsetof(agentmail_message_t, subject),
+    offsetof(agentmail_message_t, timestamp),
+};
+static const size_t ATTACHMENT_STRINGS[] = {
+    offsetof(agentmail_attachment_info_t, attachment_id),
+    offsetof(agentmail_attachment_info_t, filename),
+    offsetof(agentmail_attachment_info_t, content_type),
+};
+
+#define STRING_COUNT(offsets) (sizeof(offsets) / sizeof((offsets)[0]))
+
+/**
+ * Stored inbox
+ */
+typedef struct {
+    agentmail_inbox_t inbox;        // strdup()ed strings (inbox_id always set)
+    char *cursor;
+    char *etag;                     // Validator of the newest page, as last synced
+    agentmail_message_t **messages; // Newest first, each a block from message_pack()
+    size_t count;
+} store_inbox_t;
+
+struct agentmail_store {
+    const agentmail_storage_t *storage;
+    char *key;
+    size_t max_messages;
+    agentmail_mutex_t lock;         // Guards everything below
+    store_inbox_t *inboxes;
+    size_t inbox_count;
+    bool dirty;                     // Changed since loaded or flushed
+};
+
+// ============================================================================
+// Records
+// ============================================================================
+
+static char **member(const void *base, size_t offset) {
+    return (char **)((char *)base + offset);
+}
+
+static bool same_string(const char *a, const char *b) {
+    return (a == NULL || b == NULL) ? a == b : strcmp(a, b) == 0;
+}
+
+static size_t strings_size(const void *src, const size_t *offsets, size_t count) {
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char *value = *member(src, offsets[i]);
+        if (value != NULL) {
+            size += strlen(value) + 1;
+        }
+    }
+    return size;
+}
+
+/**
+ * Copy the listed strings of src into dst, packed one after another at
+ * out; returns the end
+ */
+static char *strings_pack(const void *src, void *dst, const size_t *offsets, size_t count, char *out) {
+    for (size_t i = 0; i < count; i++) {
+        const char *value = *member(src, offsets[i]);
+        if (value == NULL) {
+            *member(dst, offsets[i]) = NULL;
+        } else {
+            size_t len = strlen(value) + 1;
+            memcpy(out, value, len);
+            *member(dst, offsets[i]) = out;
+            out += len;
+        }
+    }
+    return out;
+}
+
+static bool strings_equal(const void *a, const void *b, const size_t *offsets, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!same_string(*member(a, offsets[i]), *member(b, offsets[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Bytes of a message's block
+ */
+static size_t message_size(const agentmail_message_t *message) {
+    size_t size = sizeof(agentmail_message_t) +
+                  message->attachment_count * sizeof(agentmail_attachment_info_t) +
+                  strings_size(message, MESSAGE_STRINGS, STRING_COUNT(MESSAGE_STRINGS));
+    for (size_t i = 0; i < message->attachment_count; i++) {
+        size += strings_size(&message->attachments[i], ATTACHMENT_STRINGS, STRING_COUNT(ATTACHMENT_STRINGS));
+    }
+    return size;
+}
+
+/**
+ * Copy a message's metadata into a single block (freed with free())
+ */
+static agentmail_message_t *message_pack(const agentmail_message_t *src) {
+    agentmail_message_t *dst = (agentmail_message_t *)malloc(message_size(src));
+    if (dst == NULL) {
+        return NULL;
+    }
+    memset(dst, 0, sizeof(agentmail_message_t));
+    dst->is_read = src->is_read;
+    dst->attachment_count = src->attachment_count;
+
+    agentmail_attachment_info_t *attachments = (agentmail_attachment_info_t *)(dst + 1);
+    char *out = (char *)(attachments + src->attachment_count);
+    dst->attachments = (src->attachment_count > 0) ? attachments : NULL;
+    for (size_t i = 0; i < src->attachment_count; i++) {
+        attachments[i].size = src->attachments[i].size;
+        out = strings_pack(&src->attachments[i], &attachments[i], ATTACHMENT_STRINGS,
+                           STRING_COUNT(ATTACHMENT_STRINGS), out);
+    }
+    strings_pack(src, dst, MESSAGE_STRINGS, STRING_COUNT(MESSAGE_STRINGS), out);
+    return dst;
+}
+
+/**
+ * Whether storing b in place of a would change anything
+ */
+static bool message_equal(const agentmail_message_t *a, const agentmail_message_t *b) {
+    if (a->is_read != b->is_read || a->attachment_count != b->attachment_count ||
+        !strings_equal(a, b, MESSAGE_STRINGS, STRING_COUNT(MESSAGE_STRINGS))) {
+        return false;
+    }
+    for (size_t i = 0; i < a->attachment_count; i++) {
+        if (a->attachments[i].size != b->attachments[i].size ||
+            !strings_equal(&a->attachments[i], &b->attachments[i], ATTACHMENT_STRINGS,
+                           STRING_COUNT(ATTACHMENT_STRINGS))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Newest first; ISO 8601 timestamps in one format compare as strings, and
+ * undated messages go last
+ */
+static bool message_newer(const agentmail_message_t *a, const agentmail_message_t *b) {
+    if (a->timestamp == NULL) {
+        return false;
+    }
+    return b->timestamp == NULL || strcmp(a->timestamp, b->timestamp) > 0;
+}
+
+/**
+ * Replace the listed strings of dst with copies of src's
+ */
+static bool strings_replace(void *dst, const void *src, const size_t *offsets, size_t count) {
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        const char *value = *member(src, offsets[i]);
+        char *copy = (value != NULL) ? strdup(value) : NULL;
+        if (value != NULL && copy == NULL) {
+            ok = false;
+            continue;
+        }
+        free(*member(dst, offsets[i]));
+        *member(dst, offsets[i]) = copy;
+    }
+    return ok;
+}
+
+static void inbox_clear(store_inbox_t *record) {
+    for (size_t i = 0; i < STRING_COUNT(INBOX_STRINGS); i++) {
+        free(*member(&record->inbox, INBOX_STRINGS[i]));
+    }
+    free(record->cursor);
+    free(record->etag);
+    for (size_t i = 0; i < record->count; i++) {
+        free(record->messages[i]);
+    }
+    free(record->messages);
+    memset(record, 0, sizeof(store_inbox_t));
+}
+
+static store_inbox_t *find_inbox(agentmail_store_t *store, const char *inbox_id) {
+    for (size_t i = 0; i < store->inbox_count; i++) {
+        if (strcmp(store->inboxes[i].inbox.inbox_id, inbox_id) == 0) {
+            return &store->inboxes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find an inbox record, adding an empty one if there is none
+ */
+static store_inbox_t *get_inbox(agentmail_store_t *store, const char *inbox_id) {
+    store_inbox_t *record = find_inbox(store, inbox_id);
+    if (record != NULL) {
+        return record;
+    }
+    char *id = strdup(inbox_id);
+    store_inbox_t *inboxes = (store_inbox_t *)realloc(store->inboxes,
+                                                      (store->inbox_count + 1) * sizeof(store_inbox_t));
+    if (id == NULL || inboxes == NULL) {
+        free(id);
+        if (inboxes != NULL) {
+            store->inboxes = inboxes;
+        }
+        return NULL;
+    }
+    store->inboxes = inboxes;
+    record = &inboxes[store->inbox_count++];
+    memset(record, 0, sizeof(store_inbox_t));
+    record->inbox.inbox_id = id;
+    return record;
+}
+
+static size_t find_message(const store_inbox_t *record, const char *message_id) {
+    size_t i = 0;
+    while (i < record->count && !same_string(record->messages[i]->message_id, message_id)) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Merge messages into a record, newest first and at most max long,
+ * reporting each message's outcome in changes (optional)
+ *
+ * @return Whether the record changed
+ */
+static bool merge_messages(store_inbox_t *record, const agentmail_message_t *messages, size_t count,
+                           size_t max, agentmail_store_change_t *changes, agentmail_err_t *err) {
+    for (size_t i = 0; changes != NULL && i < count; i++) {
+        changes[i] = AGENTMAIL_STORE_UNCHANGED;
+    }
+    if (count == 0) {
+        return false;
+    }
+    agentmail_message_t **list = (agentmail_message_t **)realloc(
+        record->messages, (record->count + count) * sizeof(agentmail_message_t *));
+    if (list == NULL) {
+        *err = AGENTMAIL_ERR_NO_MEM;
+        return false;
+    }
+    record->messages = list;
+    size_t stored = record->count;  // Sorted; merged messages are appended after
+
+    bool changed = false;
+    for (size_t i = 0; i < count; i++) {
+        const agentmail_message_t *message = &messages[i];
+        if (message->message_id == NULL) {
+            continue;
+        }
+        size_t pos = find_message(record, message->message_id);
+        if (pos < record->count && message_equal(list[pos], message)) {
+            continue;
+        }
+        // Older than everything kept in a full list: would be trimmed again
+        if (pos == record->count && stored >= max && !message_newer(message, list[stored - 1])) {
+            continue;
+        }
+        agentmail_message_t *packed = message_pack(message);
+        if (packed == NULL) {
+            *err = AGENTMAIL_ERR_NO_MEM;
+            break;
+        }
+        if (changes != NULL) {
+            changes[i] = (pos < record->count) ? AGENTMAIL_STORE_UPDATED : AGENTMAIL_STORE_ADDED;
+        }
+        if (pos < record->count) {
+            free(list[pos]);
+        } else {
+            record->count++;
+        }
+        list[pos] = packed;
+        changed = true;
+    }
+    if (!changed) {
+        return false;
+    }
+
+    // Insertion sort: stable, and linear for the usual nearly sorted list
+    for (size_t i = 1; i < record->count; i++) {
+        agentmail_message_t *message = list[i];
+        size_t k = i;
+        while (k > 0 && message_newer(message, list[k - 1])) {
+            list[k] = list[k - 1];
+            k--;
+        }
+        list[k] = message;
+    }
+    while (record->count > max) {
+        free(list[--record->count]);
+    }
+    return true;
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+/**
+ * Record being written (buf NULL: only measure)
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} store_writer_t;
+
+static void write_byte(store_writer_t *w, uint8_t byte) {
+    if (w->buf != NULL) {
+        w->buf[w->len] = byte;
+    }
+    w->len++;
+}
+
+static void write_varint(store_writer_t *w, uint64_t value) {
+    while (value >= 0x80) {
+        write_byte(w, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    write_byte(w, (uint8_t)value);
+}
+
+static void write_string(store_writer_t *w, const char *value) {
+    if (value == NULL) {
+        write_varint(w, 0);
+        return;
+    }
+    size_t len = strlen(value) + 1;
+    write_varint(w, len);
+    if (w->buf != NULL) {
+        memcpy(w->buf + w->len, value, len);
+    }
+    w->len += len;
+}
+
+static void write_strings(store_writer_t *w, const void *src, const size_t *offsets, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        write_string(w, *member(src, offsets[i]));
+    }
+}
+
+static void store_serialize(const agentmail_store_t *store, store_writer_t *w) {
+    for (size_t i = 0; i < sizeof(STORE_MAGIC); i++) {
+        write_byte(w, STORE_MAGIC[i]);
+    }
+    write_byte(w, STORE_VERSION);
+    for (int i = 0; i < 4; i++) {
+        write_byte(w, 0);  // CRC, filled in afterwards
+    }
+
+    write_varint(w, store->inbox_count);
+    for (size_t i = 0; i < store->inbox_count; i++) {
+        const store_inbox_t *record = &store->inboxes[i];
+        write_strings(w, &record->inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS));
+        write_string(w, record->cursor);
+        write_string(w, record->etag);
+        write_varint(w, record->count);
+        for (size_t k = 0; k < record->count; k++) {
+            const agentmail_message_t *message = record->messages[k];
+            write_strings(w, message, MESSAGE_STRINGS, STRING_COUNT(MESSAGE_STRINGS));
+            write_byte(w, message->is_read ? 1 : 0);
+            write_varint(w, message->attachment_count);
+            for (size_t a = 0; a < message->attachment_count; a++) {
+                write_strings(w, &message->attachments[a], ATTACHMENT_STRINGS,
+                              STRING_COUNT(ATTACHMENT_STRINGS));
+                write_varint(w, message->attachments[a].size);
+            }
+        }
+    }
+}
+
+/**
+ * Record being read (ok is cleared on truncated or malformed input)
+ */
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool ok;
+} store_reader_t;
+
+static uint8_t read_byte(store_reader_t *r) {
+    if (r->pos >= r->end) {
+        r->ok = false;
+        return 0;
+    }
+    return *r->pos++;
+}
+
+static uint64_t read_varint(store_reader_t *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && r->ok; shift += 7) {
+        uint8_t byte = read_byte(r);
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    r->ok = false;
+    return 0;
+}
+
+/**
+ * Read a count of items taking at least min_size bytes each
+ */
+static size_t read_count(store_reader_t *r, size_t min_size) {
+    uint64_t count = read_varint(r);
+    if (count > (uint64_t)(r->end - r->pos) / min_size) {
+        r->ok = false;
+        return 0;
+    }
+    return (size_t)count;
+}
+
+/**
+ * Read a string, pointing into the record
+ */
+static char *read_string(store_reader_t *r) {
+    uint64_t len = read_varint(r);
+    if (len == 0 || !r->ok) {
+        return NULL;
+    }
+    if (len > (uint64_t)(r->end - r->pos) || r->pos[len - 1] != '\0') {
+        r->ok = false;
+        return NULL;
+    }
+    char *value = (char *)r->pos;
+    r->pos += len;
+    return value;
+}
+
+static void read_strings(store_reader_t *r, void *dst, const size_t *offsets, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        *member(dst, offsets[i]) = read_string(r);
+    }
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+    static const uint32_t TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+        crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * Load a saved record into an empty store
+ *
+ * @return false if the record is damaged or from a newer version (the
+ *         store is left empty)
+ */
+static bool store_deserialize(agentmail_store_t *store, const uint8_t *data, size_t len) {
+    if (len < STORE_HEADER_LEN || memcmp(data, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 ||
+        data[3] < 1 || data[3] > STORE_VERSION ||
+        get_le32(data + 4) != crc32(data + STORE_HEADER_LEN, len - STORE_HEADER_LEN)) {
+        return false;
+    }
+    uint8_t version = data[3];
+
+    store_reader_t r = {data + STORE_HEADER_LEN, data + len, true};
+    agentmail_attachment_info_t *attachments = NULL;
+    size_t inbox_count = read_count(&r, 7);
+    for (size_t i = 0; i < inbox_count && r.ok; i++) {
+        agentmail_inbox_t inbox = {};
+        read_strings(&r, &inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS));
+        char *cursor = read_string(&r);
+        char *etag = (version >= 2) ? read_string(&r) : NULL;
+        bool valid = r.ok && inbox.inbox_id != NULL && find_inbox(store, inbox.inbox_id) == NULL;
+        store_inbox_t *record = valid ? get_inbox(store, inbox.inbox_id) : NULL;
+        if (record == NULL ||
+            !strings_replace(&record->inbox, &inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS)) ||
+            (cursor != NULL && (record->cursor = strdup(cursor)) == NULL) ||
+            (etag != NULL && (record->etag = strdup(etag)) == NULL)) {
+            r.ok = false;
+            break;
+        }
+
+        size_t message_count = read_count(&r, 8);
+        record->messages = (agentmail_message_t **)malloc((message_count + 1) * sizeof(agentmail_message_t *));
+        r.ok = r.ok && record->messages != NULL;
+        for (size_t k = 0; k < message_count && r.ok; k++) {
+            agentmail_message_t message = {};
+            read_strings(&r, &message, MESSAGE_STRINGS, STRING_COUNT(MESSAGE_STRINGS));
+            message.is_read = (read_byte(&r) & 1) != 0;
+            message.attachment_count = read_count(&r, 4);
+            if (message.attachment_count > 0) {
+                free(attachments);
+                attachments = (agentmail_attachment_info_t *)malloc(
+                    message.attachment_count * sizeof(agentmail_attachment_info_t));
+                r.ok = r.ok && attachments != NULL;
+                message.attachments = attachments;
+            }
+            for (size_t a = 0; a < message.attachment_count && r.ok; a++) {
+                read_strings(&r, &attachments[a], ATTACHMENT_STRINGS, STRING_COUNT(ATTACHMENT_STRINGS));
+                attachments[a].size = (size_t)read_varint(&r);
+            }
+            if (!r.ok || message.message_id == NULL) {
+                r.ok = false;
+                break;
+            }
+            // max_messages may have been lowered since the record was saved
+            if (record->count < store->max_messages) {
+                agentmail_message_t *packed = message_pack(&message);
+                r.ok = (packed != NULL);
+                if (packed != NULL) {
+                    record->messages[record->count++] = packed;
+                }
+            }
+        }
+    }
+    free(attachments);
+
+    if (!r.ok || r.pos != r.end) {
+        for (size_t i = 0; i < store->inbox_count; i++) {
+            inbox_clear(&store->inboxes[i]);
+        }
+        free(store->inboxes);
+        store->inboxes = NULL;
+        store->inbox_count = 0;
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Storage Backends
+// ============================================================================
+
+/**
+ * Read a whole file into a malloc()ed buffer
+ */
+static agentmail_err_t file_read(const char *path, char **data, size_t *len) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return AGENTMAIL_ERR_NOT_FOUND;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_IO;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+    }
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        char *buf = (char *)malloc(size > 0 ? (size_t)size : 1);
+        if (buf == NULL) {
+            err = AGENTMAIL_ERR_NO_MEM;
+        } else if (fread(buf, 1, (size_t)size, file) == (size_t)size) {
+            *data = buf;
+            *len = (size_t)size;
+            err = AGENTMAIL_ERR_NONE;
+        } else {
+            free(buf);
+        }
+    }
+    fclose(file);
+    return err;
+}
+
+static char *file_tmp_path(const char *path) {
+    size_t len = strlen(path);
+    char *tmp = (char *)malloc(len + sizeof(".tmp"));
+    if (tmp != NULL) {
+        memcpy(tmp, path, len);
+        memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+    }
+    return tmp;
+}
+
+static agentmail_err_t file_load(const char *key, char **data, size_t *len) {
+    agentmail_err_t err = file_read(key, data, len);
+    if (err == AGENTMAIL_ERR_NOT_FOUND) {
+        // A save interrupted between removing the old file and renaming
+        char *tmp = file_tmp_path(key);
+        err = (tmp != NULL) ? file_read(tmp, data, len) : AGENTMAIL_ERR_NO_MEM;
+        free(tmp);
+    }
+    return err;
+}
+
+static agentmail_err_t file_save(const char *key, const char *data, size_t len) {
+    char *tmp = file_tmp_path(key);
+    if (tmp == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_IO;
+    FILE *file = fopen(tmp, "wb");
+    if (file != NULL) {
+        bool written = fwrite(data, 1, len, file) == len && fflush(file) == 0 && fsync(fileno(file)) == 0;
+        if (fclose(file) == 0 && written) {
+            // SPIFFS and FAT don't rename over an existing file
+            if (rename(tmp, key) == 0 || (remove(key) == 0 && rename(tmp, key) == 0)) {
+                err = AGENTMAIL_ERR_NONE;
+            }
+        }
+        if (err != AGENTMAIL_ERR_NONE) {
+            remove(tmp);
+        }
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        ESP_LOGE(TAG, "Failed to write %s", key);
+    }
+    free(tmp);
+    return err;
+}
+
+static const agentmail_storage_t FILE_STORAGE = {
+    .name = "file",
+    .default_key = "agentmail.store",
+    .load = file_load,
+    .save = file_save,
+};
+
+const agentmail_storage_t *agentmail_storage_file(void) {
+    return &FILE_STORAGE;
+}
+
+#ifdef ESP_PLATFORM
+
+static const char *NVS_NAMESPACE = "agentmail";
+
+static agentmail_err_t storage_nvs_load(const char *key, char **data, size_t *len) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return AGENTMAIL_ERR_NOT_FOUND;  // Namespace not created yet
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return AGENTMAIL_ERR_IO;
+    }
+
+    agentmail_err_t err = AGENTMAIL_ERR_IO;
+    size_t size = 0;
+    ret = nvs_get_blob(handle, key, NULL, &size);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        err = AGENTMAIL_ERR_NOT_FOUND;
+    } else if (ret == ESP_OK) {
+        char *buf = (char *)malloc(size > 0 ? size : 1);
+        if (buf == NULL) {
+            err = AGENTMAIL_ERR_NO_MEM;
+        } else if ((ret = nvs_get_blob(handle, key, buf, &size)) == ESP_OK) {
+            *data = buf;
+            *len = size;
+            err = AGENTMAIL_ERR_NONE;
+        } else {
+            free(buf);
+        }
+    }
+    if (err == AGENTMAIL_ERR_IO) {
+        ESP_LOGE(TAG, "Failed to read %s from NVS: %s", key, esp_err_to_name(ret));
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static agentmail_err_t storage_nvs_save(const char *key, const char *data, size_t len) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, key, data, len);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %s to NVS: %s", key, esp_err_to_name(ret));
+        return AGENTMAIL_ERR_IO;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static const agentmail_storage_t NVS_STORAGE = {
+    .name = "nvs",
+    .default_key = "store",
+    .load = storage_nvs_load,
+    .save = storage_nvs_save,
+};
+
+const agentmail_storage_t *agentmail_storage_nvs(void) {
+    return &NVS_STORAGE;
+}
+
+#endif // ESP_PLATFORM
+
+const agentmail_storage_t *agentmail_storage_default(void) {
+#ifdef ESP_PLATFORM
+    return agentmail_storage_nvs();
+#else
+    return agentmail_storage_file();
+#endif
+}
+
+// ============================================================================
+// Store API
+// ============================================================================
+
+agentmail_err_t agentmail_store_open(const agentmail_store_options_t *options, agentmail_store_t **store) {
+    if (store == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_store_options_t defaults = {};
+    if (options == NULL) {
+        options = &defaults;
+    }
+
+    agentmail_store_t *s = (agentmail_store_t *)calloc(1, sizeof(agentmail_store_t));
+    if (s == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    s->storage = options->storage ? options->storage : agentmail_storage_default();
+    s->key = strdup(options->key ? options->key : s->storage->default_key);
+    s->max_messages = options->max_messages ? options->max_messages : STORE_DEFAULT_MAX_MESSAGES;
+    s->lock = agentmail_mutex_create();
+    if (s->key == NULL || s->lock == NULL) {
+        if (s->lock != NULL) {
+            agentmail_mutex_delete(s->lock);
+        }
+        free(s->key);
+        free(s);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+
+    char *data = NULL;
+    size_t len = 0;
+    agentmail_err_t err = s->storage->load(s->key, &data, &len);
+    if (err == AGENTMAIL_ERR_NONE) {
+        if (store_deserialize(s, (const uint8_t *)data, len)) {
+            ESP_LOGI(TAG, "Loaded %zu inboxes from %s (%zu bytes)", s->inbox_count, s->key, len);
+        } else {
+            ESP_LOGW(TAG, "Discarding damaged or outdated record %s", s->key);
+        }
+    } else if (err != AGENTMAIL_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Could not load %s (%s); starting empty", s->key, agentmail_err_to_str(err));
+    }
+    free(data);
+
+    *store = s;
+    return AGENTMAIL_ERR_NONE;
+}
+
+agentmail_err_t agentmail_store_flush(agentmail_store_t *store) {
+    if (store == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    if (store->dirty) {
+        store_writer_t w = {NULL, 0};
+        store_serialize(store, &w);
+        w.buf = (uint8_t *)malloc(w.len);
+        if (w.buf == NULL) {
+            err = AGENTMAIL_ERR_NO_MEM;
+        } else {
+            w.len = 0;
+            store_serialize(store, &w);
+            put_le32(w.buf + 4, crc32(w.buf + STORE_HEADER_LEN, w.len - STORE_HEADER_LEN));
+            err = store->storage->save(store->key, (const char *)w.buf, w.len);
+            if (err == AGENTMAIL_ERR_NONE) {
+                store->dirty = false;
+                ESP_LOGD(TAG, "Saved %s (%zu bytes)", store->key, w.len);
+            }
+            free(w.buf);
+        }
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+void agentmail_store_close(agentmail_store_t *store) {
+    if (store == NULL) {
+        return;
+    }
+    agentmail_store_flush(store);
+    for (size_t i = 0; i < store->inbox_count; i++) {
+        inbox_clear(&store->inboxes[i]);
+    }
+    free(store->inboxes);
+    agentmail_mutex_delete(store->lock);
+    free(store->key);
+    free(store);
+}
+
+agentmail_err_t agentmail_store_put_inbox(agentmail_store_t *store, const agentmail_inbox_t *inbox) {
+    if (store == NULL || inbox == NULL || inbox->inbox_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    store_inbox_t *record = get_inbox(store, inbox->inbox_id);
+    if (record == NULL) {
+        err = AGENTMAIL_ERR_NO_MEM;
+    } else if (!strings_equal(&record->inbox, inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS))) {
+        if (!strings_replace(&record->inbox, inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS))) {
+            err = AGENTMAIL_ERR_NO_MEM;
+        }
+        store->dirty = true;
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+agentmail_err_t agentmail_store_get_inboxes(agentmail_store_t *store, agentmail_inbox_list_t *inboxes) {
+    if (store == NULL || inboxes == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    memset(inboxes, 0, sizeof(agentmail_inbox_list_t));
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    if (store->inbox_count > 0) {
+        size_t size = store->inbox_count * sizeof(agentmail_inbox_t);
+        for (size_t i = 0; i < store->inbox_count; i++) {
+            size += strings_size(&store->inboxes[i].inbox, INBOX_STRINGS, STRING_COUNT(INBOX_STRINGS)) +
+                    STRING_COUNT(INBOX_STRINGS) * sizeof(void *);
+        }
+        agentmail_arena_t *arena = agentmail_arena_create(size);
+        agentmail_inbox_t *list = arena ? (agentmail_inbox_t *)agentmail_arena_alloc(
+            arena, store->inbox_count * sizeof(agentmail_inbox_t)) : NULL;
+        for (size_t i = 0; list != NULL && i < store->inbox_count; i++) {
+            memset(&list[i], 0, sizeof(agentmail_inbox_t));
+            for (size_t k = 0; k < STRING_COUNT(INBOX_STRINGS); k++) {
+                const char *value = *member(&store->inboxes[i].inbox, INBOX_STRINGS[k]);
+                if (value != NULL &&
+                    (*member(&list[i], INBOX_STRINGS[k]) = agentmail_arena_strndup(arena, value, strlen(value))) == NULL) {
+                    list = NULL;
+                    break;
+                }
+            }
+        }
+        if (list != NULL) {
+            inboxes->inboxes = list;
+            inboxes->count = store->inbox_count;
+            inboxes->arena = arena;
+        } else {
+            if (arena != NULL) {
+                agentmail_arena_destroy(arena);
+            }
+            err = AGENTMAIL_ERR_NO_MEM;
+        }
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+agentmail_err_t agentmail_store_remove_inbox(agentmail_store_t *store, const char *inbox_id) {
+    if (store == NULL || inbox_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NOT_FOUND;
+    agentmail_mutex_lock(store->lock);
+    store_inbox_t *record = find_inbox(store, inbox_id);
+    if (record != NULL) {
+        inbox_clear(record);
+        size_t index = record - store->inboxes;
+        memmove(record, record + 1, (store->inbox_count - index - 1) * sizeof(store_inbox_t));
+        store->inbox_count--;
+        store->dirty = true;
+        err = AGENTMAIL_ERR_NONE;
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+agentmail_err_t agentmail_store_put_messages(agentmail_store_t *store, const char *inbox_id,
+                                             const agentmail_message_t *messages, size_t count) {
+    return agentmail_store_merge_messages(store, inbox_id, messages, count, NULL);
+}
+
+agentmail_err_t agentmail_store_merge_messages(agentmail_store_t *store, const char *inbox_id,
+                                               const agentmail_message_t *messages, size_t count,
+                                               agentmail_store_change_t *changes) {
+    if (store == NULL || inbox_id == NULL || (messages == NULL && count > 0)) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    bool existed = (find_inbox(store, inbox_id) != NULL);
+    store_inbox_t *record = get_inbox(store, inbox_id);
+    if (record == NULL) {
+        err = AGENTMAIL_ERR_NO_MEM;
+    } else if (merge_messages(record, messages, count, store->max_messages, changes, &err) || !existed) {
+        store->dirty = true;
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+/**
+ * Copy a stored message into an arena
+ */
+static bool message_copy_to_arena(agentmail_arena_t *arena, const agentmail_message_t *src,
+                                  agentmail_message_t *dst) {
+    *dst = *src;
+    dst->attachments = NULL;
+    if (src->attachment_count > 0) {
+        dst->attachments = (agentmail_attachment_info_t *)agentmail_arena_alloc(
+            arena, src->attachment_count * sizeof(agentmail_attachment_info_t));
+        if (dst->attachments == NULL) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < STRING_COUNT(MESSAGE_STRINGS); i++) {
+        const char *value = *member(src, MESSAGE_STRINGS[i]);
+        if (value != NULL &&
+            (*member(dst, MESSAGE_STRINGS[i]) = agentmail_arena_strndup(arena, value, strlen(value))) == NULL) {
+            return false;
+        }
+    }
+    for (size_t a = 0; a < src->attachment_count; a++) {
+        dst->attachments[a] = src->attachments[a];
+        for (size_t i = 0; i < STRING_COUNT(ATTACHMENT_STRINGS); i++) {
+            const char *value = *member(&src->attachments[a], ATTACHMENT_STRINGS[i]);
+            if (value != NULL &&
+                (*member(&dst->attachments[a], ATTACHMENT_STRINGS[i]) =
+                     agentmail_arena_strndup(arena, value, strlen(value))) == NULL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+agentmail_err_t agentmail_store_get_messages(agentmail_store_t *store, const char *inbox_id,
+                                             agentmail_message_list_t *messages) {
+    if (store == NULL || inbox_id == NULL || messages == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    memset(messages, 0, sizeof(agentmail_message_list_t));
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    const store_inbox_t *record = find_inbox(store, inbox_id);
+    if (record != NULL && (record->count > 0 || record->cursor != NULL)) {
+        // Room for the blocks' contents plus per-string alignment
+        size_t size = (record->cursor ? strlen(record->cursor) + 1 : 0) + 64;
+        for (size_t i = 0; i < record->count; i++) {
+            size += message_size(record->messages[i]) + 8 * sizeof(void *);
+        }
+        agentmail_arena_t *arena = agentmail_arena_create(size);
+        agentmail_message_t *list = NULL;
+        bool ok = (arena != NULL);
+        if (ok && record->count > 0) {
+            list = (agentmail_message_t *)agentmail_arena_alloc(arena, record->count * sizeof(agentmail_message_t));
+            ok = (list != NULL);
+        }
+        for (size_t i = 0; ok && i < record->count; i++) {
+            ok = message_copy_to_arena(arena, record->messages[i], &list[i]);
+        }
+        if (ok && record->cursor != NULL) {
+            messages->next_cursor = agentmail_arena_strndup(arena, record->cursor, strlen(record->cursor));
+            ok = (messages->next_cursor != NULL);
+        }
+        if (ok) {
+            messages->messages = list;
+            messages->count = record->count;
+            messages->total = record->count;
+            messages->arena = arena;
+        } else {
+            if (arena != NULL) {
+                agentmail_arena_destroy(arena);
+            }
+            memset(messages, 0, sizeof(agentmail_message_list_t));
+            err = AGENTMAIL_ERR_NO_MEM;
+        }
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+agentmail_err_t agentmail_store_remove_message(agentmail_store_t *store, const char *inbox_id,
+                                               const char *message_id) {
+    if (store == NULL || inbox_id == NULL || message_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NOT_FOUND;
+    agentmail_mutex_lock(store->lock);
+    store_inbox_t *record = find_inbox(store, inbox_id);
+    size_t pos = record ? find_message(record, message_id) : 0;
+    if (record != NULL && pos < record->count) {
+        free(record->messages[pos]);
+        memmove(&record->messages[pos], &record->messages[pos + 1],
+                (record->count - pos - 1) * sizeof(agentmail_message_t *));
+        record->count--;
+        store->dirty = true;
+        err = AGENTMAIL_ERR_NONE;
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+/**
+ * Replace one of an inbox's saved strings (the inbox record is created if
+ * needed)
+ */
+static agentmail_err_t set_inbox_string(agentmail_store_t *store, const char *inbox_id, size_t offset,
+                                        const char *value) {
+    if (store == NULL || inbox_id == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_err_t err = AGENTMAIL_ERR_NONE;
+    agentmail_mutex_lock(store->lock);
+    store_inbox_t *record = get_inbox(store, inbox_id);
+    char **field = record ? member(record, offset) : NULL;
+    if (record == NULL) {
+        err = AGENTMAIL_ERR_NO_MEM;
+    } else if (!same_string(*field, value)) {
+        char *copy = value ? strdup(value) : NULL;
+        if (value != NULL && copy == NULL) {
+            err = AGENTMAIL_ERR_NO_MEM;
+        } else {
+            free(*field);
+            *field = copy;
+            store->dirty = true;
+        }
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
+
+agentmail_err_t agentmail_store_set_cursor(agentmail_store_t *store, const char *inbox_id,
+                                           const char *cursor) {
+    return set_inbox_string(store, inbox_id, offsetof(store_inbox_t, cursor), cursor);
+}
+
+agentmail_err_t agentmail_store_set_etag(agentmail_store_t *store, const char *inbox_id, const char *etag) {
+    return set_inbox_string(store, inbox_id, offsetof(store_inbox_t, etag), etag);
+}
+
+agentmail_err_t agentmail_store_get_etag(agentmail_store_t *store, const char *inbox_id, char **etag) {
+    if (store == NULL || inbox_id == NULL || etag == NULL) {
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    *etag = NULL;
+    agentmail_err_t err = AGENTMAIL_ERR_NOT_FOUND;
+    agentmail_mutex_lock(store->lock);
+    const store_inbox_t *record = find_inbox(store, inbox_id);
+    if (record != NULL && record->etag != NULL) {
+        *etag = strdup(record->etag);
+        err = (*etag != NULL) ? AGENTMAIL_ERR_NONE : AGENTMAIL_ERR_NO_MEM;
+    }
+    agentmail_mutex_unlock(store->lock);
+    return err;
+}
@@ -0,0 +1,231 @@
+#ifndef AGENTMAIL_STORE_H
+#define AGENTMAIL_STORE_H
+
+/**
+ * @file agentmail_store.h
+ * @brief Persistent cache of inboxes, message metadata and cursors
+ *
+ * Keeps what a device needs to show its mailbox right after a reboot:
+ * inbox records, the newest messages of each inbox (metadata and read
+ * state, without bodies), a pagination cursor and the ETag of the newest
+ * page per inbox. Everything is held in RAM and written to flash as one
+ * compact binary record on agentmail_store_flush(), so the store can be
+ * updated freely and the flash is written only when the application
+ * decides.
+ *
+ * The record is saved through an agentmail_storage_t: NVS on device, a
+ * file on a Linux host. The file backend also works on device with a
+ * mounted SPIFFS or LittleFS partition. A record that fails its checksum
+ * (e.g. after a write torn by a power cut) is discarded and the store
+ * starts empty.
+ *
+ * Example (show the cached list, then fetch what's new):
+ * @code
+ * agentmail_store_t *store = NULL;
+ * agentmail_store_open(NULL, &store);
+ *
+ * agentmail_message_list_t cached = {};
+ * agentmail_store_get_messages(store, inbox_id, &cached);
+ * show(&cached);
+ * agentmail_message_list_free(&cached);
+ *
+ * agentmail_message_list_t fresh = {};
+ * if (agentmail_messages_get(client, inbox_id, &query, &fresh) == AGENTMAIL_ERR_NONE) {
+ *     agentmail_store_put_messages(store, inbox_id, fresh.messages, fresh.count);
+ *     agentmail_store_flush(store);
+ *     agentmail_message_list_free(&fresh);
+ * }
+ * @endcode
+ */
+
+#include "agentmail_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Storage backend vtable
+ *
+ * Holds whole records by key. Calls are made with the store locked, one
+ * at a time.
+ */
+typedef struct agentmail_storage {
+    const char *name;             ///< Backend name for logging
+    const char *default_key;      ///< Key used when agentmail_store_options_t::key is NULL
+
+    /**
+     * Read the record saved under key into a malloc()ed buffer. Returns
+     * AGENTMAIL_ERR_NOT_FOUND if there is none.
+     */
+    agentmail_err_t (*load)(const char *key, char **data, size_t *len);
+
+    /**
+     * Replace the record saved under key, atomically where the medium
+     * allows it.
+     */
+    agentmail_err_t (*save)(const char *key, const char *data, size_t len);
+} agentmail_storage_t;
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief NVS backend: blobs in the "agentmail" namespace
+ *
+ * Keys are at most 15 characters (default: "store"). nvs_flash_init()
+ * must have been called.
+ */
+const agentmail_storage_t *agentmail_storage_nvs(void);
+#endif
+
+/**
+ * @brief File backend: one file per key, which is its path
+ *
+ * Written to "<path>.tmp" and renamed over the old file (default:
+ * "agentmail.store"; on device a path on a mounted SPIFFS or LittleFS
+ * partition such as "/spiffs/agentmail.store").
+ */
+const agentmail_storage_t *agentmail_storage_file(void);
+
+/**
+ * @brief Default storage backend for the current platform (NVS on device,
+ *        file on a host)
+ */
+const agentmail_storage_t *agentmail_storage_default(void);
+
+/**
+ * @brief Options for opening a store
+ */
+typedef struct {
+    const char *key;              ///< Optional: Record key (default: backend's default_key)
+    const agentmail_storage_t *storage; ///< Optional: Storage backend (default: platform backend)
+    size_t max_messages;          ///< Optional: Messages kept per inbox, newest first (default: 50)
+} agentmail_store_options_t;
+
+/**
+ * @brief Opaque store handle
+ */
+typedef struct agentmail_store agentmail_store_t;
+
+/**
+ * @brief Open a store and load its saved record
+ *
+ * A missing or damaged record is not an error; the store starts empty.
+ *
+ * @param[in] options Options (NULL for defaults)
+ * @param[out] store Output store handle
+ * @return AGENTMAIL_ERR_NONE on success, error code otherwise
+ */
+agentmail_err_t agentmail_store_open(const agentmail_store_options_t *options, agentmail_store_t **store);
+
+/**
+ * @brief Write the store to flash if it changed since it was loaded or
+ *        last flushed
+ *
+ * @return AGENTMAIL_ERR_NONE on success, AGENTMAIL_ERR_IO if the backend
+ *         failed (the store stays dirty and the next flush retries)
+ */
+agentmail_err_t agentmail_store_flush(agentmail_store_t *store);
+
+/**
+ * @brief Flush and close the store
+ */
+void agentmail_store_close(agentmail_store_t *store);
+
+/**
+ * @brief Add or update an inbox record
+ */
+agentmail_err_t agentmail_store_put_inbox(agentmail_store_t *store, const agentmail_inbox_t *inbox);
+
+/**
+ * @brief Get every stored inbox
+ *
+ * @param[out] inboxes Output list (caller must free with agentmail_inbox_list_free())
+ */
+agentmail_err_t agentmail_store_get_inboxes(agentmail_store_t *store, agentmail_inbox_list_t *inboxes);
+
+/**
+ * @brief Remove an inbox with its messages and cursor
+ *
+ * @return AGENTMAIL_ERR_NONE, or AGENTMAIL_ERR_NOT_FOUND if it isn't stored
+ */
+agentmail_err_t agentmail_store_remove_inbox(agentmail_store_t *store, const char *inbox_id);
+
+/**
+ * @brief Merge messages into an inbox's stored list
+ *
+ * Messages already stored (same message_id) are replaced, others are
+ * added; the list is kept newest first and trimmed to max_messages.
+ * Bodies are not stored, so projected list results (e.g.
+ * AGENTMAIL_FIELDS_METADATA) are enough. The inbox record is created if
+ * needed.
+ */
+agentmail_err_t agentmail_store_put_messages(agentmail_store_t *store, const char *inbox_id,
+                                             const agentmail_message_t *messages, size_t count);
+
+/**
+ * @brief Outcome of merging one message
+ */
+typedef enum {
+    AGENTMAIL_STORE_UNCHANGED,    ///< Already stored as is, or older than everything kept in a full list
+    AGENTMAIL_STORE_ADDED,        ///< Not stored before
+    AGENTMAIL_STORE_UPDATED,      ///< Stored before with different metadata or read state
+} agentmail_store_change_t;
+
+/**
+ * @brief Merge messages like agentmail_store_put_messages(), reporting
+ *        what each one changed
+ *
+ * @param[out] changes Outcome per message (count entries)
+ */
+agentmail_err_t agentmail_store_merge_messages(agentmail_store_t *store, const char *inbox_id,
+                                               const agentmail_message_t *messages, size_t count,
+                                               agentmail_store_change_t *changes);
+
+/**
+ * @brief Get an inbox's stored messages, newest first
+ *
+ * @param[out] messages Output list without bodies, with next_cursor set to
+ *             the stored cursor (caller must free with
+ *             agentmail_message_list_free()); empty if the inbox isn't stored
+ */
+agentmail_err_t agentmail_store_get_messages(agentmail_store_t *store, const char *inbox_id,
+                                             agentmail_message_list_t *messages);
+
+/**
+ * @brief Remove a message from an inbox's stored list
+ *
+ * @return AGENTMAIL_ERR_NONE, or AGENTMAIL_ERR_NOT_FOUND if it isn't stored
+ */
+agentmail_err_t agentmail_store_remove_message(agentmail_store_t *store, const char *inbox_id,
+                                               const char *message_id);
+
+/**
+ * @brief Save an inbox's pagination cursor (e.g. where loading older
+ *        messages continues)
+ *
+ * @param[in] cursor Cursor (NULL to clear)
+ */
+agentmail_err_t agentmail_store_set_cursor(agentmail_store_t *store, const char *inbox_id,
+                                           const char *cursor);
+
+/**
+ * @brief Save the ETag of an inbox's newest page, so a later poll can ask
+ *        for it conditionally (used by agentmail_sync_inbox())
+ *
+ * @param[in] etag ETag (NULL to clear)
+ */
+agentmail_err_t agentmail_store_set_etag(agentmail_store_t *store, const char *inbox_id, const char *etag);
+
+/**
+ * @brief Get an inbox's saved ETag
+ *
+ * @param[out] etag Copy of the ETag (caller must free())
+ * @return AGENTMAIL_ERR_NONE, or AGENTMAIL_ERR_NOT_FOUND if none is saved
+ */
+agentmail_err_t agentmail_store_get_etag(agentmail_store_t *store, const char *inbox_id, char **etag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_STORE_H
@@ -98,6 +98,12 @@ static void check_messages_task(void* arg) {
     while (true) {
         vTaskDelay(pdMS_TO_TICKS(CONFIG_AGENTMAIL_TEST_CHECK_INTERVAL * 1000));
         
+        // New messages are pushed while the subscription is up
+        if (manager->IsPushConnected()) {
+            print_statistics();
+            continue;
+        }
+        
         test_stats.check_count++;
         test_stats.last_check_time = esp_timer_get_time() / 1000000;
         
@@ -304,7 +310,7 @@ void start_agentmail_test() {
     ESP_LOGI(TAG, "  • Check for new messages every %d seconds", 
              CONFIG_AGENTMAIL_TEST_CHECK_INTERVAL);
     ESP_LOGI(TAG, "  • Display message details when found");
-    ESP_LOGI(TAG, "  • Auto-mark messages as read");
+    ESP_LOGI(TAG, "  • Report each new message once (polled or pushed)");
     ESP_LOGI(TAG, "  • Show periodic statistics");
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "To test message receiving:");
@@ -325,6 +331,17 @@ void start_agentmail_test() {
             ("Checking every " + std::to_string(CONFIG_AGENTMAIL_TEST_CHECK_INTERVAL) + "s").c_str());
     }
     
+    // Subscribe for pushed messages; polling below is the fallback
+    ESP_LOGI(TAG, "Subscribing to message events...");
+    if (agentmail_manager.Subscribe([](const agentmail_message_t& msg) {
+            test_stats.messages_received++;
+            print_message_details(msg, test_stats.messages_received);
+        })) {
+        ESP_LOGI(TAG, "✓ Subscription started");
+    } else {
+        ESP_LOGW(TAG, "  Subscription failed, polling only");
+    }
+    
     // Start message checking task
     ESP_LOGI(TAG, "Starting periodic check task...");
     xTaskCreate(check_messages_task, "agentmail_check", 
@@ -0,0 +1,265 @@
+#ifndef AGENTMAIL_TRANSPORT_H
+#define AGENTMAIL_TRANSPORT_H
+
+#include "agentmail_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup Transport HTTP Transport Backends
+ * @brief Pluggable HTTP, WebSocket and HTTP server layers used by the AgentMail client
+ *
+ * The client performs every request through an agentmail_transport_t.
+ * The ESP-IDF backend (esp_http_client) is the default on device; the
+ * POSIX socket backend is the default on a Linux host. A custom backend
+ * can be supplied through agentmail_config_t::transport.
+ *
+ * Event subscriptions use an agentmail_ws_transport_t in the same way
+ * (esp_transport_ws on device, POSIX sockets on a host), overridable
+ * through agentmail_subscribe_options_t::transport, and webhook listeners
+ * use an agentmail_http_server_t (esp_http_server on device, a POSIX
+ * socket server on a host), overridable through
+ * agentmail_webhook_options_t::server.
+ * @{
+ */
+
+/**
+ * @brief Settings passed to a backend when a connection is created
+ */
+typedef struct {
+    const char *base_url;         ///< URL every request path is relative to (e.g. "https://api.agentmail.to/v0")
+    int timeout_ms;               ///< Network timeout in ms
+    const char *const *headers;   ///< NULL-terminated name/value pairs sent with every request
+} agentmail_transport_config_t;
+
+/**
+ * @brief A single HTTP request
+ */
+typedef struct {
+    const char *method;           ///< "GET", "POST", "PATCH", "PUT" or "DELETE"
+    const char *path;             ///< Path and query, appended to the base URL (e.g. "/inboxes")
+    const char *body;             ///< Request body (NULL for none)
+    size_t body_len;              ///< Length of body (or of the write_body output) in bytes
+    const char *const *headers;   ///< Optional NULL-terminated name/value pairs for this request only
+
+    /**
+     * Optional body producer, used instead of body for payloads too large
+     * to hold in memory. Called once per attempt after the headers are
+     * sent; it passes exactly body_len bytes to write, in any number of
+     * pieces, and returns the first error write returned.
+     */
+    agentmail_err_t (*write_body)(void *ctx, agentmail_write_cb_t write, void *write_ctx);
+    void *body_ctx;               ///< Passed to write_body
+
+    /**
+     * The response body may be large and its consumer may stop early
+     * (sink->on_data returning non-zero). Backends whose fast path would
+     * drain the whole body first read it piecewise instead, and drop the
+     * connection as soon as the sink aborts.
+     */
+    bool stream_response;
+} agentmail_http_request_t;
+
+/**
+ * @brief Callbacks through which a backend delivers a response
+ *
+ * All callbacks are optional and are invoked on the calling task.
+ */
+typedef struct {
+    void (*on_connected)(void *ctx);                                      ///< New TCP/TLS connection established
+    void (*on_status)(void *ctx, int status_code);                        ///< Status received, before any header or body byte
+    void (*on_header)(void *ctx, const char *key, const char *value);     ///< Response header received
+    agentmail_err_t (*on_data)(void *ctx, const char *data, size_t len);  ///< Body bytes received; non-zero aborts
+    void *ctx;                                                            ///< Passed to every callback
+} agentmail_http_sink_t;
+
+/**
+ * @brief Transport backend vtable
+ */
+typedef struct agentmail_transport {
+    const char *name;             ///< Backend name for logging
+
+    /**
+     * Create a connection object. Everything that does not change between
+     * requests (parsed base URL, TLS configuration, header block) is
+     * prepared here; no network activity is required yet.
+     */
+    agentmail_err_t (*create)(const agentmail_transport_config_t *config, void **conn);
+
+    /**
+     * Perform one request, reusing the open connection when possible.
+     * Sets *status_code when a status line was received.
+     */
+    agentmail_err_t (*perform)(void *conn, const agentmail_http_request_t *request,
+                               const agentmail_http_sink_t *sink, int *status_code);
+
+    /**
+     * Drop the open connection; the next perform() reconnects.
+     */
+    void (*close)(void *conn);
+
+    /**
+     * Close and free the connection object.
+     */
+    void (*destroy)(void *conn);
+} agentmail_transport_t;
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief ESP-IDF backend built on esp_http_client
+ */
+const agentmail_transport_t *agentmail_transport_esp(void);
+#else
+/**
+ * @brief Linux host backend built on POSIX sockets (plain HTTP only)
+ */
+const agentmail_transport_t *agentmail_transport_posix(void);
+#endif
+
+/**
+ * @brief Default backend for the current platform
+ */
+const agentmail_transport_t *agentmail_transport_default(void);
+
+/**
+ * @brief Settings for a WebSocket connection
+ */
+typedef struct {
+    const char *url;              ///< ws:// or wss:// URL
+    const char *const *headers;   ///< NULL-terminated name/value pairs sent with the upgrade request
+    int timeout_ms;               ///< Connect, handshake and send timeout in ms
+} agentmail_ws_config_t;
+
+/**
+ * @brief WebSocket backend vtable
+ *
+ * Used by agentmail_subscribe(). All calls are blocking and made from the
+ * subscription task only.
+ */
+typedef struct agentmail_ws_transport {
+    const char *name;             ///< Backend name for logging
+
+    /**
+     * Connect and complete the opening handshake.
+     */
+    agentmail_err_t (*connect)(const agentmail_ws_config_t *config, void **conn);
+
+    /**
+     * Send one text message.
+     */
+    agentmail_err_t (*send_text)(void *conn, const char *data, size_t len);
+
+    /**
+     * Send a ping. The pong (like any other frame) counts as traffic.
+     */
+    agentmail_err_t (*ping)(void *conn);
+
+    /**
+     * Wait up to timeout_ms for the next message and pass its payload to
+     * on_data, possibly in several pieces. Control frames are answered
+     * internally. Returns AGENTMAIL_ERR_TIMEOUT if no frame arrived,
+     * AGENTMAIL_ERR_NONE once a message is complete (or a control frame
+     * was handled, with no on_data call), and AGENTMAIL_ERR_NETWORK when
+     * the connection was closed.
+     */
+    agentmail_err_t (*receive)(void *conn, int timeout_ms, agentmail_write_cb_t on_data, void *ctx);
+
+    /**
+     * Close the connection and free it.
+     */
+    void (*close)(void *conn);
+} agentmail_ws_transport_t;
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief ESP-IDF WebSocket backend built on esp_transport_ws
+ */
+const agentmail_ws_transport_t *agentmail_ws_transport_esp(void);
+#else
+/**
+ * @brief Linux host WebSocket backend built on POSIX sockets (ws:// only)
+ */
+const agentmail_ws_transport_t *agentmail_ws_transport_posix(void);
+#endif
+
+/**
+ * @brief Default WebSocket backend for the current platform
+ */
+const agentmail_ws_transport_t *agentmail_ws_transport_default(void);
+
+/**
+ * @brief One request received by an HTTP server backend
+ */
+typedef struct {
+    const char *method;           ///< Request method
+    const char *path;             ///< Path without the query string
+    const char *const *header_values; ///< Values of agentmail_http_server_config_t::header_names (NULL if absent)
+    const char *body;             ///< Body, NUL-terminated
+    size_t body_len;              ///< Length of body in bytes
+} agentmail_http_server_request_t;
+
+/**
+ * @brief Settings passed to an HTTP server backend
+ */
+typedef struct {
+    uint16_t port;                ///< Listening port (0 = backend default)
+    const char *const *header_names; ///< NULL-terminated request headers to capture
+    size_t max_body_len;          ///< Larger bodies are answered 413 without calling the handler
+
+    /**
+     * Handle one request and return the HTTP status to answer with (the
+     * response has no body). Called on the server task, one request at a
+     * time.
+     */
+    int (*handler)(void *ctx, const agentmail_http_server_request_t *request);
+    void *ctx;                    ///< Passed to handler
+} agentmail_http_server_config_t;
+
+/**
+ * @brief HTTP server backend vtable
+ */
+typedef struct agentmail_http_server {
+    const char *name;             ///< Backend name for logging
+
+    /**
+     * Start listening and serving requests.
+     */
+    agentmail_err_t (*start)(const agentmail_http_server_config_t *config, void **server);
+
+    /**
+     * Port the server is listening on.
+     */
+    uint16_t (*port)(void *server);
+
+    /**
+     * Stop serving (waiting for a request in progress) and free the server.
+     */
+    void (*stop)(void *server);
+} agentmail_http_server_t;
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief ESP-IDF HTTP server backend built on esp_http_server
+ */
+const agentmail_http_server_t *agentmail_http_server_esp(void);
+#else
+/**
+ * @brief Linux host HTTP server backend built on POSIX sockets
+ */
+const agentmail_http_server_t *agentmail_http_server_posix(void);
+#endif
+
+/**
+ * @brief Default HTTP server backend for the current platform
+ */
+const agentmail_http_server_t *agentmail_http_server_default(void);
+
+/** @} */ // end of Transport group
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGENTMAIL_TRANSPORT_H
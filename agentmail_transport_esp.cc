@@ -0,0 +1,700 @@
+/**
+ * AgentMail ESP-IDF Transport Backend
+ *
+ * Performs requests with esp_http_client over a persistent
+ * HTTP/1.1 keep-alive connection. Event subscriptions use esp_transport_ws
+ * over a TCP or TLS transport, and webhook listeners use esp_http_server.
+ */
+
+#ifdef ESP_PLATFORM
+
+#include "agentmail_transport.h"
+#include "agentmail_port.h"
+#include <esp_http_client.h>
+#include <esp_http_server.h>
+#include <esp_transport.h>
+#include <esp_transport_ssl.h>
+#include <esp_transport_tcp.h>
+#include <esp_transport_ws.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include <esp_crt_bundle.h>
+#endif
+
+static const char *TAG = "agentmail_esp";
+
+/**
+ * Connection state
+ */
+typedef struct {
+    esp_http_client_handle_t http;     // Configured once, in esp_create()
+    char *url;                         // Base URL followed by the path of the last request
+    size_t base_len;
+    size_t url_cap;
+    const agentmail_http_sink_t *sink; // Sink of the request in flight
+    agentmail_err_t sink_err;          // First error returned by sink->on_data
+    agentmail_err_t body_err;          // Error returned by request->write_body
+    bool status_sent;                  // sink->on_status called for this response
+} esp_conn_t;
+
+/**
+ * HTTP event handler forwarding response events to the sink
+ */
+static esp_err_t esp_event_handler(esp_http_client_event_t *evt) {
+    esp_conn_t *conn = (esp_conn_t *)evt->user_data;
+    const agentmail_http_sink_t *sink = conn->sink;
+    if (sink == NULL) {
+        return ESP_OK;
+    }
+
+    // The status line has been parsed by the time the first header or
+    // body byte of a response is reported
+    if ((evt->event_id == HTTP_EVENT_ON_HEADER || evt->event_id == HTTP_EVENT_ON_DATA) &&
+        !conn->status_sent) {
+        conn->status_sent = true;
+        if (sink->on_status) {
+            sink->on_status(sink->ctx, esp_http_client_get_status_code(evt->client));
+        }
+    }
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            if (sink->on_connected) {
+                sink->on_connected(sink->ctx);
+            }
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (sink->on_header) {
+                sink->on_header(sink->ctx, evt->header_key, evt->header_value);
+            }
+            break;
+        case HTTP_EVENT_ON_DATA:
+            // Chunked responses arrive here already de-chunked, one chunk
+            // piece at a time, so both encodings take the same path
+            if (sink->on_data && conn->sink_err == AGENTMAIL_ERR_NONE) {
+                conn->sink_err = sink->on_data(sink->ctx, (const char *)evt->data, evt->data_len);
+            }
+            break;
+        case HTTP_EVENT_ERROR:
+            ESP_LOGE(TAG, "HTTP event error");
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+static void esp_destroy(void *handle);
+
+static agentmail_err_t esp_write_body(void *ctx, const char *data, size_t len) {
+    esp_http_client_handle_t http_client = (esp_http_client_handle_t)ctx;
+    while (len > 0) {
+        int n = esp_http_client_write(http_client, data, (int)len);
+        if (n <= 0) {
+            return AGENTMAIL_ERR_NETWORK;
+        }
+        data += n;
+        len -= n;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Read the response of a request opened with esp_http_client_open(). The
+ * body reaches the sink through HTTP_EVENT_ON_DATA as it is read; reading
+ * stops as soon as the sink returns an error, leaving the rest unread.
+ */
+static esp_err_t esp_read_response(esp_conn_t *conn) {
+    esp_http_client_handle_t http_client = conn->http;
+    int64_t content_length = esp_http_client_fetch_headers(http_client);
+    if (content_length < 0) {
+        return (content_length == -ESP_ERR_HTTP_EAGAIN) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+    char scratch[256];  // Copy handed back by esp_http_client_read(); the sink already has it
+    while (conn->sink_err == AGENTMAIL_ERR_NONE && !esp_http_client_is_complete_data_received(http_client)) {
+        int n = esp_http_client_read(http_client, scratch, sizeof(scratch));
+        if (n < 0) {
+            return (n == -ESP_ERR_HTTP_EAGAIN) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        }
+        if (n == 0) {
+            // End of stream: complete only for a body delimited by the close
+            bool delimited = content_length > 0 || esp_http_client_is_chunked_response(http_client);
+            return delimited ? ESP_FAIL : ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Send a request (its body from request->write_body, if any) and read the
+ * response piece by piece; the parser reports it through the same events
+ * as perform()
+ */
+static esp_err_t esp_perform_streamed(esp_conn_t *conn, const agentmail_http_request_t *request) {
+    esp_http_client_handle_t http_client = conn->http;
+    esp_err_t err = esp_http_client_open(http_client, (int)request->body_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (request->write_body != NULL) {
+        conn->body_err = request->write_body(request->body_ctx, esp_write_body, http_client);
+        if (conn->body_err != AGENTMAIL_ERR_NONE) {
+            return ESP_FAIL;
+        }
+    }
+    return esp_read_response(conn);
+}
+
+/**
+ * Build the client once: URL parsing, TLS configuration (certificate
+ * bundle, session tickets) and the invariant headers all carry over
+ * between requests
+ */
+static agentmail_err_t esp_create(const agentmail_transport_config_t *config, void **out) {
+    esp_conn_t *conn = (esp_conn_t *)calloc(1, sizeof(esp_conn_t));
+    if (conn == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    conn->base_len = strlen(config->base_url);
+    while (conn->base_len > 0 && config->base_url[conn->base_len - 1] == '/') {
+        conn->base_len--;
+    }
+    conn->url_cap = conn->base_len + 128;
+    conn->url = (char *)malloc(conn->url_cap);
+    if (conn->url == NULL) {
+        free(conn);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    memcpy(conn->url, config->base_url, conn->base_len);
+    conn->url[conn->base_len] = '\0';
+
+    esp_http_client_config_t http_config = {};
+    http_config.url = conn->url;
+    http_config.timeout_ms = config->timeout_ms;
+    http_config.event_handler = esp_event_handler;
+    http_config.user_data = conn;
+    http_config.buffer_size = 2048;
+    http_config.buffer_size_tx = 2048;
+    http_config.keep_alive_enable = true;
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    http_config.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // Keep the TLS session in the handle so a reconnect after the server
+    // dropped the idle socket resumes it instead of a full handshake
+    http_config.save_client_session = true;
+#endif
+
+    conn->http = esp_http_client_init(&http_config);
+    if (conn->http == NULL) {
+        ESP_LOGE(TAG, "Invalid base URL: %s", config->base_url);
+        esp_destroy(conn);
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    // Invariant headers survive across requests on the same handle
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        esp_http_client_set_header(conn->http, h[0], h[1]);
+    }
+    *out = conn;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t esp_perform(
+    void *handle,
+    const agentmail_http_request_t *request,
+    const agentmail_http_sink_t *sink,
+    int *status_code
+) {
+    esp_conn_t *conn = (esp_conn_t *)handle;
+
+    // Only the path changes; the base stays in place in the URL buffer
+    size_t path_len = strlen(request->path);
+    if (conn->base_len + path_len + 1 > conn->url_cap) {
+        size_t url_cap = conn->base_len + path_len + 1;
+        char *url = (char *)realloc(conn->url, url_cap);
+        if (url == NULL) {
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        conn->url = url;
+        conn->url_cap = url_cap;
+    }
+    memcpy(conn->url + conn->base_len, request->path, path_len + 1);
+    esp_http_client_handle_t http_client = conn->http;
+    esp_http_client_set_url(http_client, conn->url);
+
+    // Set method
+    const char *method = request->method;
+    if (strcmp(method, "GET") == 0) {
+        esp_http_client_set_method(http_client, HTTP_METHOD_GET);
+    } else if (strcmp(method, "POST") == 0) {
+        esp_http_client_set_method(http_client, HTTP_METHOD_POST);
+    } else if (strcmp(method, "PUT") == 0) {
+        esp_http_client_set_method(http_client, HTTP_METHOD_PUT);
+    } else if (strcmp(method, "DELETE") == 0) {
+        esp_http_client_set_method(http_client, HTTP_METHOD_DELETE);
+    } else if (strcmp(method, "PATCH") == 0) {
+        esp_http_client_set_method(http_client, HTTP_METHOD_PATCH);
+    }
+
+    // Set body if provided (clears the previous request's body otherwise).
+    // Per-request headers go after, since clearing the body drops Content-Type.
+    // A streamed body is written after the headers instead.
+    const char *body = request->write_body ? NULL : request->body;
+    esp_http_client_set_post_field(http_client, body, body ? (int)request->body_len : 0);
+    for (const char *const *h = request->headers; h != NULL && h[0] != NULL; h += 2) {
+        esp_http_client_set_header(http_client, h[0], h[1]);
+    }
+
+    conn->sink = sink;
+    conn->sink_err = AGENTMAIL_ERR_NONE;
+    conn->status_sent = false;
+    conn->body_err = AGENTMAIL_ERR_NONE;
+    // perform() drains the whole body before returning, whatever the sink
+    // says; a body the caller may stop early is read piecewise instead
+    bool streamed = request->write_body != NULL || request->stream_response;
+    esp_err_t err;
+    if (streamed) {
+        err = esp_perform_streamed(conn, request);
+    } else {
+        err = esp_http_client_perform(http_client);
+    }
+    *status_code = esp_http_client_get_status_code(http_client);
+    conn->sink = NULL;
+
+    // Per-request headers must not leak into the next request
+    for (const char *const *h = request->headers; h != NULL && h[0] != NULL; h += 2) {
+        esp_http_client_delete_header(http_client, h[0]);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+        // Don't reuse a connection in an unknown state
+        esp_http_client_close(http_client);
+        if (conn->body_err != AGENTMAIL_ERR_NONE && conn->body_err != AGENTMAIL_ERR_NETWORK) {
+            return conn->body_err;  // The body source failed, not the network
+        }
+        return (err == ESP_ERR_TIMEOUT) ? AGENTMAIL_ERR_TIMEOUT : AGENTMAIL_ERR_NETWORK;
+    }
+    // Only perform() rearms the handle for the next request on the same
+    // socket, so a streamed request doesn't keep its connection, and an
+    // aborted body is left unread
+    if (conn->sink_err != AGENTMAIL_ERR_NONE || streamed) {
+        esp_http_client_close(http_client);
+    }
+    return conn->sink_err;
+}
+
+static void esp_close(void *handle) {
+    esp_conn_t *conn = (esp_conn_t *)handle;
+    if (conn->http != NULL) {
+        esp_http_client_close(conn->http);
+    }
+}
+
+static void esp_destroy(void *handle) {
+    esp_conn_t *conn = (esp_conn_t *)handle;
+    if (conn == NULL) return;
+    if (conn->http != NULL) {
+        esp_http_client_cleanup(conn->http);
+    }
+    free(conn->url);
+    free(conn);
+}
+
+static const agentmail_transport_t ESP_TRANSPORT = {
+    .name = "esp_http_client",
+    .create = esp_create,
+    .perform = esp_perform,
+    .close = esp_close,
+    .destroy = esp_destroy,
+};
+
+const agentmail_transport_t *agentmail_transport_esp(void) {
+    return &ESP_TRANSPORT;
+}
+
+// ============================================================================
+// WebSocket
+// ============================================================================
+
+/**
+ * WebSocket connection state
+ */
+typedef struct {
+    esp_transport_handle_t parent;     // TCP or TLS transport under the WebSocket layer
+    esp_transport_handle_t ws;
+    int timeout_ms;
+} esp_ws_conn_t;
+
+static void esp_ws_free(esp_ws_conn_t *conn) {
+    // Destroying the WebSocket layer leaves its parent to the caller
+    if (conn->ws != NULL) {
+        esp_transport_close(conn->ws);
+        esp_transport_destroy(conn->ws);
+    }
+    if (conn->parent != NULL) {
+        esp_transport_destroy(conn->parent);
+    }
+    free(conn);
+}
+
+/**
+ * Split a ws:// or wss:// URL into host, port and path
+ */
+static bool parse_ws_url(const char *url, char *host, size_t host_size, int *port,
+                         const char **path, bool *secure) {
+    const char *p = url;
+    if (strncmp(p, "wss://", 6) == 0) {
+        p += 6;
+        *port = 443;
+        *secure = true;
+    } else if (strncmp(p, "ws://", 5) == 0) {
+        p += 5;
+        *port = 80;
+        *secure = false;
+    } else {
+        return false;
+    }
+
+    const char *host_end = p;
+    while (*host_end && *host_end != ':' && *host_end != '/' && *host_end != '?') {
+        host_end++;
+    }
+    size_t host_len = host_end - p;
+    if (host_len == 0 || host_len >= host_size) {
+        return false;
+    }
+    memcpy(host, p, host_len);
+    host[host_len] = '\0';
+
+    p = host_end;
+    if (*p == ':') {
+        *port = atoi(p + 1);
+        while (*p && *p != '/' && *p != '?') p++;
+    }
+    *path = (*p != '\0') ? p : "/";
+    return true;
+}
+
+static agentmail_err_t esp_ws_connect(const agentmail_ws_config_t *config, void **out) {
+    char host[128];
+    int port = 0;
+    const char *path = NULL;
+    bool secure = false;
+    if (!parse_ws_url(config->url, host, sizeof(host), &port, &path, &secure)) {
+        ESP_LOGE(TAG, "Unsupported WebSocket URL: %s", config->url);
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+
+    esp_ws_conn_t *conn = (esp_ws_conn_t *)calloc(1, sizeof(esp_ws_conn_t));
+    if (conn == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    conn->timeout_ms = config->timeout_ms;
+    conn->parent = secure ? esp_transport_ssl_init() : esp_transport_tcp_init();
+    if (conn->parent != NULL) {
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        if (secure) {
+            esp_transport_ssl_crt_bundle_attach(conn->parent, esp_crt_bundle_attach);
+        }
+#endif
+        conn->ws = esp_transport_ws_init(conn->parent);
+    }
+
+    // Extra upgrade headers as one "Name: value\r\n" block
+    size_t len = 1;
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        len += strlen(h[0]) + strlen(h[1]) + 4;
+    }
+    char *headers = (char *)malloc(len);
+    if (conn->ws == NULL || headers == NULL) {
+        free(headers);
+        esp_ws_free(conn);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    size_t pos = 0;
+    headers[0] = '\0';
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        pos += snprintf(headers + pos, len - pos, "%s: %s\r\n", h[0], h[1]);
+    }
+    esp_transport_ws_set_path(conn->ws, path);
+    esp_transport_ws_set_headers(conn->ws, headers);
+    free(headers);
+
+    // Includes the opening handshake and Sec-WebSocket-Accept check
+    if (esp_transport_connect(conn->ws, host, port, conn->timeout_ms) < 0) {
+        ESP_LOGE(TAG, "WebSocket connect to %s:%d failed", host, port);
+        esp_ws_free(conn);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    *out = conn;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t esp_ws_send_text(void *handle, const char *data, size_t len) {
+    esp_ws_conn_t *conn = (esp_ws_conn_t *)handle;
+    ws_transport_opcodes_t opcode =
+        (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_TEXT | WS_TRANSPORT_OPCODES_FIN);
+    if (esp_transport_ws_send_raw(conn->ws, opcode, data, (int)len, conn->timeout_ms) < 0) {
+        return AGENTMAIL_ERR_NETWORK;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t esp_ws_ping(void *handle) {
+    esp_ws_conn_t *conn = (esp_ws_conn_t *)handle;
+    ws_transport_opcodes_t opcode =
+        (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_PING | WS_TRANSPORT_OPCODES_FIN);
+    if (esp_transport_ws_send_raw(conn->ws, opcode, NULL, 0, conn->timeout_ms) < 0) {
+        return AGENTMAIL_ERR_NETWORK;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t esp_ws_receive(void *handle, int timeout_ms, agentmail_write_cb_t on_data,
+                                      void *ctx) {
+    esp_ws_conn_t *conn = (esp_ws_conn_t *)handle;
+    int ready = esp_transport_poll_read(conn->ws, timeout_ms);
+    if (ready == 0) {
+        return AGENTMAIL_ERR_TIMEOUT;
+    }
+    if (ready < 0) {
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    char buf[512];
+    bool in_message = false;
+    while (true) {
+        // Reads the next frame header plus the first part of its payload
+        int n = esp_transport_read(conn->ws, buf, sizeof(buf), conn->timeout_ms);
+        if (n < 0) {
+            return AGENTMAIL_ERR_NETWORK;
+        }
+        ws_transport_opcodes_t opcode = esp_transport_ws_get_read_opcode(conn->ws);
+        if (opcode == WS_TRANSPORT_OPCODES_CLOSE) {
+            return AGENTMAIL_ERR_NETWORK;
+        }
+        if (opcode == WS_TRANSPORT_OPCODES_PING || opcode == WS_TRANSPORT_OPCODES_PONG) {
+            // Pings are answered by esp_transport_ws
+            if (!in_message) {
+                return AGENTMAIL_ERR_NONE;
+            }
+            continue;
+        }
+
+        int remaining = esp_transport_ws_get_read_payload_len(conn->ws) - n;
+        while (true) {
+            if (n > 0 && on_data) {
+                agentmail_err_t err = on_data(ctx, buf, n);
+                if (err != AGENTMAIL_ERR_NONE) {
+                    return err;
+                }
+            }
+            if (remaining <= 0) {
+                break;
+            }
+            int want = remaining < (int)sizeof(buf) ? remaining : (int)sizeof(buf);
+            n = esp_transport_read(conn->ws, buf, want, conn->timeout_ms);
+            if (n <= 0) {
+                return AGENTMAIL_ERR_NETWORK;
+            }
+            remaining -= n;
+        }
+
+        if (esp_transport_ws_get_fin_flag(conn->ws)) {
+            return AGENTMAIL_ERR_NONE;
+        }
+        in_message = true;
+    }
+}
+
+static void esp_ws_close(void *handle) {
+    esp_ws_conn_t *conn = (esp_ws_conn_t *)handle;
+    ws_transport_opcodes_t opcode =
+        (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_CLOSE | WS_TRANSPORT_OPCODES_FIN);
+    esp_transport_ws_send_raw(conn->ws, opcode, NULL, 0, conn->timeout_ms);
+    esp_ws_free(conn);
+}
+
+static const agentmail_ws_transport_t ESP_WS_TRANSPORT = {
+    .name = "esp_transport_ws",
+    .connect = esp_ws_connect,
+    .send_text = esp_ws_send_text,
+    .ping = esp_ws_ping,
+    .receive = esp_ws_receive,
+    .close = esp_ws_close,
+};
+
+const agentmail_ws_transport_t *agentmail_ws_transport_esp(void) {
+    return &ESP_WS_TRANSPORT;
+}
+
+// ============================================================================
+// HTTP Server
+// ============================================================================
+
+static const uint32_t SERVER_TASK_STACK_SIZE = 6144;
+
+/**
+ * Server state
+ */
+typedef struct {
+    httpd_handle_t httpd;
+    uint16_t port;
+    agentmail_http_server_config_t config;
+    size_t header_count;
+} esp_server_t;
+
+static const char *server_status_text(int status) {
+    switch (status) {
+        case 200: return "200 OK";
+        case 204: return "204 No Content";
+        case 400: return "400 Bad Request";
+        case 401: return "401 Unauthorized";
+        case 404: return "404 Not Found";
+        case 405: return "405 Method Not Allowed";
+        case 408: return "408 Request Timeout";
+        case 413: return "413 Payload Too Large";
+        default:  return status < 300 ? "200 OK" : "500 Internal Server Error";
+    }
+}
+
+/**
+ * Collect the body and the configured headers, then hand the request to
+ * the handler
+ */
+static int esp_server_handle(esp_server_t *server, httpd_req_t *req, char **values) {
+    if (req->content_len > server->config.max_body_len) {
+        return 413;
+    }
+
+    for (size_t i = 0; i < server->header_count; i++) {
+        size_t len = httpd_req_get_hdr_value_len(req, server->config.header_names[i]);
+        if (len == 0) {
+            continue;
+        }
+        values[i] = (char *)malloc(len + 1);
+        if (values[i] == NULL ||
+            httpd_req_get_hdr_value_str(req, server->config.header_names[i], values[i], len + 1) != ESP_OK) {
+            return 500;
+        }
+    }
+
+    char *body = (char *)malloc(req->content_len + 1);
+    if (body == NULL) {
+        return 500;
+    }
+    size_t body_len = 0;
+    while (body_len < req->content_len) {
+        int n = httpd_req_recv(req, body + body_len, req->content_len - body_len);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+            free(body);
+            return 408;
+        }
+        if (n <= 0) {
+            free(body);
+            return 400;
+        }
+        body_len += n;
+    }
+    body[body_len] = '\0';
+
+    // req->uri still carries the query string
+    char path[CONFIG_HTTPD_MAX_URI_LEN + 1];
+    snprintf(path, sizeof(path), "%s", req->uri);
+    char *query = strchr(path, '?');
+    if (query != NULL) {
+        *query = '\0';
+    }
+
+    agentmail_http_server_request_t request = {};
+    request.method = http_method_str((enum http_method)req->method);
+    request.path = path;
+    request.header_values = (const char *const *)values;
+    request.body = body;
+    request.body_len = body_len;
+    int status = server->config.handler(server->config.ctx, &request);
+    free(body);
+    return status;
+}
+
+static esp_err_t esp_server_on_request(httpd_req_t *req) {
+    esp_server_t *server = (esp_server_t *)req->user_ctx;
+    char **values = (char **)calloc(server->header_count + 1, sizeof(char *));
+    int status = values ? esp_server_handle(server, req, values) : 500;
+    if (values != NULL) {
+        for (size_t i = 0; i < server->header_count; i++) {
+            free(values[i]);
+        }
+        free(values);
+    }
+
+    httpd_resp_set_status(req, server_status_text(status));
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static agentmail_err_t esp_server_start(const agentmail_http_server_config_t *config, void **out) {
+    esp_server_t *server = (esp_server_t *)calloc(1, sizeof(esp_server_t));
+    if (server == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    server->config = *config;
+    while (config->header_names && config->header_names[server->header_count]) {
+        server->header_count++;
+    }
+
+    httpd_config_t httpd_config = HTTPD_DEFAULT_CONFIG();
+    if (config->port != 0) {
+        httpd_config.server_port = config->port;
+    }
+    httpd_config.stack_size = SERVER_TASK_STACK_SIZE;
+    httpd_config.uri_match_fn = httpd_uri_match_wildcard;
+    httpd_config.lru_purge_enable = true;
+    server->port = httpd_config.server_port;
+
+    esp_err_t err = httpd_start(&server->httpd, &httpd_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP server on port %u: %s", server->port, esp_err_to_name(err));
+        free(server);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    // Paths are matched by the handler, so anything but POST is a 405
+    httpd_uri_t uri = {};
+    uri.uri = "*";
+    uri.method = HTTP_POST;
+    uri.handler = esp_server_on_request;
+    uri.user_ctx = server;
+    httpd_register_uri_handler(server->httpd, &uri);
+
+    *out = server;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static uint16_t esp_server_port(void *handle) {
+    return ((esp_server_t *)handle)->port;
+}
+
+static void esp_server_stop(void *handle) {
+    esp_server_t *server = (esp_server_t *)handle;
+    httpd_stop(server->httpd);
+    free(server);
+}
+
+static const agentmail_http_server_t ESP_HTTP_SERVER = {
+    .name = "esp_http_server",
+    .start = esp_server_start,
+    .port = esp_server_port,
+    .stop = esp_server_stop,
+};
+
+const agentmail_http_server_t *agentmail_http_server_esp(void) {
+    return &ESP_HTTP_SERVER;
+}
+
+#endif // ESP_PLATFORM
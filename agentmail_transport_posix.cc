@@ -0,0 +1,1038 @@
+/**
+ * AgentMail POSIX Transport Backend
+ *
+ * Minimal HTTP/1.1 client over POSIX sockets for Linux host builds.
+ * Keeps one keep-alive connection open and supports plain http:// URLs,
+ * which is what the local mock server (agentmail_mock_server.h) serves.
+ * A matching WebSocket client (ws:// only) backs event subscriptions, and
+ * a single-threaded HTTP/1.1 server backs webhook listeners.
+ */
+
+#ifndef ESP_PLATFORM
+
+#include "agentmail_transport.h"
+#include "agentmail_port.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const char *TAG = "agentmail_posix";
+static const size_t RECV_BUFFER_SIZE = 4096;
+static const size_t MAX_HEADER_LINE = 2048;
+static const size_t SERVER_MAX_HEADER_SIZE = 8192;
+static const int SERVER_POLL_MS = 250;
+static const int SERVER_RECV_TIMEOUT_MS = 5000;
+static const uint32_t SERVER_TASK_STACK_SIZE = 6144;
+static const int SERVER_TASK_PRIORITY = 5;
+
+/**
+ * Connection state
+ */
+typedef struct {
+    int fd;                       // -1 when not connected
+    char host[256];
+    int port;
+    char *base_path;              // Path part of the base URL, without a trailing '/'
+    size_t base_path_len;
+    int timeout_ms;
+    char *header_block;           // Preformatted Host line and invariant headers
+    size_t header_block_len;
+    char *head;                   // Request head being sent, reused across requests
+    size_t head_cap;
+    char *rbuf;                   // Receive buffer
+    size_t rpos;
+    size_t rlen;
+} posix_conn_t;
+
+/**
+ * Split an http:// or ws:// URL into host, port and path
+ */
+static bool parse_url(const char *url, char *host, size_t host_size, int *port, const char **path) {
+    const char *p = url;
+    if (strncmp(p, "http://", 7) == 0) {
+        p += 7;
+        *port = 80;
+    } else if (strncmp(p, "ws://", 5) == 0) {
+        p += 5;
+        *port = 80;
+    } else {
+        ESP_LOGE(TAG, "Unsupported URL scheme: %s", url);
+        return false;
+    }
+
+    const char *host_end = p;
+    while (*host_end && *host_end != ':' && *host_end != '/' && *host_end != '?') {
+        host_end++;
+    }
+    size_t host_len = host_end - p;
+    if (host_len == 0 || host_len >= host_size) {
+        return false;
+    }
+    memcpy(host, p, host_len);
+    host[host_len] = '\0';
+
+    p = host_end;
+    if (*p == ':') {
+        *port = atoi(p + 1);
+        while (*p && *p != '/' && *p != '?') p++;
+    }
+    *path = (*p != '\0') ? p : "/";
+    return true;
+}
+
+static void posix_disconnect(posix_conn_t *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    conn->rpos = 0;
+    conn->rlen = 0;
+}
+
+static agentmail_err_t posix_connect(posix_conn_t *conn) {
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", conn->port);
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(conn->host, port_str, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "Failed to resolve %s", conn->host);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", conn->host, conn->port);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = conn->timeout_ms / 1000;
+    tv.tv_usec = (conn->timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn->fd = fd;
+    conn->rpos = 0;
+    conn->rlen = 0;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t send_all(posix_conn_t *conn, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(conn->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? AGENTMAIL_ERR_TIMEOUT
+                                                             : AGENTMAIL_ERR_NETWORK;
+        }
+        data += n;
+        len -= n;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t write_body_piece(void *ctx, const char *data, size_t len) {
+    return send_all((posix_conn_t *)ctx, data, len);
+}
+
+/**
+ * Refill the receive buffer; returns AGENTMAIL_ERR_NETWORK on EOF
+ */
+static agentmail_err_t fill_buffer(posix_conn_t *conn) {
+    if (conn->rpos > 0 && conn->rpos == conn->rlen) {
+        conn->rpos = 0;
+        conn->rlen = 0;
+    }
+    while (true) {
+        ssize_t n = recv(conn->fd, conn->rbuf + conn->rlen, RECV_BUFFER_SIZE - conn->rlen, 0);
+        if (n > 0) {
+            conn->rlen += n;
+            return AGENTMAIL_ERR_NONE;
+        }
+        if (n == 0) {
+            return AGENTMAIL_ERR_NETWORK;
+        }
+        if (errno == EINTR) continue;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? AGENTMAIL_ERR_TIMEOUT
+                                                         : AGENTMAIL_ERR_NETWORK;
+    }
+}
+
+/**
+ * Read one CRLF-terminated line (without the terminator) into line
+ */
+static agentmail_err_t read_line(posix_conn_t *conn, char *line, size_t line_size) {
+    size_t len = 0;
+    while (true) {
+        if (conn->rpos == conn->rlen) {
+            agentmail_err_t err = fill_buffer(conn);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+        }
+        char c = conn->rbuf[conn->rpos++];
+        if (c == '\n') {
+            if (len > 0 && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            return AGENTMAIL_ERR_NONE;
+        }
+        if (len + 1 >= line_size) {
+            return AGENTMAIL_ERR_HTTP;
+        }
+        line[len++] = c;
+    }
+}
+
+/**
+ * Read exactly len body bytes, forwarding them to the sink
+ */
+static agentmail_err_t read_body(posix_conn_t *conn, size_t len, const agentmail_http_sink_t *sink) {
+    while (len > 0) {
+        if (conn->rpos == conn->rlen) {
+            agentmail_err_t err = fill_buffer(conn);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+        }
+        size_t avail = conn->rlen - conn->rpos;
+        size_t n = avail < len ? avail : len;
+        if (sink->on_data) {
+            agentmail_err_t err = sink->on_data(sink->ctx, conn->rbuf + conn->rpos, n);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+        }
+        conn->rpos += n;
+        len -= n;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Read a Transfer-Encoding: chunked body, forwarding each chunk as it arrives
+ */
+static agentmail_err_t read_chunked_body(posix_conn_t *conn, const agentmail_http_sink_t *sink) {
+    char line[MAX_HEADER_LINE];
+    while (true) {
+        agentmail_err_t err = read_line(conn, line, sizeof(line));
+        if (err != AGENTMAIL_ERR_NONE) return err;
+
+        // Chunk size in hex, optionally followed by ";extensions"
+        char *end = NULL;
+        unsigned long chunk_size = strtoul(line, &end, 16);
+        if (end == line) {
+            ESP_LOGE(TAG, "Malformed chunk size: %s", line);
+            return AGENTMAIL_ERR_HTTP;
+        }
+
+        if (chunk_size == 0) {
+            // Skip trailers up to the terminating empty line
+            do {
+                err = read_line(conn, line, sizeof(line));
+                if (err != AGENTMAIL_ERR_NONE) return err;
+            } while (line[0] != '\0');
+            return AGENTMAIL_ERR_NONE;
+        }
+
+        err = read_body(conn, chunk_size, sink);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+
+        // CRLF after chunk data
+        err = read_line(conn, line, sizeof(line));
+        if (err != AGENTMAIL_ERR_NONE) return err;
+    }
+}
+
+/**
+ * Read until the server closes the connection
+ */
+static agentmail_err_t read_until_close(posix_conn_t *conn, const agentmail_http_sink_t *sink) {
+    while (true) {
+        if (conn->rpos < conn->rlen && sink->on_data) {
+            agentmail_err_t err = sink->on_data(sink->ctx, conn->rbuf + conn->rpos, conn->rlen - conn->rpos);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+        }
+        conn->rpos = conn->rlen;
+        agentmail_err_t err = fill_buffer(conn);
+        if (err == AGENTMAIL_ERR_NETWORK) return AGENTMAIL_ERR_NONE;
+        if (err != AGENTMAIL_ERR_NONE) return err;
+    }
+}
+
+static agentmail_err_t posix_create(const agentmail_transport_config_t *config, void **out) {
+    posix_conn_t *conn = (posix_conn_t *)calloc(1, sizeof(posix_conn_t));
+    if (conn == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    conn->fd = -1;
+    conn->timeout_ms = config->timeout_ms;
+
+    // Requests only append their path to the parsed base URL
+    const char *base_path = "";
+    if (!parse_url(config->base_url, conn->host, sizeof(conn->host), &conn->port, &base_path)) {
+        free(conn);
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    const char *query = strchr(base_path, '?');
+    conn->base_path_len = query ? (size_t)(query - base_path) : strlen(base_path);
+    while (conn->base_path_len > 0 && base_path[conn->base_path_len - 1] == '/') {
+        conn->base_path_len--;
+    }
+    conn->base_path = (char *)malloc(conn->base_path_len + 1);
+    conn->rbuf = (char *)malloc(RECV_BUFFER_SIZE);
+
+    // Preformat the Host line and invariant headers once
+    size_t len = strlen(conn->host) + 32;
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        len += strlen(h[0]) + strlen(h[1]) + 4;
+    }
+    conn->header_block = (char *)malloc(len + 1);
+    if (conn->base_path == NULL || conn->rbuf == NULL || conn->header_block == NULL) {
+        free(conn->base_path);
+        free(conn->rbuf);
+        free(conn->header_block);
+        free(conn);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    memcpy(conn->base_path, base_path, conn->base_path_len);
+    conn->base_path[conn->base_path_len] = '\0';
+    size_t pos = sprintf(conn->header_block, "Host: %s:%d\r\n", conn->host, conn->port);
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        pos += sprintf(conn->header_block + pos, "%s: %s\r\n", h[0], h[1]);
+    }
+    conn->header_block[pos] = '\0';
+    conn->header_block_len = pos;
+
+    *out = conn;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t posix_perform(
+    void *handle,
+    const agentmail_http_request_t *request,
+    const agentmail_http_sink_t *sink,
+    int *status_code
+) {
+    posix_conn_t *conn = (posix_conn_t *)handle;
+
+    if (conn->fd < 0) {
+        agentmail_err_t err = posix_connect(conn);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+        if (sink->on_connected) {
+            sink->on_connected(sink->ctx);
+        }
+    }
+
+    // Request line and headers
+    size_t method_len = strlen(request->method);
+    size_t path_len = strlen(request->path);
+    size_t extra_len = 0;
+    for (const char *const *h = request->headers; h != NULL && h[0] != NULL; h += 2) {
+        extra_len += strlen(h[0]) + strlen(h[1]) + 4;
+    }
+    size_t head_size = method_len + conn->base_path_len + path_len +
+                       conn->header_block_len + extra_len + 64;
+    if (head_size > conn->head_cap) {
+        char *head = (char *)realloc(conn->head, head_size);
+        if (head == NULL) {
+            return AGENTMAIL_ERR_NO_MEM;
+        }
+        conn->head = head;
+        conn->head_cap = head_size;
+    }
+    char *head = conn->head;
+    size_t pos = 0;
+    memcpy(head + pos, request->method, method_len);
+    pos += method_len;
+    head[pos++] = ' ';
+    memcpy(head + pos, conn->base_path, conn->base_path_len);
+    pos += conn->base_path_len;
+    memcpy(head + pos, request->path, path_len);
+    pos += path_len;
+    memcpy(head + pos, " HTTP/1.1\r\n", 11);
+    pos += 11;
+    memcpy(head + pos, conn->header_block, conn->header_block_len);
+    pos += conn->header_block_len;
+    for (const char *const *h = request->headers; h != NULL && h[0] != NULL; h += 2) {
+        pos += snprintf(head + pos, head_size - pos, "%s: %s\r\n", h[0], h[1]);
+    }
+    size_t body_len = (request->body || request->write_body) ? request->body_len : 0;
+    pos += snprintf(head + pos, head_size - pos, "Content-Length: %zu\r\n\r\n", body_len);
+
+    agentmail_err_t err = send_all(conn, head, pos);
+    if (err == AGENTMAIL_ERR_NONE && request->write_body != NULL) {
+        err = request->write_body(request->body_ctx, write_body_piece, conn);
+    } else if (err == AGENTMAIL_ERR_NONE && body_len > 0) {
+        err = send_all(conn, request->body, body_len);
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        posix_disconnect(conn);
+        return err;
+    }
+
+    // Status line
+    char line[MAX_HEADER_LINE];
+    err = read_line(conn, line, sizeof(line));
+    if (err != AGENTMAIL_ERR_NONE) {
+        posix_disconnect(conn);
+        return err;
+    }
+    if (sscanf(line, "HTTP/%*d.%*d %d", status_code) != 1) {
+        ESP_LOGE(TAG, "Malformed status line: %s", line);
+        posix_disconnect(conn);
+        return AGENTMAIL_ERR_HTTP;
+    }
+    if (sink->on_status) {
+        sink->on_status(sink->ctx, *status_code);
+    }
+
+    // Headers
+    long content_length = -1;
+    bool chunked = false;
+    bool keep_alive = true;
+    while (true) {
+        err = read_line(conn, line, sizeof(line));
+        if (err != AGENTMAIL_ERR_NONE) {
+            posix_disconnect(conn);
+            return err;
+        }
+        if (line[0] == '\0') break;
+
+        char *colon = strchr(line, ':');
+        if (colon == NULL) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            content_length = strtol(value, NULL, 10);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasestr(value, "chunked")) {
+            chunked = true;
+        } else if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0) {
+            keep_alive = false;
+        }
+        if (sink->on_header) {
+            sink->on_header(sink->ctx, line, value);
+        }
+    }
+
+    // Body
+    bool no_body = (strcmp(request->method, "HEAD") == 0) || *status_code == 204 ||
+                   *status_code == 304 || (*status_code >= 100 && *status_code < 200);
+    if (no_body) {
+        err = AGENTMAIL_ERR_NONE;
+    } else if (chunked) {
+        err = read_chunked_body(conn, sink);
+    } else if (content_length >= 0) {
+        err = read_body(conn, (size_t)content_length, sink);
+    } else {
+        err = read_until_close(conn, sink);
+        keep_alive = false;
+    }
+
+    if (err != AGENTMAIL_ERR_NONE || !keep_alive) {
+        posix_disconnect(conn);
+    }
+    return err;
+}
+
+static void posix_close(void *handle) {
+    posix_disconnect((posix_conn_t *)handle);
+}
+
+static void posix_destroy(void *handle) {
+    posix_conn_t *conn = (posix_conn_t *)handle;
+    if (conn == NULL) return;
+    posix_disconnect(conn);
+    free(conn->base_path);
+    free(conn->rbuf);
+    free(conn->header_block);
+    free(conn->head);
+    free(conn);
+}
+
+static const agentmail_transport_t POSIX_TRANSPORT = {
+    .name = "posix",
+    .create = posix_create,
+    .perform = posix_perform,
+    .close = posix_close,
+    .destroy = posix_destroy,
+};
+
+const agentmail_transport_t *agentmail_transport_posix(void) {
+    return &POSIX_TRANSPORT;
+}
+
+// ============================================================================
+// WebSocket (RFC 6455)
+// ============================================================================
+
+enum {
+    WS_OPCODE_CONTINUATION = 0x0,
+    WS_OPCODE_TEXT = 0x1,
+    WS_OPCODE_CLOSE = 0x8,
+    WS_OPCODE_PING = 0x9,
+    WS_OPCODE_PONG = 0xA,
+};
+
+static void base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = (uint32_t)in[i] << 16;
+        if (i + 1 < len) n |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) n |= in[i + 2];
+        out[pos++] = ALPHABET[(n >> 18) & 0x3F];
+        out[pos++] = ALPHABET[(n >> 12) & 0x3F];
+        out[pos++] = (i + 1 < len) ? ALPHABET[(n >> 6) & 0x3F] : '=';
+        out[pos++] = (i + 2 < len) ? ALPHABET[n & 0x3F] : '=';
+    }
+    out[pos] = '\0';
+}
+
+/**
+ * Read exactly len bytes
+ */
+static agentmail_err_t read_exact(posix_conn_t *conn, uint8_t *out, size_t len) {
+    while (len > 0) {
+        if (conn->rpos == conn->rlen) {
+            agentmail_err_t err = fill_buffer(conn);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+        }
+        size_t avail = conn->rlen - conn->rpos;
+        size_t n = avail < len ? avail : len;
+        memcpy(out, conn->rbuf + conn->rpos, n);
+        conn->rpos += n;
+        out += n;
+        len -= n;
+    }
+    return AGENTMAIL_ERR_NONE;
+}
+
+/**
+ * Send one frame; client frames are always masked
+ */
+static agentmail_err_t ws_send_frame(posix_conn_t *conn, uint8_t opcode, const char *data, size_t len) {
+    size_t head_len = 2 + (len > 65535 ? 8 : len > 125 ? 2 : 0) + 4;
+    uint8_t *frame = (uint8_t *)malloc(head_len + len);
+    if (frame == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    frame[0] = 0x80 | opcode;
+    size_t pos = 2;
+    if (len <= 125) {
+        frame[1] = 0x80 | (uint8_t)len;
+    } else if (len <= 65535) {
+        frame[1] = 0x80 | 126;
+        frame[pos++] = (uint8_t)(len >> 8);
+        frame[pos++] = (uint8_t)len;
+    } else {
+        frame[1] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame[pos++] = (uint8_t)((uint64_t)len >> shift);
+        }
+    }
+    uint32_t mask = agentmail_random();
+    memcpy(frame + pos, &mask, 4);
+    const uint8_t *key = frame + pos;
+    pos += 4;
+    for (size_t i = 0; i < len; i++) {
+        frame[pos + i] = (uint8_t)data[i] ^ key[i % 4];
+    }
+
+    agentmail_err_t err = send_all(conn, (const char *)frame, pos + len);
+    free(frame);
+    return err;
+}
+
+static agentmail_err_t posix_ws_connect(const agentmail_ws_config_t *config, void **out) {
+    if (strncmp(config->url, "ws://", 5) != 0) {
+        ESP_LOGE(TAG, "Unsupported WebSocket URL: %s", config->url);
+        return AGENTMAIL_ERR_INVALID_ARG;
+    }
+    agentmail_transport_config_t http_config = {};
+    http_config.base_url = config->url;
+    http_config.timeout_ms = config->timeout_ms;
+    void *handle = NULL;
+    agentmail_err_t err = posix_create(&http_config, &handle);
+    if (err != AGENTMAIL_ERR_NONE) {
+        return err;
+    }
+    posix_conn_t *conn = (posix_conn_t *)handle;
+
+    // Unlike HTTP requests the handshake keeps the query string
+    const char *path = strchr(config->url + 5, '/');
+    if (path == NULL) {
+        path = "/";
+    }
+    err = posix_connect(conn);
+    if (err != AGENTMAIL_ERR_NONE) {
+        posix_destroy(conn);
+        return err;
+    }
+
+    uint8_t nonce[16];
+    for (size_t i = 0; i < sizeof(nonce); i += 4) {
+        uint32_t r = agentmail_random();
+        memcpy(nonce + i, &r, 4);
+    }
+    char key[25];
+    base64_encode(nonce, sizeof(nonce), key);
+
+    // Opening handshake
+    size_t head_size = strlen(path) + strlen(conn->host) + 192;
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        head_size += strlen(h[0]) + strlen(h[1]) + 4;
+    }
+    char *head = (char *)malloc(head_size);
+    if (head == NULL) {
+        posix_destroy(conn);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    int pos = snprintf(head, head_size,
+                       "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n",
+                       path, conn->host, conn->port, key);
+    for (const char *const *h = config->headers; h != NULL && h[0] != NULL; h += 2) {
+        pos += snprintf(head + pos, head_size - pos, "%s: %s\r\n", h[0], h[1]);
+    }
+    pos += snprintf(head + pos, head_size - pos, "\r\n");
+    err = send_all(conn, head, pos);
+    free(head);
+
+    // Sec-WebSocket-Accept is not verified: this backend only talks to
+    // the local stand-in, and the device backend checks it
+    char line[MAX_HEADER_LINE];
+    int status_code = 0;
+    if (err == AGENTMAIL_ERR_NONE) {
+        err = read_line(conn, line, sizeof(line));
+    }
+    if (err == AGENTMAIL_ERR_NONE && (sscanf(line, "HTTP/%*d.%*d %d", &status_code) != 1 ||
+                                      status_code != 101)) {
+        ESP_LOGE(TAG, "WebSocket upgrade refused: %s", line);
+        err = (status_code == 401 || status_code == 403) ? AGENTMAIL_ERR_AUTH : AGENTMAIL_ERR_HTTP;
+    }
+    while (err == AGENTMAIL_ERR_NONE) {
+        err = read_line(conn, line, sizeof(line));
+        if (line[0] == '\0') break;
+    }
+    if (err != AGENTMAIL_ERR_NONE) {
+        posix_destroy(conn);
+        return err;
+    }
+
+    *out = conn;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static agentmail_err_t posix_ws_send_text(void *handle, const char *data, size_t len) {
+    return ws_send_frame((posix_conn_t *)handle, WS_OPCODE_TEXT, data, len);
+}
+
+static agentmail_err_t posix_ws_ping(void *handle) {
+    return ws_send_frame((posix_conn_t *)handle, WS_OPCODE_PING, NULL, 0);
+}
+
+/**
+ * Read the rest of one message after its first frame has started arriving
+ */
+static agentmail_err_t ws_read_message(posix_conn_t *conn, agentmail_write_cb_t on_data, void *ctx) {
+    agentmail_http_sink_t sink = {};
+    sink.on_data = on_data;
+    sink.ctx = ctx;
+    bool in_message = false;
+    while (true) {
+        uint8_t head[2];
+        agentmail_err_t err = read_exact(conn, head, 2);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+        bool fin = (head[0] & 0x80) != 0;
+        uint8_t opcode = head[0] & 0x0F;
+        uint64_t len = head[1] & 0x7F;
+        if (head[1] & 0x80) {
+            ESP_LOGE(TAG, "Masked frame from server");
+            return AGENTMAIL_ERR_NETWORK;
+        }
+        if (len >= 126) {
+            uint8_t ext[8];
+            size_t ext_len = (len == 126) ? 2 : 8;
+            err = read_exact(conn, ext, ext_len);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+            len = 0;
+            for (size_t i = 0; i < ext_len; i++) {
+                len = (len << 8) | ext[i];
+            }
+        }
+
+        if (opcode & 0x8) {
+            // Control frames may be interleaved with a fragmented message
+            uint8_t payload[125];
+            if (len > sizeof(payload)) return AGENTMAIL_ERR_NETWORK;
+            err = read_exact(conn, payload, (size_t)len);
+            if (err != AGENTMAIL_ERR_NONE) return err;
+            if (opcode == WS_OPCODE_CLOSE) {
+                ws_send_frame(conn, WS_OPCODE_CLOSE, (const char *)payload, len >= 2 ? 2 : 0);
+                return AGENTMAIL_ERR_NETWORK;
+            }
+            if (opcode == WS_OPCODE_PING) {
+                err = ws_send_frame(conn, WS_OPCODE_PONG, (const char *)payload, (size_t)len);
+                if (err != AGENTMAIL_ERR_NONE) return err;
+            }
+            if (!in_message) return AGENTMAIL_ERR_NONE;
+            continue;
+        }
+        if (in_message != (opcode == WS_OPCODE_CONTINUATION)) {
+            ESP_LOGE(TAG, "Unexpected WebSocket opcode %u", opcode);
+            return AGENTMAIL_ERR_NETWORK;
+        }
+
+        err = read_body(conn, (size_t)len, &sink);
+        if (err != AGENTMAIL_ERR_NONE) return err;
+        if (fin) return AGENTMAIL_ERR_NONE;
+        in_message = true;
+    }
+}
+
+static agentmail_err_t posix_ws_receive(void *handle, int timeout_ms, agentmail_write_cb_t on_data,
+                                        void *ctx) {
+    posix_conn_t *conn = (posix_conn_t *)handle;
+    if (conn->rpos == conn->rlen) {
+        struct pollfd pfd = {};
+        pfd.fd = conn->fd;
+        pfd.events = POLLIN;
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            return AGENTMAIL_ERR_TIMEOUT;
+        }
+        if (ready < 0) {
+            return AGENTMAIL_ERR_NETWORK;
+        }
+    }
+
+    // Once a frame has started, a stall loses the stream position
+    agentmail_err_t err = ws_read_message(conn, on_data, ctx);
+    return (err == AGENTMAIL_ERR_TIMEOUT) ? AGENTMAIL_ERR_NETWORK : err;
+}
+
+static void posix_ws_close(void *handle) {
+    posix_conn_t *conn = (posix_conn_t *)handle;
+    if (conn->fd >= 0) {
+        static const char NORMAL_CLOSURE[2] = {0x03, (char)0xE8}; // 1000
+        ws_send_frame(conn, WS_OPCODE_CLOSE, NORMAL_CLOSURE, sizeof(NORMAL_CLOSURE));
+    }
+    posix_destroy(conn);
+}
+
+static const agentmail_ws_transport_t POSIX_WS_TRANSPORT = {
+    .name = "posix",
+    .connect = posix_ws_connect,
+    .send_text = posix_ws_send_text,
+    .ping = posix_ws_ping,
+    .receive = posix_ws_receive,
+    .close = posix_ws_close,
+};
+
+const agentmail_ws_transport_t *agentmail_ws_transport_posix(void) {
+    return &POSIX_WS_TRANSPORT;
+}
+
+// ============================================================================
+// HTTP Server
+// ============================================================================
+
+/**
+ * Server state
+ */
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    agentmail_http_server_config_t config;
+    size_t header_count;
+    agentmail_mutex_t lock;       // Guards stopping
+    bool stopping;
+    agentmail_task_t task;
+} posix_server_t;
+
+static const char *server_status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        default:  return status < 300 ? "OK" : "Error";
+    }
+}
+
+static void server_respond(int fd, int status) {
+    char response[128];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                       status, server_status_text(status));
+    send(fd, response, len, MSG_NOSIGNAL);
+}
+
+/**
+ * Receive until buf holds the complete request head. Returns the length
+ * received, 0 if the peer went away, or -status on failure.
+ */
+static ssize_t server_read_head(int fd, char *buf, char **header_end) {
+    size_t len = 0;
+    while (true) {
+        if (len == SERVER_MAX_HEADER_SIZE) {
+            return -400;
+        }
+        ssize_t n = recv(fd, buf + len, SERVER_MAX_HEADER_SIZE - len, 0);
+        if (n <= 0) {
+            return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? -408 : 0;
+        }
+        len += n;
+        buf[len] = '\0';
+        *header_end = strstr(buf, "\r\n\r\n");
+        if (*header_end != NULL) {
+            return len;
+        }
+    }
+}
+
+/**
+ * Read one request (Content-Length bodies only) and return the status to
+ * answer with, or 0 to drop the connection without an answer
+ */
+static int server_handle(posix_server_t *server, int fd, char *buf, const char **values) {
+    char *header_end = NULL;
+    ssize_t len = server_read_head(fd, buf, &header_end);
+    if (len <= 0) {
+        return -len;
+    }
+    *header_end = '\0';
+    const char *leftover = header_end + 4;
+    size_t leftover_len = len - (leftover - buf);
+
+    // Request line: METHOD SP TARGET SP VERSION
+    char *line_end = strstr(buf, "\r\n");
+    if (line_end != NULL) {
+        *line_end = '\0';
+    }
+    char *method = buf;
+    char *target = strchr(method, ' ');
+    if (target == NULL) {
+        return 400;
+    }
+    *target++ = '\0';
+    char *version = strchr(target, ' ');
+    if (version != NULL) {
+        *version = '\0';
+    }
+    char *query = strchr(target, '?');
+    if (query != NULL) {
+        *query = '\0';
+    }
+
+    long content_length = -1;
+    bool chunked = false;
+    char *line = line_end ? line_end + 2 : header_end;
+    while (line < header_end) {
+        char *next = strstr(line, "\r\n");
+        if (next == NULL) {
+            next = header_end;
+        } else {
+            *next = '\0';
+        }
+        char *colon = strchr(line, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            if (strcasecmp(line, "Content-Length") == 0) {
+                content_length = strtol(value, NULL, 10);
+            } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+                chunked = true;
+            }
+            for (size_t i = 0; i < server->header_count; i++) {
+                if (strcasecmp(line, server->config.header_names[i]) == 0) {
+                    values[i] = value;
+                }
+            }
+        }
+        line = next + 2;
+    }
+
+    if (chunked || (content_length < 0 && strcmp(method, "POST") == 0)) {
+        return 411;
+    }
+    if (content_length < 0) {
+        content_length = 0;
+    }
+    if ((size_t)content_length > server->config.max_body_len) {
+        return 413;
+    }
+
+    char *body = (char *)malloc(content_length + 1);
+    if (body == NULL) {
+        return 500;
+    }
+    size_t body_len = leftover_len < (size_t)content_length ? leftover_len : (size_t)content_length;
+    memcpy(body, leftover, body_len);
+    while (body_len < (size_t)content_length) {
+        ssize_t n = recv(fd, body + body_len, content_length - body_len, 0);
+        if (n <= 0) {
+            free(body);
+            return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? 408 : 0;
+        }
+        body_len += n;
+    }
+    body[body_len] = '\0';
+
+    agentmail_http_server_request_t request = {};
+    request.method = method;
+    request.path = target;
+    request.header_values = values;
+    request.body = body;
+    request.body_len = body_len;
+    int status = server->config.handler(server->config.ctx, &request);
+    free(body);
+    return status;
+}
+
+/**
+ * Serve one request; the connection is closed afterwards
+ */
+static void server_serve(posix_server_t *server, int fd) {
+    char *buf = (char *)malloc(SERVER_MAX_HEADER_SIZE + 1);
+    const char **values = (const char **)calloc(server->header_count + 1, sizeof(char *));
+    int status = (buf != NULL && values != NULL) ? server_handle(server, fd, buf, values) : 500;
+    if (status != 0) {
+        server_respond(fd, status);
+    }
+    free(values);
+    free(buf);
+}
+
+static bool server_stopping(posix_server_t *server) {
+    agentmail_mutex_lock(server->lock);
+    bool stopping = server->stopping;
+    agentmail_mutex_unlock(server->lock);
+    return stopping;
+}
+
+static void server_task(void *arg) {
+    posix_server_t *server = (posix_server_t *)arg;
+    while (!server_stopping(server)) {
+        struct pollfd pfd = {};
+        pfd.fd = server->listen_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, SERVER_POLL_MS) <= 0) {
+            continue;
+        }
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        struct timeval tv;
+        tv.tv_sec = SERVER_RECV_TIMEOUT_MS / 1000;
+        tv.tv_usec = (SERVER_RECV_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        server_serve(server, fd);
+        close(fd);
+    }
+}
+
+static void posix_server_free(posix_server_t *server) {
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    if (server->lock != NULL) {
+        agentmail_mutex_delete(server->lock);
+    }
+    free(server);
+}
+
+static agentmail_err_t posix_server_start(const agentmail_http_server_config_t *config, void **out) {
+    posix_server_t *server = (posix_server_t *)calloc(1, sizeof(posix_server_t));
+    if (server == NULL) {
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    server->config = *config;
+    while (config->header_names && config->header_names[server->header_count]) {
+        server->header_count++;
+    }
+    server->lock = agentmail_mutex_create();
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->lock == NULL || server->listen_fd < 0) {
+        posix_server_free(server);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+
+    int one = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config->port);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 8) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %u: %s", config->port, strerror(errno));
+        posix_server_free(server);
+        return AGENTMAIL_ERR_NETWORK;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    server->task = agentmail_task_create(server_task, server, "agentmail_httpd",
+                                         SERVER_TASK_STACK_SIZE, SERVER_TASK_PRIORITY);
+    if (server->task == NULL) {
+        posix_server_free(server);
+        return AGENTMAIL_ERR_NO_MEM;
+    }
+    *out = server;
+    return AGENTMAIL_ERR_NONE;
+}
+
+static uint16_t posix_server_port(void *handle) {
+    return ((posix_server_t *)handle)->port;
+}
+
+static void posix_server_stop(void *handle) {
+    posix_server_t *server = (posix_server_t *)handle;
+    agentmail_mutex_lock(server->lock);
+    server->stopping = true;
+    agentmail_mutex_unlock(server->lock);
+    agentmail_task_join(server->task);
+    posix_server_free(server);
+}
+
+static const agentmail_http_server_t POSIX_HTTP_SERVER = {
+    .name = "posix",
+    .start = posix_server_start,
+    .port = posix_server_port,
+    .stop = posix_server_stop,
+};
+
+const agentmail_http_server_t *agentmail_http_server_posix(void) {
+    return &POSIX_HTTP_SERVER;
+}
+
+#endif // !ESP_PLATFORM
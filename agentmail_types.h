@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +25,9 @@ typedef enum {
     AGENTMAIL_ERR_NETWORK        = -9,  ///< Network error
     AGENTMAIL_ERR_TIMEOUT        = -10, ///< Request timeout
     AGENTMAIL_ERR_OTHER          = -11, ///< Other error
+    AGENTMAIL_ERR_BUSY           = -12, ///< Async request queue full
+    AGENTMAIL_ERR_NOT_MODIFIED   = -13, ///< Unchanged since the last identical query (304)
+    AGENTMAIL_ERR_IO             = -14, ///< Attachment file, source or persistent store could not be read or written
 } agentmail_err_t;
 
 /**
@@ -31,6 +35,63 @@ typedef enum {
  */
 typedef void *agentmail_handle_t;
 
+/**
+ * @brief Opaque handle to an event subscription
+ */
+typedef void *agentmail_subscription_t;
+
+/**
+ * @brief Opaque handle to a webhook listener
+ */
+typedef void *agentmail_webhook_t;
+
+/**
+ * @brief Opaque handle to a delta sync
+ */
+typedef void *agentmail_sync_t;
+
+struct agentmail_transport;
+struct agentmail_store;
+struct agentmail_ws_transport;
+struct agentmail_http_server;
+
+/**
+ * @brief Retry policy for failed requests
+ *
+ * Rate-limited (429) requests are retried after the server's Retry-After
+ * delay. 5xx responses, network errors and timeouts are retried with
+ * jittered exponential backoff, for idempotent requests (GET, PUT, DELETE)
+ * only unless retry_non_idempotent is set.
+ */
+typedef struct {
+    int max_attempts;             ///< Total attempts including the first (0 or 1: no retries)
+    uint32_t base_delay_ms;       ///< First backoff window (default: 500)
+    uint32_t max_delay_ms;        ///< Longest single wait, including Retry-After (default: 30000)
+    bool retry_non_idempotent;    ///< Also retry POST/PATCH on 5xx/network errors (may duplicate sends)
+} agentmail_retry_policy_t;
+
+/**
+ * @brief Endpoint classes for client-side rate limiting
+ */
+typedef enum {
+    AGENTMAIL_ENDPOINT_READ,      ///< GET requests (lists, message and inbox lookups)
+    AGENTMAIL_ENDPOINT_WRITE,     ///< Updates and deletes (e.g. mark read), inbox creation
+    AGENTMAIL_ENDPOINT_SEND,      ///< Outgoing mail (send, reply)
+    AGENTMAIL_ENDPOINT_CLASS_COUNT,
+} agentmail_endpoint_class_t;
+
+/**
+ * @brief Token-bucket rate limit
+ *
+ * The bucket holds up to burst tokens and refills at requests_per_sec.
+ * Each request takes one token, waiting for a refill if the bucket is
+ * empty.
+ */
+typedef struct {
+    float requests_per_sec;       ///< Sustained rate (0: unlimited)
+    uint32_t burst;               ///< Bucket size (default: 1)
+} agentmail_rate_limit_t;
+
 /**
  * @brief Configuration options for AgentMail client
  */
@@ -40,8 +101,45 @@ typedef struct {
     int timeout_ms;               ///< Optional: HTTP timeout in ms (default: 10000)
     bool enable_logging;          ///< Optional: Enable detailed logging (default: true)
     void *ctx;                    ///< Optional: User context for callbacks
+    const struct agentmail_transport *transport; ///< Optional: HTTP backend (default: platform backend)
+    bool use_arena;               ///< Optional: Allocate each returned list in one arena (default: false)
+    bool decode_in_place;         ///< Optional: Leave inbox/message strings in the response body instead of copying them (default: false)
+    int async_queue_len;          ///< Optional: Max queued async requests (default: 8)
+    agentmail_retry_policy_t retry; ///< Optional: Retry policy (default: no retries)
+    agentmail_rate_limit_t rate_limit; ///< Optional: Limit across all requests (default: unlimited)
+    agentmail_rate_limit_t endpoint_rate_limits[AGENTMAIL_ENDPOINT_CLASS_COUNT]; ///< Optional: Per-class limits, applied on top of rate_limit
+    size_t message_cache_size;    ///< Optional: Bytes of RAM for an LRU cache serving agentmail_message_get() (default: 0, no cache)
 } agentmail_config_t;
 
+/**
+ * @brief Client connection statistics
+ *
+ * Counters are cumulative since agentmail_init() or the last
+ * agentmail_reset_stats() call.
+ */
+typedef struct {
+    uint32_t requests;            ///< HTTP requests issued
+    uint32_t handshakes;          ///< New TCP/TLS connections established
+    uint32_t handshake_time_ms;   ///< Total time spent connecting (TCP connect plus TLS handshake)
+    uint32_t last_handshake_ms;   ///< Connect time of the most recent new connection
+    uint32_t connections_reused;  ///< Requests served on an already-open connection
+    uint32_t reconnects;          ///< Transparent reconnects after the server closed an idle connection (idempotent requests only)
+    uint32_t retries;             ///< Attempts repeated under the retry policy
+    uint32_t retry_wait_ms;       ///< Total time spent waiting between attempts
+    uint32_t last_attempts;       ///< Attempts made by the most recent request
+    uint32_t throttled;           ///< Attempts delayed by the client-side rate limiter
+    uint32_t throttle_wait_ms;    ///< Total time spent waiting for the rate limiter
+    uint32_t not_modified;        ///< Conditional requests answered 304 Not Modified
+    uint32_t resumed_downloads;   ///< Attachment downloads continued with a Range request after a drop
+    uint32_t cache_hits;          ///< agentmail_message_get() calls served from the message cache
+    uint32_t cache_misses;        ///< agentmail_message_get() calls that went to the server with the cache enabled
+    uint32_t ws_connects;         ///< Event subscription connections established
+    uint32_t events;              ///< message.received events delivered from the push connection
+    uint32_t events_resumed;      ///< Messages delivered by catch-up after a reconnect
+    uint32_t webhook_events;      ///< message.received events delivered from webhook POSTs
+    uint32_t webhook_rejected;    ///< Webhook POSTs refused (bad signature, stale or malformed)
+} agentmail_stats_t;
+
 /**
  * @brief Inbox information
  */
@@ -51,8 +149,21 @@ typedef struct {
     char *email_address;          ///< Full email address
     char *created_at;             ///< ISO 8601 timestamp
     char *metadata;               ///< Optional JSON metadata
+    void *backing;                ///< Internal: response body the strings point into when decoded in place (NULL otherwise)
 } agentmail_inbox_t;
 
+/**
+ * @brief Attachment of a received message (metadata only)
+ *
+ * The content is fetched separately with agentmail_attachment_download().
+ */
+typedef struct {
+    char *attachment_id;          ///< Attachment ID
+    char *filename;               ///< File name (may be NULL)
+    char *content_type;           ///< MIME type (may be NULL)
+    size_t size;                  ///< Content size in bytes
+} agentmail_attachment_info_t;
+
 /**
  * @brief Email message
  */
@@ -66,8 +177,9 @@ typedef struct {
     char *body_html;              ///< Email body (HTML, optional)
     char *timestamp;              ///< ISO 8601 timestamp
     bool is_read;                 ///< Read status
-    char **attachments;           ///< Array of attachment URLs
+    agentmail_attachment_info_t *attachments; ///< Attachments
     size_t attachment_count;      ///< Number of attachments
+    void *backing;                ///< Internal: response body the strings point into when decoded in place (NULL otherwise)
 } agentmail_message_t;
 
 /**
@@ -78,6 +190,7 @@ typedef struct {
     size_t count;                  ///< Number of messages in array
     char *next_cursor;             ///< Cursor for next page (NULL if no more)
     size_t total;                  ///< Total messages available (if provided by API)
+    void *arena;                   ///< Internal: backing arena in arena mode (NULL otherwise)
 } agentmail_message_list_t;
 
 /**
@@ -87,8 +200,41 @@ typedef struct {
     agentmail_inbox_t *inboxes;    ///< Array of inboxes
     size_t count;                  ///< Number of inboxes in array
     char *next_cursor;             ///< Cursor for next page (NULL if no more)
+    void *arena;                   ///< Internal: backing arena in arena mode (NULL otherwise)
 } agentmail_inbox_list_t;
 
+/**
+ * @brief Callback reading attachment content
+ *
+ * Reads exactly len bytes starting at offset. The content is read again if
+ * the request is retried, so reads must be repeatable. Like an
+ * agentmail_write_cb_t, it runs while the request holds the client's
+ * connection and must not call back into the same client.
+ *
+ * @param ctx agentmail_attachment_t::read_ctx
+ * @param offset Position of the first byte to read
+ * @param buf Output
+ * @param len Number of bytes to read
+ * @return AGENTMAIL_ERR_NONE on success, any other value aborts the send
+ */
+typedef agentmail_err_t (*agentmail_read_cb_t)(void *ctx, size_t offset, uint8_t *buf, size_t len);
+
+/**
+ * @brief Attachment to send
+ *
+ * The content is read from a file or a callback and base64-encoded into
+ * the request a chunk at a time while it is sent, so it never has to be in
+ * RAM as a whole.
+ */
+typedef struct {
+    const char *filename;         ///< Required: File name shown to the recipient
+    const char *content_type;     ///< Optional: MIME type (e.g. "image/jpeg")
+    const char *path;             ///< File to attach (e.g. "/spiffs/photo.jpg"), or NULL to use read
+    agentmail_read_cb_t read;     ///< Content source when path is NULL
+    void *read_ctx;               ///< Passed to read
+    size_t size;                  ///< Content size in bytes when using read (the file size is used with path)
+} agentmail_attachment_t;
+
 /**
  * @brief Options for sending an email
  */
@@ -104,6 +250,8 @@ typedef struct {
     size_t cc_count;              ///< Number of CC recipients
     const char **bcc;             ///< Optional: BCC recipients
     size_t bcc_count;             ///< Number of BCC recipients
+    const agentmail_attachment_t *attachments; ///< Optional: Attachments
+    size_t attachment_count;      ///< Number of attachments
 } agentmail_send_options_t;
 
 /**
@@ -114,6 +262,27 @@ typedef struct {
     const char *metadata;         ///< Optional: JSON metadata
 } agentmail_inbox_options_t;
 
+/**
+ * @brief Message fields, for projecting list results
+ */
+typedef enum {
+    AGENTMAIL_FIELD_MESSAGE_ID = 1 << 0,
+    AGENTMAIL_FIELD_THREAD_ID  = 1 << 1,
+    AGENTMAIL_FIELD_FROM       = 1 << 2,
+    AGENTMAIL_FIELD_TO         = 1 << 3,
+    AGENTMAIL_FIELD_SUBJECT    = 1 << 4,
+    AGENTMAIL_FIELD_BODY_TEXT  = 1 << 5,
+    AGENTMAIL_FIELD_BODY_HTML  = 1 << 6,
+    AGENTMAIL_FIELD_TIMESTAMP  = 1 << 7,
+    AGENTMAIL_FIELD_ATTACHMENTS = 1 << 8,
+
+    /** Everything except the bodies */
+    AGENTMAIL_FIELDS_METADATA  = AGENTMAIL_FIELD_MESSAGE_ID | AGENTMAIL_FIELD_THREAD_ID |
+                                 AGENTMAIL_FIELD_FROM | AGENTMAIL_FIELD_TO |
+                                 AGENTMAIL_FIELD_SUBJECT | AGENTMAIL_FIELD_TIMESTAMP |
+                                 AGENTMAIL_FIELD_ATTACHMENTS,
+} agentmail_field_t;
+
 /**
  * @brief Options for retrieving messages
  */
@@ -122,8 +291,130 @@ typedef struct {
     const char *cursor;           ///< Pagination cursor (NULL for first page)
     bool unread_only;             ///< Only return unread messages
     const char *thread_id;        ///< Filter by thread ID
+    uint32_t fields;              ///< Fields to fill in (agentmail_field_t mask, 0 = all)
+    bool if_changed;              ///< Return AGENTMAIL_ERR_NOT_MODIFIED if unchanged since the last identical query
 } agentmail_message_query_t;
 
+/**
+ * @brief Options for an event subscription
+ */
+typedef struct {
+    const char *url;              ///< Optional: WebSocket URL (default: "wss://ws.agentmail.to/v0")
+    const char **inbox_ids;       ///< Required: Inboxes to watch
+    size_t inbox_count;           ///< Number of inboxes
+    uint32_t reconnect_delay_ms;  ///< Optional: First reconnect delay (default: 1000)
+    uint32_t reconnect_max_delay_ms; ///< Optional: Longest reconnect delay (default: 60000)
+    uint32_t ping_interval_ms;    ///< Optional: Keepalive ping interval (default: 30000)
+    const struct agentmail_ws_transport *transport; ///< Optional: WebSocket backend (default: platform backend)
+} agentmail_subscribe_options_t;
+
+/**
+ * @brief Options for a webhook listener
+ */
+typedef struct {
+    uint16_t port;                ///< Optional: Listening port (default: 80 on device, a free port on a host)
+    const char *path;             ///< Optional: Path POSTs are accepted on (default: "/agentmail/webhook")
+    const char *secret;           ///< Signing secret ("whsec_..."); required unless allow_unsigned is set
+    bool allow_unsigned;          ///< Optional: Accept unsigned POSTs when secret is NULL (trusted networks only)
+    uint32_t tolerance_s;         ///< Optional: Largest accepted signature age (default: 300; needs a set clock)
+    size_t max_body_len;          ///< Optional: Largest accepted payload (default: 32768)
+    const struct agentmail_http_server *server; ///< Optional: HTTP server backend (default: platform backend)
+} agentmail_webhook_options_t;
+
+/**
+ * @brief Options for a delta sync
+ */
+typedef struct {
+    struct agentmail_store *store; ///< Optional: Store holding known messages and high-water marks (default: a private one in RAM)
+    int page_size;                ///< Optional: Messages per request (default: 20)
+    int max_pages;                ///< Optional: Most requests per inbox per sync (default: 10)
+    uint32_t fields;              ///< Optional: Fields of reported messages (default: AGENTMAIL_FIELDS_METADATA)
+} agentmail_sync_options_t;
+
+/**
+ * @brief Subscription, webhook and sync event types
+ */
+typedef enum {
+    AGENTMAIL_EVENT_CONNECTED,        ///< Push connection (re-)established and subscribed
+    AGENTMAIL_EVENT_DISCONNECTED,     ///< Push connection lost; reconnecting
+    AGENTMAIL_EVENT_MESSAGE_RECEIVED, ///< New message in a watched inbox
+    AGENTMAIL_EVENT_MESSAGE_CHANGED,  ///< Known message changed, e.g. its read state (sync only)
+    AGENTMAIL_EVENT_MESSAGE_DELETED,  ///< Known message no longer listed (sync only)
+} agentmail_event_type_t;
+
+/**
+ * @brief Subscription, webhook or sync event
+ */
+typedef struct {
+    agentmail_event_type_t type;
+    const char *inbox_id;         ///< Inbox of the message (MESSAGE_* only)
+    const agentmail_message_t *message; ///< The message (MESSAGE_* only; as last stored for MESSAGE_DELETED)
+    bool resumed;                 ///< Fetched by catch-up after a reconnect rather than pushed
+} agentmail_event_t;
+
+/**
+ * @brief Callback receiving subscription, webhook or sync events
+ *
+ * Runs on the subscription task (or the webhook server task, or the task
+ * calling agentmail_sync_inbox()). The event and everything it points to
+ * are valid only during the call.
+ *
+ * @param ctx User context from agentmail_config_t
+ * @param event The event
+ */
+typedef void (*agentmail_event_cb_t)(void *ctx, const agentmail_event_t *event);
+
+/**
+ * @brief Callback receiving a streamed response body
+ *
+ * Runs while the request holds the client's connection, so it must not
+ * call back into the same client (a request from it would wait for
+ * itself); agentmail_get_stats() and agentmail_reset_stats() are safe.
+ *
+ * @param ctx User context
+ * @param data Next piece of the body (valid only during the call)
+ * @param len Length of data
+ * @return AGENTMAIL_ERR_NONE to continue, any other value aborts the transfer
+ */
+typedef agentmail_err_t (*agentmail_write_cb_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Completion callback for requests without a result
+ *
+ * @param ctx User context from agentmail_config_t
+ * @param err Result of the request
+ */
+typedef void (*agentmail_done_cb_t)(void *ctx, agentmail_err_t err);
+
+/**
+ * @brief Completion callback for agentmail_send_async()
+ *
+ * @param ctx User context from agentmail_config_t
+ * @param err Result of the request
+ * @param message_id ID of the sent message (NULL on error, valid only during the call)
+ */
+typedef void (*agentmail_send_cb_t)(void *ctx, agentmail_err_t err, const char *message_id);
+
+/**
+ * @brief Completion callback for agentmail_message_get_async()
+ *
+ * @param ctx User context from agentmail_config_t
+ * @param err Result of the request
+ * @param message Retrieved message, freed after the callback returns. To
+ *        keep it, copy the struct and zero *message.
+ */
+typedef void (*agentmail_message_cb_t)(void *ctx, agentmail_err_t err, agentmail_message_t *message);
+
+/**
+ * @brief Completion callback for agentmail_messages_get_async()
+ *
+ * @param ctx User context from agentmail_config_t
+ * @param err Result of the request
+ * @param messages Retrieved list, freed after the callback returns. To
+ *        keep it, copy the struct and zero *messages.
+ */
+typedef void (*agentmail_messages_cb_t)(void *ctx, agentmail_err_t err, agentmail_message_list_t *messages);
+
 #ifdef __cplusplus
 }
 #endif
@@ -305,6 +305,9 @@ static void message_check_task(void* arg) {
         
         if (!agentmail_manager_) continue;
         
+        // New messages are pushed while the subscription is up
+        if (agentmail_manager_->IsPushConnected()) continue;
+        
         test_state.check_count++;
         test_state.last_check_time = esp_timer_get_time() / 1000000;
         
@@ -321,7 +324,7 @@ static void message_check_task(void* arg) {
             std::string op = "Received: ";
             op += msg.subject ? msg.subject : "(no subject)";
             update_operation(op, true);
-        });
+        }, AGENTMAIL_FIELDS_METADATA);
         
         if (msg_count == 0) {
             ESP_LOGI(TAG, "No new messages");
@@ -508,6 +511,20 @@ void start_agentmail_ui_test() {
     
     update_status(LV_SYMBOL_OK " Test complete", COLOR_SUCCESS);
     
+    // Subscribe for pushed messages; the check task polls only while
+    // the subscription is disconnected
+    agentmail_manager_->Subscribe([](const agentmail_message_t& msg) {
+        test_state.messages_received++;
+        
+        ESP_LOGI(TAG, "Pushed message: %s - %s", 
+                 msg.from ? msg.from : "unknown",
+                 msg.subject ? msg.subject : "(no subject)");
+        
+        std::string op = "Received: ";
+        op += msg.subject ? msg.subject : "(no subject)";
+        update_operation(op, true);
+    });
+    
     // Start background tasks
     ESP_LOGI(TAG, "Starting background tasks...");
     xTaskCreate(ui_update_task, "agentmail_ui_update", 